@@ -0,0 +1,220 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <harfbuzz-shaper.h>
+#include "harfbuzz-sfnt.h"
+
+// The mapping of a font file. It is shared by every face opened from it and
+// by every blob handed out, and unmapped when the last of them goes away.
+typedef struct {
+  const uint8_t *data;
+  size_t length;
+  int refcount;
+} hb_sfnt_file;
+
+struct hb_sfnt_face {
+  hb_sfnt_file *file;
+  const uint8_t *directory;  // the offset table of this face
+  unsigned num_tables;
+};
+
+#if defined(__GNUC__)
+#define hb_sfnt_ref(file) __sync_add_and_fetch(&(file)->refcount, 1)
+#define hb_sfnt_unref(file) __sync_sub_and_fetch(&(file)->refcount, 1)
+#else
+#define hb_sfnt_ref(file) (++(file)->refcount)
+#define hb_sfnt_unref(file) (--(file)->refcount)
+#endif
+
+static uint16_t
+read_u16(const uint8_t *p) {
+  return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static uint32_t
+read_u32(const uint8_t *p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+         ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static hb_sfnt_file *
+hb_sfnt_file_map(const char *path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < 12) {
+    close(fd);
+    return NULL;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  hb_sfnt_file *file = (hb_sfnt_file *) malloc(sizeof(hb_sfnt_file));
+  if (!file) {
+    munmap(data, st.st_size);
+    return NULL;
+  }
+  file->data = (const uint8_t *) data;
+  file->length = st.st_size;
+  file->refcount = 1;
+  return file;
+}
+
+static void
+hb_sfnt_file_release(void *voidfile) {
+  hb_sfnt_file *file = (hb_sfnt_file *) voidfile;
+  if (hb_sfnt_unref(file) == 0) {
+    munmap((void *) file->data, file->length);
+    free(file);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Return the number of faces in @file and, if @index is one of them, store
+// the offset of its offset table in @offset.
+// -----------------------------------------------------------------------------
+static unsigned
+hb_sfnt_file_faces(const hb_sfnt_file *file, unsigned index,
+                   uint32_t *offset) {
+  const uint8_t *data = file->data;
+  const uint32_t tag = read_u32(data);
+
+  if (tag == HB_MAKE_TAG('t', 't', 'c', 'f')) {
+    const uint32_t num_fonts = read_u32(data + 8);
+    if (num_fonts > (file->length - 12) / 4)
+      return 0;
+    if (index < num_fonts)
+      *offset = read_u32(data + 12 + 4 * index);
+    return num_fonts;
+  }
+
+  if (tag != 0x00010000 && tag != HB_MAKE_TAG('O', 'T', 'T', 'O') &&
+      tag != HB_MAKE_TAG('t', 'r', 'u', 'e'))
+    return 0;
+  if (index == 0)
+    *offset = 0;
+  return 1;
+}
+
+unsigned
+hb_sfnt_face_count(const char *path) {
+  hb_sfnt_file *file = hb_sfnt_file_map(path);
+  if (!file)
+    return 0;
+
+  uint32_t offset;
+  const unsigned count = hb_sfnt_file_faces(file, 0, &offset);
+  hb_sfnt_file_release(file);
+  return count;
+}
+
+hb_sfnt_face *
+hb_sfnt_face_open(const char *path, unsigned index) {
+  hb_sfnt_file *file = hb_sfnt_file_map(path);
+  if (!file)
+    return NULL;
+
+  uint32_t offset;
+  if (index >= hb_sfnt_file_faces(file, index, &offset) ||
+      offset > file->length || file->length - offset < 12) {
+    hb_sfnt_file_release(file);
+    return NULL;
+  }
+
+  const uint8_t *directory = file->data + offset;
+  const unsigned num_tables = read_u16(directory + 4);
+  if ((file->length - offset - 12) / 16 < num_tables) {
+    hb_sfnt_file_release(file);
+    return NULL;
+  }
+
+  hb_sfnt_face *face = (hb_sfnt_face *) malloc(sizeof(hb_sfnt_face));
+  if (!face) {
+    hb_sfnt_file_release(file);
+    return NULL;
+  }
+  face->file = file;
+  face->directory = directory;
+  face->num_tables = num_tables;
+  return face;
+}
+
+void
+hb_sfnt_face_close(hb_sfnt_face *face) {
+  if (!face)
+    return;
+  hb_sfnt_file_release(face->file);
+  free(face);
+}
+
+static HB_Error
+hb_sfnt_table_find(const hb_sfnt_face *face, HB_Tag tag,
+                   const uint8_t **data, uint32_t *length) {
+  const uint8_t *record = face->directory + 12;
+  unsigned i;
+
+  for (i = 0; i < face->num_tables; ++i, record += 16) {
+    if (read_u32(record) != tag)
+      continue;
+
+    const uint32_t offset = read_u32(record + 8);
+    const uint32_t len = read_u32(record + 12);
+    if (offset > face->file->length || len > face->file->length - offset)
+      return HB_Err_Invalid_Argument;
+
+    *data = face->file->data + offset;
+    *length = len;
+    return HB_Err_Ok;
+  }
+
+  return HB_Err_Not_Covered;
+}
+
+HB_Error
+hb_sfnt_table_blob_get(void *voidface, HB_Tag tag, HB_BlobRec *blob) {
+  hb_sfnt_face *face = (hb_sfnt_face *) voidface;
+  const uint8_t *data;
+  uint32_t length;
+
+  const HB_Error error = hb_sfnt_table_find(face, tag, &data, &length);
+  if (error)
+    return error;
+
+  hb_sfnt_ref(face->file);
+  blob->data = data;
+  blob->length = length;
+  blob->destroy = hb_sfnt_file_release;
+  blob->user_data = face->file;
+  return HB_Err_Ok;
+}
+
+HB_Error
+hb_sfnt_table_get(void *voidface, HB_Tag tag, HB_Byte *buffer,
+                  HB_UInt *len) {
+  hb_sfnt_face *face = (hb_sfnt_face *) voidface;
+  const uint8_t *data;
+  uint32_t length;
+
+  const HB_Error error = hb_sfnt_table_find(face, tag, &data, &length);
+  if (error)
+    return error;
+
+  if (buffer) {
+    if (*len < length)
+      return HB_Err_Invalid_Argument;
+    memcpy(buffer, data, length);
+  }
+  *len = length;
+  return HB_Err_Ok;
+}
@@ -0,0 +1,41 @@
+#ifndef HB_SFNT_H_
+#define HB_SFNT_H_
+
+#include <harfbuzz-shaper.h>
+
+// -----------------------------------------------------------------------------
+// A font table provider that maps a .ttf, .otf or .ttc file into memory and
+// hands out the tables straight from the mapping, without FreeType and
+// without copying. The mapping is shared between all faces of a collection
+// and stays alive until the last face and the last table blob are released.
+// -----------------------------------------------------------------------------
+typedef struct hb_sfnt_face hb_sfnt_face;
+
+// -----------------------------------------------------------------------------
+// Return the number of faces in the font file at @path: 1 for a plain sfnt,
+// the number of fonts in a TrueType collection, and 0 if the file can't be
+// read or isn't an sfnt.
+// -----------------------------------------------------------------------------
+unsigned hb_sfnt_face_count(const char *path);
+
+// -----------------------------------------------------------------------------
+// Map the file at @path and open the face @index of it (must be 0 unless the
+// file is a TrueType collection). Returns NULL on error.
+// -----------------------------------------------------------------------------
+hb_sfnt_face *hb_sfnt_face_open(const char *path, unsigned index);
+
+void hb_sfnt_face_close(hb_sfnt_face *face);
+
+// -----------------------------------------------------------------------------
+// HB_GetFontTableBlobFunc for HB_NewFaceFromBlobs(), @voidface is the
+// hb_sfnt_face.
+// -----------------------------------------------------------------------------
+HB_Error hb_sfnt_table_blob_get(void *voidface, HB_Tag tag, HB_BlobRec *blob);
+
+// -----------------------------------------------------------------------------
+// HB_GetFontTableFunc for HB_NewFace(), which copies the table.
+// -----------------------------------------------------------------------------
+HB_Error hb_sfnt_table_get(void *voidface, HB_Tag tag, HB_Byte *buffer,
+                           HB_UInt *len);
+
+#endif  // HB_SFNT_H_
@@ -1009,7 +1009,7 @@ static HB_Bool arabicSyriacOpenTypeShape(HB_ShaperItem *item, HB_Bool *ot_ok)
         ++l;
         ++properties;
     }
-    if (f + l < item->stringLength) {
+    if (item->item.pos + item->item.length < item->stringLength) {
         ++l;
     }
     getArabicProperties(uc+f, l, props);
@@ -61,6 +61,10 @@ _hb_buffer_add_output_glyph ( HB_Buffer buffer,
 HB_INTERNAL HB_Error
 _hb_buffer_copy_output_glyph ( HB_Buffer buffer );
 
+HB_INTERNAL HB_Error
+_hb_buffer_copy_output_glyphs ( HB_Buffer buffer,
+				HB_UInt   count );
+
 HB_INTERNAL HB_Error
 _hb_buffer_replace_output_glyph ( HB_Buffer buffer,
 				  HB_UInt   glyph_index,
@@ -69,6 +73,10 @@ _hb_buffer_replace_output_glyph ( HB_Buffer buffer,
 HB_INTERNAL HB_UShort
 _hb_buffer_allocate_ligid( HB_Buffer buffer );
 
+HB_INTERNAL void
+_hb_buffer_reset_skip_lists( HB_Buffer buffer,
+			     HB_Bool   enable );
+
 
 /* convenience macros */
 
@@ -87,6 +95,16 @@ _hb_buffer_allocate_ligid( HB_Buffer buffer );
           ( ( error = _HB_GDEF_Check_Property( (gdef), (index), (flags),		\
                                       (property) ) ) != HB_Err_Ok )
 
+/* move `pos' to the nearest glyph of the input string at or after
+   (resp. before) it which isn't ignored by `flags'                  */
+
+#define SKIP_Forward( gdef, flags, pos )						\
+          ( ( error = _HB_GDEF_Skip_Forward( (gdef), buffer, (flags),			\
+					     &(pos) ) ) != HB_Err_Ok )
+#define SKIP_Backward( gdef, flags, pos )						\
+          ( ( error = _HB_GDEF_Skip_Backward( (gdef), buffer, (flags),			\
+					      &(pos) ) ) != HB_Err_Ok )
+
 #define ADD_String( buffer, num_in, num_out, glyph_data, component, ligID )             \
           ( ( error = _hb_buffer_add_output_glyphs( (buffer),                            \
 						    (num_in), (num_out),                \
@@ -101,6 +119,8 @@ _hb_buffer_allocate_ligid( HB_Buffer buffer );
 						      (nesting_level) == 1 ) ) != HB_Err_Ok )
 #define COPY_Glyph( buffer )								\
 	  ( (error = _hb_buffer_copy_output_glyph ( buffer ) ) != HB_Err_Ok )
+#define COPY_Glyphs( buffer, count )							\
+	  ( (error = _hb_buffer_copy_output_glyphs ( buffer, count ) ) != HB_Err_Ok )
 
 HB_END_HEADER
 
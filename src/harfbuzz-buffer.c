@@ -80,6 +80,10 @@ hb_buffer_ensure( HB_Buffer buffer,
 
       if ( REALLOC_ARRAY( buffer->in_string, new_allocated, HB_GlyphItemRec ) )
 	return error;
+#ifdef HB_PARALLEL_GINDEX
+      if ( REALLOC_ARRAY( buffer->in_gindex, new_allocated, HB_UShort ) )
+	return error;
+#endif
 
       if ( buffer->separate_out )
         {
@@ -87,6 +91,12 @@ hb_buffer_ensure( HB_Buffer buffer,
 	    return error;
 
 	  buffer->out_string = buffer->alt_string;
+#ifdef HB_PARALLEL_GINDEX
+	  if ( REALLOC_ARRAY( buffer->alt_gindex, new_allocated, HB_UShort ) )
+	    return error;
+
+	  buffer->out_gindex = buffer->alt_gindex;
+#endif
 	}
       else
         {
@@ -97,6 +107,15 @@ hb_buffer_ensure( HB_Buffer buffer,
 	      if ( REALLOC_ARRAY( buffer->alt_string, new_allocated, HB_GlyphItemRec ) )
 		return error;
 	    }
+#ifdef HB_PARALLEL_GINDEX
+	  buffer->out_gindex = buffer->in_gindex;
+
+	  if ( buffer->alt_gindex )
+	    {
+	      if ( REALLOC_ARRAY( buffer->alt_gindex, new_allocated, HB_UShort ) )
+		return error;
+	    }
+#endif
 	}
 
       buffer->allocated = new_allocated;
@@ -118,6 +137,18 @@ hb_buffer_duplicate_out_buffer( HB_Buffer buffer )
 
   buffer->out_string = buffer->alt_string;
   memcpy( buffer->out_string, buffer->in_string, buffer->out_length * sizeof (buffer->out_string[0]) );
+#ifdef HB_PARALLEL_GINDEX
+  if ( !buffer->alt_gindex )
+    {
+      HB_Error error;
+
+      if ( ALLOC_ARRAY( buffer->alt_gindex, buffer->allocated, HB_UShort ) )
+	return error;
+    }
+
+  buffer->out_gindex = buffer->alt_gindex;
+  memcpy( buffer->out_gindex, buffer->in_gindex, buffer->out_length * sizeof (buffer->out_gindex[0]) );
+#endif
   buffer->separate_out = TRUE;
 
   return HB_Err_Ok;
@@ -137,7 +168,13 @@ hb_buffer_new( HB_Buffer *pbuffer )
   buffer->allocated = 0;
   buffer->in_string = NULL;
   buffer->alt_string = NULL;
+#ifdef HB_PARALLEL_GINDEX
+  buffer->in_gindex = NULL;
+  buffer->alt_gindex = NULL;
+#endif
   buffer->positions = NULL;
+  buffer->skip_lists = NULL;
+  buffer->skip_allocated = 0;
 
   hb_buffer_clear( buffer );
 
@@ -152,7 +189,13 @@ hb_buffer_free( HB_Buffer buffer )
   FREE( buffer->in_string );
   FREE( buffer->alt_string );
   buffer->out_string = NULL;
+#ifdef HB_PARALLEL_GINDEX
+  FREE( buffer->in_gindex );
+  FREE( buffer->alt_gindex );
+  buffer->out_gindex = NULL;
+#endif
   FREE( buffer->positions );
+  FREE( buffer->skip_lists );
   FREE( buffer );
 }
 
@@ -164,8 +207,55 @@ hb_buffer_clear( HB_Buffer buffer )
   buffer->in_pos = 0;
   buffer->out_pos = 0;
   buffer->out_string = buffer->in_string;
+#ifdef HB_PARALLEL_GINDEX
+  buffer->out_gindex = buffer->in_gindex;
+#endif
   buffer->separate_out = FALSE;
   buffer->max_ligID = 0;
+  DIGEST_Clear( &buffer->digest );
+  _hb_buffer_reset_skip_lists( buffer, FALSE );
+}
+
+HB_Error
+hb_buffer_reserve( HB_Buffer buffer,
+		   HB_UInt   size )
+{
+  HB_Error error;
+
+  error = hb_buffer_ensure( buffer, size );
+  if ( error )
+    return error;
+
+  /* the arrays which are otherwise allocated on first use */
+  if ( !buffer->positions )
+    {
+      if ( ALLOC_ARRAY( buffer->positions, buffer->allocated, HB_PositionRec ) )
+	return error;
+    }
+
+  if ( !buffer->alt_string )
+    {
+      if ( ALLOC_ARRAY( buffer->alt_string, buffer->allocated, HB_GlyphItemRec ) )
+	return error;
+    }
+#ifdef HB_PARALLEL_GINDEX
+  if ( !buffer->alt_gindex )
+    {
+      if ( ALLOC_ARRAY( buffer->alt_gindex, buffer->allocated, HB_UShort ) )
+	return error;
+    }
+#endif
+
+  /* the skip lists, see Get_Skip_List() in harfbuzz-gdef.c */
+  if ( buffer->skip_allocated < 2 * size * HB_BUFFER_SKIP_LISTS )
+    {
+      if ( REALLOC_ARRAY( buffer->skip_lists, 2 * size * HB_BUFFER_SKIP_LISTS,
+			  HB_UInt ) )
+	return error;
+      buffer->skip_allocated = 2 * size * HB_BUFFER_SKIP_LISTS;
+    }
+
+  return HB_Err_Ok;
 }
 
 HB_Error
@@ -188,8 +278,13 @@ hb_buffer_add_glyph( HB_Buffer buffer,
   glyph->component = 0;
   glyph->ligID = 0;
   glyph->gproperties = HB_GLYPH_PROPERTIES_UNKNOWN;
+#ifdef HB_PARALLEL_GINDEX
+  buffer->in_gindex[buffer->in_length] = (HB_UShort)glyph_index;
+#endif
+  DIGEST_Add_Glyph( &buffer->digest, glyph_index );
   
   buffer->in_length++;
+  buffer->skip_enabled = FALSE;
 
   return HB_Err_Ok;
 }
@@ -202,6 +297,9 @@ _hb_buffer_clear_output( HB_Buffer buffer )
   buffer->out_length = 0;
   buffer->out_pos = 0;
   buffer->out_string = buffer->in_string;
+#ifdef HB_PARALLEL_GINDEX
+  buffer->out_gindex = buffer->in_gindex;
+#endif
   buffer->separate_out = FALSE;
 }
 
@@ -234,6 +332,11 @@ _hb_buffer_swap( HB_Buffer buffer )
       buffer->in_string = buffer->out_string;
       buffer->out_string = tmp_string;
       buffer->alt_string = buffer->out_string;
+#ifdef HB_PARALLEL_GINDEX
+      buffer->alt_gindex = buffer->in_gindex;
+      buffer->in_gindex = buffer->out_gindex;
+      buffer->out_gindex = buffer->alt_gindex;
+#endif
     }
 
   tmp_length = buffer->in_length;
@@ -243,6 +346,21 @@ _hb_buffer_swap( HB_Buffer buffer )
   tmp_pos = buffer->in_pos;
   buffer->in_pos = buffer->out_pos;
   buffer->out_pos = tmp_pos;
+
+  buffer->skip_enabled = FALSE;
+}
+
+/* Drop the skip lists of the buffer.  While a string lookup runs
+   forwards over the input string, it doesn't change (glyphs are only
+   written behind `in_pos'), so the lists may be built; `enable' says
+   whether this is such a lookup.                                     */
+
+HB_INTERNAL void
+_hb_buffer_reset_skip_lists( HB_Buffer buffer,
+			     HB_Bool   enable )
+{
+  buffer->skip_count = 0;
+  buffer->skip_enabled = enable;
 }
 
 /* The following function copies `num_out' elements from `glyph_data'
@@ -305,6 +423,10 @@ _hb_buffer_add_output_glyphs( HB_Buffer  buffer,
     item->component = component;
     item->ligID = ligID;
     item->gproperties = HB_GLYPH_PROPERTIES_UNKNOWN;
+#ifdef HB_PARALLEL_GINDEX
+    buffer->out_gindex[buffer->out_pos + i] = glyph_data[i];
+#endif
+    DIGEST_Add_Glyph( &buffer->digest, glyph_data[i] );
   }
 
   buffer->in_pos  += num_in;
@@ -339,6 +461,9 @@ _hb_buffer_copy_output_glyph ( HB_Buffer buffer )
   if ( buffer->separate_out )
     {
       buffer->out_string[buffer->out_pos] = buffer->in_string[buffer->in_pos];
+#ifdef HB_PARALLEL_GINDEX
+      buffer->out_gindex[buffer->out_pos] = buffer->in_gindex[buffer->in_pos];
+#endif
     }
 
   buffer->in_pos++;
@@ -348,6 +473,35 @@ _hb_buffer_copy_output_glyph ( HB_Buffer buffer )
   return HB_Err_Ok;
 }
 
+HB_INTERNAL HB_Error
+_hb_buffer_copy_output_glyphs ( HB_Buffer buffer,
+				HB_UInt   count )
+{
+  HB_Error  error;
+
+  error = hb_buffer_ensure( buffer, buffer->out_pos + count );
+  if ( error )
+    return error;
+
+  if ( buffer->separate_out )
+    {
+      memcpy( buffer->out_string + buffer->out_pos,
+	      buffer->in_string + buffer->in_pos,
+	      count * sizeof( HB_GlyphItemRec ) );
+#ifdef HB_PARALLEL_GINDEX
+      memcpy( buffer->out_gindex + buffer->out_pos,
+	      buffer->in_gindex + buffer->in_pos,
+	      count * sizeof( HB_UShort ) );
+#endif
+    }
+
+  buffer->in_pos += count;
+  buffer->out_pos += count;
+  buffer->out_length = buffer->out_pos;
+
+  return HB_Err_Ok;
+}
+
 HB_INTERNAL HB_Error
 _hb_buffer_replace_output_glyph( HB_Buffer buffer,
 				 HB_UInt   glyph_index,
@@ -363,6 +517,27 @@ _hb_buffer_replace_output_glyph( HB_Buffer buffer,
 	return error;
 
       buffer->out_string[buffer->out_pos-1].gindex = glyph_index;
+#ifdef HB_PARALLEL_GINDEX
+      buffer->out_gindex[buffer->out_pos-1] = (HB_UShort)glyph_index;
+#endif
+      DIGEST_Add_Glyph( &buffer->digest, glyph_index );
+    }
+  else if ( !buffer->separate_out )
+    {
+      /* the output string still is the input string, and replacing a
+	 glyph keeps it that way                                      */
+      HB_GlyphItem item = &buffer->in_string[buffer->in_pos];
+
+      item->gindex = glyph_index;
+      item->gproperties = HB_GLYPH_PROPERTIES_UNKNOWN;
+#ifdef HB_PARALLEL_GINDEX
+      buffer->in_gindex[buffer->in_pos] = (HB_UShort)glyph_index;
+#endif
+      DIGEST_Add_Glyph( &buffer->digest, glyph_index );
+
+      buffer->in_pos++;
+      buffer->out_pos++;
+      buffer->out_length = buffer->out_pos;
     }
   else
     {
@@ -32,6 +32,41 @@
 
 HB_BEGIN_HEADER
 
+/* With HB_COMPACT_BUFFER defined, glyph indices are stored as the 16-bit
+   glyph IDs of OpenType and the fields are ordered so that a glyph item
+   takes 16 instead of 20 bytes.  The last three fields of a position
+   share 32 bits, so that it takes 20 instead of 24 bytes; a position
+   can then go back at most 32767 glyphs.
+   The define changes the layout of these records, so it must be the same
+   for the library and the code using it.                                 */
+
+#ifdef HB_COMPACT_BUFFER
+
+typedef struct HB_GlyphItemRec_ {
+  HB_UInt     properties;
+  HB_UInt     cluster;
+  HB_UShort   gindex;
+  HB_UShort   component;
+  HB_UShort   ligID;
+  HB_UShort   gproperties;
+} HB_GlyphItemRec, *HB_GlyphItem;
+
+/* the fields are those of the default layout below */
+
+typedef struct HB_PositionRec_ {
+  HB_Fixed      x_pos;
+  HB_Fixed      y_pos;
+  HB_Fixed      x_advance;
+  HB_Fixed      y_advance;
+  unsigned int  back          : 15;
+  unsigned int  new_advance   : 1;
+  signed int    cursive_chain : 16;
+} HB_PositionRec, *HB_Position;
+
+#define HB_POSITION_MAX_BACK  32767
+
+#else
+
 typedef struct HB_GlyphItemRec_ {
   HB_UInt     gindex;
   HB_UInt     properties;
@@ -57,6 +92,20 @@ typedef struct HB_PositionRec_ {
 				 only internally                     */
 } HB_PositionRec, *HB_Position;
 
+#define HB_POSITION_MAX_BACK  65535
+
+#endif
+
+
+#define HB_BUFFER_SKIP_LISTS  2
+
+/* With HB_PARALLEL_GINDEX defined, the buffer also keeps the glyph IDs
+   of its strings in arrays of their own (in_gindex, out_gindex and
+   alt_gindex, in the low 16 bits), which the string lookups scan to pass
+   over the glyphs they can't apply at.  The glyph IDs of the strings
+   must then only be changed through the buffer.  The define changes the
+   layout of HB_BufferRec, so it must be the same for the library and the
+   code using it.                                                        */
 
 typedef struct HB_BufferRec_{ 
   HB_UInt    allocated;
@@ -70,8 +119,25 @@ typedef struct HB_BufferRec_{
   HB_GlyphItem  in_string;
   HB_GlyphItem  out_string;
   HB_GlyphItem  alt_string;
+#ifdef HB_PARALLEL_GINDEX
+  HB_UShort*    in_gindex;
+  HB_UShort*    out_gindex;
+  HB_UShort*    alt_gindex;
+#endif
   HB_Position   positions;
   HB_UShort      max_ligID;
+
+  HB_GlyphDigest digest;      /* of all glyphs added to the buffer since
+				 it was cleared; lookups which can't
+				 apply to them are skipped             */
+
+  HB_UInt*   skip_lists;      /* glyphs not ignored by the lookup flags
+				 `skip_flags', for every position of the
+				 input string; see harfbuzz-gdef.c     */
+  HB_UInt    skip_allocated;
+  HB_UShort  skip_flags[HB_BUFFER_SKIP_LISTS];
+  HB_UShort  skip_count;      /* number of lists built               */
+  HB_Bool    skip_enabled;    /* the input string is fixed for now   */
 } HB_BufferRec, *HB_Buffer;
 
 HB_Error
@@ -83,6 +149,14 @@ hb_buffer_free( HB_Buffer buffer );
 void
 hb_buffer_clear( HB_Buffer buffer );
 
+/* Makes room for `size' glyphs in all strings and arrays of the buffer,
+   so that holding and shaping that many glyphs needs no allocation.
+   The buffer keeps its memory when cleared, so a buffer reused for
+   strings of at most `size' glyphs won't allocate again.              */
+HB_Error
+hb_buffer_reserve( HB_Buffer buffer,
+		   HB_UInt   size );
+
 HB_Error
 hb_buffer_add_glyph( HB_Buffer buffer,
 		      HB_UInt    glyph_index,
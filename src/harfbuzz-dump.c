@@ -197,7 +197,7 @@ DEF_DUMP (Coverage)
 
       for (i = 0; i < Coverage->cf.cf1.GlyphCount; i++)
 	DUMP2("<Glyph>%#06x</Glyph> <!-- %d -->\n",
-	      Coverage->cf.cf1.GlyphArray[i], i);
+	      ARRAY_UShort (Coverage->cf.cf1.GlyphArray, i), i);
     }
   else
     {
@@ -206,20 +206,11 @@ DEF_DUMP (Coverage)
 
       for ( i = 0; i < Coverage->cf.cf2.RangeCount; i++ )
 	  DUMP3("<Glyph>%#06x - %#06x</Glyph> <!-- %d -->\n",
-	        Coverage->cf.cf2.RangeRecord[i].Start,
-	        Coverage->cf.cf2.RangeRecord[i].End, i);
+	        RANGE_Start (Coverage->cf.cf2.RangeRecord, i),
+	        RANGE_End (Coverage->cf.cf2.RangeRecord, i), i);
     }
 }
 
-DEF_DUMP (ClassRangeRecord)
-{
-  HB_UNUSED(hb_type);
-
-  DUMP_FGLYPH (ClassRangeRecord, Start);
-  DUMP_FGLYPH (ClassRangeRecord, End);
-  DUMP_FUINT (ClassRangeRecord, Class);
-}
-
 DEF_DUMP (ClassDefinition)
 {
   HB_UNUSED(hb_type);
@@ -235,7 +226,7 @@ DEF_DUMP (ClassDefinition)
       DUMP_FUINT (ClassDefFormat1, StartGlyph );
       DUMP_FUINT (ClassDefFormat1, GlyphCount );
       for (i = 0; i < ClassDefFormat1->GlyphCount; i++)
-	DUMP2(" <Class>%d</Class> <!-- %#06x -->", ClassDefFormat1->ClassValueArray[i],
+	DUMP2(" <Class>%d</Class> <!-- %#06x -->", ARRAY_UShort (ClassDefFormat1->ClassValueArray, i),
 	      ClassDefFormat1->StartGlyph+i );
     }
   else if (ClassDefinition->ClassFormat == 2)
@@ -245,7 +236,17 @@ DEF_DUMP (ClassDefinition)
       DUMP_FUINT (ClassDefFormat2, ClassRangeCount);
 
       for (i = 0; i < ClassDefFormat2->ClassRangeCount; i++)
-	RECURSE_NUM (ClassRangeRecord, i, ClassRangeRecord, &ClassDefFormat2->ClassRangeRecord[i]);
+	{
+	  const HB_Byte *crr = ClassDefFormat2->ClassRangeRecord;
+
+	  DUMP1 ("<ClassRangeRecord> <!-- %d -->\n", i);
+	  indent++;
+	  DUMP1 ("<Start>%#06x</Start>\n", RANGE_Start (crr, i));
+	  DUMP1 ("<End>%#06x</End>\n", RANGE_End (crr, i));
+	  DUMP1 ("<Class>%u</Class>\n", RANGE_Value (crr, i));
+	  indent--;
+	  DUMP ("</ClassRangeRecord>\n");
+	}
     }
   else
     fprintf(stderr, "invalid class def table!!!\n");
@@ -722,7 +723,7 @@ DEF_DUMP (Lookup)
   for (i=0; i < Lookup->SubTableCount; i++)
     {
       DUMP ("<Subtable>\n");
-      if (lookup_func)
+      if (lookup_func && Lookup->SubTable)
 	(*lookup_func) (&Lookup->SubTable[i], stream, indent + 1, hb_type);
       DUMP ("</Subtable>\n");
     }
@@ -735,7 +736,15 @@ DEF_DUMP (LookupList)
   DUMP_FUINT (LookupList, LookupCount);
 
   for (i=0; i < LookupList->LookupCount; i++)
-    RECURSE_NUM (Lookup, i, Lookup, &LookupList->Lookup[i]);
+    {
+      /* the subtables of a lookup which can't be loaded are left out */
+      HB_Lookup lookup = LookupList->Lookup[i];
+
+      (void)_HB_OPEN_Get_Lookup_SubTables (LookupList, i, hb_type,
+					   &lookup.SubTable,
+					   &lookup.SubTableCount);
+      RECURSE_NUM (Lookup, i, Lookup, &lookup);
+    }
 }
 
 void
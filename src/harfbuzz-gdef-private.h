@@ -113,6 +113,18 @@ _HB_GDEF_Check_Property( HB_GDEFHeader* gdef,
 				   HB_UShort        flags,
 				   HB_UShort*       property );
 
+HB_INTERNAL HB_Error
+_HB_GDEF_Skip_Forward( HB_GDEFHeader* gdef,
+		       HB_Buffer      buffer,
+		       HB_UShort      flags,
+		       HB_UInt*       pos );
+
+HB_INTERNAL HB_Error
+_HB_GDEF_Skip_Backward( HB_GDEFHeader* gdef,
+			HB_Buffer      buffer,
+			HB_UShort      flags,
+			HB_UInt*       pos );
+
 HB_INTERNAL HB_Error
 _HB_GDEF_LoadMarkAttachClassDef_From_LookupFlags( HB_GDEFHeader* gdef,
 						  HB_Stream      input,
@@ -32,10 +32,8 @@ static HB_Error  Load_AttachList( HB_AttachList*  al,
 static HB_Error  Load_LigCaretList( HB_LigCaretList*  lcl,
 				    HB_Stream          stream );
 
-static void  Free_AttachList( HB_AttachList*  al);
-static void  Free_LigCaretList( HB_LigCaretList*  lcl);
-
 static void  Free_NewGlyphClasses( HB_GDEFHeader*  gdef);
+static HB_Error  Make_Glyph_Properties( HB_GDEFHeader*  gdef );
 
 
 
@@ -57,12 +55,25 @@ HB_Error  HB_New_GDEF_Table( HB_GDEFHeader** retptr )
   HB_Error         error;
 
   HB_GDEFHeader*  gdef;
+  HB_Arena        arena;
 
   if ( !retptr )
     return ERR(HB_Err_Invalid_Argument);
 
-  if ( ALLOC( gdef, sizeof( *gdef ) ) )
+  /* the header and all subtables loaded later go into one arena */
+
+  arena = _hb_arena_new( HB_TABLE_ARENA_CHUNK, &error );
+  if ( error )
+    return error;
+
+  gdef = _hb_arena_alloc( arena, sizeof( *gdef ), &error );
+  if ( error )
+  {
+    _hb_arena_free( arena );
     return error;
+  }
+
+  gdef->arena = arena;
 
   gdef->GlyphClassDef.loaded = FALSE;
   gdef->AttachList.loaded = FALSE;
@@ -73,6 +84,9 @@ HB_Error  HB_New_GDEF_Table( HB_GDEFHeader** retptr )
   gdef->LastGlyph = 0;
   gdef->NewGlyphClasses = NULL;
 
+  gdef->GlyphProperties = NULL;
+  gdef->GlyphPropertyCount = 0;
+
   *retptr = gdef;
 
   return HB_Err_Ok;
@@ -97,13 +111,15 @@ HB_Error  HB_Load_GDEF_Table( HB_Stream stream,
   if (( error = HB_New_GDEF_Table ( &gdef ) ))
     return error;
 
+  stream->arena = gdef->arena;
+
   base_offset = FILE_Pos();
 
   /* skip version */
 
   if ( FILE_Seek( base_offset + 4L ) ||
        ACCESS_Frame( 2L ) )
-    goto Fail0;
+    goto Fail;
 
   new_offset = GET_UShort();
 
@@ -121,12 +137,12 @@ HB_Error  HB_Load_GDEF_Table( HB_Stream stream,
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_ClassDefinition( &gdef->GlyphClassDef, 5,
 					 stream ) ) != HB_Err_Ok )
-      goto Fail0;
+      goto Fail;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail1;
+    goto Fail;
 
   new_offset = GET_UShort();
 
@@ -140,12 +156,12 @@ HB_Error  HB_Load_GDEF_Table( HB_Stream stream,
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_AttachList( &gdef->AttachList,
 				    stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      goto Fail;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    goto Fail;
 
   new_offset = GET_UShort();
 
@@ -159,7 +175,7 @@ HB_Error  HB_Load_GDEF_Table( HB_Stream stream,
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_LigCaretList( &gdef->LigCaretList,
 				      stream ) ) != HB_Err_Ok )
-      goto Fail2;
+      goto Fail;
     (void)FILE_Seek( cur_offset );
   }
 
@@ -168,7 +184,7 @@ HB_Error  HB_Load_GDEF_Table( HB_Stream stream,
      must load it or not.  Here we only store the offset of the table. */
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    goto Fail;
 
   new_offset = GET_UShort();
 
@@ -179,21 +195,23 @@ HB_Error  HB_Load_GDEF_Table( HB_Stream stream,
   else
     gdef->MarkAttachClassDef_offset = 0;
 
-  *retptr = gdef;
+  stream->arena = NULL;
 
-  return HB_Err_Ok;
+  if ( ( error = Make_Glyph_Properties( gdef ) ) != HB_Err_Ok )
+    goto Fail;
 
-Fail3:
-  Free_LigCaretList( &gdef->LigCaretList );
-  
-Fail2:
-  Free_AttachList( &gdef->AttachList );
+  /* class definition and coverage tables are used in place, so keep
+     the table data                                                  */
+  gdef->Stream = *stream;
+  stream->destroy = NULL;
 
-Fail1:
-  _HB_OPEN_Free_ClassDefinition( &gdef->GlyphClassDef );
+  *retptr = gdef;
+
+  return HB_Err_Ok;
 
-Fail0:
-  FREE( gdef );
+Fail:
+  stream->arena = NULL;
+  HB_Done_GDEF_Table( gdef );
 
   return error;
 }
@@ -201,14 +219,12 @@ Fail0:
 
 HB_Error  HB_Done_GDEF_Table ( HB_GDEFHeader* gdef ) 
 {  
-  Free_LigCaretList( &gdef->LigCaretList );
-  Free_AttachList( &gdef->AttachList );
-  _HB_OPEN_Free_ClassDefinition( &gdef->GlyphClassDef );
-  _HB_OPEN_Free_ClassDefinition( &gdef->MarkAttachClassDef );
-  
   Free_NewGlyphClasses( gdef );
 
-  FREE( gdef );
+  if ( gdef->Stream.destroy )
+    gdef->Stream.destroy( gdef->Stream.user_data );
+
+  _hb_arena_free( gdef->arena );
 
   return HB_Err_Ok;
 }
@@ -243,16 +259,13 @@ static HB_Error  Load_AttachPoint( HB_AttachPoint*  ap,
 
   if ( count )
   {
-    if ( ALLOC_ARRAY( ap->PointIndex, count, HB_UShort ) )
+    if ( ARENA_ALLOC_ARRAY( ap->PointIndex, count, HB_UShort ) )
       return error;
 
     pi = ap->PointIndex;
 
     if ( ACCESS_Frame( count * 2L ) )
-    {
-      FREE( pi );
       return error;
-    }
 
     for ( n = 0; n < count; n++ )
       pi[n] = GET_UShort();
@@ -264,12 +277,6 @@ static HB_Error  Load_AttachPoint( HB_AttachPoint*  ap,
 }
 
 
-static void  Free_AttachPoint( HB_AttachPoint*  ap )
-{
-  FREE( ap->PointIndex );
-}
-
-
 /* AttachList */
 
 static HB_Error  Load_AttachList( HB_AttachList*  al,
@@ -277,7 +284,7 @@ static HB_Error  Load_AttachList( HB_AttachList*  al,
 {
   HB_Error  error;
 
-  HB_UShort         n, m, count;
+  HB_UShort         n, count;
   HB_UInt          cur_offset, new_offset, base_offset;
 
   HB_AttachPoint*  ap;
@@ -299,7 +306,7 @@ static HB_Error  Load_AttachList( HB_AttachList*  al,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = al->GlyphCount = GET_UShort();
 
@@ -307,15 +314,15 @@ static HB_Error  Load_AttachList( HB_AttachList*  al,
 
   al->AttachPoint = NULL;
 
-  if ( ALLOC_ARRAY( al->AttachPoint, count, HB_AttachPoint ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( al->AttachPoint, count, HB_AttachPoint ) )
+    return error;
 
   ap = al->AttachPoint;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -324,48 +331,13 @@ static HB_Error  Load_AttachList( HB_AttachList*  al,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_AttachPoint( &ap[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   al->loaded = TRUE;
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_AttachPoint( &ap[m] );
-
-  FREE( ap );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &al->Coverage );
-  return error;
-}
-
-
-static void  Free_AttachList( HB_AttachList*  al)
-{
-  HB_UShort         n, count;
-
-  HB_AttachPoint*  ap;
-
-
-  if ( !al->loaded )
-    return;
-
-  if ( al->AttachPoint )
-  {
-    count = al->GlyphCount;
-    ap    = al->AttachPoint;
-
-    for ( n = 0; n < count; n++ )
-      Free_AttachPoint( &ap[n] );
-
-    FREE( ap );
-  }
-
-  _HB_OPEN_Free_Coverage( &al->Coverage );
 }
 
 
@@ -455,13 +427,6 @@ static HB_Error  Load_CaretValue( HB_CaretValue*  cv,
 }
 
 
-static void  Free_CaretValue( HB_CaretValue*  cv)
-{
-  if ( cv->CaretValueFormat == 3 )
-    _HB_OPEN_Free_Device( &cv->cvf.cvf3.Device );
-}
-
-
 /* LigGlyph */
 
 static HB_Error  Load_LigGlyph( HB_LigGlyph*  lg,
@@ -469,7 +434,7 @@ static HB_Error  Load_LigGlyph( HB_LigGlyph*  lg,
 {
   HB_Error  error;
 
-  HB_UShort        n, m, count;
+  HB_UShort        n, count;
   HB_UInt         cur_offset, new_offset, base_offset;
 
   HB_CaretValue*  cv;
@@ -486,7 +451,7 @@ static HB_Error  Load_LigGlyph( HB_LigGlyph*  lg,
 
   lg->CaretValue = NULL;
 
-  if ( ALLOC_ARRAY( lg->CaretValue, count, HB_CaretValue ) )
+  if ( ARENA_ALLOC_ARRAY( lg->CaretValue, count, HB_CaretValue ) )
     return error;
 
   cv = lg->CaretValue;
@@ -494,7 +459,7 @@ static HB_Error  Load_LigGlyph( HB_LigGlyph*  lg,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -503,38 +468,11 @@ static HB_Error  Load_LigGlyph( HB_LigGlyph*  lg,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_CaretValue( &cv[n], stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_CaretValue( &cv[m] );
-
-  FREE( cv );
-  return error;
-}
-
-
-static void  Free_LigGlyph( HB_LigGlyph*  lg)
-{
-  HB_UShort        n, count;
-
-  HB_CaretValue*  cv;
-
-
-  if ( lg->CaretValue )
-  {
-    count = lg->CaretCount;
-    cv    = lg->CaretValue;
-
-    for ( n = 0; n < count; n++ )
-      Free_CaretValue( &cv[n] );
-
-    FREE( cv );
-  }
 }
 
 
@@ -545,7 +483,7 @@ static HB_Error  Load_LigCaretList( HB_LigCaretList*  lcl,
 {
   HB_Error  error;
 
-  HB_UShort      m, n, count;
+  HB_UShort      n, count;
   HB_UInt       cur_offset, new_offset, base_offset;
 
   HB_LigGlyph*  lg;
@@ -567,7 +505,7 @@ static HB_Error  Load_LigCaretList( HB_LigCaretList*  lcl,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = lcl->LigGlyphCount = GET_UShort();
 
@@ -575,15 +513,15 @@ static HB_Error  Load_LigCaretList( HB_LigCaretList*  lcl,
 
   lcl->LigGlyph = NULL;
 
-  if ( ALLOC_ARRAY( lcl->LigGlyph, count, HB_LigGlyph ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( lcl->LigGlyph, count, HB_LigGlyph ) )
+    return error;
 
   lg = lcl->LigGlyph;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -592,48 +530,13 @@ static HB_Error  Load_LigCaretList( HB_LigCaretList*  lcl,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_LigGlyph( &lg[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   lcl->loaded = TRUE;
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_LigGlyph( &lg[m] );
-
-  FREE( lg );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &lcl->Coverage );
-  return error;
-}
-
-
-static void  Free_LigCaretList( HB_LigCaretList*  lcl )
-{
-  HB_UShort      n, count;
-
-  HB_LigGlyph*  lg;
-
-
-  if ( !lcl->loaded )
-    return;
-
-  if ( lcl->LigGlyph )
-  {
-    count = lcl->LigGlyphCount;
-    lg    = lcl->LigGlyph;
-
-    for ( n = 0; n < count; n++ )
-      Free_LigGlyph( &lg[n] );
-
-    FREE( lg );
-  }
-
-  _HB_OPEN_Free_Coverage( &lcl->Coverage );
 }
 
 
@@ -650,7 +553,7 @@ static HB_UShort  Get_New_Class( HB_GDEFHeader*  gdef,
   HB_UShort              glyph_index, array_index, count;
   HB_UShort              byte, bits;
   
-  HB_ClassRangeRecord*  gcrr;
+  const HB_Byte*         gcrr;
   HB_UShort**            ngc;
 
 
@@ -661,18 +564,18 @@ static HB_UShort  Get_New_Class( HB_GDEFHeader*  gdef,
   gcrr = gdef->GlyphClassDef.cd.cd2.ClassRangeRecord;
   ngc  = gdef->NewGlyphClasses;
 
-  if ( index < count && glyphID < gcrr[index].Start )
+  if ( index < count && glyphID < RANGE_Start( gcrr, index ) )
   {
     array_index = index;
     if ( index == 0 )
       glyph_index = glyphID;
     else
-      glyph_index = glyphID - gcrr[index - 1].End - 1;
+      glyph_index = glyphID - RANGE_End( gcrr, index - 1 ) - 1;
   }
   else
   {
     array_index = index + 1;
-    glyph_index = glyphID - gcrr[index].End - 1;
+    glyph_index = glyphID - RANGE_End( gcrr, index ) - 1;
   }
 
   byte = ngc[array_index][glyph_index / 4];
@@ -695,6 +598,13 @@ HB_Error  HB_GDEF_Get_Glyph_Property( HB_GDEFHeader*  gdef,
   if ( !gdef || !property )
     return ERR(HB_Err_Invalid_Argument);
 
+  if ( gdef->GlyphProperties )
+  {
+    *property = glyphID < gdef->GlyphPropertyCount ?
+		  gdef->GlyphProperties[glyphID] : 0;
+    return HB_Err_Ok;
+  }
+
   /* first, we check for mark attach classes */
 
   if ( gdef->MarkAttachClassDef.loaded )
@@ -747,33 +657,99 @@ HB_Error  HB_GDEF_Get_Glyph_Property( HB_GDEFHeader*  gdef,
 }
 
 
+/* one more than the largest glyph ID covered by `cd' */
+
+static HB_UInt  ClassDef_Glyph_Limit( HB_ClassDefinition*  cd )
+{
+  HB_UInt         limit = 0;
+  HB_UShort       n;
+  const HB_Byte*  crr;
+
+
+  if ( !cd->loaded )
+    return 0;
+
+  if ( cd->ClassFormat == 1 )
+    return cd->cd.cd1.GlyphCount ?
+	     cd->cd.cd1.StartGlyph + (HB_UInt)cd->cd.cd1.GlyphCount : 0;
+
+  crr = cd->cd.cd2.ClassRangeRecord;
+
+  for ( n = 0; n < cd->cd.cd2.ClassRangeCount; n++ )
+    if ( RANGE_End( crr, n ) + 1UL > limit )
+      limit = RANGE_End( crr, n ) + 1UL;
+
+  return limit;
+}
+
+
+static HB_Error  Make_Glyph_Properties( HB_GDEFHeader*  gdef )
+{
+  HB_Error    error;
+  HB_UInt     glyph, count;
+  HB_UShort*  properties;
+
+
+  count = ClassDef_Glyph_Limit( &gdef->GlyphClassDef );
+  glyph = ClassDef_Glyph_Limit( &gdef->MarkAttachClassDef );
+  if ( glyph > count )
+    count = glyph;
+
+  /* the array is only valid once complete */
+
+  gdef->GlyphProperties    = NULL;
+  gdef->GlyphPropertyCount = 0;
+
+  if ( !count )
+    return HB_Err_Ok;
+
+  properties = _hb_arena_alloc( gdef->arena, count * sizeof( HB_UShort ),
+				&error );
+  if ( error )
+    return error;
+
+  for ( glyph = 0; glyph < count; glyph++ )
+    if ( ( error = HB_GDEF_Get_Glyph_Property( gdef, (HB_UShort)glyph,
+					       &properties[glyph] ) ) != HB_Err_Ok )
+      return error;
+
+  gdef->GlyphProperties    = properties;
+  gdef->GlyphPropertyCount = count;
+
+  return HB_Err_Ok;
+}
+
+
 static HB_Error  Make_ClassRange( HB_ClassDefinition*  cd,
 				  HB_UShort             start,
 				  HB_UShort             end,
 				  HB_UShort             class )
 {
   HB_Error               error;
-  HB_UShort              index;
 
   HB_ClassDefFormat2*   cdf2;
-  HB_ClassRangeRecord*  crr;
+  HB_Byte*               crr;
 
 
   cdf2 = &cd->cd.cd2;
 
-  if ( REALLOC_ARRAY( cdf2->ClassRangeRecord,
-		      cdf2->ClassRangeCount + 1 ,
-		      HB_ClassRangeRecord ) )
+  /* a constructed class table is on the heap, in table byte order */
+
+  crr = (HB_Byte*)cdf2->ClassRangeRecord;
+
+  if ( REALLOC_ARRAY( crr, ( cdf2->ClassRangeCount + 1 ) * 6, HB_Byte ) )
     return error;
 
-  cdf2->ClassRangeCount++;
+  cdf2->ClassRangeRecord = crr;
 
-  crr   = cdf2->ClassRangeRecord;
-  index = cdf2->ClassRangeCount - 1;
+  crr += 6 * cdf2->ClassRangeCount++;
 
-  crr[index].Start = start;
-  crr[index].End   = end;
-  crr[index].Class = class;
+  crr[0] = start >> 8;
+  crr[1] = start & 0xFF;
+  crr[2] = end >> 8;
+  crr[3] = end & 0xFF;
+  crr[4] = class >> 8;
+  crr[5] = class & 0xFF;
 
   return HB_Err_Ok;
 }
@@ -791,7 +767,7 @@ HB_Error  HB_GDEF_Build_ClassDefinition( HB_GDEFHeader*  gdef,
   HB_Error               error;
 
   HB_ClassDefinition*   gcd;
-  HB_ClassRangeRecord*  gcrr;
+  const HB_Byte*         gcrr;
   HB_UShort**            ngc;
 
 
@@ -800,6 +776,11 @@ HB_Error  HB_GDEF_Build_ClassDefinition( HB_GDEFHeader*  gdef,
 
   gcd = &gdef->GlyphClassDef;
 
+  /* the classes of a constructed table change, so always look them up */
+
+  gdef->GlyphProperties    = NULL;
+  gdef->GlyphPropertyCount = 0;
+
   /* We build a format 2 table */
 
   gcd->ClassFormat = 2;
@@ -807,6 +788,10 @@ HB_Error  HB_GDEF_Build_ClassDefinition( HB_GDEFHeader*  gdef,
   gcd->cd.cd2.ClassRangeCount  = 0;
   gcd->cd.cd2.ClassRangeRecord = NULL;
 
+  /* the ranges are searched, as we need the index of the range records
+     around glyphs not covered (see Get_New_Class)                      */
+  gcd->cd.cd2.FlatCount        = 0;
+
   start      = glyph_array[0];
   curr_class = class_array[0];
   curr_glyph = start;
@@ -900,25 +885,27 @@ HB_Error  HB_GDEF_Build_ClassDefinition( HB_GDEFHeader*  gdef,
 
   if ( count > 0 )
   {
-      if ( gcrr[0].Start )
+      if ( RANGE_Start( gcrr, 0 ) )
       {
-	if ( ALLOC_ARRAY( ngc[0], ( gcrr[0].Start + 3 ) / 4, HB_UShort ) )
+	if ( ALLOC_ARRAY( ngc[0], ( RANGE_Start( gcrr, 0 ) + 3 ) / 4,
+			  HB_UShort ) )
 	  goto Fail2;
       }
 
       for ( n = 1; n < count; n++ )
       {
-	if ( gcrr[n].Start - gcrr[n - 1].End > 1 )
+	if ( RANGE_Start( gcrr, n ) - RANGE_End( gcrr, n - 1 ) > 1 )
 	  if ( ALLOC_ARRAY( ngc[n],
-			    ( gcrr[n].Start - gcrr[n - 1].End + 2 ) / 4,
+			    ( RANGE_Start( gcrr, n ) -
+			      RANGE_End( gcrr, n - 1 ) + 2 ) / 4,
 			    HB_UShort ) )
 	    goto Fail1;
       }
 
-      if ( gcrr[count - 1].End != num_glyphs - 1 )
+      if ( RANGE_End( gcrr, count - 1 ) != num_glyphs - 1 )
       {
 	if ( ALLOC_ARRAY( ngc[count],
-			  ( num_glyphs - gcrr[count - 1].End + 2 ) / 4,
+			  ( num_glyphs - RANGE_End( gcrr, count - 1 ) + 2 ) / 4,
 			  HB_UShort ) )
 	    goto Fail1;
       }
@@ -948,7 +935,8 @@ Fail2:
   FREE( gdef->NewGlyphClasses );
 
 Fail3:
-  FREE( gcd->cd.cd2.ClassRangeRecord );
+  _hb_free( (HB_Pointer)gcd->cd.cd2.ClassRangeRecord );
+  gcd->cd.cd2.ClassRangeRecord = NULL;
 
 Fail4:
   return error;
@@ -970,6 +958,10 @@ static void  Free_NewGlyphClasses( HB_GDEFHeader*  gdef )
       FREE( ngc[n] );
 
     FREE( ngc );
+
+    /* a constructed class table isn't in the arena */
+    _hb_free( (HB_Pointer)gdef->GlyphClassDef.cd.cd2.ClassRangeRecord );
+    gdef->GlyphClassDef.cd.cd2.ClassRangeRecord = NULL;
   }
 }
 
@@ -984,7 +976,7 @@ _HB_GDEF_Add_Glyph_Property( HB_GDEFHeader* gdef,
   HB_UShort              byte, bits, mask;
   HB_UShort              array_index, glyph_index, count;
 
-  HB_ClassRangeRecord*  gcrr;
+  const HB_Byte*         gcrr;
   HB_UShort**            ngc;
 
 
@@ -1027,18 +1019,18 @@ _HB_GDEF_Add_Glyph_Property( HB_GDEFHeader* gdef,
   gcrr = gdef->GlyphClassDef.cd.cd2.ClassRangeRecord;
   ngc  = gdef->NewGlyphClasses;
 
-  if ( index < count && glyphID < gcrr[index].Start )
+  if ( index < count && glyphID < RANGE_Start( gcrr, index ) )
   {
     array_index = index;
     if ( index == 0 )
       glyph_index = glyphID;
     else
-      glyph_index = glyphID - gcrr[index - 1].End - 1;
+      glyph_index = glyphID - RANGE_End( gcrr, index - 1 ) - 1;
   }
   else
   {
     array_index = index + 1;
-    glyph_index = glyphID - gcrr[index].End - 1;
+    glyph_index = glyphID - RANGE_End( gcrr, index ) - 1;
   }
 
   byte  = ngc[array_index][glyph_index / 4];
@@ -1073,14 +1065,22 @@ _HB_GDEF_Check_Property( HB_GDEFHeader* gdef,
     HB_UShort basic_glyph_class;
     HB_UShort desired_attachment_class;
 
-    if ( gitem->gproperties == HB_GLYPH_PROPERTIES_UNKNOWN )
+    if ( gdef->GlyphProperties )
     {
-      error = HB_GDEF_Get_Glyph_Property( gdef, gitem->gindex, &gitem->gproperties );
-      if ( error )
-	return error;
+      *property = gitem->gindex < gdef->GlyphPropertyCount ?
+		    gdef->GlyphProperties[gitem->gindex] : 0;
     }
+    else
+    {
+      if ( gitem->gproperties == HB_GLYPH_PROPERTIES_UNKNOWN )
+      {
+	error = HB_GDEF_Get_Glyph_Property( gdef, gitem->gindex, &gitem->gproperties );
+	if ( error )
+	  return error;
+      }
 
-    *property = gitem->gproperties;
+      *property = gitem->gproperties;
+    }
 
     /* If the glyph was found in the MarkAttachmentClass table,
      * then that class value is the high byte of the result,
@@ -1116,6 +1116,171 @@ _HB_GDEF_Check_Property( HB_GDEFHeader* gdef,
   return HB_Err_Ok;
 }
 
+
+/* Context, ligature and mark lookups step over the glyphs ignored by
+   the lookup flags, and in mark-heavy text the same glyphs are looked
+   at again and again.  For up to HB_BUFFER_SKIP_LISTS sets of flags
+   per string lookup, the buffer keeps the next and the previous glyph
+   not ignored for every position of the input string.  Each list is
+   built when first asked for; until then, and with constructed GDEF
+   tables (which gain glyph classes while lookups run), the string is
+   scanned as before.                                                 */
+
+#define SKIP_NONE  0xFFFFFFFFUL
+
+static HB_Error  Get_Skip_List( HB_GDEFHeader*  gdef,
+				HB_Buffer       buffer,
+				HB_UShort       flags,
+				HB_UInt**       list )
+{
+  HB_Error   error;
+  HB_UShort  property;
+  HB_UInt    n, i, s;
+  HB_UInt*   next;
+  HB_UInt*   prev;
+
+
+  *list = NULL;
+
+  n = buffer->in_length;
+
+  if ( !buffer->skip_enabled || !gdef || gdef->NewGlyphClasses || !n )
+    return HB_Err_Ok;
+
+  /* no glyph is ignored, the first one looked at is taken */
+  if ( !( flags & ( HB_LOOKUP_FLAG_IGNORE_BASE_GLYPHS |
+		    HB_LOOKUP_FLAG_IGNORE_LIGATURES   |
+		    HB_LOOKUP_FLAG_IGNORE_MARKS       |
+		    HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS ) ) )
+    return HB_Err_Ok;
+
+  for ( s = 0; s < buffer->skip_count; s++ )
+    if ( buffer->skip_flags[s] == flags )
+    {
+      *list = buffer->skip_lists + 2 * n * s;
+      return HB_Err_Ok;
+    }
+
+  if ( s == HB_BUFFER_SKIP_LISTS )
+    return HB_Err_Ok;
+
+  if ( buffer->skip_allocated < 2 * n * HB_BUFFER_SKIP_LISTS )
+  {
+    if ( REALLOC_ARRAY( buffer->skip_lists, 2 * n * HB_BUFFER_SKIP_LISTS,
+			HB_UInt ) )
+      return error;
+    buffer->skip_allocated = 2 * n * HB_BUFFER_SKIP_LISTS;
+  }
+
+  next = buffer->skip_lists + 2 * n * s;
+  prev = next + n;
+
+  for ( i = 0; i < n; i++ )
+  {
+    if ( !CHECK_Property( gdef, IN_ITEM( i ), flags, &property ) )
+      prev[i] = i;
+    else if ( error != HB_Err_Not_Covered )
+      return error;
+    else
+      prev[i] = i ? prev[i - 1] : SKIP_NONE;
+  }
+
+  next[n - 1] = prev[n - 1] == n - 1 ? n - 1 : n;
+  for ( i = n - 1; i-- > 0; )
+    next[i] = prev[i] == i ? i : next[i + 1];
+
+  buffer->skip_flags[s] = flags;
+  buffer->skip_count    = (HB_UShort)( s + 1 );
+
+  *list = next;
+  return HB_Err_Ok;
+}
+
+
+/* Returns HB_Err_Not_Covered (with `*pos' set to the string length)
+   if there is no such glyph.                                        */
+
+HB_INTERNAL HB_Error
+_HB_GDEF_Skip_Forward( HB_GDEFHeader* gdef,
+		       HB_Buffer      buffer,
+		       HB_UShort      flags,
+		       HB_UInt*       pos )
+{
+  HB_Error   error;
+  HB_UShort  property;
+  HB_UInt    j = *pos;
+  HB_UInt*   list;
+
+
+  if ( j >= buffer->in_length )
+  {
+    *pos = buffer->in_length;
+    return HB_Err_Not_Covered;
+  }
+
+  error = Get_Skip_List( gdef, buffer, flags, &list );
+  if ( error )
+    return error;
+
+  if ( list )
+    j = list[j];
+  else
+    for ( ; j < buffer->in_length; j++ )
+    {
+      if ( !CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
+	break;
+      if ( error != HB_Err_Not_Covered )
+	return error;
+    }
+
+  *pos = j;
+
+  return j < buffer->in_length ? HB_Err_Ok : HB_Err_Not_Covered;
+}
+
+
+/* `*pos' must be inside of the string; returns HB_Err_Not_Covered if
+   there is no such glyph.                                             */
+
+HB_INTERNAL HB_Error
+_HB_GDEF_Skip_Backward( HB_GDEFHeader* gdef,
+			HB_Buffer      buffer,
+			HB_UShort      flags,
+			HB_UInt*       pos )
+{
+  HB_Error   error;
+  HB_UShort  property;
+  HB_UInt    j = *pos;
+  HB_UInt*   list;
+
+
+  error = Get_Skip_List( gdef, buffer, flags, &list );
+  if ( error )
+    return error;
+
+  if ( list )
+    j = list[buffer->in_length + j];
+  else
+    for ( ;; j-- )
+    {
+      if ( !CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
+	break;
+      if ( error != HB_Err_Not_Covered )
+	return error;
+      if ( !j )
+      {
+	j = SKIP_NONE;
+	break;
+      }
+    }
+
+  if ( j == SKIP_NONE )
+    return HB_Err_Not_Covered;
+
+  *pos = j;
+  return HB_Err_Ok;
+}
+
 HB_INTERNAL HB_Error
 _HB_GDEF_LoadMarkAttachClassDef_From_LookupFlags( HB_GDEFHeader* gdef,
 						  HB_Stream      stream,
@@ -1124,6 +1289,7 @@ _HB_GDEF_LoadMarkAttachClassDef_From_LookupFlags( HB_GDEFHeader* gdef,
 {
   HB_Error   error = HB_Err_Ok;
   HB_UShort  i;
+  HB_Arena   arena;
 
   /* We now check the LookupFlags for values larger than 0xFF to find
      out whether we need to load the `MarkAttachClassDef' field of the
@@ -1142,17 +1308,23 @@ _HB_GDEF_LoadMarkAttachClassDef_From_LookupFlags( HB_GDEFHeader* gdef,
 
       if ( lo[i].LookupFlag & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS )
       {
-	if ( FILE_Seek( gdef->MarkAttachClassDef_offset ) ||
-	     ( error = _HB_OPEN_Load_ClassDefinition( &gdef->MarkAttachClassDef,
-					     256, stream ) ) != HB_Err_Ok )
-	  goto Done;
+	/* the class table belongs to GDEF, not to the lookup table */
+	arena = stream->arena;
+	stream->arena = gdef->arena;
+
+	if ( !FILE_Seek( gdef->MarkAttachClassDef_offset ) )
+	  error = _HB_OPEN_Load_ClassDefinition( &gdef->MarkAttachClassDef,
+						 256, stream );
+
+	stream->arena = arena;
 
+	if ( !error && !gdef->NewGlyphClasses )
+	  error = Make_Glyph_Properties( gdef );
 	break;
       }
     }
   }
 
-Done:
   return error;
 }
 
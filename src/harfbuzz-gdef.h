@@ -87,7 +87,13 @@ typedef struct HB_LigCaretList_  HB_LigCaretList;
    `Version' field value hasn't been increased to indicate that we have
    one more field for some obscure reason, we must parse the GSUB table
    to find out whether class values refer to this table.  Only then we
-   can finally load the MarkAttachClassDef structure if necessary.      */
+   can finally load the MarkAttachClassDef structure if necessary.
+
+   `GlyphProperties' holds the result of HB_GDEF_Get_Glyph_Property()
+   for the glyphs 0 to `GlyphPropertyCount' - 1, all glyphs covered by
+   the class tables; other glyphs have no properties.  It is built
+   whenever a class table has been loaded, but not for constructed
+   tables, as their classes change while applying lookups.             */
 
 struct  HB_GDEFHeader_
 {
@@ -103,6 +109,14 @@ struct  HB_GDEFHeader_
 
   HB_UShort            LastGlyph;
   HB_UShort**          NewGlyphClasses;
+
+  HB_UShort*           GlyphProperties;
+  HB_UInt              GlyphPropertyCount;
+
+  HB_Arena             arena;     /* holds the header and the loaded
+					 subtables                       */
+  HB_StreamRec         Stream;    /* the table data, which is read in
+					 place                           */
 };
 
 typedef struct HB_GDEFHeader_   HB_GDEFHeader;
@@ -112,6 +126,9 @@ typedef struct HB_GDEFHeader_*  HB_GDEF;
 HB_Error  HB_New_GDEF_Table( HB_GDEFHeader** retptr );
       
 
+/* On success the table takes over the data of `stream' (its destroy
+   function is cleared), as class definition and coverage tables are
+   read from it in place; it is released by HB_Done_GDEF_Table().     */
 HB_Error  HB_Load_GDEF_Table( HB_Stream       stream,
 			      HB_GDEFHeader** gdef );
 
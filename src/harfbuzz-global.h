@@ -109,8 +109,20 @@ typedef struct {
     HB_Fixed y;
 } HB_FixedPoint;
 
+/* A glyph digest is a small summary of a set of glyphs which rules out
+   most glyphs that aren't in the set: for each of HB_DIGEST_SHIFTS
+   shift widths, bit `(glyph >> shift) & 31' of the mask is set for
+   every glyph of the set.                                             */
+
+#define HB_DIGEST_SHIFTS  3
+
+typedef struct {
+    HB_UInt mask[HB_DIGEST_SHIFTS];
+} HB_GlyphDigest;
+
 typedef struct HB_Font_ *HB_Font;
 typedef struct HB_StreamRec_ *HB_Stream;
+typedef struct HB_ArenaRec_ HB_ArenaRec, *HB_Arena;
 typedef struct HB_FaceRec_ *HB_Face;
 
 HB_END_HEADER
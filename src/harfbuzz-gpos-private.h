@@ -208,6 +208,12 @@ struct  HB_PairSet_
 				      /* number of PairValueRecord tables */
   HB_PairValueRecord*  PairValueRecord;
 				      /* array of PairValueRecord tables  */
+
+  /* The second glyphs again, packed for searching; if they are sorted
+     (as they should be) they are searched by bisection.              */
+
+  HB_UShort*            SecondGlyph;
+  HB_Bool               Sorted;
 };
 
 typedef struct HB_PairSet_  HB_PairSet;
@@ -239,6 +245,33 @@ struct  HB_Class1Record_
 typedef struct HB_Class1Record_  HB_Class1Record;
 
 
+/* The values of a PairPosFormat2 subtable resolved for one font scale:
+   for every pair of classes the adjustments of the first and the
+   second glyph, with device tables applied.  Only the position fields
+   the value formats can change are stored, `Stride' values per pair.
+   Matrices are built on demand and never freed before the table.      */
+
+#define HB_KERN_MATRIX_MAX_SCALES  4      /* per subtable             */
+#define HB_KERN_MATRIX_MAX_VALUES  65536  /* per matrix               */
+
+struct  HB_KernMatrix_
+{
+  struct HB_KernMatrix_*  next;      /* another scale of the subtable  */
+  struct HB_KernMatrix_*  chain;     /* all matrices of the table      */
+
+  HB_UShort    x_ppem, y_ppem;
+  HB_16Dot16   x_scale, y_scale;
+  HB_Bool      dvi;
+
+  HB_UShort    Fields1;              /* position fields of the first   */
+  HB_UShort    Fields2;              /* and of the second glyph        */
+  HB_UShort    Stride;
+  HB_Fixed*    Values;
+};
+
+typedef struct HB_KernMatrix_  HB_KernMatrix;
+
+
 struct  HB_PairPosFormat2_
 {
   HB_ClassDefinition  ClassDef1;     /* class def. for first glyph     */
@@ -248,6 +281,8 @@ struct  HB_PairPosFormat2_
   HB_UShort            Class2Count;   /* number of classes in ClassDef2
 					 table                          */
   HB_Class1Record*    Class1Record;  /* array of Class1Record tables   */
+
+  HB_KernMatrix*      Matrices;      /* resolved values per scale      */
 };
 
 typedef struct HB_PairPosFormat2_  HB_PairPosFormat2;
@@ -546,6 +581,8 @@ struct  HB_ChainPosRuleSet_
   HB_UShort          ChainPosRuleCount;
 				      /* number of ChainPosRule tables */
   HB_ChainPosRule*  ChainPosRule;    /* array of ChainPosRule tables  */
+
+  HB_ChainTrie       Trie;            /* the rules, compiled          */
 };
 
 typedef struct HB_ChainPosRuleSet_  HB_ChainPosRuleSet;
@@ -592,6 +629,8 @@ struct  HB_ChainPosClassSet_
   HB_ChainPosClassRule*  ChainPosClassRule;
 				      /* array of ChainPosClassRule
 					 tables                      */
+
+  HB_ChainTrie            Trie;       /* the rules, compiled          */
 };
 
 typedef struct HB_ChainPosClassSet_  HB_ChainPosClassSet;
@@ -703,9 +742,9 @@ _HB_GPOS_Load_SubTable( HB_GPOS_SubTable* st,
 				  HB_Stream     stream,
 				  HB_UShort     lookup_type );
 
-HB_INTERNAL void
-_HB_GPOS_Free_SubTable( HB_GPOS_SubTable* st,
-			      HB_UShort     lookup_type );
+HB_INTERNAL HB_Coverage*
+_HB_GPOS_First_Coverage( HB_GPOS_SubTable* st,
+			 HB_UShort         lookup_type );
 
 HB_END_HEADER
 
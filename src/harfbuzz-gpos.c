@@ -82,6 +82,7 @@ HB_Error  HB_Load_GPOS_Table( HB_Stream stream,
   HB_UInt         cur_offset, new_offset, base_offset;
 
   HB_GPOSHeader*  gpos;
+  HB_Arena        arena;
 
   HB_Error   error;
 
@@ -94,8 +95,16 @@ HB_Error  HB_Load_GPOS_Table( HB_Stream stream,
 
   base_offset = FILE_Pos();
 
-  if ( ALLOC ( gpos, sizeof( *gpos ) ) )
+  /* everything but the lookup subtables is allocated in one arena */
+
+  arena = _hb_arena_new( HB_TABLE_ARENA_CHUNK, &error );
+  if ( error )
     return error;
+  stream->arena = arena;
+
+  if ( ARENA_ALLOC( gpos, sizeof( *gpos ) ) )
+    goto Fail;
+  gpos->arena = arena;
 
   gpos->mmfunc = default_mmfunc;
 
@@ -103,7 +112,7 @@ HB_Error  HB_Load_GPOS_Table( HB_Stream stream,
 
   if ( FILE_Seek( base_offset + 4L ) ||
        ACCESS_Frame( 2L ) )
-    goto Fail4;
+    goto Fail;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -113,11 +122,11 @@ HB_Error  HB_Load_GPOS_Table( HB_Stream stream,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_ScriptList( &gpos->ScriptList,
 				  stream ) ) != HB_Err_Ok )
-    goto Fail4;
+    goto Fail;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    goto Fail;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -127,11 +136,11 @@ HB_Error  HB_Load_GPOS_Table( HB_Stream stream,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_FeatureList( &gpos->FeatureList,
 				   stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    goto Fail;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    goto Fail;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -141,30 +150,28 @@ HB_Error  HB_Load_GPOS_Table( HB_Stream stream,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_LookupList( &gpos->LookupList,
 				  stream, HB_Type_GPOS ) ) != HB_Err_Ok )
-    goto Fail2;
+    goto Fail;
 
   gpos->gdef = gdef;      /* can be NULL */
 
   if ( ( error =  _HB_GDEF_LoadMarkAttachClassDef_From_LookupFlags( gdef, gdefStream,
 								     gpos->LookupList.Lookup,
 								     gpos->LookupList.LookupCount ) ) )
-    goto Fail1;
-
-  *retptr = gpos;
+    goto Fail;
 
-  return HB_Err_Ok;
+  stream->arena = NULL;
 
-Fail1:
-  _HB_OPEN_Free_LookupList( &gpos->LookupList, HB_Type_GPOS );
+  /* the lookup subtables are loaded on demand, so keep the table data */
+  gpos->LookupList.Stream = *stream;
+  stream->destroy = NULL;
 
-Fail2:
-  _HB_OPEN_Free_FeatureList( &gpos->FeatureList );
+  *retptr = gpos;
 
-Fail3:
-  _HB_OPEN_Free_ScriptList( &gpos->ScriptList );
+  return HB_Err_Ok;
 
-Fail4:
-  FREE( gpos );
+Fail:
+  stream->arena = NULL;
+  _hb_arena_free( arena );
 
   return error;
 }
@@ -172,11 +179,17 @@ Fail4:
 
 HB_Error  HB_Done_GPOS_Table( HB_GPOSHeader* gpos )
 {
-  _HB_OPEN_Free_LookupList( &gpos->LookupList, HB_Type_GPOS );
-  _HB_OPEN_Free_FeatureList( &gpos->FeatureList );
-  _HB_OPEN_Free_ScriptList( &gpos->ScriptList );
+  HB_KernMatrix*  m;
+
+
+  while ( ( m = gpos->kern_matrices ) != NULL )
+  {
+    gpos->kern_matrices = m->chain;
+    FREE( m );
+  }
 
-  FREE( gpos );
+  _HB_OPEN_Free_LookupList( &gpos->LookupList );
+  _hb_arena_free( gpos->arena );
 
   return HB_Err_Ok;
 }
@@ -286,7 +299,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
   if ( format & HB_GPOS_FORMAT_HAVE_Y_PLACEMENT_DEVICE )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail3;
+      return error;
 
     new_offset = GET_UShort();
 
@@ -300,7 +313,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = _HB_OPEN_Load_Device( &vr->YPlacementDevice,
 				  stream ) ) != HB_Err_Ok )
-	goto Fail3;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -317,7 +330,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
   if ( format & HB_GPOS_FORMAT_HAVE_X_ADVANCE_DEVICE )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     new_offset = GET_UShort();
 
@@ -331,7 +344,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = _HB_OPEN_Load_Device( &vr->XAdvanceDevice,
 				  stream ) ) != HB_Err_Ok )
-	goto Fail2;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -348,7 +361,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
   if ( format & HB_GPOS_FORMAT_HAVE_Y_ADVANCE_DEVICE )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort();
 
@@ -362,7 +375,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = _HB_OPEN_Load_Device( &vr->YAdvanceDevice,
 				  stream ) ) != HB_Err_Ok )
-	goto Fail1;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -379,7 +392,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
   if ( format & HB_GPOS_FORMAT_HAVE_X_ID_PLACEMENT )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     vr->XIdPlacement = GET_UShort();
 
@@ -391,7 +404,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
   if ( format & HB_GPOS_FORMAT_HAVE_Y_ID_PLACEMENT )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     vr->YIdPlacement = GET_UShort();
 
@@ -403,7 +416,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
   if ( format & HB_GPOS_FORMAT_HAVE_X_ID_ADVANCE )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     vr->XIdAdvance = GET_UShort();
 
@@ -415,7 +428,7 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
   if ( format & HB_GPOS_FORMAT_HAVE_Y_ID_ADVANCE )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     vr->YIdAdvance = GET_UShort();
 
@@ -425,30 +438,6 @@ static HB_Error  Load_ValueRecord( HB_ValueRecord*  vr,
     vr->YIdAdvance = 0;
 
   return HB_Err_Ok;
-
-Fail1:
-  _HB_OPEN_Free_Device( &vr->YAdvanceDevice );
-
-Fail2:
-  _HB_OPEN_Free_Device( &vr->XAdvanceDevice );
-
-Fail3:
-  _HB_OPEN_Free_Device( &vr->YPlacementDevice );
-  return error;
-}
-
-
-static void  Free_ValueRecord( HB_ValueRecord*  vr,
-			       HB_UShort         format )
-{
-  if ( format & HB_GPOS_FORMAT_HAVE_Y_ADVANCE_DEVICE )
-    _HB_OPEN_Free_Device( &vr->YAdvanceDevice );
-  if ( format & HB_GPOS_FORMAT_HAVE_X_ADVANCE_DEVICE )
-    _HB_OPEN_Free_Device( &vr->XAdvanceDevice );
-  if ( format & HB_GPOS_FORMAT_HAVE_Y_PLACEMENT_DEVICE )
-    _HB_OPEN_Free_Device( &vr->YPlacementDevice );
-  if ( format & HB_GPOS_FORMAT_HAVE_X_PLACEMENT_DEVICE )
-    _HB_OPEN_Free_Device( &vr->XPlacementDevice );
 }
 
 
@@ -625,7 +614,7 @@ static HB_Error  Load_Anchor( HB_Anchor*  an,
     }
 
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort();
 
@@ -639,7 +628,7 @@ static HB_Error  Load_Anchor( HB_Anchor*  an,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = _HB_OPEN_Load_Device( &an->af.af3.YDeviceTable,
 				  stream ) ) != HB_Err_Ok )
-	goto Fail;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -665,20 +654,6 @@ static HB_Error  Load_Anchor( HB_Anchor*  an,
   }
 
   return HB_Err_Ok;
-
-Fail:
-  _HB_OPEN_Free_Device( &an->af.af3.XDeviceTable );
-  return error;
-}
-
-
-static void  Free_Anchor( HB_Anchor*  an)
-{
-  if ( an->PosFormat == 3 )
-  {
-    _HB_OPEN_Free_Device( &an->af.af3.YDeviceTable );
-    _HB_OPEN_Free_Device( &an->af.af3.XDeviceTable );
-  }
 }
 
 
@@ -779,7 +754,7 @@ static HB_Error  Load_MarkArray ( HB_MarkArray*  ma,
 {
   HB_Error  error;
 
-  HB_UShort        n, m, count;
+  HB_UShort        n, count;
   HB_UInt         cur_offset, new_offset, base_offset;
 
   HB_MarkRecord*  mr;
@@ -796,7 +771,7 @@ static HB_Error  Load_MarkArray ( HB_MarkArray*  ma,
 
   ma->MarkRecord = NULL;
 
-  if ( ALLOC_ARRAY( ma->MarkRecord, count, HB_MarkRecord ) )
+  if ( ARENA_ALLOC_ARRAY( ma->MarkRecord, count, HB_MarkRecord ) )
     return error;
 
   mr = ma->MarkRecord;
@@ -804,7 +779,7 @@ static HB_Error  Load_MarkArray ( HB_MarkArray*  ma,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 4L ) )
-      goto Fail;
+      return error;
 
     mr[n].Class = GET_UShort();
     new_offset  = GET_UShort() + base_offset;
@@ -814,38 +789,11 @@ static HB_Error  Load_MarkArray ( HB_MarkArray*  ma,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_Anchor( &mr[n].MarkAnchor, stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_Anchor( &mr[m].MarkAnchor );
-
-  FREE( mr );
-  return error;
-}
-
-
-static void  Free_MarkArray( HB_MarkArray*  ma )
-{
-  HB_UShort        n, count;
-
-  HB_MarkRecord*  mr;
-
-
-  if ( ma->MarkRecord )
-  {
-    count = ma->MarkCount;
-    mr    = ma->MarkRecord;
-
-    for ( n = 0; n < count; n++ )
-      Free_Anchor( &mr[n].MarkAnchor );
-
-    FREE( mr );
-  }
 }
 
 
@@ -860,7 +808,7 @@ static HB_Error  Load_SinglePos( HB_GPOS_SubTable* st,
   HB_Error  error;
   HB_SinglePos*   sp = &st->single;
 
-  HB_UShort         n, m, count, format;
+  HB_UShort         n, count, format;
   HB_UInt          cur_offset, new_offset, base_offset;
 
   HB_ValueRecord*  vr;
@@ -893,12 +841,12 @@ static HB_Error  Load_SinglePos( HB_GPOS_SubTable* st,
     error = Load_ValueRecord( &sp->spf.spf1.Value, format,
 			      base_offset, stream );
     if ( error )
-      goto Fail2;
+      return error;
     break;
 
   case 2:
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     count = sp->spf.spf2.ValueCount = GET_UShort();
 
@@ -906,8 +854,8 @@ static HB_Error  Load_SinglePos( HB_GPOS_SubTable* st,
 
     sp->spf.spf2.Value = NULL;
 
-    if ( ALLOC_ARRAY( sp->spf.spf2.Value, count, HB_ValueRecord ) )
-      goto Fail2;
+    if ( ARENA_ALLOC_ARRAY( sp->spf.spf2.Value, count, HB_ValueRecord ) )
+      return error;
 
     vr = sp->spf.spf2.Value;
 
@@ -915,7 +863,7 @@ static HB_Error  Load_SinglePos( HB_GPOS_SubTable* st,
     {
       error = Load_ValueRecord( &vr[n], format, base_offset, stream );
       if ( error )
-	goto Fail1;
+	return error;
     }
     break;
 
@@ -924,52 +872,6 @@ static HB_Error  Load_SinglePos( HB_GPOS_SubTable* st,
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_ValueRecord( &vr[m], format );
-
-  FREE( vr );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &sp->Coverage );
-  return error;
-}
-
-
-static void  Free_SinglePos( HB_GPOS_SubTable* st )
-{
-  HB_UShort         n, count, format;
-  HB_SinglePos*   sp = &st->single;
-
-  HB_ValueRecord*  v;
-
-
-  format = sp->ValueFormat;
-
-  switch ( sp->PosFormat )
-  {
-  case 1:
-    Free_ValueRecord( &sp->spf.spf1.Value, format );
-    break;
-
-  case 2:
-    if ( sp->spf.spf2.Value )
-    {
-      count = sp->spf.spf2.ValueCount;
-      v     = sp->spf.spf2.Value;
-
-      for ( n = 0; n < count; n++ )
-	Free_ValueRecord( &v[n], format );
-
-      FREE( v );
-    }
-    break;
-  default:
-    break;
-  }
-
-  _HB_OPEN_Free_Coverage( &sp->Coverage );
 }
 
 static HB_Error  Lookup_SinglePos( GPOS_Instance*    gpi,
@@ -1035,7 +937,7 @@ static HB_Error  Load_PairSet ( HB_PairSet*  ps,
 {
   HB_Error  error;
 
-  HB_UShort             n, m, count;
+  HB_UShort             n, count;
   HB_UInt              base_offset;
 
   HB_PairValueRecord*  pvr;
@@ -1051,8 +953,11 @@ static HB_Error  Load_PairSet ( HB_PairSet*  ps,
   FORGET_Frame();
 
   ps->PairValueRecord = NULL;
+  ps->SecondGlyph     = NULL;
+  ps->Sorted          = TRUE;
 
-  if ( ALLOC_ARRAY( ps->PairValueRecord, count, HB_PairValueRecord ) )
+  if ( ARENA_ALLOC_ARRAY( ps->PairValueRecord, count, HB_PairValueRecord ) ||
+       ARENA_ALLOC_ARRAY( ps->SecondGlyph, count, HB_UShort ) )
     return error;
 
   pvr = ps->PairValueRecord;
@@ -1060,72 +965,32 @@ static HB_Error  Load_PairSet ( HB_PairSet*  ps,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
-    pvr[n].SecondGlyph = GET_UShort();
+    pvr[n].SecondGlyph = ps->SecondGlyph[n] = GET_UShort();
 
     FORGET_Frame();
 
+    if ( n && ps->SecondGlyph[n] < ps->SecondGlyph[n - 1] )
+      ps->Sorted = FALSE;
+
     if ( format1 )
     {
       error = Load_ValueRecord( &pvr[n].Value1, format1,
 				base_offset, stream );
       if ( error )
-	goto Fail;
+	return error;
     }
     if ( format2 )
     {
       error = Load_ValueRecord( &pvr[n].Value2, format2,
 				base_offset, stream );
       if ( error )
-      {
-	if ( format1 )
-	  Free_ValueRecord( &pvr[n].Value1, format1 );
-	goto Fail;
-      }
+	return error;
     }
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-  {
-    if ( format1 )
-      Free_ValueRecord( &pvr[m].Value1, format1 );
-    if ( format2 )
-      Free_ValueRecord( &pvr[m].Value2, format2 );
-  }
-
-  FREE( pvr );
-  return error;
-}
-
-
-static void  Free_PairSet( HB_PairSet*  ps,
-			   HB_UShort     format1,
-			   HB_UShort     format2 )
-{
-  HB_UShort             n, count;
-
-  HB_PairValueRecord*  pvr;
-
-
-  if ( ps->PairValueRecord )
-  {
-    count = ps->PairValueCount;
-    pvr   = ps->PairValueRecord;
-
-    for ( n = 0; n < count; n++ )
-    {
-      if ( format1 )
-	Free_ValueRecord( &pvr[n].Value1, format1 );
-      if ( format2 )
-	Free_ValueRecord( &pvr[n].Value2, format2 );
-    }
-
-    FREE( pvr );
-  }
 }
 
 
@@ -1138,7 +1003,7 @@ static HB_Error  Load_PairPos1( HB_PairPosFormat1*  ppf1,
 {
   HB_Error  error;
 
-  HB_UShort     n, m, count;
+  HB_UShort     n, count;
   HB_UInt      cur_offset, new_offset, base_offset;
 
   HB_PairSet*  ps;
@@ -1155,7 +1020,7 @@ static HB_Error  Load_PairPos1( HB_PairPosFormat1*  ppf1,
 
   ppf1->PairSet = NULL;
 
-  if ( ALLOC_ARRAY( ppf1->PairSet, count, HB_PairSet ) )
+  if ( ARENA_ALLOC_ARRAY( ppf1->PairSet, count, HB_PairSet ) )
     return error;
 
   ps = ppf1->PairSet;
@@ -1163,7 +1028,7 @@ static HB_Error  Load_PairPos1( HB_PairPosFormat1*  ppf1,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -1173,40 +1038,11 @@ static HB_Error  Load_PairPos1( HB_PairPosFormat1*  ppf1,
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_PairSet( &ps[n], format1,
 				 format2, stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_PairSet( &ps[m], format1, format2 );
-
-  FREE( ps );
-  return error;
-}
-
-
-static void  Free_PairPos1( HB_PairPosFormat1*  ppf1,
-			    HB_UShort            format1,
-			    HB_UShort            format2 )
-{
-  HB_UShort     n, count;
-
-  HB_PairSet*  ps;
-
-
-  if ( ppf1->PairSet )
-  {
-    count = ppf1->PairSetCount;
-    ps    = ppf1->PairSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_PairSet( &ps[n], format1, format2 );
-
-    FREE( ps );
-  }
 }
 
 
@@ -1219,7 +1055,7 @@ static HB_Error  Load_PairPos2( HB_PairPosFormat2*  ppf2,
 {
   HB_Error  error;
 
-  HB_UShort          m, n, k, count1, count2;
+  HB_UShort          m, n, count1, count2;
   HB_UInt           cur_offset, new_offset1, new_offset2, base_offset;
 
   HB_Class1Record*  c1r;
@@ -1250,13 +1086,13 @@ static HB_Error  Load_PairPos2( HB_PairPosFormat2*  ppf2,
   if ( FILE_Seek( new_offset2 ) ||
        ( error = _HB_OPEN_Load_ClassDefinition( &ppf2->ClassDef2, count2,
 				       stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   ppf2->Class1Record = NULL;
 
-  if ( ALLOC_ARRAY( ppf2->Class1Record, count1, HB_Class1Record ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ppf2->Class1Record, count1, HB_Class1Record ) )
+    return error;
 
   c1r = ppf2->Class1Record;
 
@@ -1264,8 +1100,8 @@ static HB_Error  Load_PairPos2( HB_PairPosFormat2*  ppf2,
   {
     c1r[m].Class2Record = NULL;
 
-    if ( ALLOC_ARRAY( c1r[m].Class2Record, count2, HB_Class2Record ) )
-      goto Fail1;
+    if ( ARENA_ALLOC_ARRAY( c1r[m].Class2Record, count2, HB_Class2Record ) )
+      return error;
 
     c2r = c1r[m].Class2Record;
 
@@ -1276,99 +1112,19 @@ static HB_Error  Load_PairPos2( HB_PairPosFormat2*  ppf2,
 	error = Load_ValueRecord( &c2r[n].Value1, format1,
 				  base_offset, stream );
 	if ( error )
-	  goto Fail0;
+	  return error;
       }
       if ( format2 )
       {
 	error = Load_ValueRecord( &c2r[n].Value2, format2,
 				  base_offset, stream );
 	if ( error )
-	{
-	  if ( format1 )
-	    Free_ValueRecord( &c2r[n].Value1, format1 );
-	  goto Fail0;
-	}
+	  return error;
       }
     }
-
-    continue;
-
-  Fail0:
-    for ( k = 0; k < n; k++ )
-    {
-      if ( format1 )
-	Free_ValueRecord( &c2r[k].Value1, format1 );
-      if ( format2 )
-	Free_ValueRecord( &c2r[k].Value2, format2 );
-    }
-    goto Fail1;
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( k = 0; k < m; k++ )
-  {
-    c2r = c1r[k].Class2Record;
-
-    for ( n = 0; n < count2; n++ )
-    {
-      if ( format1 )
-	Free_ValueRecord( &c2r[n].Value1, format1 );
-      if ( format2 )
-	Free_ValueRecord( &c2r[n].Value2, format2 );
-    }
-
-    FREE( c2r );
-  }
-
-  FREE( c1r );
-Fail2:
-
-  _HB_OPEN_Free_ClassDefinition( &ppf2->ClassDef2 );
-
-Fail3:
-  _HB_OPEN_Free_ClassDefinition( &ppf2->ClassDef1 );
-  return error;
-}
-
-
-static void  Free_PairPos2( HB_PairPosFormat2*  ppf2,
-			    HB_UShort            format1,
-			    HB_UShort            format2)
-{
-  HB_UShort          m, n, count1, count2;
-
-  HB_Class1Record*  c1r;
-  HB_Class2Record*  c2r;
-
-
-  if ( ppf2->Class1Record )
-  {
-    c1r    = ppf2->Class1Record;
-    count1 = ppf2->Class1Count;
-    count2 = ppf2->Class2Count;
-
-    for ( m = 0; m < count1; m++ )
-    {
-      c2r = c1r[m].Class2Record;
-
-      for ( n = 0; n < count2; n++ )
-      {
-	if ( format1 )
-	  Free_ValueRecord( &c2r[n].Value1, format1 );
-	if ( format2 )
-	  Free_ValueRecord( &c2r[n].Value2, format2 );
-      }
-
-      FREE( c2r );
-    }
-
-    FREE( c1r );
-
-    _HB_OPEN_Free_ClassDefinition( &ppf2->ClassDef2 );
-    _HB_OPEN_Free_ClassDefinition( &ppf2->ClassDef1 );
-  }
 }
 
 
@@ -1406,13 +1162,13 @@ static HB_Error  Load_PairPos( HB_GPOS_SubTable* st,
   case 1:
     error = Load_PairPos1( &pp->ppf.ppf1, format1, format2, stream );
     if ( error )
-      goto Fail;
+      return error;
     break;
 
   case 2:
     error = Load_PairPos2( &pp->ppf.ppf2, format1, format2, stream );
     if ( error )
-      goto Fail;
+      return error;
     break;
 
   default:
@@ -1420,37 +1176,6 @@ static HB_Error  Load_PairPos( HB_GPOS_SubTable* st,
   }
 
   return HB_Err_Ok;
-
-Fail:
-  _HB_OPEN_Free_Coverage( &pp->Coverage );
-  return error;
-}
-
-
-static void  Free_PairPos( HB_GPOS_SubTable* st )
-{
-  HB_UShort  format1, format2;
-  HB_PairPos*     pp = &st->pair;
-
-
-  format1 = pp->ValueFormat1;
-  format2 = pp->ValueFormat2;
-
-  switch ( pp->PosFormat )
-  {
-  case 1:
-    Free_PairPos1( &pp->ppf.ppf1, format1, format2 );
-    break;
-
-  case 2:
-    Free_PairPos2( &pp->ppf.ppf2, format1, format2 );
-    break;
-
-  default:
-    break;
-  }
-
-  _HB_OPEN_Free_Coverage( &pp->Coverage );
 }
 
 
@@ -1463,51 +1188,214 @@ static HB_Error  Lookup_PairPos1( GPOS_Instance*       gpi,
 				  HB_UShort            format2 )
 {
   HB_Error              error;
-  HB_UShort             numpvr, glyph2;
+  HB_UShort             glyph2;
+  HB_UInt               n, lo, hi;
 
+  HB_PairSet*          ps;
   HB_PairValueRecord*  pvr;
 
 
   if ( index >= ppf1->PairSetCount )
      return ERR(HB_Err_Invalid_SubTable);
 
-  pvr = ppf1->PairSet[index].PairValueRecord;
-  if ( !pvr )
+  ps = &ppf1->PairSet[index];
+  if ( !ps->PairValueRecord )
     return ERR(HB_Err_Invalid_SubTable);
 
   glyph2 = IN_CURGLYPH();
 
-  for ( numpvr = ppf1->PairSet[index].PairValueCount;
-	numpvr;
-	numpvr--, pvr++ )
+  /* find the first record for `glyph2' */
+
+  if ( ps->Sorted )
   {
-    if ( glyph2 == pvr->SecondGlyph )
+    lo = 0;
+    hi = ps->PairValueCount;
+
+    while ( lo < hi )
     {
-      error = Get_ValueRecord( gpi, &pvr->Value1, format1,
-			       POSITION( first_pos ) );
-      if ( error )
-	return error;
-      return Get_ValueRecord( gpi, &pvr->Value2, format2,
-			      POSITION( buffer->in_pos ) );
+      n = ( lo + hi ) >> 1;
+
+      if ( ps->SecondGlyph[n] < glyph2 )
+	lo = n + 1;
+      else
+	hi = n;
     }
+
+    n = lo;
   }
+  else
+    for ( n = 0; n < ps->PairValueCount; n++ )
+      if ( ps->SecondGlyph[n] == glyph2 )
+	break;
 
-  return HB_Err_Not_Covered;
+  if ( n >= ps->PairValueCount || ps->SecondGlyph[n] != glyph2 )
+    return HB_Err_Not_Covered;
+
+  pvr = &ps->PairValueRecord[n];
+
+  error = Get_ValueRecord( gpi, &pvr->Value1, format1,
+			   POSITION( first_pos ) );
+  if ( error )
+    return error;
+  return Get_ValueRecord( gpi, &pvr->Value2, format2,
+			  POSITION( buffer->in_pos ) );
 }
 
 
-static HB_Error  Lookup_PairPos2( GPOS_Instance*       gpi,
-				  HB_PairPosFormat2*  ppf2,
-				  HB_Buffer           buffer,
-				  HB_UInt              first_pos,
-				  HB_UShort            format1,
-				  HB_UShort            format2 )
-{
+/* The position fields a value format changes, as a mask of the
+   HB_GPOS_FORMAT_HAVE_{X,Y}_{PLACEMENT,ADVANCE} bits.            */
+
+#define VALUE_Fields( format )  ( ( (format) | (format) >> 4 ) & 0x000F )
+
+
+static HB_UShort  Count_Fields( HB_UShort  fields )
+{
+  HB_UShort  count = 0;
+
+
+  for ( ; fields; fields >>= 1 )
+    count += fields & 1;
+
+  return count;
+}
+
+
+static HB_Fixed*  Store_Adjustment( HB_Fixed*    v,
+				    HB_UShort    fields,
+				    HB_Position  gd )
+{
+  if ( fields & HB_GPOS_FORMAT_HAVE_X_PLACEMENT )
+    *v++ = gd->x_pos;
+  if ( fields & HB_GPOS_FORMAT_HAVE_Y_PLACEMENT )
+    *v++ = gd->y_pos;
+  if ( fields & HB_GPOS_FORMAT_HAVE_X_ADVANCE )
+    *v++ = gd->x_advance;
+  if ( fields & HB_GPOS_FORMAT_HAVE_Y_ADVANCE )
+    *v++ = gd->y_advance;
+
+  return v;
+}
+
+
+static const HB_Fixed*  Apply_Adjustment( const HB_Fixed*  v,
+					  HB_UShort        fields,
+					  HB_Position      gd )
+{
+  if ( fields & HB_GPOS_FORMAT_HAVE_X_PLACEMENT )
+    gd->x_pos += *v++;
+  if ( fields & HB_GPOS_FORMAT_HAVE_Y_PLACEMENT )
+    gd->y_pos += *v++;
+  if ( fields & HB_GPOS_FORMAT_HAVE_X_ADVANCE )
+    gd->x_advance += *v++;
+  if ( fields & HB_GPOS_FORMAT_HAVE_Y_ADVANCE )
+    gd->y_advance += *v++;
+
+  return v;
+}
+
+
+/* Return the kerning matrix of `ppf2' for the current font scale,
+   building it if necessary, or NULL if the values have to be computed
+   pair by pair: Multiple Master values come from a callback, and the
+   number of matrices and their size are limited.                      */
+
+static HB_KernMatrix*  Get_Kern_Matrix( GPOS_Instance*      gpi,
+					HB_PairPosFormat2*  ppf2,
+					HB_UShort           format1,
+					HB_UShort           format2 )
+{
+  HB_Error         error;
+  HB_GPOSHeader*  gpos = gpi->gpos;
+  HB_Font          font = gpi->font;
+
+  HB_KernMatrix*  head;
+  HB_KernMatrix*  m;
+  HB_UShort        scales = 0, c1, c2, fields1, fields2, stride;
+  HB_UInt          values;
+  HB_Fixed*        v;
+  HB_PositionRec   pos1, pos2;
+
+
+  head = (HB_KernMatrix*)HB_AtomicLoadPtr( &ppf2->Matrices );
+
+  for ( m = head; m; m = m->next, scales++ )
+    if ( m->x_ppem  == font->x_ppem  && m->y_ppem  == font->y_ppem  &&
+	 m->x_scale == font->x_scale && m->y_scale == font->y_scale &&
+	 m->dvi == gpi->dvi )
+      return m;
+
+  fields1 = VALUE_Fields( format1 );
+  fields2 = VALUE_Fields( format2 );
+  stride  = Count_Fields( fields1 ) + Count_Fields( fields2 );
+  values  = (HB_UInt)ppf2->Class1Count * ppf2->Class2Count * stride;
+
+  if ( ( format1 | format2 ) & 0x0F00 || !values ||
+       values > HB_KERN_MATRIX_MAX_VALUES ||
+       scales >= HB_KERN_MATRIX_MAX_SCALES )
+    return NULL;
+
+  if ( ALLOC( m, sizeof( HB_KernMatrix ) + values * sizeof( HB_Fixed ) ) )
+    return NULL;
+
+  m->x_ppem  = font->x_ppem;
+  m->y_ppem  = font->y_ppem;
+  m->x_scale = font->x_scale;
+  m->y_scale = font->y_scale;
+  m->dvi     = gpi->dvi;
+  m->Fields1 = fields1;
+  m->Fields2 = fields2;
+  m->Stride  = stride;
+  m->Values  = (HB_Fixed*)( m + 1 );
+
+  v = m->Values;
+
+  for ( c1 = 0; c1 < ppf2->Class1Count; c1++ )
+    for ( c2 = 0; c2 < ppf2->Class2Count; c2++ )
+    {
+      HB_Class2Record*  c2r = &ppf2->Class1Record[c1].Class2Record[c2];
+
+      pos1.x_pos = pos1.y_pos = pos1.x_advance = pos1.y_advance = 0;
+      pos2.x_pos = pos2.y_pos = pos2.x_advance = pos2.y_advance = 0;
+
+      /* without Multiple Master values this can't fail */
+
+      (void)Get_ValueRecord( gpi, &c2r->Value1, format1, &pos1 );
+      (void)Get_ValueRecord( gpi, &c2r->Value2, format2, &pos2 );
+
+      v = Store_Adjustment( v, fields1, &pos1 );
+      v = Store_Adjustment( v, fields2, &pos2 );
+    }
+
+  /* the table frees every matrix; if another thread has added one to
+     the subtable meanwhile, this one is only used for this call      */
+
+  m->next = head;
+  HB_MemoryBarrier();
+
+  do
+    m->chain = (HB_KernMatrix*)HB_AtomicLoadPtr( &gpos->kern_matrices );
+  while ( !HB_AtomicTestAndSetPtr( &gpos->kern_matrices, m->chain, m ) );
+
+  (void)HB_AtomicTestAndSetPtr( &ppf2->Matrices, head, m );
+
+  return m;
+}
+
+
+static HB_Error  Lookup_PairPos2( GPOS_Instance*       gpi,
+				  HB_PairPosFormat2*  ppf2,
+				  HB_Buffer           buffer,
+				  HB_UInt              first_pos,
+				  HB_UShort            format1,
+				  HB_UShort            format2 )
+{
   HB_Error           error;
   HB_UShort          cl1 = 0, cl2 = 0; /* shut compiler up */
 
   HB_Class1Record*  c1r;
   HB_Class2Record*  c2r;
+  HB_KernMatrix*    m;
+  const HB_Fixed*   v;
 
 
   error = _HB_OPEN_Get_Class( &ppf2->ClassDef1, IN_GLYPH( first_pos ),
@@ -1519,6 +1407,16 @@ static HB_Error  Lookup_PairPos2( GPOS_Instance*       gpi,
   if ( error && error != HB_Err_Not_Covered )
     return error;
 
+  m = Get_Kern_Matrix( gpi, ppf2, format1, format2 );
+  if ( m )
+  {
+    v = m->Values + ( (HB_UInt)cl1 * ppf2->Class2Count + cl2 ) * m->Stride;
+    v = Apply_Adjustment( v, m->Fields1, POSITION( first_pos ) );
+    (void)Apply_Adjustment( v, m->Fields2, POSITION( buffer->in_pos ) );
+
+    return HB_Err_Ok;
+  }
+
   c1r = &ppf2->Class1Record[cl1];
   if ( !c1r )
     return ERR(HB_Err_Invalid_SubTable);
@@ -1564,19 +1462,10 @@ static HB_Error  Lookup_PairPos( GPOS_Instance*    gpi,
   first_pos = buffer->in_pos;
   (buffer->in_pos)++;
 
-  while ( CHECK_Property( gpos->gdef, IN_CURITEM(),
-			  flags, &property ) )
+  if ( SKIP_Forward( gpos->gdef, flags, buffer->in_pos ) )
   {
-    if ( error && error != HB_Err_Not_Covered )
-      return error;
-
-    if ( buffer->in_pos == buffer->in_length )
-      {
-	buffer->in_pos = first_pos;
-        return HB_Err_Not_Covered;
-      }
-    (buffer->in_pos)++;
-
+    buffer->in_pos = first_pos;
+    return error;
   }
 
   switch ( pp->PosFormat )
@@ -1621,7 +1510,7 @@ static HB_Error  Load_CursivePos( HB_GPOS_SubTable* st,
   HB_Error  error;
   HB_CursivePos*  cp = &st->cursive;
 
-  HB_UShort             n, m, count;
+  HB_UShort             n, count;
   HB_UInt              cur_offset, new_offset, base_offset;
 
   HB_EntryExitRecord*  eer;
@@ -1644,7 +1533,7 @@ static HB_Error  Load_CursivePos( HB_GPOS_SubTable* st,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = cp->EntryExitCount = GET_UShort();
 
@@ -1652,19 +1541,17 @@ static HB_Error  Load_CursivePos( HB_GPOS_SubTable* st,
 
   cp->EntryExitRecord = NULL;
 
-  if ( ALLOC_ARRAY( cp->EntryExitRecord, count, HB_EntryExitRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( cp->EntryExitRecord, count, HB_EntryExitRecord ) )
+    return error;
 
   eer = cp->EntryExitRecord;
 
   for ( n = 0; n < count; n++ )
   {
-    HB_UInt entry_offset;
-
     if ( ACCESS_Frame( 2L ) )
       return error;
 
-    entry_offset = new_offset = GET_UShort();
+    new_offset = GET_UShort();
 
     FORGET_Frame();
 
@@ -1676,7 +1563,7 @@ static HB_Error  Load_CursivePos( HB_GPOS_SubTable* st,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_Anchor( &eer[n].EntryAnchor,
 				  stream ) ) != HB_Err_Ok )
-	goto Fail1;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -1697,11 +1584,7 @@ static HB_Error  Load_CursivePos( HB_GPOS_SubTable* st,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_Anchor( &eer[n].ExitAnchor,
 				  stream ) ) != HB_Err_Ok )
-      {
-	if ( entry_offset )
-	  Free_Anchor( &eer[n].EntryAnchor );
-	goto Fail1;
-      }
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -1709,45 +1592,6 @@ static HB_Error  Load_CursivePos( HB_GPOS_SubTable* st,
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-  {
-    Free_Anchor( &eer[m].EntryAnchor );
-    Free_Anchor( &eer[m].ExitAnchor );
-  }
-
-  FREE( eer );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &cp->Coverage );
-  return error;
-}
-
-
-static void  Free_CursivePos( HB_GPOS_SubTable* st )
-{
-  HB_UShort             n, count;
-  HB_CursivePos*  cp = &st->cursive;
-
-  HB_EntryExitRecord*  eer;
-
-
-  if ( cp->EntryExitRecord )
-  {
-    count = cp->EntryExitCount;
-    eer   = cp->EntryExitRecord;
-
-    for ( n = 0; n < count; n++ )
-    {
-      Free_Anchor( &eer[n].EntryAnchor );
-      Free_Anchor( &eer[n].ExitAnchor );
-    }
-
-    FREE( eer );
-  }
-
-  _HB_OPEN_Free_Coverage( &cp->Coverage );
 }
 
 
@@ -2002,15 +1846,15 @@ static HB_Error  Load_BaseArray( HB_BaseArray*  ba,
 
   ba->BaseRecord = NULL;
 
-  if ( ALLOC_ARRAY( ba->BaseRecord, count, HB_BaseRecord ) )
+  if ( ARENA_ALLOC_ARRAY( ba->BaseRecord, count, HB_BaseRecord ) )
     return error;
 
   br = ba->BaseRecord;
 
   bans = NULL;
 
-  if ( ALLOC_ARRAY( bans, count * num_classes, HB_Anchor ) )
-    goto Fail;
+  if ( ARENA_ALLOC_ARRAY( bans, count * num_classes, HB_Anchor ) )
+    return error;
 
   for ( m = 0; m < count; m++ )
   {
@@ -2021,7 +1865,7 @@ static HB_Error  Load_BaseArray( HB_BaseArray*  ba,
     for ( n = 0; n < num_classes; n++ )
     {
       if ( ACCESS_Frame( 2L ) )
-	goto Fail;
+	return error;
 
       new_offset = GET_UShort() + base_offset;
 
@@ -2039,40 +1883,12 @@ static HB_Error  Load_BaseArray( HB_BaseArray*  ba,
       cur_offset = FILE_Pos();
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_Anchor( &ban[n], stream ) ) != HB_Err_Ok )
-	goto Fail;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
   }
 
   return HB_Err_Ok;
-
-Fail:
-  FREE( bans );
-  FREE( br );
-  return error;
-}
-
-
-static void  Free_BaseArray( HB_BaseArray*  ba,
-			     HB_UShort       num_classes )
-{
-  HB_BaseRecord  *br;
-  HB_Anchor      *bans;
-
-  HB_UNUSED(num_classes);
-
-  if ( ba->BaseRecord )
-  {
-    br    = ba->BaseRecord;
-
-    if ( ba->BaseCount )
-    {
-      bans = br[0].BaseAnchor;
-      FREE( bans );
-    }
-
-    FREE( br );
-  }
 }
 
 
@@ -2107,7 +1923,7 @@ static HB_Error  Load_MarkBasePos( HB_GPOS_SubTable* st,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -2116,11 +1932,11 @@ static HB_Error  Load_MarkBasePos( HB_GPOS_SubTable* st,
   cur_offset = FILE_Pos();
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_Coverage( &mbp->BaseCoverage, stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 4L ) )
-    goto Fail2;
+    return error;
 
   mbp->ClassCount = GET_UShort();
   new_offset      = GET_UShort() + base_offset;
@@ -2130,11 +1946,11 @@ static HB_Error  Load_MarkBasePos( HB_GPOS_SubTable* st,
   cur_offset = FILE_Pos();
   if ( FILE_Seek( new_offset ) ||
        ( error = Load_MarkArray( &mbp->MarkArray, stream ) ) != HB_Err_Ok )
-    goto Fail2;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail1;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -2144,30 +1960,9 @@ static HB_Error  Load_MarkBasePos( HB_GPOS_SubTable* st,
   if ( FILE_Seek( new_offset ) ||
        ( error = Load_BaseArray( &mbp->BaseArray, mbp->ClassCount,
 				 stream ) ) != HB_Err_Ok )
-    goto Fail1;
+    return error;
 
   return HB_Err_Ok;
-
-Fail1:
-  Free_MarkArray( &mbp->MarkArray );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &mbp->BaseCoverage );
-
-Fail3:
-  _HB_OPEN_Free_Coverage( &mbp->MarkCoverage );
-  return error;
-}
-
-
-static void  Free_MarkBasePos( HB_GPOS_SubTable* st )
-{
-  HB_MarkBasePos* mbp = &st->markbase;
-
-  Free_BaseArray( &mbp->BaseArray, mbp->ClassCount );
-  Free_MarkArray( &mbp->MarkArray );
-  _HB_OPEN_Free_Coverage( &mbp->BaseCoverage );
-  _HB_OPEN_Free_Coverage( &mbp->MarkCoverage );
 }
 
 
@@ -2178,7 +1973,8 @@ static HB_Error  Lookup_MarkBasePos( GPOS_Instance*    gpi,
 				     HB_UShort         context_length,
 				     int               nesting_level )
 {
-  HB_UShort        i, j, mark_index, base_index, property, class;
+  HB_UShort        i, mark_index, base_index, property, class;
+  HB_UInt          j;
   HB_Fixed           x_mark_value, y_mark_value, x_base_value, y_base_value;
   HB_Error         error;
   HB_GPOSHeader*  gpos = gpi->gpos;
@@ -2209,24 +2005,26 @@ static HB_Error  Lookup_MarkBasePos( GPOS_Instance*    gpi,
   if ( error )
     return error;
 
-  /* now we search backwards for a non-mark glyph */
+  /* now we search backwards for a non-mark glyph; these are exactly
+     the glyphs not ignored with HB_LOOKUP_FLAG_IGNORE_MARKS          */
+
+  if ( buffer->in_pos == 0 )
+    return HB_Err_Not_Covered;
+
+  if ( !gpos->gdef )
+    return ERR(HB_Err_Invalid_Argument);
 
-  i = 1;
   j = buffer->in_pos - 1;
 
-  while ( i <= buffer->in_pos )
-  {
-    error = HB_GDEF_Get_Glyph_Property( gpos->gdef, IN_GLYPH( j ),
-					&property );
-    if ( error )
-      return error;
+  if ( SKIP_Backward( gpos->gdef, HB_LOOKUP_FLAG_IGNORE_MARKS, j ) )
+    return error;
 
-    if ( !( property == HB_GDEF_MARK || property & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS ) )
-      break;
+  /* the position can't refer to a glyph further back */
 
-    i++;
-    j--;
-  }
+  if ( buffer->in_pos - j > HB_POSITION_MAX_BACK )
+    return HB_Err_Not_Covered;
+
+  i = (HB_UShort)( buffer->in_pos - j );
 
   /* The following assertion is too strong -- at least for mangal.ttf. */
 #if 0
@@ -2234,9 +2032,6 @@ static HB_Error  Lookup_MarkBasePos( GPOS_Instance*    gpi,
     return HB_Err_Not_Covered;
 #endif
 
-  if ( i > buffer->in_pos )
-    return HB_Err_Not_Covered;
-
   error = _HB_OPEN_Coverage_Index( &mbp->BaseCoverage, IN_GLYPH( j ),
 			  &base_index );
   if ( error )
@@ -2297,7 +2092,7 @@ static HB_Error  Load_LigatureAttach( HB_LigatureAttach*  lat,
 {
   HB_Error  error;
 
-  HB_UShort             m, n, k, count;
+  HB_UShort             m, n, count;
   HB_UInt              cur_offset, new_offset, base_offset;
 
   HB_ComponentRecord*  cr;
@@ -2315,7 +2110,7 @@ static HB_Error  Load_LigatureAttach( HB_LigatureAttach*  lat,
 
   lat->ComponentRecord = NULL;
 
-  if ( ALLOC_ARRAY( lat->ComponentRecord, count, HB_ComponentRecord ) )
+  if ( ARENA_ALLOC_ARRAY( lat->ComponentRecord, count, HB_ComponentRecord ) )
     return error;
 
   cr = lat->ComponentRecord;
@@ -2324,15 +2119,15 @@ static HB_Error  Load_LigatureAttach( HB_LigatureAttach*  lat,
   {
     cr[m].LigatureAnchor = NULL;
 
-    if ( ALLOC_ARRAY( cr[m].LigatureAnchor, num_classes, HB_Anchor ) )
-      goto Fail;
+    if ( ARENA_ALLOC_ARRAY( cr[m].LigatureAnchor, num_classes, HB_Anchor ) )
+      return error;
 
     lan = cr[m].LigatureAnchor;
 
     for ( n = 0; n < num_classes; n++ )
     {
       if ( ACCESS_Frame( 2L ) )
-	goto Fail0;
+	return error;
 
       new_offset = GET_UShort();
 
@@ -2345,64 +2140,15 @@ static HB_Error  Load_LigatureAttach( HB_LigatureAttach*  lat,
 	cur_offset = FILE_Pos();
 	if ( FILE_Seek( new_offset ) ||
 	     ( error = Load_Anchor( &lan[n], stream ) ) != HB_Err_Ok )
-	  goto Fail0;
+	  return error;
 	(void)FILE_Seek( cur_offset );
       }
       else
 	lan[n].PosFormat = 0;
     }
-
-    continue;
-  Fail0:
-    for ( k = 0; k < n; k++ )
-      Free_Anchor( &lan[k] );
-    goto Fail;
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( k = 0; k < m; k++ )
-  {
-    lan = cr[k].LigatureAnchor;
-
-    for ( n = 0; n < num_classes; n++ )
-      Free_Anchor( &lan[n] );
-
-    FREE( lan );
-  }
-
-  FREE( cr );
-  return error;
-}
-
-
-static void  Free_LigatureAttach( HB_LigatureAttach*  lat,
-				  HB_UShort            num_classes )
-{
-  HB_UShort        m, n, count;
-
-  HB_ComponentRecord*  cr;
-  HB_Anchor*           lan;
-
-
-  if ( lat->ComponentRecord )
-  {
-    count = lat->ComponentCount;
-    cr    = lat->ComponentRecord;
-
-    for ( m = 0; m < count; m++ )
-    {
-      lan = cr[m].LigatureAnchor;
-
-      for ( n = 0; n < num_classes; n++ )
-	Free_Anchor( &lan[n] );
-
-      FREE( lan );
-    }
-
-    FREE( cr );
-  }
 }
 
 
@@ -2414,7 +2160,7 @@ static HB_Error  Load_LigatureArray( HB_LigatureArray*  la,
 {
   HB_Error  error;
 
-  HB_UShort            n, m, count;
+  HB_UShort            n, count;
   HB_UInt             cur_offset, new_offset, base_offset;
 
   HB_LigatureAttach*  lat;
@@ -2431,7 +2177,7 @@ static HB_Error  Load_LigatureArray( HB_LigatureArray*  la,
 
   la->LigatureAttach = NULL;
 
-  if ( ALLOC_ARRAY( la->LigatureAttach, count, HB_LigatureAttach ) )
+  if ( ARENA_ALLOC_ARRAY( la->LigatureAttach, count, HB_LigatureAttach ) )
     return error;
 
   lat = la->LigatureAttach;
@@ -2439,7 +2185,7 @@ static HB_Error  Load_LigatureArray( HB_LigatureArray*  la,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2449,39 +2195,11 @@ static HB_Error  Load_LigatureArray( HB_LigatureArray*  la,
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_LigatureAttach( &lat[n], num_classes,
 					stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_LigatureAttach( &lat[m], num_classes );
-
-  FREE( lat );
-  return error;
-}
-
-
-static void  Free_LigatureArray( HB_LigatureArray*  la,
-				 HB_UShort           num_classes )
-{
-  HB_UShort            n, count;
-
-  HB_LigatureAttach*  lat;
-
-
-  if ( la->LigatureAttach )
-  {
-    count = la->LigatureCount;
-    lat   = la->LigatureAttach;
-
-    for ( n = 0; n < count; n++ )
-      Free_LigatureAttach( &lat[n], num_classes );
-
-    FREE( lat );
-  }
 }
 
 
@@ -2513,7 +2231,7 @@ static HB_Error  Load_MarkLigPos( HB_GPOS_SubTable* st,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -2523,11 +2241,11 @@ static HB_Error  Load_MarkLigPos( HB_GPOS_SubTable* st,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_Coverage( &mlp->LigatureCoverage,
 				stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 4L ) )
-    goto Fail2;
+    return error;
 
   mlp->ClassCount = GET_UShort();
   new_offset      = GET_UShort() + base_offset;
@@ -2537,11 +2255,11 @@ static HB_Error  Load_MarkLigPos( HB_GPOS_SubTable* st,
   cur_offset = FILE_Pos();
   if ( FILE_Seek( new_offset ) ||
        ( error = Load_MarkArray( &mlp->MarkArray, stream ) ) != HB_Err_Ok )
-    goto Fail2;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail1;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -2551,30 +2269,9 @@ static HB_Error  Load_MarkLigPos( HB_GPOS_SubTable* st,
   if ( FILE_Seek( new_offset ) ||
        ( error = Load_LigatureArray( &mlp->LigatureArray, mlp->ClassCount,
 				     stream ) ) != HB_Err_Ok )
-    goto Fail1;
+    return error;
 
   return HB_Err_Ok;
-
-Fail1:
-  Free_MarkArray( &mlp->MarkArray );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &mlp->LigatureCoverage );
-
-Fail3:
-  _HB_OPEN_Free_Coverage( &mlp->MarkCoverage );
-  return error;
-}
-
-
-static void  Free_MarkLigPos( HB_GPOS_SubTable* st)
-{
-  HB_MarkLigPos*  mlp = &st->marklig;
-
-  Free_LigatureArray( &mlp->LigatureArray, mlp->ClassCount );
-  Free_MarkArray( &mlp->MarkArray );
-  _HB_OPEN_Free_Coverage( &mlp->LigatureCoverage );
-  _HB_OPEN_Free_Coverage( &mlp->MarkCoverage );
 }
 
 
@@ -2585,7 +2282,8 @@ static HB_Error  Lookup_MarkLigPos( GPOS_Instance*    gpi,
 				    HB_UShort         context_length,
 				    int               nesting_level )
 {
-  HB_UShort        i, j, mark_index, lig_index, property, class;
+  HB_UShort        i, mark_index, lig_index, property, class;
+  HB_UInt          j;
   HB_UShort        mark_glyph;
   HB_Fixed           x_mark_value, y_mark_value, x_lig_value, y_lig_value;
   HB_Error         error;
@@ -2619,24 +2317,26 @@ static HB_Error  Lookup_MarkLigPos( GPOS_Instance*    gpi,
   if ( error )
     return error;
 
-  /* now we search backwards for a non-mark glyph */
+  /* now we search backwards for a non-mark glyph; these are exactly
+     the glyphs not ignored with HB_LOOKUP_FLAG_IGNORE_MARKS          */
+
+  if ( buffer->in_pos == 0 )
+    return HB_Err_Not_Covered;
+
+  if ( !gpos->gdef )
+    return ERR(HB_Err_Invalid_Argument);
 
-  i = 1;
   j = buffer->in_pos - 1;
 
-  while ( i <= buffer->in_pos )
-  {
-    error = HB_GDEF_Get_Glyph_Property( gpos->gdef, IN_GLYPH( j ),
-					&property );
-    if ( error )
-      return error;
+  if ( SKIP_Backward( gpos->gdef, HB_LOOKUP_FLAG_IGNORE_MARKS, j ) )
+    return error;
 
-    if ( !( property == HB_GDEF_MARK || property & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS ) )
-      break;
+  /* the position can't refer to a glyph further back */
 
-    i++;
-    j--;
-  }
+  if ( buffer->in_pos - j > HB_POSITION_MAX_BACK )
+    return HB_Err_Not_Covered;
+
+  i = (HB_UShort)( buffer->in_pos - j );
 
   /* Similar to Lookup_MarkBasePos(), I suspect that this assertion is
      too strong, thus it is commented out.                             */
@@ -2645,9 +2345,6 @@ static HB_Error  Lookup_MarkLigPos( GPOS_Instance*    gpi,
     return HB_Err_Not_Covered;
 #endif
 
-  if ( i > buffer->in_pos )
-    return HB_Err_Not_Covered;
-
   error = _HB_OPEN_Coverage_Index( &mlp->LigatureCoverage, IN_GLYPH( j ),
 			  &lig_index );
   if ( error )
@@ -2723,7 +2420,7 @@ static HB_Error  Load_Mark2Array( HB_Mark2Array*  m2a,
 {
   HB_Error  error;
 
-  HB_UShort        k, m, n, count;
+  HB_UShort        m, n, count;
   HB_UInt          cur_offset, new_offset, base_offset;
 
   HB_Mark2Record  *m2r;
@@ -2741,15 +2438,15 @@ static HB_Error  Load_Mark2Array( HB_Mark2Array*  m2a,
 
   m2a->Mark2Record = NULL;
 
-  if ( ALLOC_ARRAY( m2a->Mark2Record, count, HB_Mark2Record ) )
+  if ( ARENA_ALLOC_ARRAY( m2a->Mark2Record, count, HB_Mark2Record ) )
     return error;
 
   m2r = m2a->Mark2Record;
 
   m2ans = NULL;
 
-  if ( ALLOC_ARRAY( m2ans, count * num_classes, HB_Anchor ) )
-    goto Fail;
+  if ( ARENA_ALLOC_ARRAY( m2ans, count * num_classes, HB_Anchor ) )
+    return error;
 
   for ( m = 0; m < count; m++ )
   {
@@ -2758,7 +2455,7 @@ static HB_Error  Load_Mark2Array( HB_Mark2Array*  m2a,
     for ( n = 0; n < num_classes; n++ )
     {
       if ( ACCESS_Frame( 2L ) )
-	goto Fail;
+	return error;
 
       new_offset = GET_UShort() + base_offset;
 
@@ -2774,40 +2471,12 @@ static HB_Error  Load_Mark2Array( HB_Mark2Array*  m2a,
       cur_offset = FILE_Pos();
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_Anchor( &m2an[n], stream ) ) != HB_Err_Ok )
-	goto Fail;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
   }
 
   return HB_Err_Ok;
-
-Fail:
-  FREE( m2ans );
-  FREE( m2r );
-  return error;
-}
-
-
-static void  Free_Mark2Array( HB_Mark2Array*  m2a,
-			      HB_UShort        num_classes )
-{
-  HB_Mark2Record  *m2r;
-  HB_Anchor       *m2ans;
-
-  HB_UNUSED(num_classes);
-
-  if ( m2a->Mark2Record )
-  {
-    m2r   = m2a->Mark2Record;
-
-    if ( m2a->Mark2Count )
-    {
-      m2ans = m2r[0].Mark2Anchor;
-      FREE( m2ans );
-    }
-
-    FREE( m2r );
-  }
 }
 
 
@@ -2840,7 +2509,7 @@ static HB_Error  Load_MarkMarkPos( HB_GPOS_SubTable* st,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -2850,11 +2519,11 @@ static HB_Error  Load_MarkMarkPos( HB_GPOS_SubTable* st,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_Coverage( &mmp->Mark2Coverage,
 				stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 4L ) )
-    goto Fail2;
+    return error;
 
   mmp->ClassCount = GET_UShort();
   new_offset      = GET_UShort() + base_offset;
@@ -2864,11 +2533,11 @@ static HB_Error  Load_MarkMarkPos( HB_GPOS_SubTable* st,
   cur_offset = FILE_Pos();
   if ( FILE_Seek( new_offset ) ||
        ( error = Load_MarkArray( &mmp->Mark1Array, stream ) ) != HB_Err_Ok )
-    goto Fail2;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail1;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -2878,30 +2547,9 @@ static HB_Error  Load_MarkMarkPos( HB_GPOS_SubTable* st,
   if ( FILE_Seek( new_offset ) ||
        ( error = Load_Mark2Array( &mmp->Mark2Array, mmp->ClassCount,
 				  stream ) ) != HB_Err_Ok )
-    goto Fail1;
+    return error;
 
   return HB_Err_Ok;
-
-Fail1:
-  Free_MarkArray( &mmp->Mark1Array );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &mmp->Mark2Coverage );
-
-Fail3:
-  _HB_OPEN_Free_Coverage( &mmp->Mark1Coverage );
-  return error;
-}
-
-
-static void  Free_MarkMarkPos( HB_GPOS_SubTable* st)
-{
-  HB_MarkMarkPos* mmp = &st->markmark;
-
-  Free_Mark2Array( &mmp->Mark2Array, mmp->ClassCount );
-  Free_MarkArray( &mmp->Mark1Array );
-  _HB_OPEN_Free_Coverage( &mmp->Mark2Coverage );
-  _HB_OPEN_Free_Coverage( &mmp->Mark1Coverage );
 }
 
 
@@ -2912,7 +2560,8 @@ static HB_Error  Lookup_MarkMarkPos( GPOS_Instance*    gpi,
 				     HB_UShort         context_length,
 				     int               nesting_level )
 {
-  HB_UShort        i, j, mark1_index, mark2_index, property, class;
+  HB_UShort        mark1_index, mark2_index, property, class;
+  HB_UInt          j;
   HB_Fixed           x_mark1_value, y_mark1_value,
 		   x_mark2_value, y_mark2_value;
   HB_Error         error;
@@ -2950,29 +2599,22 @@ static HB_Error  Lookup_MarkMarkPos( GPOS_Instance*    gpi,
   if ( buffer->in_pos == 0 )
     return HB_Err_Not_Covered;
 
-  i = 1;
   j = buffer->in_pos - 1;
-  while ( i <= buffer->in_pos )
-  {
-    error = HB_GDEF_Get_Glyph_Property( gpos->gdef, IN_GLYPH( j ),
-					&property );
-    if ( error )
-      return error;
 
-    if ( !( property == HB_GDEF_MARK || property & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS ) )
-      return HB_Err_Not_Covered;
+  /* marks of other attachment classes are the glyphs ignored with
+     just the high byte of the lookup flags                         */
 
-    if ( flags & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS )
-    {
-      if ( property == (flags & 0xFF00) )
-        break;
-    }
-    else
-      break;
+  if ( flags & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS &&
+       SKIP_Backward( gpos->gdef, flags & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS, j ) )
+    return error;
 
-    i++;
-    j--;
-  }
+  error = HB_GDEF_Get_Glyph_Property( gpos->gdef, IN_GLYPH( j ),
+				      &property );
+  if ( error )
+    return error;
+
+  if ( !( property == HB_GDEF_MARK || property & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS ) )
+    return HB_Err_Not_Covered;
 
   error = _HB_OPEN_Coverage_Index( &mmp->Mark2Coverage, IN_GLYPH( j ),
 			  &mark2_index );
@@ -3096,13 +2738,13 @@ static HB_Error  Load_PosRule( HB_PosRule*  pr,
 
   count = pr->GlyphCount - 1;         /* only GlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( pr->Input, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( pr->Input, count, HB_UShort ) )
     return error;
 
   i = pr->Input;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     i[n] = GET_UShort();
@@ -3113,13 +2755,13 @@ static HB_Error  Load_PosRule( HB_PosRule*  pr,
 
   count = pr->PosCount;
 
-  if ( ALLOC_ARRAY( pr->PosLookupRecord, count, HB_PosLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( pr->PosLookupRecord, count, HB_PosLookupRecord ) )
+    return error;
 
   plr = pr->PosLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -3130,20 +2772,6 @@ static HB_Error  Load_PosRule( HB_PosRule*  pr,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( plr );
-
-Fail2:
-  FREE( i );
-  return error;
-}
-
-
-static void  Free_PosRule( HB_PosRule*  pr )
-{
-  FREE( pr->PosLookupRecord );
-  FREE( pr->Input );
 }
 
 
@@ -3154,7 +2782,7 @@ static HB_Error  Load_PosRuleSet( HB_PosRuleSet*  prs,
 {
   HB_Error  error;
 
-  HB_UShort     n, m, count;
+  HB_UShort     n, count;
   HB_UInt      cur_offset, new_offset, base_offset;
 
   HB_PosRule*  pr;
@@ -3171,7 +2799,7 @@ static HB_Error  Load_PosRuleSet( HB_PosRuleSet*  prs,
 
   prs->PosRule = NULL;
 
-  if ( ALLOC_ARRAY( prs->PosRule, count, HB_PosRule ) )
+  if ( ARENA_ALLOC_ARRAY( prs->PosRule, count, HB_PosRule ) )
     return error;
 
   pr = prs->PosRule;
@@ -3179,7 +2807,7 @@ static HB_Error  Load_PosRuleSet( HB_PosRuleSet*  prs,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -3188,38 +2816,11 @@ static HB_Error  Load_PosRuleSet( HB_PosRuleSet*  prs,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_PosRule( &pr[n], stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_PosRule( &pr[m] );
-
-  FREE( pr );
-  return error;
-}
-
-
-static void  Free_PosRuleSet( HB_PosRuleSet*  prs )
-{
-  HB_UShort     n, count;
-
-  HB_PosRule*  pr;
-
-
-  if ( prs->PosRule )
-  {
-    count = prs->PosRuleCount;
-    pr    = prs->PosRule;
-
-    for ( n = 0; n < count; n++ )
-      Free_PosRule( &pr[n] );
-
-    FREE( pr );
-  }
 }
 
 
@@ -3230,7 +2831,7 @@ static HB_Error  Load_ContextPos1( HB_ContextPosFormat1*  cpf1,
 {
   HB_Error  error;
 
-  HB_UShort        n, m, count;
+  HB_UShort        n, count;
   HB_UInt         cur_offset, new_offset, base_offset;
 
   HB_PosRuleSet*  prs;
@@ -3252,7 +2853,7 @@ static HB_Error  Load_ContextPos1( HB_ContextPosFormat1*  cpf1,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = cpf1->PosRuleSetCount = GET_UShort();
 
@@ -3260,15 +2861,15 @@ static HB_Error  Load_ContextPos1( HB_ContextPosFormat1*  cpf1,
 
   cpf1->PosRuleSet = NULL;
 
-  if ( ALLOC_ARRAY( cpf1->PosRuleSet, count, HB_PosRuleSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( cpf1->PosRuleSet, count, HB_PosRuleSet ) )
+    return error;
 
   prs = cpf1->PosRuleSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -3277,43 +2878,11 @@ static HB_Error  Load_ContextPos1( HB_ContextPosFormat1*  cpf1,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_PosRuleSet( &prs[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_PosRuleSet( &prs[m] );
-
-  FREE( prs );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &cpf1->Coverage );
-  return error;
-}
-
-
-static void  Free_ContextPos1( HB_ContextPosFormat1*  cpf1 )
-{
-  HB_UShort        n, count;
-
-  HB_PosRuleSet*  prs;
-
-
-  if ( cpf1->PosRuleSet )
-  {
-    count = cpf1->PosRuleSetCount;
-    prs   = cpf1->PosRuleSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_PosRuleSet( &prs[n] );
-
-    FREE( prs );
-  }
-
-  _HB_OPEN_Free_Coverage( &cpf1->Coverage );
 }
 
 
@@ -3346,13 +2915,13 @@ static HB_Error  Load_PosClassRule( HB_ContextPosFormat2*  cpf2,
 
   count = pcr->GlyphCount - 1;        /* only GlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( pcr->Class, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( pcr->Class, count, HB_UShort ) )
     return error;
 
   c = pcr->Class;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     c[n] = GET_UShort();
@@ -3363,13 +2932,13 @@ static HB_Error  Load_PosClassRule( HB_ContextPosFormat2*  cpf2,
 
   count = pcr->PosCount;
 
-  if ( ALLOC_ARRAY( pcr->PosLookupRecord, count, HB_PosLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( pcr->PosLookupRecord, count, HB_PosLookupRecord ) )
+    return error;
 
   plr = pcr->PosLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -3380,20 +2949,6 @@ static HB_Error  Load_PosClassRule( HB_ContextPosFormat2*  cpf2,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( plr );
-
-Fail2:
-  FREE( c );
-  return error;
-}
-
-
-static void  Free_PosClassRule( HB_PosClassRule*  pcr )
-{
-  FREE( pcr->PosLookupRecord );
-  FREE( pcr->Class );
 }
 
 
@@ -3405,7 +2960,7 @@ static HB_Error  Load_PosClassSet( HB_ContextPosFormat2*  cpf2,
 {
   HB_Error  error;
 
-  HB_UShort          n, m, count;
+  HB_UShort          n, count;
   HB_UInt           cur_offset, new_offset, base_offset;
 
   HB_PosClassRule*  pcr;
@@ -3422,7 +2977,7 @@ static HB_Error  Load_PosClassSet( HB_ContextPosFormat2*  cpf2,
 
   pcs->PosClassRule = NULL;
 
-  if ( ALLOC_ARRAY( pcs->PosClassRule, count, HB_PosClassRule ) )
+  if ( ARENA_ALLOC_ARRAY( pcs->PosClassRule, count, HB_PosClassRule ) )
     return error;
 
   pcr = pcs->PosClassRule;
@@ -3430,7 +2985,7 @@ static HB_Error  Load_PosClassSet( HB_ContextPosFormat2*  cpf2,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -3440,38 +2995,11 @@ static HB_Error  Load_PosClassSet( HB_ContextPosFormat2*  cpf2,
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_PosClassRule( cpf2, &pcr[n],
 				      stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_PosClassRule( &pcr[m] );
-
-  FREE( pcr );
-  return error;
-}
-
-
-static void  Free_PosClassSet( HB_PosClassSet*  pcs )
-{
-  HB_UShort          n, count;
-
-  HB_PosClassRule*  pcr;
-
-
-  if ( pcs->PosClassRule )
-  {
-    count = pcs->PosClassRuleCount;
-    pcr   = pcs->PosClassRule;
-
-    for ( n = 0; n < count; n++ )
-      Free_PosClassRule( &pcr[n] );
-
-    FREE( pcr );
-  }
 }
 
 
@@ -3482,7 +3010,7 @@ static HB_Error  Load_ContextPos2( HB_ContextPosFormat2*  cpf2,
 {
   HB_Error  error;
 
-  HB_UShort         n, m, count;
+  HB_UShort         n, count;
   HB_UInt          cur_offset, new_offset, base_offset;
 
   HB_PosClassSet*  pcs;
@@ -3504,7 +3032,7 @@ static HB_Error  Load_ContextPos2( HB_ContextPosFormat2*  cpf2,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 4L ) )
-    goto Fail3;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -3519,21 +3047,21 @@ static HB_Error  Load_ContextPos2( HB_ContextPosFormat2*  cpf2,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_ClassDefinition( &cpf2->ClassDef, count,
 				       stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   cpf2->PosClassSet      = NULL;
   cpf2->MaxContextLength = 0;
 
-  if ( ALLOC_ARRAY( cpf2->PosClassSet, count, HB_PosClassSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( cpf2->PosClassSet, count, HB_PosClassSet ) )
+    return error;
 
   pcs = cpf2->PosClassSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -3545,7 +3073,7 @@ static HB_Error  Load_ContextPos2( HB_ContextPosFormat2*  cpf2,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_PosClassSet( cpf2, &pcs[n],
 				       stream ) ) != HB_Err_Ok )
-	goto Fail1;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -3558,42 +3086,6 @@ static HB_Error  Load_ContextPos2( HB_ContextPosFormat2*  cpf2,
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; n++ )
-    Free_PosClassSet( &pcs[m] );
-
-  FREE( pcs );
-
-Fail2:
-  _HB_OPEN_Free_ClassDefinition( &cpf2->ClassDef );
-
-Fail3:
-  _HB_OPEN_Free_Coverage( &cpf2->Coverage );
-  return error;
-}
-
-
-static void  Free_ContextPos2( HB_ContextPosFormat2*  cpf2 )
-{
-  HB_UShort         n, count;
-
-  HB_PosClassSet*  pcs;
-
-
-  if ( cpf2->PosClassSet )
-  {
-    count = cpf2->PosClassSetCount;
-    pcs   = cpf2->PosClassSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_PosClassSet( &pcs[n] );
-
-    FREE( pcs );
-  }
-
-  _HB_OPEN_Free_ClassDefinition( &cpf2->ClassDef );
-  _HB_OPEN_Free_Coverage( &cpf2->Coverage );
 }
 
 
@@ -3625,7 +3117,7 @@ static HB_Error  Load_ContextPos3( HB_ContextPosFormat3*  cpf3,
 
   count = cpf3->GlyphCount;
 
-  if ( ALLOC_ARRAY( cpf3->Coverage, count, HB_Coverage ) )
+  if ( ARENA_ALLOC_ARRAY( cpf3->Coverage, count, HB_Coverage ) )
     return error;
 
   c = cpf3->Coverage;
@@ -3633,7 +3125,7 @@ static HB_Error  Load_ContextPos3( HB_ContextPosFormat3*  cpf3,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -3642,7 +3134,7 @@ static HB_Error  Load_ContextPos3( HB_ContextPosFormat3*  cpf3,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &c[n], stream ) ) != HB_Err_Ok )
-      goto Fail2;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
@@ -3650,13 +3142,13 @@ static HB_Error  Load_ContextPos3( HB_ContextPosFormat3*  cpf3,
 
   count = cpf3->PosCount;
 
-  if ( ALLOC_ARRAY( cpf3->PosLookupRecord, count, HB_PosLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( cpf3->PosLookupRecord, count, HB_PosLookupRecord ) )
+    return error;
 
   plr = cpf3->PosLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -3667,38 +3159,6 @@ static HB_Error  Load_ContextPos3( HB_ContextPosFormat3*  cpf3,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( plr );
-
-Fail2:
-  for ( n = 0; n < count; n++ )
-    _HB_OPEN_Free_Coverage( &c[n] );
-
-  FREE( c );
-  return error;
-}
-
-
-static void  Free_ContextPos3( HB_ContextPosFormat3*  cpf3 )
-{
-  HB_UShort      n, count;
-
-  HB_Coverage*  c;
-
-
-  FREE( cpf3->PosLookupRecord );
-
-  if ( cpf3->Coverage )
-  {
-    count = cpf3->GlyphCount;
-    c     = cpf3->Coverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
 }
 
 
@@ -3737,20 +3197,6 @@ static HB_Error  Load_ContextPos( HB_GPOS_SubTable* st,
 }
 
 
-static void  Free_ContextPos( HB_GPOS_SubTable* st )
-{
-  HB_ContextPos*   cp = &st->context;
-
-  switch ( cp->PosFormat )
-  {
-  case 1:  Free_ContextPos1( &cp->cpf.cpf1 ); break;
-  case 2:  Free_ContextPos2( &cp->cpf.cpf2 ); break;
-  case 3:  Free_ContextPos3( &cp->cpf.cpf3 ); break;
-  default:					      break;
-  }
-}
-
-
 static HB_Error  Lookup_ContextPos1( GPOS_Instance*          gpi,
 				     HB_ContextPosFormat1*  cpf1,
 				     HB_Buffer              buffer,
@@ -3759,7 +3205,8 @@ static HB_Error  Lookup_ContextPos1( GPOS_Instance*          gpi,
 				     int                     nesting_level )
 {
   HB_UShort        index, property;
-  HB_UShort        i, j, k, numpr;
+  HB_UShort        i, k, numpr;
+  HB_UInt          j;
   HB_Error         error;
   HB_GPOSHeader*  gpos = gpi->gpos;
 
@@ -3789,14 +3236,11 @@ static HB_Error  Lookup_ContextPos1( GPOS_Instance*          gpi,
 
     for ( i = 1, j = buffer->in_pos + 1; i < pr[k].GlyphCount; i++, j++ )
     {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
+      if ( SKIP_Forward( gdef, flags, j ) )
       {
-	if ( error && error != HB_Err_Not_Covered )
+	if ( error != HB_Err_Not_Covered )
 	  return error;
-
-	if ( j + pr[k].GlyphCount - i == (HB_Int)buffer->in_length )
-	  goto next_posrule;
-	j++;
+	goto next_posrule;
       }
 
       if ( IN_GLYPH( j ) != pr[k].Input[i - 1] )
@@ -3825,7 +3269,8 @@ static HB_Error  Lookup_ContextPos2( GPOS_Instance*          gpi,
 {
   HB_UShort          index, property;
   HB_Error           error;
-  HB_UShort          i, j, k, known_classes;
+  HB_UShort          i, k, known_classes;
+  HB_UInt            j;
 
   HB_UShort*         classes;
   HB_UShort*         cl;
@@ -3884,14 +3329,11 @@ static HB_Error  Lookup_ContextPos2( GPOS_Instance*          gpi,
 
     for ( i = 1, j = buffer->in_pos + 1; i < pr->GlyphCount; i++, j++ )
     {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
+      if ( SKIP_Forward( gdef, flags, j ) )
       {
-	if ( error && error != HB_Err_Not_Covered )
+	if ( error != HB_Err_Not_Covered )
 	  goto End;
-
-	if ( j + pr->GlyphCount - i == (HB_Int)buffer->in_length )
-	  goto next_posclassrule;
-	j++;
+	goto next_posclassrule;
       }
 
       if ( i > known_classes )
@@ -3934,7 +3376,8 @@ static HB_Error  Lookup_ContextPos3( GPOS_Instance*          gpi,
 				     int                     nesting_level )
 {
   HB_Error         error;
-  HB_UShort        index, i, j, property;
+  HB_UShort        index, i, property;
+  HB_UInt          j;
   HB_GPOSHeader*  gpos = gpi->gpos;
 
   HB_Coverage*    c;
@@ -3954,17 +3397,10 @@ static HB_Error  Lookup_ContextPos3( GPOS_Instance*          gpi,
 
   c    = cpf3->Coverage;
 
-  for ( i = 1, j = 1; i < cpf3->GlyphCount; i++, j++ )
+  for ( i = 1, j = buffer->in_pos + 1; i < cpf3->GlyphCount; i++, j++ )
   {
-    while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-    {
-      if ( error && error != HB_Err_Not_Covered )
-	return error;
-
-      if ( j + cpf3->GlyphCount - i == (HB_Int)buffer->in_length )
-	return HB_Err_Not_Covered;
-      j++;
-    }
+    if ( SKIP_Forward( gdef, flags, j ) )
+      return error;
 
     error = _HB_OPEN_Coverage_Index( &c[i], IN_GLYPH( j ), &index );
     if ( error )
@@ -4037,13 +3473,13 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
 
   count = cpr->BacktrackGlyphCount;
 
-  if ( ALLOC_ARRAY( cpr->Backtrack, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( cpr->Backtrack, count, HB_UShort ) )
     return error;
 
   b = cpr->Backtrack;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail4;
+    return error;
 
   for ( n = 0; n < count; n++ )
     b[n] = GET_UShort();
@@ -4051,7 +3487,7 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail4;
+    return error;
 
   cpr->InputGlyphCount = GET_UShort();
 
@@ -4061,13 +3497,13 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
 
   count = cpr->InputGlyphCount - 1;  /* only InputGlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( cpr->Input, count, HB_UShort ) )
-    goto Fail4;
+  if ( ARENA_ALLOC_ARRAY( cpr->Input, count, HB_UShort ) )
+    return error;
 
   i = cpr->Input;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail3;
+    return error;
 
   for ( n = 0; n < count; n++ )
     i[n] = GET_UShort();
@@ -4075,7 +3511,7 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   cpr->LookaheadGlyphCount = GET_UShort();
 
@@ -4085,13 +3521,13 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
 
   count = cpr->LookaheadGlyphCount;
 
-  if ( ALLOC_ARRAY( cpr->Lookahead, count, HB_UShort ) )
-    goto Fail3;
+  if ( ARENA_ALLOC_ARRAY( cpr->Lookahead, count, HB_UShort ) )
+    return error;
 
   l = cpr->Lookahead;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     l[n] = GET_UShort();
@@ -4099,7 +3535,7 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   cpr->PosCount = GET_UShort();
 
@@ -4109,13 +3545,13 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
 
   count = cpr->PosCount;
 
-  if ( ALLOC_ARRAY( cpr->PosLookupRecord, count, HB_PosLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( cpr->PosLookupRecord, count, HB_PosLookupRecord ) )
+    return error;
 
   plr = cpr->PosLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -4126,28 +3562,6 @@ static HB_Error  Load_ChainPosRule( HB_ChainPosRule*  cpr,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( plr );
-
-Fail2:
-  FREE( l );
-
-Fail3:
-  FREE( i );
-
-Fail4:
-  FREE( b );
-  return error;
-}
-
-
-static void  Free_ChainPosRule( HB_ChainPosRule*  cpr )
-{
-  FREE( cpr->PosLookupRecord );
-  FREE( cpr->Lookahead );
-  FREE( cpr->Input );
-  FREE( cpr->Backtrack );
 }
 
 
@@ -4158,10 +3572,11 @@ static HB_Error  Load_ChainPosRuleSet( HB_ChainPosRuleSet*  cprs,
 {
   HB_Error  error;
 
-  HB_UShort          n, m, count;
+  HB_UShort          n, count;
   HB_UInt           cur_offset, new_offset, base_offset;
 
   HB_ChainPosRule*  cpr;
+  HB_ChainRuleKey*  keys;
 
 
   base_offset = FILE_Pos();
@@ -4175,7 +3590,7 @@ static HB_Error  Load_ChainPosRuleSet( HB_ChainPosRuleSet*  cprs,
 
   cprs->ChainPosRule = NULL;
 
-  if ( ALLOC_ARRAY( cprs->ChainPosRule, count, HB_ChainPosRule ) )
+  if ( ARENA_ALLOC_ARRAY( cprs->ChainPosRule, count, HB_ChainPosRule ) )
     return error;
 
   cpr = cprs->ChainPosRule;
@@ -4183,7 +3598,7 @@ static HB_Error  Load_ChainPosRuleSet( HB_ChainPosRuleSet*  cprs,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -4192,38 +3607,22 @@ static HB_Error  Load_ChainPosRuleSet( HB_ChainPosRuleSet*  cprs,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_ChainPosRule( &cpr[n], stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
-  return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_ChainPosRule( &cpr[m] );
-
-  FREE( cpr );
-  return error;
-}
-
-
-static void  Free_ChainPosRuleSet( HB_ChainPosRuleSet*  cprs )
-{
-  HB_UShort          n, count;
-
-  HB_ChainPosRule*  cpr;
+  /* compile the rules */
 
+  if ( ALLOC_ARRAY( keys, count, HB_ChainRuleKey ) )
+    return error;
 
-  if ( cprs->ChainPosRule )
-  {
-    count = cprs->ChainPosRuleCount;
-    cpr   = cprs->ChainPosRule;
+  for ( n = 0; n < count; n++ )
+    CHAIN_RULE_Key( &keys[n], &cpr[n] );
 
-    for ( n = 0; n < count; n++ )
-      Free_ChainPosRule( &cpr[n] );
+  error = _HB_OPEN_Make_Chain_Trie( &cprs->Trie, keys, count, FALSE, stream );
 
-    FREE( cpr );
-  }
+  FREE( keys );
+  return error;
 }
 
 
@@ -4234,7 +3633,7 @@ static HB_Error  Load_ChainContextPos1( HB_ChainContextPosFormat1*  ccpf1,
 {
   HB_Error  error;
 
-  HB_UShort             n, m, count;
+  HB_UShort             n, count;
   HB_UInt              cur_offset, new_offset, base_offset;
 
   HB_ChainPosRuleSet*  cprs;
@@ -4256,7 +3655,7 @@ static HB_Error  Load_ChainContextPos1( HB_ChainContextPosFormat1*  ccpf1,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = ccpf1->ChainPosRuleSetCount = GET_UShort();
 
@@ -4264,15 +3663,15 @@ static HB_Error  Load_ChainContextPos1( HB_ChainContextPosFormat1*  ccpf1,
 
   ccpf1->ChainPosRuleSet = NULL;
 
-  if ( ALLOC_ARRAY( ccpf1->ChainPosRuleSet, count, HB_ChainPosRuleSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ccpf1->ChainPosRuleSet, count, HB_ChainPosRuleSet ) )
+    return error;
 
   cprs = ccpf1->ChainPosRuleSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -4281,43 +3680,11 @@ static HB_Error  Load_ChainContextPos1( HB_ChainContextPosFormat1*  ccpf1,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_ChainPosRuleSet( &cprs[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_ChainPosRuleSet( &cprs[m] );
-
-  FREE( cprs );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &ccpf1->Coverage );
-  return error;
-}
-
-
-static void  Free_ChainContextPos1( HB_ChainContextPosFormat1*  ccpf1 )
-{
-  HB_UShort             n, count;
-
-  HB_ChainPosRuleSet*  cprs;
-
-
-  if ( ccpf1->ChainPosRuleSet )
-  {
-    count = ccpf1->ChainPosRuleSetCount;
-    cprs  = ccpf1->ChainPosRuleSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_ChainPosRuleSet( &cprs[n] );
-
-    FREE( cprs );
-  }
-
-  _HB_OPEN_Free_Coverage( &ccpf1->Coverage );
 }
 
 
@@ -4352,13 +3719,13 @@ static HB_Error  Load_ChainPosClassRule(
 
   count = cpcr->BacktrackGlyphCount;
 
-  if ( ALLOC_ARRAY( cpcr->Backtrack, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( cpcr->Backtrack, count, HB_UShort ) )
     return error;
 
   b = cpcr->Backtrack;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail4;
+    return error;
 
   for ( n = 0; n < count; n++ )
     b[n] = GET_UShort();
@@ -4366,7 +3733,7 @@ static HB_Error  Load_ChainPosClassRule(
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail4;
+    return error;
 
   cpcr->InputGlyphCount = GET_UShort();
 
@@ -4379,13 +3746,13 @@ static HB_Error  Load_ChainPosClassRule(
 
   count = cpcr->InputGlyphCount - 1; /* only InputGlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( cpcr->Input, count, HB_UShort ) )
-    goto Fail4;
+  if ( ARENA_ALLOC_ARRAY( cpcr->Input, count, HB_UShort ) )
+    return error;
 
   i = cpcr->Input;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail3;
+    return error;
 
   for ( n = 0; n < count; n++ )
     i[n] = GET_UShort();
@@ -4393,7 +3760,7 @@ static HB_Error  Load_ChainPosClassRule(
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   cpcr->LookaheadGlyphCount = GET_UShort();
 
@@ -4406,13 +3773,13 @@ static HB_Error  Load_ChainPosClassRule(
 
   count = cpcr->LookaheadGlyphCount;
 
-  if ( ALLOC_ARRAY( cpcr->Lookahead, count, HB_UShort ) )
-    goto Fail3;
+  if ( ARENA_ALLOC_ARRAY( cpcr->Lookahead, count, HB_UShort ) )
+    return error;
 
   l = cpcr->Lookahead;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     l[n] = GET_UShort();
@@ -4420,7 +3787,7 @@ static HB_Error  Load_ChainPosClassRule(
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   cpcr->PosCount = GET_UShort();
 
@@ -4430,13 +3797,13 @@ static HB_Error  Load_ChainPosClassRule(
 
   count = cpcr->PosCount;
 
-  if ( ALLOC_ARRAY( cpcr->PosLookupRecord, count, HB_PosLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( cpcr->PosLookupRecord, count, HB_PosLookupRecord ) )
+    return error;
 
   plr = cpcr->PosLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -4447,28 +3814,6 @@ static HB_Error  Load_ChainPosClassRule(
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( plr );
-
-Fail2:
-  FREE( l );
-
-Fail3:
-  FREE( i );
-
-Fail4:
-  FREE( b );
-  return error;
-}
-
-
-static void  Free_ChainPosClassRule( HB_ChainPosClassRule*  cpcr )
-{
-  FREE( cpcr->PosLookupRecord );
-  FREE( cpcr->Lookahead );
-  FREE( cpcr->Input );
-  FREE( cpcr->Backtrack );
 }
 
 
@@ -4481,10 +3826,11 @@ static HB_Error  Load_ChainPosClassSet(
 {
   HB_Error  error;
 
-  HB_UShort               n, m, count;
+  HB_UShort               n, count;
   HB_UInt                cur_offset, new_offset, base_offset;
 
   HB_ChainPosClassRule*  cpcr;
+  HB_ChainRuleKey*       keys;
 
 
   base_offset = FILE_Pos();
@@ -4498,7 +3844,7 @@ static HB_Error  Load_ChainPosClassSet(
 
   cpcs->ChainPosClassRule = NULL;
 
-  if ( ALLOC_ARRAY( cpcs->ChainPosClassRule, count,
+  if ( ARENA_ALLOC_ARRAY( cpcs->ChainPosClassRule, count,
 		    HB_ChainPosClassRule ) )
     return error;
 
@@ -4507,7 +3853,7 @@ static HB_Error  Load_ChainPosClassSet(
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -4517,38 +3863,22 @@ static HB_Error  Load_ChainPosClassSet(
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_ChainPosClassRule( ccpf2, &cpcr[n],
 					   stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
-  return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_ChainPosClassRule( &cpcr[m] );
+  /* compile the rules */
 
-  FREE( cpcr );
-  return error;
-}
-
-
-static void  Free_ChainPosClassSet( HB_ChainPosClassSet*  cpcs )
-{
-  HB_UShort               n, count;
-
-  HB_ChainPosClassRule*  cpcr;
+  if ( ALLOC_ARRAY( keys, count, HB_ChainRuleKey ) )
+    return error;
 
+  for ( n = 0; n < count; n++ )
+    CHAIN_RULE_Key( &keys[n], &cpcr[n] );
 
-  if ( cpcs->ChainPosClassRule )
-  {
-    count = cpcs->ChainPosClassRuleCount;
-    cpcr  = cpcs->ChainPosClassRule;
+  error = _HB_OPEN_Make_Chain_Trie( &cpcs->Trie, keys, count, TRUE, stream );
 
-    for ( n = 0; n < count; n++ )
-      Free_ChainPosClassRule( &cpcr[n] );
-
-    FREE( cpcr );
-  }
+  FREE( keys );
+  return error;
 }
 
 
@@ -4559,7 +3889,7 @@ static HB_Error  Load_ChainContextPos2( HB_ChainContextPosFormat2*  ccpf2,
 {
   HB_Error  error;
 
-  HB_UShort              n, m, count;
+  HB_UShort              n, count;
   HB_UInt               cur_offset, new_offset, base_offset;
   HB_UInt               backtrack_offset, input_offset, lookahead_offset;
 
@@ -4582,7 +3912,7 @@ static HB_Error  Load_ChainContextPos2( HB_ChainContextPosFormat2*  ccpf2,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 8L ) )
-    goto Fail5;
+    return error;
 
   backtrack_offset = GET_UShort();
   input_offset     = GET_UShort();
@@ -4599,30 +3929,30 @@ static HB_Error  Load_ChainContextPos2( HB_ChainContextPosFormat2*  ccpf2,
   if ( ( error = _HB_OPEN_Load_EmptyOrClassDefinition( &ccpf2->BacktrackClassDef, 65535,
 						       backtrack_offset, base_offset,
 						       stream ) ) != HB_Err_Ok )
-    goto Fail5;
+    return error;
   if ( ( error = _HB_OPEN_Load_EmptyOrClassDefinition( &ccpf2->InputClassDef, count,
 						       input_offset, base_offset,
 						       stream ) ) != HB_Err_Ok )
-    goto Fail4;
+    return error;
   if ( ( error = _HB_OPEN_Load_EmptyOrClassDefinition( &ccpf2->LookaheadClassDef, 65535,
 						       lookahead_offset, base_offset,
 						       stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
 
   ccpf2->ChainPosClassSet   = NULL;
   ccpf2->MaxBacktrackLength = 0;
   ccpf2->MaxInputLength     = 0;
   ccpf2->MaxLookaheadLength = 0;
 
-  if ( ALLOC_ARRAY( ccpf2->ChainPosClassSet, count, HB_ChainPosClassSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ccpf2->ChainPosClassSet, count, HB_ChainPosClassSet ) )
+    return error;
 
   cpcs = ccpf2->ChainPosClassSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -4634,7 +3964,7 @@ static HB_Error  Load_ChainContextPos2( HB_ChainContextPosFormat2*  ccpf2,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_ChainPosClassSet( ccpf2, &cpcs[n],
 					    stream ) ) != HB_Err_Ok )
-	goto Fail1;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -4647,51 +3977,6 @@ static HB_Error  Load_ChainContextPos2( HB_ChainContextPosFormat2*  ccpf2,
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_ChainPosClassSet( &cpcs[m] );
-
-  FREE( cpcs );
-
-Fail2:
-  _HB_OPEN_Free_ClassDefinition( &ccpf2->LookaheadClassDef );
-
-Fail3:
-  _HB_OPEN_Free_ClassDefinition( &ccpf2->InputClassDef );
-
-Fail4:
-  _HB_OPEN_Free_ClassDefinition( &ccpf2->BacktrackClassDef );
-
-Fail5:
-  _HB_OPEN_Free_Coverage( &ccpf2->Coverage );
-  return error;
-}
-
-
-static void  Free_ChainContextPos2( HB_ChainContextPosFormat2*  ccpf2 )
-{
-  HB_UShort              n, count;
-
-  HB_ChainPosClassSet*  cpcs;
-
-
-  if ( ccpf2->ChainPosClassSet )
-  {
-    count = ccpf2->ChainPosClassSetCount;
-    cpcs  = ccpf2->ChainPosClassSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_ChainPosClassSet( &cpcs[n] );
-
-    FREE( cpcs );
-  }
-
-  _HB_OPEN_Free_ClassDefinition( &ccpf2->LookaheadClassDef );
-  _HB_OPEN_Free_ClassDefinition( &ccpf2->InputClassDef );
-  _HB_OPEN_Free_ClassDefinition( &ccpf2->BacktrackClassDef );
-
-  _HB_OPEN_Free_Coverage( &ccpf2->Coverage );
 }
 
 
@@ -4702,7 +3987,7 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
 {
   HB_Error  error;
 
-  HB_UShort             n, nb, ni, nl, m, count;
+  HB_UShort             n, nb, ni, nl, count;
   HB_UShort             backtrack_count, input_count, lookahead_count;
   HB_UInt              cur_offset, new_offset, base_offset;
 
@@ -4725,7 +4010,7 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
 
   backtrack_count = ccpf3->BacktrackGlyphCount;
 
-  if ( ALLOC_ARRAY( ccpf3->BacktrackCoverage, backtrack_count,
+  if ( ARENA_ALLOC_ARRAY( ccpf3->BacktrackCoverage, backtrack_count,
 		    HB_Coverage ) )
     return error;
 
@@ -4734,7 +4019,7 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
   for ( nb = 0; nb < backtrack_count; nb++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail4;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -4743,12 +4028,12 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &b[nb], stream ) ) != HB_Err_Ok )
-      goto Fail4;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail4;
+    return error;
 
   ccpf3->InputGlyphCount = GET_UShort();
 
@@ -4758,15 +4043,15 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
 
   input_count = ccpf3->InputGlyphCount;
 
-  if ( ALLOC_ARRAY( ccpf3->InputCoverage, input_count, HB_Coverage ) )
-    goto Fail4;
+  if ( ARENA_ALLOC_ARRAY( ccpf3->InputCoverage, input_count, HB_Coverage ) )
+    return error;
 
   i = ccpf3->InputCoverage;
 
   for ( ni = 0; ni < input_count; ni++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail3;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -4775,12 +4060,12 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &i[ni], stream ) ) != HB_Err_Ok )
-      goto Fail3;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   ccpf3->LookaheadGlyphCount = GET_UShort();
 
@@ -4790,16 +4075,16 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
 
   lookahead_count = ccpf3->LookaheadGlyphCount;
 
-  if ( ALLOC_ARRAY( ccpf3->LookaheadCoverage, lookahead_count,
+  if ( ARENA_ALLOC_ARRAY( ccpf3->LookaheadCoverage, lookahead_count,
 		    HB_Coverage ) )
-    goto Fail3;
+    return error;
 
   l = ccpf3->LookaheadCoverage;
 
   for ( nl = 0; nl < lookahead_count; nl++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -4808,12 +4093,12 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &l[nl], stream ) ) != HB_Err_Ok )
-      goto Fail2;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   ccpf3->PosCount = GET_UShort();
 
@@ -4823,13 +4108,13 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
 
   count = ccpf3->PosCount;
 
-  if ( ALLOC_ARRAY( ccpf3->PosLookupRecord, count, HB_PosLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ccpf3->PosLookupRecord, count, HB_PosLookupRecord ) )
+    return error;
 
   plr = ccpf3->PosLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -4840,72 +4125,6 @@ static HB_Error  Load_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( plr );
-
-Fail2:
-  for ( m = 0; m < nl; m++ )
-    _HB_OPEN_Free_Coverage( &l[m] );
-
-  FREE( l );
-
-Fail3:
-  for ( m = 0; m < ni; m++ )
-    _HB_OPEN_Free_Coverage( &i[m] );
-
-  FREE( i );
-
-Fail4:
-  for ( m = 0; m < nb; m++ )
-    _HB_OPEN_Free_Coverage( &b[m] );
-
-  FREE( b );
-  return error;
-}
-
-
-static void  Free_ChainContextPos3( HB_ChainContextPosFormat3*  ccpf3 )
-{
-  HB_UShort      n, count;
-
-  HB_Coverage*  c;
-
-
-  FREE( ccpf3->PosLookupRecord );
-
-  if ( ccpf3->LookaheadCoverage )
-  {
-    count = ccpf3->LookaheadGlyphCount;
-    c     = ccpf3->LookaheadCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
-
-  if ( ccpf3->InputCoverage )
-  {
-    count = ccpf3->InputGlyphCount;
-    c     = ccpf3->InputCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
-
-  if ( ccpf3->BacktrackCoverage )
-  {
-    count = ccpf3->BacktrackGlyphCount;
-    c     = ccpf3->BacktrackCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
 }
 
 
@@ -4944,20 +4163,6 @@ static HB_Error  Load_ChainContextPos( HB_GPOS_SubTable* st,
 }
 
 
-static void  Free_ChainContextPos( HB_GPOS_SubTable* st )
-{
-  HB_ChainContextPos*  ccp = &st->chain;
-
-  switch ( ccp->PosFormat )
-  {
-  case 1:  Free_ChainContextPos1( &ccp->ccpf.ccpf1 ); break;
-  case 2:  Free_ChainContextPos2( &ccp->ccpf.ccpf2 ); break;
-  case 3:  Free_ChainContextPos3( &ccp->ccpf.ccpf3 ); break;
-  default:						      break;
-  }
-}
-
-
 static HB_Error  Lookup_ChainContextPos1(
 		   GPOS_Instance*               gpi,
 		   HB_ChainContextPosFormat1*  ccpf1,
@@ -4966,14 +4171,12 @@ static HB_Error  Lookup_ChainContextPos1(
 		   HB_UShort                    context_length,
 		   int                          nesting_level )
 {
-  HB_UShort          index, property;
-  HB_UShort          i, j, k, num_cpr;
-  HB_UShort          bgc, igc, lgc;
+  HB_UShort          index, property, k;
   HB_Error           error;
   HB_GPOSHeader*    gpos = gpi->gpos;
 
   HB_ChainPosRule*  cpr;
-  HB_ChainPosRule   curr_cpr;
+  HB_ChainContext   cc;
   HB_GDEFHeader*    gdef;
 
 
@@ -4986,104 +4189,27 @@ static HB_Error  Lookup_ChainContextPos1(
   if ( error )
     return error;
 
-  cpr     = ccpf1->ChainPosRuleSet[index].ChainPosRule;
-  num_cpr = ccpf1->ChainPosRuleSet[index].ChainPosRuleCount;
-
-  for ( k = 0; k < num_cpr; k++ )
-  {
-    curr_cpr = cpr[k];
-    bgc      = curr_cpr.BacktrackGlyphCount;
-    igc      = curr_cpr.InputGlyphCount;
-    lgc      = curr_cpr.LookaheadGlyphCount;
-
-    if ( context_length != 0xFFFF && context_length < igc )
-      goto next_chainposrule;
-
-    /* check whether context is too long; it is a first guess only */
-
-    if ( bgc > buffer->in_pos || buffer->in_pos + igc + lgc > buffer->in_length )
-      goto next_chainposrule;
-
-    if ( bgc )
-    {
-      /* Since we don't know in advance the number of glyphs to inspect,
-	 we search backwards for matches in the backtrack glyph array    */
-
-      for ( i = 0, j = buffer->in_pos - 1; i < bgc; i++, j-- )
-      {
-	while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-	{
-	  if ( error && error != HB_Err_Not_Covered )
-	    return error;
-
-	  if ( j + 1 == bgc - i )
-	    goto next_chainposrule;
-	  j--;
-	}
-
-	/* In OpenType 1.3, it is undefined whether the offsets of
-	   backtrack glyphs is in logical order or not.  Version 1.4
-	   will clarify this:
-
-	     Logical order -      a  b  c  d  e  f  g  h  i  j
-					      i
-	     Input offsets -                  0  1
-	     Backtrack offsets -  3  2  1  0
-	     Lookahead offsets -                    0  1  2  3           */
-
-	if ( IN_GLYPH( j ) != curr_cpr.Backtrack[i] )
-	  goto next_chainposrule;
-      }
-    }
-
-    /* Start at 1 because [0] is implied */
-
-    for ( i = 1, j = buffer->in_pos + 1; i < igc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  return error;
-
-	if ( j + igc - i + lgc == (HB_Int)buffer->in_length )
-	  goto next_chainposrule;
-	j++;
-      }
-
-      if ( IN_GLYPH( j ) != curr_cpr.Input[i - 1] )
-	goto next_chainposrule;
-    }
-
-    /* we are starting to check for lookahead glyphs right after the
-       last context glyph                                            */
-
-    for ( i = 0; i < lgc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  return error;
-
-	if ( j + lgc - i == (HB_Int)buffer->in_length )
-	  goto next_chainposrule;
-	j++;
-      }
-
-      if ( IN_GLYPH( j ) != curr_cpr.Lookahead[i] )
-	goto next_chainposrule;
-    }
-
-    return Do_ContextPos( gpi, igc,
-			  curr_cpr.PosCount,
-			  curr_cpr.PosLookupRecord,
-			  buffer,
-			  nesting_level );
+  cc.gdef              = gdef;
+  cc.buffer            = buffer;
+  cc.flags             = flags;
+  cc.context_length    = context_length;
+  cc.backtrack_output  = FALSE;
+  cc.BacktrackClassDef = NULL;
+  cc.InputClassDef     = NULL;
+  cc.LookaheadClassDef = NULL;
+
+  error = _HB_OPEN_Match_Chain_Trie( &ccpf1->ChainPosRuleSet[index].Trie,
+				     &cc, &k );
+  if ( error )
+    return error;
 
-  next_chainposrule:
-    ;
-  }
+  cpr = &ccpf1->ChainPosRuleSet[index].ChainPosRule[k];
 
-  return HB_Err_Not_Covered;
+  return Do_ContextPos( gpi, cpr->InputGlyphCount,
+			cpr->PosCount,
+			cpr->PosLookupRecord,
+			buffer,
+			nesting_level );
 }
 
 
@@ -5095,25 +4221,13 @@ static HB_Error  Lookup_ChainContextPos2(
 		   HB_UShort                    context_length,
 		   int                          nesting_level )
 {
-  HB_UShort              index, property;
+  HB_UShort              index, property, klass, k;
   HB_Error               error;
-  HB_UShort              i, j, k;
-  HB_UShort              bgc, igc, lgc;
-  HB_UShort              known_backtrack_classes,
-			 known_input_classes,
-			 known_lookahead_classes;
-
-  HB_UShort*             backtrack_classes;
-  HB_UShort*             input_classes;
-  HB_UShort*             lookahead_classes;
-
-  HB_UShort*             bc;
-  HB_UShort*             ic;
-  HB_UShort*             lc;
   HB_GPOSHeader*        gpos = gpi->gpos;
 
   HB_ChainPosClassSet*  cpcs;
-  HB_ChainPosClassRule  cpcr;
+  HB_ChainPosClassRule* cpcr;
+  HB_ChainContext       cc;
   HB_GDEFHeader*        gdef;
 
 
@@ -5130,165 +4244,38 @@ static HB_Error  Lookup_ChainContextPos2(
   if ( error )
     return error;
 
-  if ( ALLOC_ARRAY( backtrack_classes, ccpf2->MaxBacktrackLength, HB_UShort ) )
-    return error;
-  known_backtrack_classes = 0;
-
   if (ccpf2->MaxInputLength < 1)
     return HB_Err_Not_Covered;
 
-  if ( ALLOC_ARRAY( input_classes, ccpf2->MaxInputLength, HB_UShort ) )
-    goto End3;
-  known_input_classes = 1;
-
-  if ( ALLOC_ARRAY( lookahead_classes, ccpf2->MaxLookaheadLength, HB_UShort ) )
-    goto End2;
-  known_lookahead_classes = 0;
-
   error = _HB_OPEN_Get_Class( &ccpf2->InputClassDef, IN_CURGLYPH(),
-		     &input_classes[0], NULL );
+		     &klass, NULL );
   if ( error && error != HB_Err_Not_Covered )
-    goto End1;
+    return error;
 
-  cpcs = &ccpf2->ChainPosClassSet[input_classes[0]];
+  cpcs = &ccpf2->ChainPosClassSet[klass];
   if ( !cpcs )
-  {
-    error = ERR(HB_Err_Invalid_SubTable);
-    goto End1;
-  }
-
-  for ( k = 0; k < cpcs->ChainPosClassRuleCount; k++ )
-  {
-    cpcr = cpcs->ChainPosClassRule[k];
-    bgc  = cpcr.BacktrackGlyphCount;
-    igc  = cpcr.InputGlyphCount;
-    lgc  = cpcr.LookaheadGlyphCount;
-
-    if ( context_length != 0xFFFF && context_length < igc )
-      goto next_chainposclassrule;
-
-    /* check whether context is too long; it is a first guess only */
-
-    if ( bgc > buffer->in_pos || buffer->in_pos + igc + lgc > buffer->in_length )
-      goto next_chainposclassrule;
-
-    if ( bgc )
-    {
-      /* Since we don't know in advance the number of glyphs to inspect,
-	 we search backwards for matches in the backtrack glyph array.
-	 Note that `known_backtrack_classes' starts at index 0.         */
-
-      bc       = cpcr.Backtrack;
-
-      for ( i = 0, j = buffer->in_pos - 1; i < bgc; i++, j-- )
-      {
-	while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-	{
-	  if ( error && error != HB_Err_Not_Covered )
-	    goto End1;
-
-	  if ( j + 1 == bgc - i )
-	    goto next_chainposclassrule;
-	  j++;
-	}
-
-	if ( i >= known_backtrack_classes )
-	{
-	  /* Keeps us from having to do this for each rule */
-
-	  error = _HB_OPEN_Get_Class( &ccpf2->BacktrackClassDef, IN_GLYPH( j ),
-			     &backtrack_classes[i], NULL );
-	  if ( error && error != HB_Err_Not_Covered )
-	    goto End1;
-	  known_backtrack_classes = i;
-	}
-
-	if ( bc[i] != backtrack_classes[i] )
-	  goto next_chainposclassrule;
-      }
-    }
-
-    ic       = cpcr.Input;
-
-    /* Start at 1 because [0] is implied */
-
-    for ( i = 1, j = buffer->in_pos + 1; i < igc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-
-	if ( j + igc - i + lgc == (HB_Int)buffer->in_length )
-	  goto next_chainposclassrule;
-	j++;
-      }
-
-      if ( i >= known_input_classes )
-      {
-	error = _HB_OPEN_Get_Class( &ccpf2->InputClassDef, IN_GLYPH( j ),
-			   &input_classes[i], NULL );
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-	known_input_classes = i;
-      }
-
-      if ( ic[i - 1] != input_classes[i] )
-	goto next_chainposclassrule;
-    }
-
-    /* we are starting to check for lookahead glyphs right after the
-       last context glyph                                            */
-
-    lc       = cpcr.Lookahead;
-
-    for ( i = 0; i < lgc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-
-	if ( j + lgc - i == (HB_Int)buffer->in_length )
-	  goto next_chainposclassrule;
-	j++;
-      }
-
-      if ( i >= known_lookahead_classes )
-      {
-	error = _HB_OPEN_Get_Class( &ccpf2->LookaheadClassDef, IN_GLYPH( j ),
-			   &lookahead_classes[i], NULL );
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-	known_lookahead_classes = i;
-      }
-
-      if ( lc[i] != lookahead_classes[i] )
-	goto next_chainposclassrule;
-    }
-
-    error = Do_ContextPos( gpi, igc,
-			   cpcr.PosCount,
-			   cpcr.PosLookupRecord,
-			   buffer,
-			   nesting_level );
-    goto End1;
-
-  next_chainposclassrule:
-    ;
-  }
+    return ERR(HB_Err_Invalid_SubTable);
 
-  error = HB_Err_Not_Covered;
+  cc.gdef              = gdef;
+  cc.buffer            = buffer;
+  cc.flags             = flags;
+  cc.context_length    = context_length;
+  cc.backtrack_output  = FALSE;
+  cc.BacktrackClassDef = &ccpf2->BacktrackClassDef;
+  cc.InputClassDef     = &ccpf2->InputClassDef;
+  cc.LookaheadClassDef = &ccpf2->LookaheadClassDef;
 
-End1:
-  FREE( lookahead_classes );
+  error = _HB_OPEN_Match_Chain_Trie( &cpcs->Trie, &cc, &k );
+  if ( error )
+    return error;
 
-End2:
-  FREE( input_classes );
+  cpcr = &cpcs->ChainPosClassRule[k];
 
-End3:
-  FREE( backtrack_classes );
-  return error;
+  return Do_ContextPos( gpi, cpcr->InputGlyphCount,
+			cpcr->PosCount,
+			cpcr->PosLookupRecord,
+			buffer,
+			nesting_level );
 }
 
 
@@ -5300,7 +4287,8 @@ static HB_Error  Lookup_ChainContextPos3(
 		   HB_UShort                    context_length,
 		   int                          nesting_level )
 {
-  HB_UShort        index, i, j, property;
+  HB_UShort        index, i, property;
+  HB_UInt          j;
   HB_UShort        bgc, igc, lgc;
   HB_Error         error;
   HB_GPOSHeader*  gpos = gpi->gpos;
@@ -5335,17 +4323,14 @@ static HB_Error  Lookup_ChainContextPos3(
 
     bc       = ccpf3->BacktrackCoverage;
 
-    for ( i = 0, j = buffer->in_pos - 1; i < bgc; i++, j-- )
+    for ( i = 0, j = buffer->in_pos; i < bgc; i++ )
     {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  return error;
+      if ( !j )
+	return HB_Err_Not_Covered;
 
-	if ( j + 1 == bgc - i )
-	  return HB_Err_Not_Covered;
-	j--;
-      }
+      j--;
+      if ( SKIP_Backward( gdef, flags, j ) )
+	return error;
 
       error = _HB_OPEN_Coverage_Index( &bc[i], IN_GLYPH( j ), &index );
       if ( error )
@@ -5358,15 +4343,8 @@ static HB_Error  Lookup_ChainContextPos3(
   for ( i = 0, j = buffer->in_pos; i < igc; i++, j++ )
   {
     /* We already called CHECK_Property for IN_GLYPH ( buffer->in_pos ) */
-    while ( j > buffer->in_pos && CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-    {
-      if ( error && error != HB_Err_Not_Covered )
-	return error;
-
-      if ( j + igc - i + lgc == (HB_Int)buffer->in_length )
-	return HB_Err_Not_Covered;
-      j++;
-    }
+    if ( j > buffer->in_pos && SKIP_Forward( gdef, flags, j ) )
+      return error;
 
     error = _HB_OPEN_Coverage_Index( &ic[i], IN_GLYPH( j ), &index );
     if ( error )
@@ -5380,15 +4358,8 @@ static HB_Error  Lookup_ChainContextPos3(
 
   for ( i = 0; i < lgc; i++, j++ )
   {
-    while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-    {
-      if ( error && error != HB_Err_Not_Covered )
-	return error;
-
-      if ( j + lgc - i == (HB_Int)buffer->in_length )
-	return HB_Err_Not_Covered;
-      j++;
-    }
+    if ( SKIP_Forward( gdef, flags, j ) )
+      return error;
 
     error = _HB_OPEN_Coverage_Index( &lc[i], IN_GLYPH( j ), &index );
     if ( error )
@@ -5736,6 +4707,8 @@ static HB_Error  GPOS_Do_Glyph_Lookup( GPOS_Instance*    gpi,
   HB_UShort            i, flags, lookup_count;
   HB_GPOSHeader*       gpos = gpi->gpos;
   HB_Lookup*           lo;
+  HB_SubTable*         subtables;
+  HB_UShort            subtable_count;
   int		       lookup_type;
 
 
@@ -5752,9 +4725,16 @@ static HB_Error  GPOS_Do_Glyph_Lookup( GPOS_Instance*    gpi,
   flags = lo->LookupFlag;
   lookup_type = lo->LookupType;
 
-  for ( i = 0; i < lo->SubTableCount; i++ )
+  /* a lookup whose subtables can't be loaded has none */
+  error = _HB_OPEN_Get_Lookup_SubTables( &gpos->LookupList, lookup_index,
+					 HB_Type_GPOS, &subtables,
+					 &subtable_count );
+  if ( error == HB_Err_Out_Of_Memory )
+    return error;
+
+  for ( i = 0; i < subtable_count; i++ )
   {
-    HB_GPOS_SubTable *st = &lo->SubTable[i].st.gpos;
+    HB_GPOS_SubTable *st = &subtables[i].st.gpos;
 
     switch (lookup_type) {
       case HB_GPOS_LOOKUP_SINGLE:
@@ -5809,21 +4789,44 @@ _HB_GPOS_Load_SubTable( HB_GPOS_SubTable* st,
 }
 
 
-HB_INTERNAL void
-_HB_GPOS_Free_SubTable( HB_GPOS_SubTable* st,
-			HB_UShort         lookup_type )
+/* the coverage of the first input glyph of a subtable, or NULL if any
+   glyph could be one                                                  */
+
+HB_INTERNAL HB_Coverage*
+_HB_GPOS_First_Coverage( HB_GPOS_SubTable* st,
+			 HB_UShort         lookup_type )
 {
+  HB_ContextPos*       cp;
+  HB_ChainContextPos*  ccp;
+
   switch ( lookup_type ) {
-    case HB_GPOS_LOOKUP_SINGLE:		Free_SinglePos		( st ); return;
-    case HB_GPOS_LOOKUP_PAIR:		Free_PairPos		( st ); return;
-    case HB_GPOS_LOOKUP_CURSIVE:	Free_CursivePos		( st ); return;
-    case HB_GPOS_LOOKUP_MARKBASE:	Free_MarkBasePos	( st ); return;
-    case HB_GPOS_LOOKUP_MARKLIG:	Free_MarkLigPos		( st ); return;
-    case HB_GPOS_LOOKUP_MARKMARK:	Free_MarkMarkPos	( st ); return;
-    case HB_GPOS_LOOKUP_CONTEXT:	Free_ContextPos		( st ); return;
-    case HB_GPOS_LOOKUP_CHAIN:		Free_ChainContextPos	( st ); return;
-  /*case HB_GPOS_LOOKUP_EXTENSION:	Free_ExtensionPos	( st ); return;*/
-    default:									return;
+    case HB_GPOS_LOOKUP_SINGLE:		return &st->single.Coverage;
+    case HB_GPOS_LOOKUP_PAIR:		return &st->pair.Coverage;
+    case HB_GPOS_LOOKUP_CURSIVE:	return &st->cursive.Coverage;
+    case HB_GPOS_LOOKUP_MARKBASE:	return &st->markbase.MarkCoverage;
+    case HB_GPOS_LOOKUP_MARKLIG:	return &st->marklig.MarkCoverage;
+    case HB_GPOS_LOOKUP_MARKMARK:	return &st->markmark.Mark1Coverage;
+
+    case HB_GPOS_LOOKUP_CONTEXT:
+      cp = &st->context;
+      switch ( cp->PosFormat ) {
+	case 1:  return &cp->cpf.cpf1.Coverage;
+	case 2:  return &cp->cpf.cpf2.Coverage;
+	case 3:  return cp->cpf.cpf3.GlyphCount ? &cp->cpf.cpf3.Coverage[0] : NULL;
+	default: return NULL;
+      }
+
+    case HB_GPOS_LOOKUP_CHAIN:
+      ccp = &st->chain;
+      switch ( ccp->PosFormat ) {
+	case 1:  return &ccp->ccpf.ccpf1.Coverage;
+	case 2:  return &ccp->ccpf.ccpf2.Coverage;
+	case 3:  return ccp->ccpf.ccpf3.InputGlyphCount ?
+			  &ccp->ccpf.ccpf3.InputCoverage[0] : NULL;
+	default: return NULL;
+      }
+
+    default:				return NULL;
   }
 }
 
@@ -5832,12 +4835,12 @@ _HB_GPOS_Free_SubTable( HB_GPOS_SubTable* st,
 
 static HB_Error  GPOS_Do_String_Lookup( GPOS_Instance*    gpi,
 				   HB_UShort         lookup_index,
+				   HB_UInt           property,
 				   HB_Buffer        buffer )
 {
   HB_Error         error, retError = HB_Err_Not_Covered;
-  HB_GPOSHeader*  gpos = gpi->gpos;
-
-  HB_UInt*  properties = gpos->LookupList.Properties;
+  HB_GlyphDigest   digest;
+  HB_Bool          skip;
 
   const int       nesting_level = 0;
   /* 0xFFFF indicates that we don't have a context length yet */
@@ -5846,10 +4849,43 @@ static HB_Error  GPOS_Do_String_Lookup( GPOS_Instance*    gpi,
 
   gpi->last  = 0xFFFF;     /* no last valid glyph for cursive pos. */
 
+  /* skip lookups which can't apply to any glyph of the buffer */
+  error = _HB_OPEN_Lookup_May_Apply( &gpi->gpos->LookupList, lookup_index,
+				     HB_Type_GPOS, buffer );
+  if ( error )
+    return error;
+
+  /* glyphs the lookup can't be applied at are passed over in one go,
+     except by the lookups which may do cursive positioning: there,
+     every glyph not connected breaks the chain of `gpi->last'       */
+  switch ( gpi->gpos->LookupList.Lookup[lookup_index].LookupType )
+  {
+    case HB_GPOS_LOOKUP_CURSIVE:
+    case HB_GPOS_LOOKUP_CONTEXT:
+    case HB_GPOS_LOOKUP_CHAIN:
+      skip = FALSE;
+      break;
+
+    default:
+      skip = TRUE;
+      _HB_OPEN_Lookup_Digest( &gpi->gpos->LookupList, lookup_index,
+			      HB_Type_GPOS, &digest );
+      break;
+  }
+
+  _hb_buffer_reset_skip_lists( buffer, TRUE );
+
   buffer->in_pos = 0;
   while ( buffer->in_pos < buffer->in_length )
   {
-    if ( ~IN_PROPERTIES( buffer->in_pos ) & properties[lookup_index] )
+    if ( skip )
+    {
+      buffer->in_pos = _HB_OPEN_Next_In_Digest( buffer, &digest );
+      if ( buffer->in_pos == buffer->in_length )
+	break;
+    }
+
+    if ( ~IN_PROPERTIES( buffer->in_pos ) & property )
     {
       /* Note that the connection between mark and base glyphs hold
 	 exactly one (string) lookup.  For example, it would be possible
@@ -5966,6 +5002,22 @@ HB_Error  HB_GPOS_Clear_Features( HB_GPOSHeader*  gpos )
 
 
 
+HB_Error  HB_GPOS_Plan_Add_Feature( HB_GPOSHeader*  gpos,
+				    HB_LookupPlan*  plan,
+				    HB_UShort       feature_index,
+				    HB_UInt         property )
+{
+  if ( !gpos )
+    return ERR(HB_Err_Invalid_Argument);
+
+  return _HB_OPEN_Plan_Add_Feature( plan,
+				    &gpos->FeatureList,
+				    &gpos->LookupList,
+				    feature_index, property );
+}
+
+
+
 HB_Error  HB_GPOS_Register_MM_Function( HB_GPOSHeader*  gpos,
 					HB_MMFunction   mmfunc,
 					void*            data )
@@ -6029,7 +5081,9 @@ HB_Error  HB_GPOS_Apply_String( HB_Font            font,
       if (lookup_index >= lookup_count)
        continue;
 
-      error = GPOS_Do_String_Lookup( &gpi, lookup_index, buffer );
+      error = GPOS_Do_String_Lookup( &gpi, lookup_index,
+				     gpos->LookupList.Properties[lookup_index],
+				     buffer );
       if ( error )
       {
 	if ( error != HB_Err_Not_Covered )
@@ -6050,4 +5104,101 @@ HB_Error  HB_GPOS_Apply_String( HB_Font            font,
   return retError;
 }
 
+
+/* Same as HB_GPOS_Apply_String(), but applies the lookups of `plan'
+   instead of the feature selection stored in `gpos'.                    */
+
+HB_Error  HB_GPOS_Apply_Plan( HB_Font               font,
+			      HB_GPOSHeader*        gpos,
+			      const HB_LookupPlan*  plan,
+			      HB_UShort             load_flags,
+			      HB_Buffer             buffer,
+			      HB_Bool               dvi,
+			      HB_Bool               r2l )
+{
+  if ( !buffer )
+    return ERR(HB_Err_Invalid_Argument);
+
+  return HB_GPOS_Apply_Strings( font, gpos, plan, load_flags,
+				&buffer, 1, NULL, dvi, r2l );
+}
+
+
+/* The buffers are processed lookup by lookup, so that the subtables of
+   a lookup are read for all of them while they are still in the cache. */
+
+HB_Error  HB_GPOS_Apply_Strings( HB_Font               font,
+				 HB_GPOSHeader*        gpos,
+				 const HB_LookupPlan*  plan,
+				 HB_UShort             load_flags,
+				 HB_Buffer*            buffers,
+				 HB_UInt               count,
+				 HB_Error*             results,
+				 HB_Bool               dvi,
+				 HB_Bool               r2l )
+{
+  HB_Error       error, retError = HB_Err_Not_Covered;
+  GPOS_Instance  gpi;
+  HB_UInt        i, n;
+
+  if ( !font || !gpos || !plan || ( count && !buffers ) )
+    return ERR(HB_Err_Invalid_Argument);
+
+  for ( n = 0; n < count; n++ )
+  {
+    if ( !buffers[n] )
+      return ERR(HB_Err_Invalid_Argument);
+    if ( results )
+      results[n] = HB_Err_Not_Covered;
+  }
+
+  if ( !plan->LookupCount )
+    return retError;
+
+  gpi.font       = font;
+  gpi.gpos       = gpos;
+  gpi.load_flags = load_flags;
+  gpi.r2l        = r2l;
+  gpi.dvi        = dvi;
+
+  for ( n = 0; n < count; n++ )
+    if ( buffers[n]->in_length )
+    {
+      error = _hb_buffer_clear_positions( buffers[n] );
+      if ( error )
+	return error;
+    }
+
+  for ( i = 0; i < plan->LookupCount; i++ )
+    for ( n = 0; n < count; n++ )
+    {
+      if ( buffers[n]->in_length == 0 )
+	continue;
+
+      error = GPOS_Do_String_Lookup( &gpi, plan->Lookup[i].LookupIndex,
+				     plan->Lookup[i].Properties, buffers[n] );
+      if ( error )
+      {
+	if ( error != HB_Err_Not_Covered )
+	  return error;
+      }
+      else
+      {
+	retError = error;
+	if ( results )
+	  results[n] = error;
+      }
+    }
+
+  for ( n = 0; n < count; n++ )
+    if ( buffers[n]->in_length )
+    {
+      error = Position_CursiveChain ( buffers[n] );
+      if ( error )
+	return error;
+    }
+
+  return retError;
+}
+
 /* END */
@@ -77,12 +77,20 @@ struct  HB_GPOSHeader_
 
   HB_MMFunction     mmfunc;
   void*              data;
+
+  HB_Arena          arena;        /* holds the header and the lists */
+
+  struct HB_KernMatrix_*  kern_matrices;  /* resolved pair adjustments,
+					     built on demand           */
 };
 
 typedef struct HB_GPOSHeader_  HB_GPOSHeader;
 typedef HB_GPOSHeader* HB_GPOS;
 
 
+/* On success the table takes over the data of `stream' (its destroy
+   function is cleared), as lookup subtables are loaded from it on first
+   use; it is released by HB_Done_GPOS_Table().                        */
 HB_Error  HB_Load_GPOS_Table( HB_Stream stream, 
                               HB_GPOSHeader** gpos,
 			      HB_GDEFHeader*  gdef,
@@ -128,6 +136,11 @@ HB_Error  HB_GPOS_Add_Feature( HB_GPOSHeader*  gpos,
 
 HB_Error  HB_GPOS_Clear_Features( HB_GPOSHeader*  gpos );
 
+HB_Error  HB_GPOS_Plan_Add_Feature( HB_GPOSHeader*  gpos,
+				    HB_LookupPlan*  plan,
+				    HB_UShort       feature_index,
+				    HB_UInt         property );
+
 
 HB_Error  HB_GPOS_Register_MM_Function( HB_GPOSHeader*  gpos,
 					HB_MMFunction   mmfunc,
@@ -144,6 +157,31 @@ HB_Error  HB_GPOS_Apply_String( HB_Font           font,
 				HB_Bool           dvi,
 				HB_Bool           r2l );
 
+HB_Error  HB_GPOS_Apply_Plan( HB_Font               font,
+			      HB_GPOSHeader*        gpos,
+			      const HB_LookupPlan*  plan,
+			      HB_UShort             load_flags,
+			      HB_Buffer             buffer,
+			      HB_Bool               dvi,
+			      HB_Bool               r2l );
+
+/* Same as calling HB_GPOS_Apply_Plan() for each of the `count' buffers,
+   but applies every lookup to all of the buffers before the next one.
+   If `results' isn't NULL, it gets what HB_GPOS_Apply_Plan() would have
+   returned for each buffer.  Returns the first error that happened,
+   otherwise HB_Err_Not_Covered if nothing was applied to any buffer, or
+   HB_Err_Ok.                                                           */
+
+HB_Error  HB_GPOS_Apply_Strings( HB_Font               font,
+				 HB_GPOSHeader*        gpos,
+				 const HB_LookupPlan*  plan,
+				 HB_UShort             load_flags,
+				 HB_Buffer*            buffers,
+				 HB_UInt               count,
+				 HB_Error*             results,
+				 HB_Bool               dvi,
+				 HB_Bool               r2l );
+
 HB_END_HEADER
 
 #endif /* HARFBUZZ_GPOS_H */
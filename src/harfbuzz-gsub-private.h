@@ -132,10 +132,32 @@ struct  HB_Ligature_
 typedef struct HB_Ligature_  HB_Ligature;
 
 
+/* The ligatures of a set are compiled into a trie of their component
+   glyphs when loaded, so that a single walk over the input finds every
+   ligature matching it.  Node 0 stands for the first glyph; the
+   children of a node are consecutive and sorted by glyph.             */
+
+struct  HB_LigatureTrieNode_
+{
+  HB_UShort  Glyph;                   /* component leading to the node  */
+  HB_UShort  Ligature;                /* 1 + index of the first ligature
+					 ending at the node, or 0       */
+  HB_UShort  First;                   /* 1 + index of the first ligature
+					 ending in the subtree          */
+  HB_UShort  ChildCount;              /* number of child nodes          */
+  HB_UInt    FirstChild;              /* index of the first child node  */
+};
+
+typedef struct HB_LigatureTrieNode_  HB_LigatureTrieNode;
+
+
 struct  HB_LigatureSet_
 {
   HB_UShort      LigatureCount;       /* number of Ligature tables */
   HB_Ligature*  Ligature;            /* array of Ligature tables  */
+
+  HB_LigatureTrieNode*  Trie;        /* component trie, NULL if the
+					set is empty                 */
 };
 
 typedef struct HB_LigatureSet_  HB_LigatureSet;
@@ -294,6 +316,8 @@ struct  HB_ChainSubRuleSet_
   HB_UShort          ChainSubRuleCount;
 				      /* number of ChainSubRule tables */
   HB_ChainSubRule*  ChainSubRule;    /* array of ChainSubRule tables  */
+
+  HB_ChainTrie       Trie;            /* the rules, compiled          */
 };
 
 typedef struct HB_ChainSubRuleSet_  HB_ChainSubRuleSet;
@@ -340,6 +364,8 @@ struct  HB_ChainSubClassSet_
   HB_ChainSubClassRule*  ChainSubClassRule;
 				      /* array of ChainSubClassRule
 					 tables                      */
+
+  HB_ChainTrie            Trie;       /* the rules, compiled          */
 };
 
 typedef struct HB_ChainSubClassSet_  HB_ChainSubClassSet;
@@ -467,9 +493,9 @@ _HB_GSUB_Load_SubTable( HB_GSUB_SubTable* st,
 				  HB_Stream     stream,
 				  HB_UShort     lookup_type );
 
-HB_INTERNAL void
-_HB_GSUB_Free_SubTable( HB_GSUB_SubTable* st,
-			      HB_UShort     lookup_type );
+HB_INTERNAL HB_Coverage*
+_HB_GSUB_First_Coverage( HB_GSUB_SubTable* st,
+			 HB_UShort         lookup_type );
 
 HB_END_HEADER
 
@@ -54,6 +54,7 @@ HB_Error  HB_Load_GSUB_Table( HB_Stream stream,
   HB_UInt         cur_offset, new_offset, base_offset;
 
   HB_GSUBHeader*  gsub;
+  HB_Arena        arena;
 
   if ( !retptr )
     return ERR(HB_Err_Invalid_Argument);
@@ -63,15 +64,22 @@ HB_Error  HB_Load_GSUB_Table( HB_Stream stream,
 
   base_offset = FILE_Pos();
 
-  if ( ALLOC ( gsub, sizeof( *gsub ) ) ) 
-      return error;
-  
+  /* everything but the lookup subtables is allocated in one arena */
+
+  arena = _hb_arena_new( HB_TABLE_ARENA_CHUNK, &error );
+  if ( error )
+    return error;
+  stream->arena = arena;
+
+  if ( ARENA_ALLOC( gsub, sizeof( *gsub ) ) )
+    goto Fail;
+  gsub->arena = arena;
 
   /* skip version */
 
   if ( FILE_Seek( base_offset + 4L ) ||
        ACCESS_Frame( 2L ) )
-    goto Fail4;
+    goto Fail;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -81,11 +89,11 @@ HB_Error  HB_Load_GSUB_Table( HB_Stream stream,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_ScriptList( &gsub->ScriptList,
 				  stream ) ) != HB_Err_Ok )
-    goto Fail4;
+    goto Fail;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    goto Fail;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -95,11 +103,11 @@ HB_Error  HB_Load_GSUB_Table( HB_Stream stream,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_FeatureList( &gsub->FeatureList,
 				   stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    goto Fail;
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    goto Fail;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -109,31 +117,28 @@ HB_Error  HB_Load_GSUB_Table( HB_Stream stream,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_LookupList( &gsub->LookupList,
 				  stream, HB_Type_GSUB ) ) != HB_Err_Ok )
-    goto Fail2;
+    goto Fail;
 
   gsub->gdef = gdef;      /* can be NULL */
 
   if ( ( error =  _HB_GDEF_LoadMarkAttachClassDef_From_LookupFlags( gdef, gdefStream,
 								     gsub->LookupList.Lookup,
 								     gsub->LookupList.LookupCount ) ) )
-    goto Fail1;
-
-  *retptr = gsub;
-
-  return HB_Err_Ok;
+    goto Fail;
 
-Fail1:
-  _HB_OPEN_Free_LookupList( &gsub->LookupList, HB_Type_GSUB );
+  stream->arena = NULL;
 
-Fail2:
-  _HB_OPEN_Free_FeatureList( &gsub->FeatureList );
+  /* the lookup subtables are loaded on demand, so keep the table data */
+  gsub->LookupList.Stream = *stream;
+  stream->destroy = NULL;
 
-Fail3:
-  _HB_OPEN_Free_ScriptList( &gsub->ScriptList );
+  *retptr = gsub;
 
-Fail4:
-  FREE ( gsub );
+  return HB_Err_Ok;
 
+Fail:
+  stream->arena = NULL;
+  _hb_arena_free( arena );
 
   return error;
 }
@@ -141,11 +146,8 @@ Fail4:
 
 HB_Error   HB_Done_GSUB_Table( HB_GSUBHeader* gsub )
 {
-  _HB_OPEN_Free_LookupList( &gsub->LookupList, HB_Type_GSUB );
-  _HB_OPEN_Free_FeatureList( &gsub->FeatureList );
-  _HB_OPEN_Free_ScriptList( &gsub->ScriptList );
-
-  FREE( gsub );
+  _HB_OPEN_Free_LookupList( &gsub->LookupList );
+  _hb_arena_free( gsub->arena );
 
   return HB_Err_Ok;
 }
@@ -192,7 +194,7 @@ static HB_Error  Load_SingleSubst( HB_GSUB_SubTable* st,
   {
   case 1:
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     ss->ssf.ssf1.DeltaGlyphID = GET_UShort();
 
@@ -202,7 +204,7 @@ static HB_Error  Load_SingleSubst( HB_GSUB_SubTable* st,
 
   case 2:
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     count = ss->ssf.ssf2.GlyphCount = GET_UShort();
 
@@ -210,13 +212,13 @@ static HB_Error  Load_SingleSubst( HB_GSUB_SubTable* st,
 
     ss->ssf.ssf2.Substitute = NULL;
 
-    if ( ALLOC_ARRAY( ss->ssf.ssf2.Substitute, count, HB_UShort ) )
-      goto Fail2;
+    if ( ARENA_ALLOC_ARRAY( ss->ssf.ssf2.Substitute, count, HB_UShort ) )
+      return error;
 
     s = ss->ssf.ssf2.Substitute;
 
     if ( ACCESS_Frame( count * 2L ) )
-      goto Fail1;
+      return error;
 
     for ( n = 0; n < count; n++ )
       s[n] = GET_UShort();
@@ -230,34 +232,6 @@ static HB_Error  Load_SingleSubst( HB_GSUB_SubTable* st,
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( s );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &ss->Coverage );
-  return error;
-}
-
-
-static void  Free_SingleSubst( HB_GSUB_SubTable* st )
-{
-  HB_SingleSubst*  ss = &st->single;
-
-  switch ( ss->SubstFormat )
-  {
-  case 1:
-    break;
-
-  case 2:
-    FREE( ss->ssf.ssf2.Substitute );
-    break;
-
-  default:
-    break;
-  }
-
-  _HB_OPEN_Free_Coverage( &ss->Coverage );
 }
 
 
@@ -342,16 +316,13 @@ static HB_Error  Load_Sequence( HB_Sequence*  s,
 
   if ( count )
   {
-    if ( ALLOC_ARRAY( s->Substitute, count, HB_UShort ) )
+    if ( ARENA_ALLOC_ARRAY( s->Substitute, count, HB_UShort ) )
       return error;
 
     sub = s->Substitute;
 
     if ( ACCESS_Frame( count * 2L ) )
-    {
-      FREE( sub );
       return error;
-    }
 
     for ( n = 0; n < count; n++ )
       sub[n] = GET_UShort();
@@ -363,12 +334,6 @@ static HB_Error  Load_Sequence( HB_Sequence*  s,
 }
 
 
-static void  Free_Sequence( HB_Sequence*  s )
-{
-  FREE( s->Substitute );
-}
-
-
 /* MultipleSubstFormat1 */
 
 static HB_Error  Load_MultipleSubst( HB_GSUB_SubTable* st,
@@ -377,7 +342,7 @@ static HB_Error  Load_MultipleSubst( HB_GSUB_SubTable* st,
   HB_Error error;
   HB_MultipleSubst*  ms = &st->multiple;
 
-  HB_UShort      n = 0, m, count;
+  HB_UShort      n = 0, count;
   HB_UInt       cur_offset, new_offset, base_offset;
 
   HB_Sequence*  s;
@@ -400,7 +365,7 @@ static HB_Error  Load_MultipleSubst( HB_GSUB_SubTable* st,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = ms->SequenceCount = GET_UShort();
 
@@ -408,15 +373,15 @@ static HB_Error  Load_MultipleSubst( HB_GSUB_SubTable* st,
 
   ms->Sequence = NULL;
 
-  if ( ALLOC_ARRAY( ms->Sequence, count, HB_Sequence ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ms->Sequence, count, HB_Sequence ) )
+    return error;
 
   s = ms->Sequence;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -425,44 +390,11 @@ static HB_Error  Load_MultipleSubst( HB_GSUB_SubTable* st,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_Sequence( &s[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_Sequence( &s[m] );
-
-  FREE( s );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &ms->Coverage );
-  return error;
-}
-
-
-static void  Free_MultipleSubst( HB_GSUB_SubTable* st )
-{
-  HB_UShort      n, count;
-  HB_MultipleSubst*  ms = &st->multiple;
-
-  HB_Sequence*  s;
-
-
-  if ( ms->Sequence )
-  {
-    count = ms->SequenceCount;
-    s     = ms->Sequence;
-
-    for ( n = 0; n < count; n++ )
-      Free_Sequence( &s[n] );
-
-    FREE( s );
-  }
-
-  _HB_OPEN_Free_Coverage( &ms->Coverage );
 }
 
 
@@ -541,16 +473,13 @@ static HB_Error  Load_AlternateSet( HB_AlternateSet*  as,
 
   as->Alternate = NULL;
 
-  if ( ALLOC_ARRAY( as->Alternate, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( as->Alternate, count, HB_UShort ) )
     return error;
 
   a = as->Alternate;
 
   if ( ACCESS_Frame( count * 2L ) )
-  {
-    FREE( a );
     return error;
-  }
 
   for ( n = 0; n < count; n++ )
     a[n] = GET_UShort();
@@ -561,12 +490,6 @@ static HB_Error  Load_AlternateSet( HB_AlternateSet*  as,
 }
 
 
-static void  Free_AlternateSet( HB_AlternateSet*  as )
-{
-  FREE( as->Alternate );
-}
-
-
 /* AlternateSubstFormat1 */
 
 static HB_Error  Load_AlternateSubst( HB_GSUB_SubTable* st,
@@ -575,7 +498,7 @@ static HB_Error  Load_AlternateSubst( HB_GSUB_SubTable* st,
   HB_Error error;
   HB_AlternateSubst* as = &st->alternate;
 
-  HB_UShort          n = 0, m, count;
+  HB_UShort          n = 0, count;
   HB_UInt           cur_offset, new_offset, base_offset;
 
   HB_AlternateSet*  aset;
@@ -598,7 +521,7 @@ static HB_Error  Load_AlternateSubst( HB_GSUB_SubTable* st,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = as->AlternateSetCount = GET_UShort();
 
@@ -606,15 +529,15 @@ static HB_Error  Load_AlternateSubst( HB_GSUB_SubTable* st,
 
   as->AlternateSet = NULL;
 
-  if ( ALLOC_ARRAY( as->AlternateSet, count, HB_AlternateSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( as->AlternateSet, count, HB_AlternateSet ) )
+    return error;
 
   aset = as->AlternateSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -623,44 +546,11 @@ static HB_Error  Load_AlternateSubst( HB_GSUB_SubTable* st,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_AlternateSet( &aset[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_AlternateSet( &aset[m] );
-
-  FREE( aset );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &as->Coverage );
-  return error;
-}
-
-
-static void  Free_AlternateSubst( HB_GSUB_SubTable* st )
-{
-  HB_UShort          n, count;
-  HB_AlternateSubst* as = &st->alternate;
-
-  HB_AlternateSet*  aset;
-
-
-  if ( as->AlternateSet )
-  {
-    count = as->AlternateSetCount;
-    aset  = as->AlternateSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_AlternateSet( &aset[n] );
-
-    FREE( aset );
-  }
-
-  _HB_OPEN_Free_Coverage( &as->Coverage );
 }
 
 
@@ -740,18 +630,17 @@ static HB_Error  Load_Ligature( HB_Ligature*  l,
 
   l->Component = NULL;
 
-  count = l->ComponentCount - 1;      /* only ComponentCount - 1 elements */
+  /* only ComponentCount - 1 elements, and none if ComponentCount is 0 */
 
-  if ( ALLOC_ARRAY( l->Component, count, HB_UShort ) )
+  count = l->ComponentCount ? l->ComponentCount - 1 : 0;
+
+  if ( ARENA_ALLOC_ARRAY( l->Component, count, HB_UShort ) )
     return error;
 
   c = l->Component;
 
   if ( ACCESS_Frame( count * 2L ) )
-  {
-    FREE( c );
     return error;
-  }
 
   for ( n = 0; n < count; n++ )
     c[n] = GET_UShort();
@@ -762,20 +651,147 @@ static HB_Error  Load_Ligature( HB_Ligature*  l,
 }
 
 
-static void  Free_Ligature( HB_Ligature*  l )
+/* LigatureSet */
+
+/* The number of components matched after the first glyph; a ligature
+   with a ComponentCount of zero is treated like one of a single glyph. */
+
+#define LIGATURE_Length( lig )						\
+	  ( (lig)->ComponentCount ? (lig)->ComponentCount - 1 : 0 )
+
+static int  Compare_Ligatures( const void*  a,
+			       const void*  b )
 {
-  FREE( l->Component );
+  const HB_Ligature*  la = *(const HB_Ligature* const*)a;
+  const HB_Ligature*  lb = *(const HB_Ligature* const*)b;
+  HB_UShort           na = LIGATURE_Length( la );
+  HB_UShort           nb = LIGATURE_Length( lb );
+  HB_UShort           n;
+
+
+  for ( n = 0; n < na && n < nb; n++ )
+    if ( la->Component[n] != lb->Component[n] )
+      return la->Component[n] < lb->Component[n] ? -1 : 1;
+
+  if ( na != nb )
+    return na < nb ? -1 : 1;
+
+  /* equal ligatures keep the order of the font */
+
+  return la < lb ? -1 : la > lb;
 }
 
 
-/* LigatureSet */
+/* Sorting the ligatures by their components makes the ligatures below
+   any trie node a contiguous run, with the ones ending at the node
+   first; the trie is then built breadth first from these runs.        */
+
+static HB_Error  Make_Ligature_Trie( HB_LigatureSet*  ls,
+				     HB_Stream        stream )
+{
+  HB_Error  error;
+
+  HB_UShort             count = ls->LigatureCount;
+  HB_UShort             depth, len, prev_len, first, n;
+  HB_UInt               node_count, next, node, k;
+  HB_Ligature**         order = NULL;
+  HB_UInt*              run = NULL;
+  HB_LigatureTrieNode*  trie;
+
+
+  ls->Trie = NULL;
+
+  if ( !count )
+    return HB_Err_Ok;
+
+  if ( ALLOC_ARRAY( order, count, HB_Ligature* ) )
+    return error;
+
+  for ( n = 0; n < count; n++ )
+    order[n] = &ls->Ligature[n];
+
+  qsort( order, count, sizeof( HB_Ligature* ), Compare_Ligatures );
+
+  /* every ligature adds the nodes past its common prefix with the
+     previous one                                                   */
+
+  node_count = 1;
+  prev_len   = 0;
+
+  for ( n = 0; n < count; n++ )
+  {
+    len = LIGATURE_Length( order[n] );
+
+    for ( depth = 0; n && depth < len && depth < prev_len; depth++ )
+      if ( order[n]->Component[depth] != order[n - 1]->Component[depth] )
+	break;
+
+    node_count += len - depth;
+    prev_len    = len;
+  }
+
+  /* the run of node `k' is run[3k] to run[3k + 1], at depth run[3k + 2] */
+
+  if ( ALLOC_ARRAY( run, node_count * 3, HB_UInt ) ||
+       ARENA_ALLOC_ARRAY( trie, node_count, HB_LigatureTrieNode ) )
+    goto Fail;
+
+  run[0] = 0;
+  run[1] = count;
+  run[2] = 0;
+  next   = 1;
+
+  for ( node = 0; node < next; node++ )
+  {
+    k     = run[3 * node];
+    depth = (HB_UShort)run[3 * node + 2];
+
+    first = 0xFFFF;
+    for ( ; k < run[3 * node + 1]; k++ )
+      if ( order[k] - ls->Ligature < first )
+	first = (HB_UShort)( order[k] - ls->Ligature );
+    trie[node].First = first + 1;
+
+    k = run[3 * node];
+    if ( k < run[3 * node + 1] && LIGATURE_Length( order[k] ) == depth )
+      trie[node].Ligature = (HB_UShort)( order[k] - ls->Ligature + 1 );
+    while ( k < run[3 * node + 1] && LIGATURE_Length( order[k] ) == depth )
+      k++;
+
+    trie[node].FirstChild = next;
+
+    while ( k < run[3 * node + 1] )
+    {
+      trie[next].Glyph   = order[k]->Component[depth];
+      run[3 * next]      = k;
+      run[3 * next + 2]  = depth + 1;
+
+      while ( k < run[3 * node + 1] &&
+	      order[k]->Component[depth] == trie[next].Glyph )
+	k++;
+
+      run[3 * next + 1] = k;
+      next++;
+    }
+
+    trie[node].ChildCount = (HB_UShort)( next - trie[node].FirstChild );
+  }
+
+  ls->Trie = trie;
+
+Fail:
+  FREE( run );
+  FREE( order );
+  return error;
+}
+
 
 static HB_Error  Load_LigatureSet( HB_LigatureSet*  ls,
 				   HB_Stream         stream )
 {
   HB_Error error;
 
-  HB_UShort      n = 0, m, count;
+  HB_UShort      n = 0, count;
   HB_UInt       cur_offset, new_offset, base_offset;
 
   HB_Ligature*  l;
@@ -792,7 +808,7 @@ static HB_Error  Load_LigatureSet( HB_LigatureSet*  ls,
 
   ls->Ligature = NULL;
 
-  if ( ALLOC_ARRAY( ls->Ligature, count, HB_Ligature ) )
+  if ( ARENA_ALLOC_ARRAY( ls->Ligature, count, HB_Ligature ) )
     return error;
 
   l = ls->Ligature;
@@ -800,7 +816,7 @@ static HB_Error  Load_LigatureSet( HB_LigatureSet*  ls,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -809,38 +825,11 @@ static HB_Error  Load_LigatureSet( HB_LigatureSet*  ls,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_Ligature( &l[n], stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
-  return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_Ligature( &l[m] );
-
-  FREE( l );
-  return error;
-}
-
-
-static void  Free_LigatureSet( HB_LigatureSet*  ls )
-{
-  HB_UShort      n, count;
-
-  HB_Ligature*  l;
-
-
-  if ( ls->Ligature )
-  {
-    count = ls->LigatureCount;
-    l     = ls->Ligature;
-
-    for ( n = 0; n < count; n++ )
-      Free_Ligature( &l[n] );
-
-    FREE( l );
-  }
+  return Make_Ligature_Trie( ls, stream );
 }
 
 
@@ -852,7 +841,7 @@ static HB_Error  Load_LigatureSubst( HB_GSUB_SubTable* st,
   HB_Error error;
   HB_LigatureSubst*  ls = &st->ligature;
 
-  HB_UShort         n = 0, m, count;
+  HB_UShort         n = 0, count;
   HB_UInt          cur_offset, new_offset, base_offset;
 
   HB_LigatureSet*  lset;
@@ -875,7 +864,7 @@ static HB_Error  Load_LigatureSubst( HB_GSUB_SubTable* st,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = ls->LigatureSetCount = GET_UShort();
 
@@ -883,15 +872,15 @@ static HB_Error  Load_LigatureSubst( HB_GSUB_SubTable* st,
 
   ls->LigatureSet = NULL;
 
-  if ( ALLOC_ARRAY( ls->LigatureSet, count, HB_LigatureSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ls->LigatureSet, count, HB_LigatureSet ) )
+    return error;
 
   lset = ls->LigatureSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -900,44 +889,11 @@ static HB_Error  Load_LigatureSubst( HB_GSUB_SubTable* st,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_LigatureSet( &lset[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_LigatureSet( &lset[m] );
-
-  FREE( lset );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &ls->Coverage );
-  return error;
-}
-
-
-static void  Free_LigatureSubst( HB_GSUB_SubTable* st )
-{
-  HB_UShort         n, count;
-  HB_LigatureSubst*  ls = &st->ligature;
-
-  HB_LigatureSet*  lset;
-
-
-  if ( ls->LigatureSet )
-  {
-    count = ls->LigatureSetCount;
-    lset  = ls->LigatureSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_LigatureSet( &lset[n] );
-
-    FREE( lset );
-  }
-
-  _HB_OPEN_Free_Coverage( &ls->Coverage );
 }
 
 
@@ -950,11 +906,15 @@ static HB_Error  Lookup_LigatureSubst( HB_GSUBHeader*    gsub,
 {
   HB_UShort      index, property;
   HB_Error       error;
-  HB_UShort      numlig, i, j, is_mark, first_is_mark = FALSE;
-  HB_UShort*     c;
+  HB_UShort      i, is_mark, first_is_mark = FALSE;
+  HB_UShort      depth, limit, best, best_depth, best_is_mark;
+  HB_UInt        j, best_end, lo, hi, mid;
   HB_LigatureSubst*  ls = &st->ligature;
+  HB_LigatureSet*    lset;
   HB_GDEFHeader*     gdef = gsub->gdef;
 
+  HB_LigatureTrieNode*  trie;
+  HB_LigatureTrieNode*  node;
   HB_Ligature*  lig;
 
   HB_UNUSED(nesting_level);
@@ -972,101 +932,150 @@ static HB_Error  Lookup_LigatureSubst( HB_GSUBHeader*    gsub,
   if ( index >= ls->LigatureSetCount )
      return ERR(HB_Err_Invalid_SubTable);
 
-  lig = ls->LigatureSet[index].Ligature;
-
-  for ( numlig = ls->LigatureSet[index].LigatureCount;
-	numlig;
-	numlig--, lig++ )
-  {
-    if ( buffer->in_pos + lig->ComponentCount > buffer->in_length )
-      goto next_ligature;               /* Not enough glyphs in input */
+  lset = &ls->LigatureSet[index];
+  trie = lset->Trie;
 
-    c    = lig->Component;
+  if ( !trie )
+    return HB_Err_Not_Covered;
 
-    is_mark = first_is_mark;
+  /* The first matching ligature of the set wins, but the ligatures
+     are only tried up to the first one longer than the context.    */
 
-    if ( context_length != 0xFFFF && context_length < lig->ComponentCount )
-      break;
+  limit = lset->LigatureCount;
 
-    for ( i = 1, j = buffer->in_pos + 1; i < lig->ComponentCount; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
+  if ( context_length != 0xFFFF )
+    for ( i = 0; i < limit; i++ )
+      if ( context_length < lset->Ligature[i].ComponentCount )
       {
-	if ( error && error != HB_Err_Not_Covered )
-	  return error;
-
-	if ( j + lig->ComponentCount - i == (HB_Int)buffer->in_length )
-	  goto next_ligature;
-	j++;
+	limit = i;
+	break;
       }
 
-      if ( !( property == HB_GDEF_MARK || property & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS ) )
-	is_mark = FALSE;
+  /* Walk down the trie along the input, skipping ignored glyphs, and
+     remember the first ligature ending on the way.  `j' is the input
+     position following the glyphs matched so far.                    */
 
-      if ( IN_GLYPH( j ) != c[i - 1] )
-	goto next_ligature;
-    }
+  node         = trie;
+  depth        = 0;
+  j            = buffer->in_pos + 1;
+  is_mark      = first_is_mark;
+  best         = 0;
+  best_depth   = 0;
+  best_end     = 0;
+  best_is_mark = FALSE;
 
-    if ( gdef && gdef->NewGlyphClasses )
+  for ( ;; )
+  {
+    if ( node->Ligature && node->Ligature <= limit &&
+	 ( !best || node->Ligature < best ) )
     {
-      /* this is just a guess ... */
+      best         = node->Ligature;
+      best_depth   = depth;
+      best_end     = j;
+      best_is_mark = is_mark;
+    }
 
-      error = _HB_GDEF_Add_Glyph_Property( gdef, lig->LigGlyph,
-				  is_mark ? HB_GDEF_MARK : HB_GDEF_LIGATURE );
-      if ( error && error != HB_Err_Not_Covered )
+    if ( !node->ChildCount || node->First > limit ||
+	 ( best && node->First >= best ) )
+      break;
+
+    if ( SKIP_Forward( gdef, flags, j ) )
+    {
+      if ( error != HB_Err_Not_Covered )
 	return error;
+      break;
     }
 
-    if ( j == buffer->in_pos + i ) /* No input glyphs skipped */
+    (void)CHECK_Property( gdef, IN_ITEM( j ), flags, &property );
+
+    if ( !( property == HB_GDEF_MARK || property & HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS ) )
+      is_mark = FALSE;
+
+    lo = node->FirstChild;
+    hi = lo + node->ChildCount;
+
+    while ( lo < hi )
     {
-      /* We don't use a new ligature ID if there are no skipped
-	 glyphs and the ligature already has an ID.             */
+      mid = ( lo + hi ) >> 1;
 
-      if ( IN_LIGID( buffer->in_pos ) )
-      {
-	if ( ADD_String( buffer, i, 1, &lig->LigGlyph,
-			0xFFFF, 0xFFFF ) )
-	  return error;
-      }
+      if ( IN_GLYPH( j ) < trie[mid].Glyph )
+	hi = mid;
+      else if ( IN_GLYPH( j ) > trie[mid].Glyph )
+	lo = mid + 1;
       else
-      {
-	HB_UShort ligID = _hb_buffer_allocate_ligid( buffer );
-	if ( ADD_String( buffer, i, 1, &lig->LigGlyph,
-			0xFFFF, ligID ) )
-	  return error;
-      }
+	break;
+    }
+
+    if ( lo >= hi )
+      break;
+
+    node = &trie[mid];
+    depth++;
+    j++;
+  }
+
+  if ( !best )
+    return HB_Err_Not_Covered;
+
+  lig     = &lset->Ligature[best - 1];
+  i       = best_depth + 1;
+  j       = best_end;
+  is_mark = best_is_mark;
+
+  if ( gdef && gdef->NewGlyphClasses )
+  {
+    /* this is just a guess ... */
+
+    error = _HB_GDEF_Add_Glyph_Property( gdef, lig->LigGlyph,
+				is_mark ? HB_GDEF_MARK : HB_GDEF_LIGATURE );
+    if ( error && error != HB_Err_Not_Covered )
+      return error;
+  }
+
+  if ( j == buffer->in_pos + i ) /* No input glyphs skipped */
+  {
+    /* We don't use a new ligature ID if there are no skipped
+       glyphs and the ligature already has an ID.             */
+
+    if ( IN_LIGID( buffer->in_pos ) )
+    {
+      if ( ADD_String( buffer, i, 1, &lig->LigGlyph,
+		      0xFFFF, 0xFFFF ) )
+	return error;
     }
     else
     {
       HB_UShort ligID = _hb_buffer_allocate_ligid( buffer );
-      if ( ADD_Glyph( buffer, lig->LigGlyph, 0xFFFF, ligID ) )
+      if ( ADD_String( buffer, i, 1, &lig->LigGlyph,
+		      0xFFFF, ligID ) )
 	return error;
+    }
+  }
+  else
+  {
+    HB_UShort ligID = _hb_buffer_allocate_ligid( buffer );
+    if ( ADD_Glyph( buffer, lig->LigGlyph, 0xFFFF, ligID ) )
+      return error;
 
-      /* Now we must do a second loop to copy the skipped glyphs to
-	 `out' and assign component values to it.  We start with the
-	 glyph after the first component.  Glyphs between component
-	 i and i+1 belong to component i.  Together with the ligID
-	 value it is later possible to check whether a specific
-	 component value really belongs to a given ligature.         */
+    /* Now we must do a second loop to copy the skipped glyphs to
+       `out' and assign component values to it.  We start with the
+       glyph after the first component.  Glyphs between component
+       i and i+1 belong to component i.  Together with the ligID
+       value it is later possible to check whether a specific
+       component value really belongs to a given ligature.         */
 
-      for ( i = 0; i < lig->ComponentCount - 1; i++ )
-      {
-	while ( CHECK_Property( gdef, IN_CURITEM(),
-				flags, &property ) )
-	  if ( ADD_Glyph( buffer, IN_CURGLYPH(), i, ligID ) )
-	    return error;
+    for ( i = 0; i < best_depth; i++ )
+    {
+      while ( CHECK_Property( gdef, IN_CURITEM(),
+			      flags, &property ) )
+	if ( ADD_Glyph( buffer, IN_CURGLYPH(), i, ligID ) )
+	  return error;
 
-	(buffer->in_pos)++;
-      }
+      (buffer->in_pos)++;
     }
-
-    return HB_Err_Ok;
-
-  next_ligature:
-    ;
   }
 
-  return HB_Err_Not_Covered;
+  return HB_Err_Ok;
 }
 
 
@@ -1152,13 +1161,13 @@ static HB_Error  Load_SubRule( HB_SubRule*  sr,
 
   count = sr->GlyphCount - 1;         /* only GlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( sr->Input, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( sr->Input, count, HB_UShort ) )
     return error;
 
   i = sr->Input;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     i[n] = GET_UShort();
@@ -1169,13 +1178,13 @@ static HB_Error  Load_SubRule( HB_SubRule*  sr,
 
   count = sr->SubstCount;
 
-  if ( ALLOC_ARRAY( sr->SubstLookupRecord, count, HB_SubstLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( sr->SubstLookupRecord, count, HB_SubstLookupRecord ) )
+    return error;
 
   slr = sr->SubstLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -1186,20 +1195,6 @@ static HB_Error  Load_SubRule( HB_SubRule*  sr,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( slr );
-
-Fail2:
-  FREE( i );
-  return error;
-}
-
-
-static void  Free_SubRule( HB_SubRule*  sr )
-{
-  FREE( sr->SubstLookupRecord );
-  FREE( sr->Input );
 }
 
 
@@ -1210,7 +1205,7 @@ static HB_Error  Load_SubRuleSet( HB_SubRuleSet*  srs,
 {
   HB_Error error;
 
-  HB_UShort     n = 0, m, count;
+  HB_UShort     n = 0, count;
   HB_UInt      cur_offset, new_offset, base_offset;
 
   HB_SubRule*  sr;
@@ -1227,7 +1222,7 @@ static HB_Error  Load_SubRuleSet( HB_SubRuleSet*  srs,
 
   srs->SubRule = NULL;
 
-  if ( ALLOC_ARRAY( srs->SubRule, count, HB_SubRule ) )
+  if ( ARENA_ALLOC_ARRAY( srs->SubRule, count, HB_SubRule ) )
     return error;
 
   sr = srs->SubRule;
@@ -1235,7 +1230,7 @@ static HB_Error  Load_SubRuleSet( HB_SubRuleSet*  srs,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -1244,38 +1239,11 @@ static HB_Error  Load_SubRuleSet( HB_SubRuleSet*  srs,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_SubRule( &sr[n], stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_SubRule( &sr[m] );
-
-  FREE( sr );
-  return error;
-}
-
-
-static void  Free_SubRuleSet( HB_SubRuleSet*  srs )
-{
-  HB_UShort     n, count;
-
-  HB_SubRule*  sr;
-
-
-  if ( srs->SubRule )
-  {
-    count = srs->SubRuleCount;
-    sr    = srs->SubRule;
-
-    for ( n = 0; n < count; n++ )
-      Free_SubRule( &sr[n] );
-
-    FREE( sr );
-  }
 }
 
 
@@ -1286,7 +1254,7 @@ static HB_Error  Load_ContextSubst1( HB_ContextSubstFormat1*  csf1,
 {
   HB_Error error;
 
-  HB_UShort        n = 0, m, count;
+  HB_UShort        n = 0, count;
   HB_UInt         cur_offset, new_offset, base_offset;
 
   HB_SubRuleSet*  srs;
@@ -1308,7 +1276,7 @@ static HB_Error  Load_ContextSubst1( HB_ContextSubstFormat1*  csf1,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = csf1->SubRuleSetCount = GET_UShort();
 
@@ -1316,15 +1284,15 @@ static HB_Error  Load_ContextSubst1( HB_ContextSubstFormat1*  csf1,
 
   csf1->SubRuleSet = NULL;
 
-  if ( ALLOC_ARRAY( csf1->SubRuleSet, count, HB_SubRuleSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( csf1->SubRuleSet, count, HB_SubRuleSet ) )
+    return error;
 
   srs = csf1->SubRuleSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -1333,43 +1301,11 @@ static HB_Error  Load_ContextSubst1( HB_ContextSubstFormat1*  csf1,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_SubRuleSet( &srs[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_SubRuleSet( &srs[m] );
-
-  FREE( srs );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &csf1->Coverage );
-  return error;
-}
-
-
-static void  Free_ContextSubst1( HB_ContextSubstFormat1* csf1 )
-{
-  HB_UShort        n, count;
-
-  HB_SubRuleSet*  srs;
-
-
-  if ( csf1->SubRuleSet )
-  {
-    count = csf1->SubRuleSetCount;
-    srs   = csf1->SubRuleSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_SubRuleSet( &srs[n] );
-
-    FREE( srs );
-  }
-
-  _HB_OPEN_Free_Coverage( &csf1->Coverage );
 }
 
 
@@ -1402,13 +1338,13 @@ static HB_Error  Load_SubClassRule( HB_ContextSubstFormat2*  csf2,
 
   count = scr->GlyphCount - 1;        /* only GlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( scr->Class, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( scr->Class, count, HB_UShort ) )
     return error;
 
   c = scr->Class;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     c[n] = GET_UShort();
@@ -1419,13 +1355,13 @@ static HB_Error  Load_SubClassRule( HB_ContextSubstFormat2*  csf2,
 
   count = scr->SubstCount;
 
-  if ( ALLOC_ARRAY( scr->SubstLookupRecord, count, HB_SubstLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( scr->SubstLookupRecord, count, HB_SubstLookupRecord ) )
+    return error;
 
   slr = scr->SubstLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -1436,20 +1372,6 @@ static HB_Error  Load_SubClassRule( HB_ContextSubstFormat2*  csf2,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( slr );
-
-Fail2:
-  FREE( c );
-  return error;
-}
-
-
-static void  Free_SubClassRule( HB_SubClassRule*  scr )
-{
-  FREE( scr->SubstLookupRecord );
-  FREE( scr->Class );
 }
 
 
@@ -1461,7 +1383,7 @@ static HB_Error  Load_SubClassSet( HB_ContextSubstFormat2*  csf2,
 {
   HB_Error error;
 
-  HB_UShort          n = 0, m, count;
+  HB_UShort          n = 0, count;
   HB_UInt           cur_offset, new_offset, base_offset;
 
   HB_SubClassRule*  scr;
@@ -1478,7 +1400,7 @@ static HB_Error  Load_SubClassSet( HB_ContextSubstFormat2*  csf2,
 
   scs->SubClassRule = NULL;
 
-  if ( ALLOC_ARRAY( scs->SubClassRule, count, HB_SubClassRule ) )
+  if ( ARENA_ALLOC_ARRAY( scs->SubClassRule, count, HB_SubClassRule ) )
     return error;
 
   scr = scs->SubClassRule;
@@ -1486,7 +1408,7 @@ static HB_Error  Load_SubClassSet( HB_ContextSubstFormat2*  csf2,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -1496,38 +1418,11 @@ static HB_Error  Load_SubClassSet( HB_ContextSubstFormat2*  csf2,
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_SubClassRule( csf2, &scr[n],
 				      stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_SubClassRule( &scr[m] );
-
-  FREE( scr );
-  return error;
-}
-
-
-static void  Free_SubClassSet( HB_SubClassSet*  scs )
-{
-  HB_UShort          n, count;
-
-  HB_SubClassRule*  scr;
-
-
-  if ( scs->SubClassRule )
-  {
-    count = scs->SubClassRuleCount;
-    scr   = scs->SubClassRule;
-
-    for ( n = 0; n < count; n++ )
-      Free_SubClassRule( &scr[n] );
-
-    FREE( scr );
-  }
 }
 
 
@@ -1538,7 +1433,7 @@ static HB_Error  Load_ContextSubst2( HB_ContextSubstFormat2*  csf2,
 {
   HB_Error error;
 
-  HB_UShort         n = 0, m, count;
+  HB_UShort         n = 0, count;
   HB_UInt          cur_offset, new_offset, base_offset;
 
   HB_SubClassSet*  scs;
@@ -1560,7 +1455,7 @@ static HB_Error  Load_ContextSubst2( HB_ContextSubstFormat2*  csf2,
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 4L ) )
-    goto Fail3;
+    return error;
 
   new_offset = GET_UShort() + base_offset;
 
@@ -1575,21 +1470,21 @@ static HB_Error  Load_ContextSubst2( HB_ContextSubstFormat2*  csf2,
   if ( FILE_Seek( new_offset ) ||
        ( error = _HB_OPEN_Load_ClassDefinition( &csf2->ClassDef, count,
 				       stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
   (void)FILE_Seek( cur_offset );
 
   csf2->SubClassSet      = NULL;
   csf2->MaxContextLength = 0;
 
-  if ( ALLOC_ARRAY( csf2->SubClassSet, count, HB_SubClassSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( csf2->SubClassSet, count, HB_SubClassSet ) )
+    return error;
 
   scs = csf2->SubClassSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -1601,7 +1496,7 @@ static HB_Error  Load_ContextSubst2( HB_ContextSubstFormat2*  csf2,
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_SubClassSet( csf2, &scs[n],
 				       stream ) ) != HB_Err_Ok )
-	goto Fail1;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -1614,42 +1509,6 @@ static HB_Error  Load_ContextSubst2( HB_ContextSubstFormat2*  csf2,
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_SubClassSet( &scs[m] );
-
-  FREE( scs );
-
-Fail2:
-  _HB_OPEN_Free_ClassDefinition( &csf2->ClassDef );
-
-Fail3:
-  _HB_OPEN_Free_Coverage( &csf2->Coverage );
-  return error;
-}
-
-
-static void  Free_ContextSubst2( HB_ContextSubstFormat2*  csf2 )
-{
-  HB_UShort         n, count;
-
-  HB_SubClassSet*  scs;
-
-
-  if ( csf2->SubClassSet )
-  {
-    count = csf2->SubClassSetCount;
-    scs   = csf2->SubClassSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_SubClassSet( &scs[n] );
-
-    FREE( scs );
-  }
-
-  _HB_OPEN_Free_ClassDefinition( &csf2->ClassDef );
-  _HB_OPEN_Free_Coverage( &csf2->Coverage );
 }
 
 
@@ -1660,7 +1519,7 @@ static HB_Error  Load_ContextSubst3( HB_ContextSubstFormat3*  csf3,
 {
   HB_Error error;
 
-  HB_UShort               n = 0, m, count;
+  HB_UShort               n = 0, count;
   HB_UInt                cur_offset, new_offset, base_offset;
 
   HB_Coverage*           c;
@@ -1681,7 +1540,7 @@ static HB_Error  Load_ContextSubst3( HB_ContextSubstFormat3*  csf3,
 
   count = csf3->GlyphCount;
 
-  if ( ALLOC_ARRAY( csf3->Coverage, count, HB_Coverage ) )
+  if ( ARENA_ALLOC_ARRAY( csf3->Coverage, count, HB_Coverage ) )
     return error;
 
   c = csf3->Coverage;
@@ -1689,7 +1548,7 @@ static HB_Error  Load_ContextSubst3( HB_ContextSubstFormat3*  csf3,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -1698,7 +1557,7 @@ static HB_Error  Load_ContextSubst3( HB_ContextSubstFormat3*  csf3,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &c[n], stream ) ) != HB_Err_Ok )
-      goto Fail2;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
@@ -1706,14 +1565,14 @@ static HB_Error  Load_ContextSubst3( HB_ContextSubstFormat3*  csf3,
 
   count = csf3->SubstCount;
 
-  if ( ALLOC_ARRAY( csf3->SubstLookupRecord, count,
+  if ( ARENA_ALLOC_ARRAY( csf3->SubstLookupRecord, count,
 		    HB_SubstLookupRecord ) )
-    goto Fail2;
+    return error;
 
   slr = csf3->SubstLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -1724,38 +1583,6 @@ static HB_Error  Load_ContextSubst3( HB_ContextSubstFormat3*  csf3,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( slr );
-
-Fail2:
-  for ( m = 0; m < n; m++ )
-    _HB_OPEN_Free_Coverage( &c[m] );
-
-  FREE( c );
-  return error;
-}
-
-
-static void  Free_ContextSubst3( HB_ContextSubstFormat3*  csf3 )
-{
-  HB_UShort      n, count;
-
-  HB_Coverage*  c;
-
-
-  FREE( csf3->SubstLookupRecord );
-
-  if ( csf3->Coverage )
-  {
-    count = csf3->GlyphCount;
-    c     = csf3->Coverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
 }
 
 
@@ -1787,20 +1614,6 @@ static HB_Error  Load_ContextSubst( HB_GSUB_SubTable* st,
 }
 
 
-static void  Free_ContextSubst( HB_GSUB_SubTable* st )
-{
-  HB_ContextSubst*  cs = &st->context;
-
-  switch ( cs->SubstFormat )
-  {
-  case 1:  Free_ContextSubst1( &cs->csf.csf1 ); break;
-  case 2:  Free_ContextSubst2( &cs->csf.csf2 ); break;
-  case 3:  Free_ContextSubst3( &cs->csf.csf3 ); break;
-  default:						break;
-  }
-}
-
-
 static HB_Error  Lookup_ContextSubst1( HB_GSUBHeader*          gsub,
 				       HB_ContextSubstFormat1* csf1,
 				       HB_Buffer               buffer,
@@ -1809,7 +1622,8 @@ static HB_Error  Lookup_ContextSubst1( HB_GSUBHeader*          gsub,
 				       int                      nesting_level )
 {
   HB_UShort        index, property;
-  HB_UShort        i, j, k, numsr;
+  HB_UShort        i, k, numsr;
+  HB_UInt          j;
   HB_Error         error;
 
   HB_SubRule*     sr;
@@ -1838,14 +1652,11 @@ static HB_Error  Lookup_ContextSubst1( HB_GSUBHeader*          gsub,
 
     for ( i = 1, j = buffer->in_pos + 1; i < sr[k].GlyphCount; i++, j++ )
     {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
+      if ( SKIP_Forward( gdef, flags, j ) )
       {
-	if ( error && error != HB_Err_Not_Covered )
+	if ( error != HB_Err_Not_Covered )
 	  return error;
-
-	if ( j + sr[k].GlyphCount - i == (HB_Int)buffer->in_length )
-	  goto next_subrule;
-	j++;
+	goto next_subrule;
       }
 
       if ( IN_GLYPH( j ) != sr[k].Input[i - 1] )
@@ -1873,7 +1684,8 @@ static HB_Error  Lookup_ContextSubst2( HB_GSUBHeader*          gsub,
 {
   HB_UShort          index, property;
   HB_Error           error;
-  HB_UShort          i, j, k, known_classes;
+  HB_UShort          i, k, known_classes;
+  HB_UInt            j;
 
   HB_UShort*         classes;
   HB_UShort*         cl;
@@ -1931,14 +1743,11 @@ static HB_Error  Lookup_ContextSubst2( HB_GSUBHeader*          gsub,
 
     for ( i = 1, j = buffer->in_pos + 1; i < sr->GlyphCount; i++, j++ )
     {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
+      if ( SKIP_Forward( gdef, flags, j ) )
       {
-	if ( error && error != HB_Err_Not_Covered )
+	if ( error != HB_Err_Not_Covered )
 	  goto End;
-
-	if ( j + sr->GlyphCount - i < (HB_Int)buffer->in_length )
-	  goto next_subclassrule;
-	j++;
+	goto next_subclassrule;
       }
 
       if ( i > known_classes )
@@ -1981,7 +1790,8 @@ static HB_Error  Lookup_ContextSubst3( HB_GSUBHeader*          gsub,
 				       int                      nesting_level )
 {
   HB_Error         error;
-  HB_UShort        index, i, j, property;
+  HB_UShort        index, i, property;
+  HB_UInt          j;
 
   HB_Coverage*    c;
   HB_GDEFHeader*  gdef;
@@ -2002,15 +1812,8 @@ static HB_Error  Lookup_ContextSubst3( HB_GSUBHeader*          gsub,
 
   for ( i = 1, j = buffer->in_pos + 1; i < csf3->GlyphCount; i++, j++ )
   {
-    while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-    {
-      if ( error && error != HB_Err_Not_Covered )
-	return error;
-
-      if ( j + csf3->GlyphCount - i == (HB_Int)buffer->in_length )
-	return HB_Err_Not_Covered;
-      j++;
-    }
+    if ( SKIP_Forward( gdef, flags, j ) )
+      return error;
 
     error = _HB_OPEN_Coverage_Index( &c[i], IN_GLYPH( j ), &index );
     if ( error )
@@ -2073,13 +1876,13 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
 
   count = csr->BacktrackGlyphCount;
 
-  if ( ALLOC_ARRAY( csr->Backtrack, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( csr->Backtrack, count, HB_UShort ) )
     return error;
 
   b = csr->Backtrack;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail4;
+    return error;
 
   for ( n = 0; n < count; n++ )
     b[n] = GET_UShort();
@@ -2087,7 +1890,7 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail4;
+    return error;
 
   csr->InputGlyphCount = GET_UShort();
 
@@ -2097,13 +1900,13 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
 
   count = csr->InputGlyphCount - 1;  /* only InputGlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( csr->Input, count, HB_UShort ) )
-    goto Fail4;
+  if ( ARENA_ALLOC_ARRAY( csr->Input, count, HB_UShort ) )
+    return error;
 
   i = csr->Input;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail3;
+    return error;
 
   for ( n = 0; n < count; n++ )
     i[n] = GET_UShort();
@@ -2111,7 +1914,7 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   csr->LookaheadGlyphCount = GET_UShort();
 
@@ -2121,13 +1924,13 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
 
   count = csr->LookaheadGlyphCount;
 
-  if ( ALLOC_ARRAY( csr->Lookahead, count, HB_UShort ) )
-    goto Fail3;
+  if ( ARENA_ALLOC_ARRAY( csr->Lookahead, count, HB_UShort ) )
+    return error;
 
   l = csr->Lookahead;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     l[n] = GET_UShort();
@@ -2135,7 +1938,7 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   csr->SubstCount = GET_UShort();
 
@@ -2145,13 +1948,13 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
 
   count = csr->SubstCount;
 
-  if ( ALLOC_ARRAY( csr->SubstLookupRecord, count, HB_SubstLookupRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( csr->SubstLookupRecord, count, HB_SubstLookupRecord ) )
+    return error;
 
   slr = csr->SubstLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -2162,28 +1965,6 @@ static HB_Error  Load_ChainSubRule( HB_ChainSubRule*  csr,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( slr );
-
-Fail2:
-  FREE( l );
-
-Fail3:
-  FREE( i );
-
-Fail4:
-  FREE( b );
-  return error;
-}
-
-
-static void  Free_ChainSubRule( HB_ChainSubRule*  csr )
-{
-  FREE( csr->SubstLookupRecord );
-  FREE( csr->Lookahead );
-  FREE( csr->Input );
-  FREE( csr->Backtrack );
 }
 
 
@@ -2194,10 +1975,11 @@ static HB_Error  Load_ChainSubRuleSet( HB_ChainSubRuleSet*  csrs,
 {
   HB_Error error;
 
-  HB_UShort          n = 0, m, count;
+  HB_UShort          n = 0, count;
   HB_UInt           cur_offset, new_offset, base_offset;
 
   HB_ChainSubRule*  csr;
+  HB_ChainRuleKey*  keys;
 
 
   base_offset = FILE_Pos();
@@ -2211,7 +1993,7 @@ static HB_Error  Load_ChainSubRuleSet( HB_ChainSubRuleSet*  csrs,
 
   csrs->ChainSubRule = NULL;
 
-  if ( ALLOC_ARRAY( csrs->ChainSubRule, count, HB_ChainSubRule ) )
+  if ( ARENA_ALLOC_ARRAY( csrs->ChainSubRule, count, HB_ChainSubRule ) )
     return error;
 
   csr = csrs->ChainSubRule;
@@ -2219,7 +2001,7 @@ static HB_Error  Load_ChainSubRuleSet( HB_ChainSubRuleSet*  csrs,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2228,38 +2010,22 @@ static HB_Error  Load_ChainSubRuleSet( HB_ChainSubRuleSet*  csrs,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_ChainSubRule( &csr[n], stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
-  return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_ChainSubRule( &csr[m] );
-
-  FREE( csr );
-  return error;
-}
-
-
-static void  Free_ChainSubRuleSet( HB_ChainSubRuleSet*  csrs )
-{
-  HB_UShort          n, count;
-
-  HB_ChainSubRule*  csr;
+  /* compile the rules */
 
+  if ( ALLOC_ARRAY( keys, count, HB_ChainRuleKey ) )
+    return error;
 
-  if ( csrs->ChainSubRule )
-  {
-    count = csrs->ChainSubRuleCount;
-    csr   = csrs->ChainSubRule;
+  for ( n = 0; n < count; n++ )
+    CHAIN_RULE_Key( &keys[n], &csr[n] );
 
-    for ( n = 0; n < count; n++ )
-      Free_ChainSubRule( &csr[n] );
+  error = _HB_OPEN_Make_Chain_Trie( &csrs->Trie, keys, count, FALSE, stream );
 
-    FREE( csr );
-  }
+  FREE( keys );
+  return error;
 }
 
 
@@ -2271,7 +2037,7 @@ static HB_Error  Load_ChainContextSubst1(
 {
   HB_Error error;
 
-  HB_UShort             n = 0, m, count;
+  HB_UShort             n = 0, count;
   HB_UInt              cur_offset, new_offset, base_offset;
 
   HB_ChainSubRuleSet*  csrs;
@@ -2293,7 +2059,7 @@ static HB_Error  Load_ChainContextSubst1(
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = ccsf1->ChainSubRuleSetCount = GET_UShort();
 
@@ -2301,15 +2067,15 @@ static HB_Error  Load_ChainContextSubst1(
 
   ccsf1->ChainSubRuleSet = NULL;
 
-  if ( ALLOC_ARRAY( ccsf1->ChainSubRuleSet, count, HB_ChainSubRuleSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ccsf1->ChainSubRuleSet, count, HB_ChainSubRuleSet ) )
+    return error;
 
   csrs = ccsf1->ChainSubRuleSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2318,43 +2084,11 @@ static HB_Error  Load_ChainContextSubst1(
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_ChainSubRuleSet( &csrs[n], stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_ChainSubRuleSet( &csrs[m] );
-
-  FREE( csrs );
-
-Fail2:
-  _HB_OPEN_Free_Coverage( &ccsf1->Coverage );
-  return error;
-}
-
-
-static void  Free_ChainContextSubst1( HB_ChainContextSubstFormat1*  ccsf1 )
-{
-  HB_UShort             n, count;
-
-  HB_ChainSubRuleSet*  csrs;
-
-
-  if ( ccsf1->ChainSubRuleSet )
-  {
-    count = ccsf1->ChainSubRuleSetCount;
-    csrs  = ccsf1->ChainSubRuleSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_ChainSubRuleSet( &csrs[n] );
-
-    FREE( csrs );
-  }
-
-  _HB_OPEN_Free_Coverage( &ccsf1->Coverage );
 }
 
 
@@ -2389,13 +2123,13 @@ static HB_Error  Load_ChainSubClassRule(
 
   count = cscr->BacktrackGlyphCount;
 
-  if ( ALLOC_ARRAY( cscr->Backtrack, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( cscr->Backtrack, count, HB_UShort ) )
     return error;
 
   b = cscr->Backtrack;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail4;
+    return error;
 
   for ( n = 0; n < count; n++ )
     b[n] = GET_UShort();
@@ -2403,7 +2137,7 @@ static HB_Error  Load_ChainSubClassRule(
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail4;
+    return error;
 
   cscr->InputGlyphCount = GET_UShort();
 
@@ -2416,13 +2150,13 @@ static HB_Error  Load_ChainSubClassRule(
 
   count = cscr->InputGlyphCount - 1; /* only InputGlyphCount - 1 elements */
 
-  if ( ALLOC_ARRAY( cscr->Input, count, HB_UShort ) )
-    goto Fail4;
+  if ( ARENA_ALLOC_ARRAY( cscr->Input, count, HB_UShort ) )
+    return error;
 
   i = cscr->Input;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail3;
+    return error;
 
   for ( n = 0; n < count; n++ )
     i[n] = GET_UShort();
@@ -2430,7 +2164,7 @@ static HB_Error  Load_ChainSubClassRule(
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   cscr->LookaheadGlyphCount = GET_UShort();
 
@@ -2443,13 +2177,13 @@ static HB_Error  Load_ChainSubClassRule(
 
   count = cscr->LookaheadGlyphCount;
 
-  if ( ALLOC_ARRAY( cscr->Lookahead, count, HB_UShort ) )
-    goto Fail3;
+  if ( ARENA_ALLOC_ARRAY( cscr->Lookahead, count, HB_UShort ) )
+    return error;
 
   l = cscr->Lookahead;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail2;
+    return error;
 
   for ( n = 0; n < count; n++ )
     l[n] = GET_UShort();
@@ -2457,7 +2191,7 @@ static HB_Error  Load_ChainSubClassRule(
   FORGET_Frame();
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   cscr->SubstCount = GET_UShort();
 
@@ -2467,14 +2201,14 @@ static HB_Error  Load_ChainSubClassRule(
 
   count = cscr->SubstCount;
 
-  if ( ALLOC_ARRAY( cscr->SubstLookupRecord, count,
+  if ( ARENA_ALLOC_ARRAY( cscr->SubstLookupRecord, count,
 		    HB_SubstLookupRecord ) )
-    goto Fail2;
+    return error;
 
   slr = cscr->SubstLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -2485,28 +2219,6 @@ static HB_Error  Load_ChainSubClassRule(
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( slr );
-
-Fail2:
-  FREE( l );
-
-Fail3:
-  FREE( i );
-
-Fail4:
-  FREE( b );
-  return error;
-}
-
-
-static void  Free_ChainSubClassRule( HB_ChainSubClassRule*  cscr )
-{
-  FREE( cscr->SubstLookupRecord );
-  FREE( cscr->Lookahead );
-  FREE( cscr->Input );
-  FREE( cscr->Backtrack );
 }
 
 
@@ -2519,10 +2231,11 @@ static HB_Error  Load_ChainSubClassSet(
 {
   HB_Error error;
 
-  HB_UShort               n = 0, m, count;
+  HB_UShort               n = 0, count;
   HB_UInt                cur_offset, new_offset, base_offset;
 
   HB_ChainSubClassRule*  cscr;
+  HB_ChainRuleKey*       keys;
 
 
   base_offset = FILE_Pos();
@@ -2536,7 +2249,7 @@ static HB_Error  Load_ChainSubClassSet(
 
   cscs->ChainSubClassRule = NULL;
 
-  if ( ALLOC_ARRAY( cscs->ChainSubClassRule, count,
+  if ( ARENA_ALLOC_ARRAY( cscs->ChainSubClassRule, count,
 		    HB_ChainSubClassRule ) )
     return error;
 
@@ -2545,7 +2258,7 @@ static HB_Error  Load_ChainSubClassSet(
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2555,38 +2268,22 @@ static HB_Error  Load_ChainSubClassSet(
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_ChainSubClassRule( ccsf2, &cscr[n],
 					   stream ) ) != HB_Err_Ok )
-      goto Fail;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
-  return HB_Err_Ok;
-
-Fail:
-  for ( m = 0; m < n; m++ )
-    Free_ChainSubClassRule( &cscr[m] );
-
-  FREE( cscr );
-  return error;
-}
-
-
-static void  Free_ChainSubClassSet( HB_ChainSubClassSet*  cscs )
-{
-  HB_UShort               n, count;
-
-  HB_ChainSubClassRule*  cscr;
+  /* compile the rules */
 
+  if ( ALLOC_ARRAY( keys, count, HB_ChainRuleKey ) )
+    return error;
 
-  if ( cscs->ChainSubClassRule )
-  {
-    count = cscs->ChainSubClassRuleCount;
-    cscr  = cscs->ChainSubClassRule;
+  for ( n = 0; n < count; n++ )
+    CHAIN_RULE_Key( &keys[n], &cscr[n] );
 
-    for ( n = 0; n < count; n++ )
-      Free_ChainSubClassRule( &cscr[n] );
+  error = _HB_OPEN_Make_Chain_Trie( &cscs->Trie, keys, count, TRUE, stream );
 
-    FREE( cscr );
-  }
+  FREE( keys );
+  return error;
 }
 
 
@@ -2598,7 +2295,7 @@ static HB_Error  Load_ChainContextSubst2(
 {
   HB_Error error;
 
-  HB_UShort              n = 0, m, count;
+  HB_UShort              n = 0, count;
   HB_UInt               cur_offset, new_offset, base_offset;
   HB_UInt               backtrack_offset, input_offset, lookahead_offset;
 
@@ -2621,7 +2318,7 @@ static HB_Error  Load_ChainContextSubst2(
   (void)FILE_Seek( cur_offset );
 
   if ( ACCESS_Frame( 8L ) )
-    goto Fail5;
+    return error;
 
   backtrack_offset = GET_UShort();
   input_offset     = GET_UShort();
@@ -2638,31 +2335,31 @@ static HB_Error  Load_ChainContextSubst2(
   if ( ( error = _HB_OPEN_Load_EmptyOrClassDefinition( &ccsf2->BacktrackClassDef, 65535,
 						       backtrack_offset, base_offset,
 						       stream ) ) != HB_Err_Ok )
-      goto Fail5;
+      return error;
 
   if ( ( error = _HB_OPEN_Load_EmptyOrClassDefinition( &ccsf2->InputClassDef, count,
 						       input_offset, base_offset,
 						       stream ) ) != HB_Err_Ok )
-      goto Fail4;
+      return error;
   if ( ( error = _HB_OPEN_Load_EmptyOrClassDefinition( &ccsf2->LookaheadClassDef, 65535,
 						       lookahead_offset, base_offset,
 						       stream ) ) != HB_Err_Ok )
-    goto Fail3;
+    return error;
 
   ccsf2->ChainSubClassSet   = NULL;
   ccsf2->MaxBacktrackLength = 0;
   ccsf2->MaxInputLength     = 0;
   ccsf2->MaxLookaheadLength = 0;
 
-  if ( ALLOC_ARRAY( ccsf2->ChainSubClassSet, count, HB_ChainSubClassSet ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( ccsf2->ChainSubClassSet, count, HB_ChainSubClassSet ) )
+    return error;
 
   cscs = ccsf2->ChainSubClassSet;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2674,7 +2371,7 @@ static HB_Error  Load_ChainContextSubst2(
       if ( FILE_Seek( new_offset ) ||
 	   ( error = Load_ChainSubClassSet( ccsf2, &cscs[n],
 					    stream ) ) != HB_Err_Ok )
-	goto Fail1;
+	return error;
       (void)FILE_Seek( cur_offset );
     }
     else
@@ -2687,51 +2384,6 @@ static HB_Error  Load_ChainContextSubst2(
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_ChainSubClassSet( &cscs[m] );
-
-  FREE( cscs );
-
-Fail2:
-  _HB_OPEN_Free_ClassDefinition( &ccsf2->LookaheadClassDef );
-
-Fail3:
-  _HB_OPEN_Free_ClassDefinition( &ccsf2->InputClassDef );
-
-Fail4:
-  _HB_OPEN_Free_ClassDefinition( &ccsf2->BacktrackClassDef );
-
-Fail5:
-  _HB_OPEN_Free_Coverage( &ccsf2->Coverage );
-  return error;
-}
-
-
-static void  Free_ChainContextSubst2( HB_ChainContextSubstFormat2*  ccsf2 )
-{
-  HB_UShort              n, count;
-
-  HB_ChainSubClassSet*  cscs;
-
-
-  if ( ccsf2->ChainSubClassSet )
-  {
-    count = ccsf2->ChainSubClassSetCount;
-    cscs  = ccsf2->ChainSubClassSet;
-
-    for ( n = 0; n < count; n++ )
-      Free_ChainSubClassSet( &cscs[n] );
-
-    FREE( cscs );
-  }
-
-  _HB_OPEN_Free_ClassDefinition( &ccsf2->LookaheadClassDef );
-  _HB_OPEN_Free_ClassDefinition( &ccsf2->InputClassDef );
-  _HB_OPEN_Free_ClassDefinition( &ccsf2->BacktrackClassDef );
-
-  _HB_OPEN_Free_Coverage( &ccsf2->Coverage );
 }
 
 
@@ -2743,7 +2395,7 @@ static HB_Error  Load_ChainContextSubst3(
 {
   HB_Error error;
 
-  HB_UShort               n, nb = 0, ni =0, nl = 0, m, count;
+  HB_UShort               n, nb = 0, ni =0, nl = 0, count;
   HB_UShort               backtrack_count, input_count, lookahead_count;
   HB_UInt                cur_offset, new_offset, base_offset;
 
@@ -2766,7 +2418,7 @@ static HB_Error  Load_ChainContextSubst3(
 
   backtrack_count = ccsf3->BacktrackGlyphCount;
 
-  if ( ALLOC_ARRAY( ccsf3->BacktrackCoverage, backtrack_count,
+  if ( ARENA_ALLOC_ARRAY( ccsf3->BacktrackCoverage, backtrack_count,
 		    HB_Coverage ) )
     return error;
 
@@ -2775,7 +2427,7 @@ static HB_Error  Load_ChainContextSubst3(
   for ( nb = 0; nb < backtrack_count; nb++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail4;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2784,12 +2436,12 @@ static HB_Error  Load_ChainContextSubst3(
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &b[nb], stream ) ) != HB_Err_Ok )
-      goto Fail4;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail4;
+    return error;
 
   ccsf3->InputGlyphCount = GET_UShort();
 
@@ -2799,15 +2451,15 @@ static HB_Error  Load_ChainContextSubst3(
 
   input_count = ccsf3->InputGlyphCount;
 
-  if ( ALLOC_ARRAY( ccsf3->InputCoverage, input_count, HB_Coverage ) )
-    goto Fail4;
+  if ( ARENA_ALLOC_ARRAY( ccsf3->InputCoverage, input_count, HB_Coverage ) )
+    return error;
 
   i = ccsf3->InputCoverage;
 
   for ( ni = 0; ni < input_count; ni++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail3;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2816,12 +2468,12 @@ static HB_Error  Load_ChainContextSubst3(
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &i[ni], stream ) ) != HB_Err_Ok )
-      goto Fail3;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   ccsf3->LookaheadGlyphCount = GET_UShort();
 
@@ -2831,16 +2483,16 @@ static HB_Error  Load_ChainContextSubst3(
 
   lookahead_count = ccsf3->LookaheadGlyphCount;
 
-  if ( ALLOC_ARRAY( ccsf3->LookaheadCoverage, lookahead_count,
+  if ( ARENA_ALLOC_ARRAY( ccsf3->LookaheadCoverage, lookahead_count,
 		    HB_Coverage ) )
-    goto Fail3;
+    return error;
 
   l = ccsf3->LookaheadCoverage;
 
   for ( nl = 0; nl < lookahead_count; nl++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -2849,12 +2501,12 @@ static HB_Error  Load_ChainContextSubst3(
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &l[nl], stream ) ) != HB_Err_Ok )
-      goto Fail2;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   ccsf3->SubstCount = GET_UShort();
 
@@ -2864,14 +2516,14 @@ static HB_Error  Load_ChainContextSubst3(
 
   count = ccsf3->SubstCount;
 
-  if ( ALLOC_ARRAY( ccsf3->SubstLookupRecord, count,
+  if ( ARENA_ALLOC_ARRAY( ccsf3->SubstLookupRecord, count,
 		    HB_SubstLookupRecord ) )
-    goto Fail2;
+    return error;
 
   slr = ccsf3->SubstLookupRecord;
 
   if ( ACCESS_Frame( count * 4L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
   {
@@ -2882,72 +2534,6 @@ static HB_Error  Load_ChainContextSubst3(
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( slr );
-
-Fail2:
-  for ( m = 0; m < nl; m++ )
-    _HB_OPEN_Free_Coverage( &l[m] );
-
-  FREE( l );
-
-Fail3:
-  for ( m = 0; m < ni; m++ )
-    _HB_OPEN_Free_Coverage( &i[m] );
-
-  FREE( i );
-
-Fail4:
-  for ( m = 0; m < nb; m++ )
-    _HB_OPEN_Free_Coverage( &b[m] );
-
-  FREE( b );
-  return error;
-}
-
-
-static void  Free_ChainContextSubst3( HB_ChainContextSubstFormat3*  ccsf3 )
-{
-  HB_UShort      n, count;
-
-  HB_Coverage*  c;
-
-
-  FREE( ccsf3->SubstLookupRecord );
-
-  if ( ccsf3->LookaheadCoverage )
-  {
-    count = ccsf3->LookaheadGlyphCount;
-    c     = ccsf3->LookaheadCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
-
-  if ( ccsf3->InputCoverage )
-  {
-    count = ccsf3->InputGlyphCount;
-    c     = ccsf3->InputCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
-
-  if ( ccsf3->BacktrackCoverage )
-  {
-    count = ccsf3->BacktrackGlyphCount;
-    c     = ccsf3->BacktrackCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
 }
 
 
@@ -2977,19 +2563,6 @@ static HB_Error  Load_ChainContextSubst( HB_GSUB_SubTable* st,
 }
 
 
-static void  Free_ChainContextSubst( HB_GSUB_SubTable* st )
-{
-  HB_ChainContextSubst*  ccs = &st->chain;
-
-  switch ( ccs->SubstFormat ) {
-    case 1:  Free_ChainContextSubst1( &ccs->ccsf.ccsf1 ); break;
-    case 2:  Free_ChainContextSubst2( &ccs->ccsf.ccsf2 ); break;
-    case 3:  Free_ChainContextSubst3( &ccs->ccsf.ccsf3 ); break;
-    default:							  break;
-  }
-}
-
-
 static HB_Error  Lookup_ChainContextSubst1( HB_GSUBHeader*               gsub,
 					    HB_ChainContextSubstFormat1* ccsf1,
 					    HB_Buffer                    buffer,
@@ -2997,13 +2570,11 @@ static HB_Error  Lookup_ChainContextSubst1( HB_GSUBHeader*               gsub,
 					    HB_UShort                     context_length,
 					    int                           nesting_level )
 {
-  HB_UShort          index, property;
-  HB_UShort          i, j, k, num_csr;
-  HB_UShort          bgc, igc, lgc;
+  HB_UShort          index, property, k;
   HB_Error           error;
 
   HB_ChainSubRule*  csr;
-  HB_ChainSubRule   curr_csr;
+  HB_ChainContext   cc;
   HB_GDEFHeader*    gdef;
 
 
@@ -3016,104 +2587,30 @@ static HB_Error  Lookup_ChainContextSubst1( HB_GSUBHeader*               gsub,
   if ( error )
     return error;
 
-  csr     = ccsf1->ChainSubRuleSet[index].ChainSubRule;
-  num_csr = ccsf1->ChainSubRuleSet[index].ChainSubRuleCount;
-
-  for ( k = 0; k < num_csr; k++ )
-  {
-    curr_csr = csr[k];
-    bgc      = curr_csr.BacktrackGlyphCount;
-    igc      = curr_csr.InputGlyphCount;
-    lgc      = curr_csr.LookaheadGlyphCount;
-
-    if ( context_length != 0xFFFF && context_length < igc )
-      goto next_chainsubrule;
-
-    /* check whether context is too long; it is a first guess only */
-
-    if ( bgc > buffer->out_pos || buffer->in_pos + igc + lgc > buffer->in_length )
-      goto next_chainsubrule;
-
-    if ( bgc )
-    {
-      /* since we don't know in advance the number of glyphs to inspect,
-	 we search backwards for matches in the backtrack glyph array    */
-
-      for ( i = 0, j = buffer->out_pos - 1; i < bgc; i++, j-- )
-      {
-	while ( CHECK_Property( gdef, OUT_ITEM( j ), flags, &property ) )
-	{
-	  if ( error && error != HB_Err_Not_Covered )
-	    return error;
-
-	  if ( j + 1 == bgc - i )
-	    goto next_chainsubrule;
-	  j--;
-	}
-
-	/* In OpenType 1.3, it is undefined whether the offsets of
-	   backtrack glyphs is in logical order or not.  Version 1.4
-	   will clarify this:
-
-	     Logical order -      a  b  c  d  e  f  g  h  i  j
-					      i
-	     Input offsets -                  0  1
-	     Backtrack offsets -  3  2  1  0
-	     Lookahead offsets -                    0  1  2  3           */
-
-	if ( OUT_GLYPH( j ) != curr_csr.Backtrack[i] )
-	  goto next_chainsubrule;
-      }
-    }
-
-    /* Start at 1 because [0] is implied */
-
-    for ( i = 1, j = buffer->in_pos + 1; i < igc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  return error;
-
-	if ( j + igc - i + lgc == (HB_Int)buffer->in_length )
-	  goto next_chainsubrule;
-	j++;
-      }
-
-      if ( IN_GLYPH( j ) != curr_csr.Input[i - 1] )
-	  goto next_chainsubrule;
-    }
-
-    /* we are starting to check for lookahead glyphs right after the
-       last context glyph                                            */
-
-    for ( i = 0; i < lgc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  return error;
-
-	if ( j + lgc - i == (HB_Int)buffer->in_length )
-	  goto next_chainsubrule;
-	j++;
-      }
+  /* the backtrack glyphs have been substituted already, so they are
+     matched against the output string                                */
 
-      if ( IN_GLYPH( j ) != curr_csr.Lookahead[i] )
-	goto next_chainsubrule;
-    }
+  cc.gdef              = gdef;
+  cc.buffer            = buffer;
+  cc.flags             = flags;
+  cc.context_length    = context_length;
+  cc.backtrack_output  = TRUE;
+  cc.BacktrackClassDef = NULL;
+  cc.InputClassDef     = NULL;
+  cc.LookaheadClassDef = NULL;
 
-    return Do_ContextSubst( gsub, igc,
-			    curr_csr.SubstCount,
-			    curr_csr.SubstLookupRecord,
-			    buffer,
-			    nesting_level );
+  error = _HB_OPEN_Match_Chain_Trie( &ccsf1->ChainSubRuleSet[index].Trie,
+				     &cc, &k );
+  if ( error )
+    return error;
 
-  next_chainsubrule:
-    ;
-  }
+  csr = &ccsf1->ChainSubRuleSet[index].ChainSubRule[k];
 
-  return HB_Err_Not_Covered;
+  return Do_ContextSubst( gsub, csr->InputGlyphCount,
+			  csr->SubstCount,
+			  csr->SubstLookupRecord,
+			  buffer,
+			  nesting_level );
 }
 
 
@@ -3124,24 +2621,12 @@ static HB_Error  Lookup_ChainContextSubst2( HB_GSUBHeader*               gsub,
 					    HB_UShort                     context_length,
 					    int                           nesting_level )
 {
-  HB_UShort              index, property;
+  HB_UShort              index, property, klass, k;
   HB_Error               error;
-  HB_UShort              i, j, k;
-  HB_UShort              bgc, igc, lgc;
-  HB_UShort              known_backtrack_classes,
-			 known_input_classes,
-			 known_lookahead_classes;
-
-  HB_UShort*             backtrack_classes;
-  HB_UShort*             input_classes;
-  HB_UShort*             lookahead_classes;
-
-  HB_UShort*             bc;
-  HB_UShort*             ic;
-  HB_UShort*             lc;
 
   HB_ChainSubClassSet*  cscs;
-  HB_ChainSubClassRule  ccsr;
+  HB_ChainSubClassRule* cscr;
+  HB_ChainContext       cc;
   HB_GDEFHeader*        gdef;
 
 
@@ -3158,165 +2643,38 @@ static HB_Error  Lookup_ChainContextSubst2( HB_GSUBHeader*               gsub,
   if ( error )
     return error;
 
-  if ( ALLOC_ARRAY( backtrack_classes, ccsf2->MaxBacktrackLength, HB_UShort ) )
-    return error;
-  known_backtrack_classes = 0;
-
   if (ccsf2->MaxInputLength < 1)
     return HB_Err_Not_Covered;
 
-  if ( ALLOC_ARRAY( input_classes, ccsf2->MaxInputLength, HB_UShort ) )
-    goto End3;
-  known_input_classes = 1;
-
-  if ( ALLOC_ARRAY( lookahead_classes, ccsf2->MaxLookaheadLength, HB_UShort ) )
-    goto End2;
-  known_lookahead_classes = 0;
-
   error = _HB_OPEN_Get_Class( &ccsf2->InputClassDef, IN_CURGLYPH(),
-		     &input_classes[0], NULL );
+		     &klass, NULL );
   if ( error && error != HB_Err_Not_Covered )
-    goto End1;
+    return error;
 
-  cscs = &ccsf2->ChainSubClassSet[input_classes[0]];
+  cscs = &ccsf2->ChainSubClassSet[klass];
   if ( !cscs )
-  {
-    error = ERR(HB_Err_Invalid_SubTable);
-    goto End1;
-  }
-
-  for ( k = 0; k < cscs->ChainSubClassRuleCount; k++ )
-  {
-    ccsr = cscs->ChainSubClassRule[k];
-    bgc  = ccsr.BacktrackGlyphCount;
-    igc  = ccsr.InputGlyphCount;
-    lgc  = ccsr.LookaheadGlyphCount;
-
-    if ( context_length != 0xFFFF && context_length < igc )
-      goto next_chainsubclassrule;
-
-    /* check whether context is too long; it is a first guess only */
-
-    if ( bgc > buffer->out_pos || buffer->in_pos + igc + lgc > buffer->in_length )
-      goto next_chainsubclassrule;
-
-    if ( bgc )
-    {
-      /* Since we don't know in advance the number of glyphs to inspect,
-	 we search backwards for matches in the backtrack glyph array.
-	 Note that `known_backtrack_classes' starts at index 0.         */
-
-      bc       = ccsr.Backtrack;
-
-      for ( i = 0, j = buffer->out_pos - 1; i < bgc; i++, j-- )
-      {
-	while ( CHECK_Property( gdef, OUT_ITEM( j ), flags, &property ) )
-	{
-	  if ( error && error != HB_Err_Not_Covered )
-	    goto End1;
-
-	  if ( j + 1 == bgc - i )
-	    goto next_chainsubclassrule;
-	  j--;
-	}
-
-	if ( i >= known_backtrack_classes )
-	{
-	  /* Keeps us from having to do this for each rule */
-
-	  error = _HB_OPEN_Get_Class( &ccsf2->BacktrackClassDef, OUT_GLYPH( j ),
-			     &backtrack_classes[i], NULL );
-	  if ( error && error != HB_Err_Not_Covered )
-	    goto End1;
-	  known_backtrack_classes = i;
-	}
-
-	if ( bc[i] != backtrack_classes[i] )
-	  goto next_chainsubclassrule;
-      }
-    }
-
-    ic       = ccsr.Input;
-
-    /* Start at 1 because [0] is implied */
-
-    for ( i = 1, j = buffer->in_pos + 1; i < igc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-
-	if ( j + igc - i + lgc == (HB_Int)buffer->in_length )
-	  goto next_chainsubclassrule;
-	j++;
-      }
-
-      if ( i >= known_input_classes )
-      {
-	error = _HB_OPEN_Get_Class( &ccsf2->InputClassDef, IN_GLYPH( j ),
-			   &input_classes[i], NULL );
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-	known_input_classes = i;
-      }
-
-      if ( ic[i - 1] != input_classes[i] )
-	goto next_chainsubclassrule;
-    }
-
-    /* we are starting to check for lookahead glyphs right after the
-       last context glyph                                            */
-
-    lc       = ccsr.Lookahead;
-
-    for ( i = 0; i < lgc; i++, j++ )
-    {
-      while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-      {
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-
-	if ( j + lgc - i == (HB_Int)buffer->in_length )
-	  goto next_chainsubclassrule;
-	j++;
-      }
-
-      if ( i >= known_lookahead_classes )
-      {
-	error = _HB_OPEN_Get_Class( &ccsf2->LookaheadClassDef, IN_GLYPH( j ),
-			   &lookahead_classes[i], NULL );
-	if ( error && error != HB_Err_Not_Covered )
-	  goto End1;
-	known_lookahead_classes = i;
-      }
-
-      if ( lc[i] != lookahead_classes[i] )
-	goto next_chainsubclassrule;
-    }
-
-    error = Do_ContextSubst( gsub, igc,
-			     ccsr.SubstCount,
-			     ccsr.SubstLookupRecord,
-			     buffer,
-			     nesting_level );
-    goto End1;
-
-  next_chainsubclassrule:
-    ;
-  }
+    return ERR(HB_Err_Invalid_SubTable);
 
-  error = HB_Err_Not_Covered;
+  cc.gdef              = gdef;
+  cc.buffer            = buffer;
+  cc.flags             = flags;
+  cc.context_length    = context_length;
+  cc.backtrack_output  = TRUE;
+  cc.BacktrackClassDef = &ccsf2->BacktrackClassDef;
+  cc.InputClassDef     = &ccsf2->InputClassDef;
+  cc.LookaheadClassDef = &ccsf2->LookaheadClassDef;
 
-End1:
-  FREE( lookahead_classes );
+  error = _HB_OPEN_Match_Chain_Trie( &cscs->Trie, &cc, &k );
+  if ( error )
+    return error;
 
-End2:
-  FREE( input_classes );
+  cscr = &cscs->ChainSubClassRule[k];
 
-End3:
-  FREE( backtrack_classes );
-  return error;
+  return Do_ContextSubst( gsub, cscr->InputGlyphCount,
+			  cscr->SubstCount,
+			  cscr->SubstLookupRecord,
+			  buffer,
+			  nesting_level );
 }
 
 
@@ -3327,7 +2685,8 @@ static HB_Error  Lookup_ChainContextSubst3( HB_GSUBHeader*               gsub,
 					    HB_UShort                     context_length,
 					    int                           nesting_level )
 {
-  HB_UShort        index, i, j, property;
+  HB_UShort        index, i, property;
+  HB_UInt          j;
   HB_UShort        bgc, igc, lgc;
   HB_Error         error;
 
@@ -3368,7 +2727,7 @@ static HB_Error  Lookup_ChainContextSubst3( HB_GSUBHeader*               gsub,
 	if ( error && error != HB_Err_Not_Covered )
 	  return error;
 
-	if ( j + 1 == bgc - i )
+	if ( j + 1 == (HB_UInt)( bgc - i ) )
 	  return HB_Err_Not_Covered;
 	j--;
       }
@@ -3384,15 +2743,8 @@ static HB_Error  Lookup_ChainContextSubst3( HB_GSUBHeader*               gsub,
   for ( i = 0, j = buffer->in_pos; i < igc; i++, j++ )
   {
     /* We already called CHECK_Property for IN_GLYPH( buffer->in_pos ) */
-    while ( j > buffer->in_pos && CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-    {
-      if ( error && error != HB_Err_Not_Covered )
-	return error;
-
-      if ( j + igc - i + lgc == (HB_Int)buffer->in_length )
-	return HB_Err_Not_Covered;
-      j++;
-    }
+    if ( j > buffer->in_pos && SKIP_Forward( gdef, flags, j ) )
+      return error;
 
     error = _HB_OPEN_Coverage_Index( &ic[i], IN_GLYPH( j ), &index );
     if ( error )
@@ -3406,15 +2758,8 @@ static HB_Error  Lookup_ChainContextSubst3( HB_GSUBHeader*               gsub,
 
   for ( i = 0; i < lgc; i++, j++ )
   {
-    while ( CHECK_Property( gdef, IN_ITEM( j ), flags, &property ) )
-    {
-      if ( error && error != HB_Err_Not_Covered )
-	return error;
-
-      if ( j + lgc - i == (HB_Int)buffer->in_length )
-	return HB_Err_Not_Covered;
-      j++;
-    }
+    if ( SKIP_Forward( gdef, flags, j ) )
+      return error;
 
     error = _HB_OPEN_Coverage_Index( &lc[i], IN_GLYPH( j ), &index );
     if ( error )
@@ -3453,7 +2798,7 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
   HB_Error error;
   HB_ReverseChainContextSubst*  rccs = &st->reverse;
 
-  HB_UShort               m, count;
+  HB_UShort               count;
 
   HB_UShort               nb = 0, nl = 0, n;
   HB_UShort               backtrack_count, lookahead_count;
@@ -3490,7 +2835,7 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
 
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail4;
+    return error;
 
   rccs->BacktrackGlyphCount = GET_UShort();
 
@@ -3500,16 +2845,16 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
 
   backtrack_count = rccs->BacktrackGlyphCount;
 
-  if ( ALLOC_ARRAY( rccs->BacktrackCoverage, backtrack_count,
+  if ( ARENA_ALLOC_ARRAY( rccs->BacktrackCoverage, backtrack_count,
 		    HB_Coverage ) )
-    goto Fail4;
+    return error;
 
   b = rccs->BacktrackCoverage;
 
   for ( nb = 0; nb < backtrack_count; nb++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail3;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -3518,13 +2863,13 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &b[nb], stream ) ) != HB_Err_Ok )
-      goto Fail3;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail3;
+    return error;
 
   rccs->LookaheadGlyphCount = GET_UShort();
 
@@ -3534,16 +2879,16 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
 
   lookahead_count = rccs->LookaheadGlyphCount;
 
-  if ( ALLOC_ARRAY( rccs->LookaheadCoverage, lookahead_count,
+  if ( ARENA_ALLOC_ARRAY( rccs->LookaheadCoverage, lookahead_count,
 		    HB_Coverage ) )
-    goto Fail3;
+    return error;
 
   l = rccs->LookaheadCoverage;
 
   for ( nl = 0; nl < lookahead_count; nl++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail2;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -3552,12 +2897,12 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = _HB_OPEN_Load_Coverage( &l[nl], stream ) ) != HB_Err_Ok )
-      goto Fail2;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   rccs->GlyphCount = GET_UShort();
 
@@ -3567,14 +2912,14 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
 
   count = rccs->GlyphCount;
 
-  if ( ALLOC_ARRAY( rccs->Substitute, count,
+  if ( ARENA_ALLOC_ARRAY( rccs->Substitute, count,
 		    HB_UShort ) )
-    goto Fail2;
+    return error;
 
   sub = rccs->Substitute;
 
   if ( ACCESS_Frame( count * 2L ) )
-    goto Fail1;
+    return error;
 
   for ( n = 0; n < count; n++ )
     sub[n] = GET_UShort();
@@ -3582,60 +2927,6 @@ static HB_Error  Load_ReverseChainContextSubst( HB_GSUB_SubTable* st,
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( sub );
-
-Fail2:
-  for ( m = 0; m < nl; m++ )
-    _HB_OPEN_Free_Coverage( &l[m] );
-
-  FREE( l );
-
-Fail3:
-  for ( m = 0; m < nb; m++ )
-    _HB_OPEN_Free_Coverage( &b[m] );
-
-  FREE( b );
-
-Fail4:
-  _HB_OPEN_Free_Coverage( &rccs->Coverage );
-  return error;
-}
-
-
-static void  Free_ReverseChainContextSubst( HB_GSUB_SubTable* st )
-{
-  HB_UShort      n, count;
-  HB_ReverseChainContextSubst*  rccs = &st->reverse;
-
-  HB_Coverage*  c;
-
-  _HB_OPEN_Free_Coverage( &rccs->Coverage );
-
-  if ( rccs->LookaheadCoverage )
-  {
-    count = rccs->LookaheadGlyphCount;
-    c     = rccs->LookaheadCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
-
-  if ( rccs->BacktrackCoverage )
-  {
-    count = rccs->BacktrackGlyphCount;
-    c     = rccs->BacktrackCoverage;
-
-    for ( n = 0; n < count; n++ )
-      _HB_OPEN_Free_Coverage( &c[n] );
-
-    FREE( c );
-  }
-
-  FREE ( rccs->Substitute );
 }
 
 
@@ -3722,6 +3013,10 @@ static HB_Error  Lookup_ReverseChainContextSubst( HB_GSUBHeader*    gsub,
   }
 
   IN_CURGLYPH() = rccs->Substitute[input_index];
+#ifdef HB_PARALLEL_GINDEX
+  buffer->in_gindex[buffer->in_pos] = rccs->Substitute[input_index];
+#endif
+  DIGEST_Add_Glyph( &buffer->digest, IN_CURGLYPH() );
   buffer->in_pos--; /* Reverse! */
 
   return error;
@@ -4025,6 +3320,8 @@ static HB_Error  GSUB_Do_Glyph_Lookup( HB_GSUBHeader* gsub,
   HB_Error               error = HB_Err_Not_Covered;
   HB_UShort              i, flags, lookup_count;
   HB_Lookup*             lo;
+  HB_SubTable*           subtables;
+  HB_UShort              subtable_count;
   int                    lookup_type;
 
   nesting_level++;
@@ -4040,9 +3337,16 @@ static HB_Error  GSUB_Do_Glyph_Lookup( HB_GSUBHeader* gsub,
   flags = lo->LookupFlag;
   lookup_type = lo->LookupType;
 
-  for ( i = 0; i < lo->SubTableCount; i++ )
+  /* a lookup whose subtables can't be loaded has none */
+  error = _HB_OPEN_Get_Lookup_SubTables( &gsub->LookupList, lookup_index,
+					 HB_Type_GSUB, &subtables,
+					 &subtable_count );
+  if ( error == HB_Err_Out_Of_Memory )
+    return error;
+
+  for ( i = 0; i < subtable_count; i++ )
   {
-    HB_GSUB_SubTable *st = &lo->SubTable[i].st.gsub;
+    HB_GSUB_SubTable *st = &subtables[i].st.gsub;
 
     switch (lookup_type) {
       case HB_GSUB_LOOKUP_SINGLE:
@@ -4094,20 +3398,43 @@ _HB_GSUB_Load_SubTable( HB_GSUB_SubTable* st,
 }
 
 
-HB_INTERNAL void
-_HB_GSUB_Free_SubTable( HB_GSUB_SubTable* st,
-			HB_UShort         lookup_type )
+/* the coverage of the first input glyph of a subtable, or NULL if any
+   glyph could be one                                                  */
+
+HB_INTERNAL HB_Coverage*
+_HB_GSUB_First_Coverage( HB_GSUB_SubTable* st,
+			 HB_UShort         lookup_type )
 {
-  switch ( lookup_type ) {
-    case HB_GSUB_LOOKUP_SINGLE:		Free_SingleSubst		( st ); return;
-    case HB_GSUB_LOOKUP_MULTIPLE:	Free_MultipleSubst		( st ); return;
-    case HB_GSUB_LOOKUP_ALTERNATE:	Free_AlternateSubst		( st ); return;
-    case HB_GSUB_LOOKUP_LIGATURE:	Free_LigatureSubst		( st ); return;
-    case HB_GSUB_LOOKUP_CONTEXT:	Free_ContextSubst		( st ); return;
-    case HB_GSUB_LOOKUP_CHAIN:		Free_ChainContextSubst		( st ); return;
-  /*case HB_GSUB_LOOKUP_EXTENSION:	Free_ExtensionSubst		( st ); return;*/
-    case HB_GSUB_LOOKUP_REVERSE_CHAIN:	Free_ReverseChainContextSubst	( st ); return;
-    default:									return;
+  HB_ContextSubst*       cs;
+  HB_ChainContextSubst*  ccs;
+
+  switch (lookup_type) {
+    case HB_GSUB_LOOKUP_SINGLE:		return &st->single.Coverage;
+    case HB_GSUB_LOOKUP_MULTIPLE:	return &st->multiple.Coverage;
+    case HB_GSUB_LOOKUP_ALTERNATE:	return &st->alternate.Coverage;
+    case HB_GSUB_LOOKUP_LIGATURE:	return &st->ligature.Coverage;
+    case HB_GSUB_LOOKUP_REVERSE_CHAIN:	return &st->reverse.Coverage;
+
+    case HB_GSUB_LOOKUP_CONTEXT:
+      cs = &st->context;
+      switch ( cs->SubstFormat ) {
+	case 1:  return &cs->csf.csf1.Coverage;
+	case 2:  return &cs->csf.csf2.Coverage;
+	case 3:  return cs->csf.csf3.GlyphCount ? &cs->csf.csf3.Coverage[0] : NULL;
+	default: return NULL;
+      }
+
+    case HB_GSUB_LOOKUP_CHAIN:
+      ccs = &st->chain;
+      switch ( ccs->SubstFormat ) {
+	case 1:  return &ccs->ccsf.ccsf1.Coverage;
+	case 2:  return &ccs->ccsf.ccsf2.Coverage;
+	case 3:  return ccs->ccsf.ccsf3.InputGlyphCount ?
+			  &ccs->ccsf.ccsf3.InputCoverage[0] : NULL;
+	default: return NULL;
+      }
+
+    default:				return NULL;
   };
 }
 
@@ -4115,19 +3442,68 @@ _HB_GSUB_Free_SubTable( HB_GSUB_SubTable* st,
 
 /* apply one lookup to the input string object */
 
+/* If `in_place' is set, the lookup must only replace glyphs one by one
+   (see HB_GSUB_Compose_Plan()).                                         */
+
 static HB_Error  GSUB_Do_String_Lookup( HB_GSUBHeader*   gsub,
 				   HB_UShort         lookup_index,
+				   HB_UInt           property,
+				   HB_Bool           in_place,
 				   HB_Buffer        buffer )
 {
-  HB_Error  error, retError = HB_Err_Not_Covered;
+  HB_Error        error, retError = HB_Err_Not_Covered;
+  HB_GlyphDigest  digest;
+  HB_UInt         next;
 
-  HB_UInt*  properties = gsub->LookupList.Properties;
   int       lookup_type = gsub->LookupList.Lookup[lookup_index].LookupType;
 
   const int       nesting_level = 0;
   /* 0xFFFF indicates that we don't have a context length yet */
   const HB_UShort context_length = 0xFFFF;
 
+  /* skip lookups which can't apply to any glyph of the buffer; this
+     leaves the buffer as it is after a lookup that doesn't match     */
+  error = _HB_OPEN_Lookup_May_Apply( &gsub->LookupList, lookup_index,
+				     HB_Type_GSUB, buffer );
+  if ( error )
+    return error;
+
+  _HB_OPEN_Lookup_Digest( &gsub->LookupList, lookup_index, HB_Type_GSUB,
+			  &digest );
+
+  if ( in_place )
+  {
+    /* the output string is the input string until a glyph is added, so
+       the glyphs not substituted can be passed over without copying;
+       the output position only matters to the lookups                 */
+
+    _hb_buffer_clear_output( buffer );
+    _hb_buffer_reset_skip_lists( buffer, TRUE );
+    buffer->in_pos = 0;
+    while ( ( buffer->in_pos = _HB_OPEN_Next_In_Digest( buffer, &digest ) ) <
+	    buffer->in_length )
+    {
+      if ( ~IN_PROPERTIES( buffer->in_pos ) & property )
+      {
+	buffer->out_pos = buffer->in_pos;
+	error = GSUB_Do_Glyph_Lookup( gsub, lookup_index, buffer, context_length, nesting_level );
+	if ( !error )
+	{
+	  retError = error;
+	  continue;
+	}
+	if ( error != HB_Err_Not_Covered )
+	  return error;
+      }
+      buffer->in_pos++;
+    }
+
+    buffer->out_pos = buffer->out_length = buffer->in_length;
+    _hb_buffer_reset_skip_lists( buffer, FALSE );
+
+    return retError;
+  }
+
   switch (lookup_type) {
 
     case HB_GSUB_LOOKUP_SINGLE:
@@ -4139,10 +3515,20 @@ static HB_Error  GSUB_Do_String_Lookup( HB_GSUBHeader*   gsub,
       /* in/out forward substitution (implemented lazy) */
 
       _hb_buffer_clear_output ( buffer );
+      _hb_buffer_reset_skip_lists( buffer, TRUE );
       buffer->in_pos = 0;
   while ( buffer->in_pos < buffer->in_length )
   {
-    if ( ~IN_PROPERTIES( buffer->in_pos ) & properties[lookup_index] )
+    /* copy the glyphs the lookup can't be applied at in one go */
+    next = _HB_OPEN_Next_In_Digest( buffer, &digest );
+    if ( next > buffer->in_pos )
+    {
+      if ( COPY_Glyphs( buffer, next - buffer->in_pos ) )
+	return error;
+      continue;
+    }
+
+    if ( ~IN_PROPERTIES( buffer->in_pos ) & property )
     {
 	  error = GSUB_Do_Glyph_Lookup( gsub, lookup_index, buffer, context_length, nesting_level );
       if ( error )
@@ -4173,10 +3559,11 @@ static HB_Error  GSUB_Do_String_Lookup( HB_GSUBHeader*   gsub,
     case HB_GSUB_LOOKUP_REVERSE_CHAIN:
       /* in-place backward substitution */
 
+      _hb_buffer_reset_skip_lists( buffer, FALSE );
       buffer->in_pos = buffer->in_length - 1;
     do
     {
-      if ( ~IN_PROPERTIES( buffer->in_pos ) & properties[lookup_index] )
+      if ( ~IN_PROPERTIES( buffer->in_pos ) & property )
 	{
 	  error = GSUB_Do_Glyph_Lookup( gsub, lookup_index, buffer, context_length, nesting_level );
 	  if ( error )
@@ -4264,6 +3651,378 @@ HB_Error  HB_GSUB_Clear_Features( HB_GSUBHeader*  gsub )
 
 
 
+HB_Error  HB_GSUB_Plan_Add_Feature( HB_GSUBHeader*  gsub,
+				    HB_LookupPlan*  plan,
+				    HB_UShort       feature_index,
+				    HB_UInt         property )
+{
+  if ( !gsub )
+    return ERR(HB_Err_Invalid_Argument);
+
+  return _HB_OPEN_Plan_Add_Feature( plan,
+				    &gsub->FeatureList,
+				    &gsub->LookupList,
+				    feature_index, property );
+}
+
+
+/* A lookup keeps the length of the string if it only replaces glyphs
+   one by one: single and alternate substitutions, and context lookups
+   whose nested lookups all keep the length.  `state' caches the answer
+   per lookup; a lookup reached again while it is examined, or one whose
+   subtables can't be loaded now, counts as changing the length.       */
+
+#define HB_LENGTH_UNKNOWN   0
+#define HB_LENGTH_CHECKING  1
+#define HB_LENGTH_KEPT      2
+#define HB_LENGTH_CHANGED   3
+
+static HB_Bool  Lookup_Keeps_Length( HB_GSUBHeader*  gsub,
+				     HB_UShort       lookup_index,
+				     HB_Byte*        state );
+
+static HB_Bool  Records_Keep_Length( HB_GSUBHeader*         gsub,
+				     HB_UShort              count,
+				     HB_SubstLookupRecord*  slr,
+				     HB_Byte*               state )
+{
+  HB_UShort  n;
+
+
+  for ( n = 0; n < count; n++ )
+    if ( !Lookup_Keeps_Length( gsub, slr[n].LookupListIndex, state ) )
+      return FALSE;
+
+  return TRUE;
+}
+
+
+static HB_Bool  Context_Keeps_Length( HB_GSUBHeader*     gsub,
+				      HB_ContextSubst*  cs,
+				      HB_Byte*           state )
+{
+  HB_UShort        i, j;
+  HB_SubRuleSet*   srs;
+  HB_SubClassSet*  scs;
+
+
+  switch ( cs->SubstFormat )
+  {
+  case 1:
+    for ( i = 0; i < cs->csf.csf1.SubRuleSetCount; i++ )
+    {
+      srs = &cs->csf.csf1.SubRuleSet[i];
+      for ( j = 0; j < srs->SubRuleCount; j++ )
+	if ( !Records_Keep_Length( gsub, srs->SubRule[j].SubstCount,
+				   srs->SubRule[j].SubstLookupRecord, state ) )
+	  return FALSE;
+    }
+    return TRUE;
+
+  case 2:
+    for ( i = 0; i < cs->csf.csf2.SubClassSetCount; i++ )
+    {
+      scs = &cs->csf.csf2.SubClassSet[i];
+      for ( j = 0; j < scs->SubClassRuleCount; j++ )
+	if ( !Records_Keep_Length( gsub, scs->SubClassRule[j].SubstCount,
+				   scs->SubClassRule[j].SubstLookupRecord, state ) )
+	  return FALSE;
+    }
+    return TRUE;
+
+  case 3:
+    return Records_Keep_Length( gsub, cs->csf.csf3.SubstCount,
+				cs->csf.csf3.SubstLookupRecord, state );
+  }
+
+  return FALSE;
+}
+
+
+static HB_Bool  Chain_Context_Keeps_Length( HB_GSUBHeader*          gsub,
+					    HB_ChainContextSubst*  ccs,
+					    HB_Byte*                state )
+{
+  HB_UShort             i, j;
+  HB_ChainSubRuleSet*   csrs;
+  HB_ChainSubClassSet*  cscs;
+
+
+  switch ( ccs->SubstFormat )
+  {
+  case 1:
+    for ( i = 0; i < ccs->ccsf.ccsf1.ChainSubRuleSetCount; i++ )
+    {
+      csrs = &ccs->ccsf.ccsf1.ChainSubRuleSet[i];
+      for ( j = 0; j < csrs->ChainSubRuleCount; j++ )
+	if ( !Records_Keep_Length( gsub, csrs->ChainSubRule[j].SubstCount,
+				   csrs->ChainSubRule[j].SubstLookupRecord, state ) )
+	  return FALSE;
+    }
+    return TRUE;
+
+  case 2:
+    for ( i = 0; i < ccs->ccsf.ccsf2.ChainSubClassSetCount; i++ )
+    {
+      cscs = &ccs->ccsf.ccsf2.ChainSubClassSet[i];
+      for ( j = 0; j < cscs->ChainSubClassRuleCount; j++ )
+	if ( !Records_Keep_Length( gsub, cscs->ChainSubClassRule[j].SubstCount,
+				   cscs->ChainSubClassRule[j].SubstLookupRecord, state ) )
+	  return FALSE;
+    }
+    return TRUE;
+
+  case 3:
+    return Records_Keep_Length( gsub, ccs->ccsf.ccsf3.SubstCount,
+				ccs->ccsf.ccsf3.SubstLookupRecord, state );
+  }
+
+  return FALSE;
+}
+
+
+static HB_Bool  Lookup_Keeps_Length( HB_GSUBHeader*  gsub,
+				     HB_UShort       lookup_index,
+				     HB_Byte*        state )
+{
+  HB_Lookup*    lo;
+  HB_SubTable*  subtables;
+  HB_UShort     i, count;
+  HB_Bool       kept = FALSE;
+
+
+  /* nonexistant lookups are skipped */
+  if ( lookup_index >= gsub->LookupList.LookupCount )
+    return TRUE;
+
+  if ( state[lookup_index] != HB_LENGTH_UNKNOWN )
+    return state[lookup_index] == HB_LENGTH_KEPT;
+
+  state[lookup_index] = HB_LENGTH_CHECKING;
+  lo = &gsub->LookupList.Lookup[lookup_index];
+
+  switch ( lo->LookupType )
+  {
+  case HB_GSUB_LOOKUP_SINGLE:
+  case HB_GSUB_LOOKUP_ALTERNATE:
+    kept = TRUE;
+    break;
+
+  case HB_GSUB_LOOKUP_CONTEXT:
+  case HB_GSUB_LOOKUP_CHAIN:
+    if ( _HB_OPEN_Get_Lookup_SubTables( &gsub->LookupList,
+					lookup_index, HB_Type_GSUB,
+					&subtables, &count ) )
+      break;
+
+    kept = TRUE;
+    for ( i = 0; kept && i < count; i++ )
+      if ( lo->LookupType == HB_GSUB_LOOKUP_CONTEXT )
+	kept = Context_Keeps_Length( gsub, &subtables[i].st.gsub.context,
+				     state );
+      else
+	kept = Chain_Context_Keeps_Length( gsub,
+					   &subtables[i].st.gsub.chain,
+					   state );
+    break;
+  }
+
+  state[lookup_index] = kept ? HB_LENGTH_KEPT : HB_LENGTH_CHANGED;
+
+  return kept;
+}
+
+
+/* A single substitution only looks at the current glyph, so a run of
+   them applied with the same properties maps glyph IDs to glyph IDs.
+   The mapping is found by applying the lookups to a buffer holding
+   every glyph ID once, up to the largest one covered by the lookups;
+   all others are left as they are.  Shorter runs aren't worth the
+   memory.                                                             */
+
+#define HB_COMPOSE_MIN_LOOKUPS  2
+
+static HB_Bool  Is_Composable( HB_GSUBHeader*        gsub,
+			       const HB_PlanLookup*  pl,
+			       HB_UInt               properties )
+{
+  return pl->Properties == properties &&
+	 gsub->LookupList.Lookup[pl->LookupIndex].LookupType ==
+	   HB_GSUB_LOOKUP_SINGLE;
+}
+
+
+static HB_Error  Compose_Lookups( HB_GSUBHeader*  gsub,
+				  HB_PlanLookup*  first,
+				  HB_UInt         count,
+				  HB_Buffer       buffer )
+{
+  HB_Error      error;
+  HB_UInt       n, pos, length, limit;
+  HB_UInt*      map;
+  HB_SubTable*  st;
+  HB_UShort     i, st_count;
+
+
+  limit = 0;
+
+  for ( n = 0; n < count; n++ )
+  {
+    error = _HB_OPEN_Get_Lookup_SubTables( &gsub->LookupList,
+					   first[n].LookupIndex, HB_Type_GSUB,
+					   &st, &st_count );
+    if ( error == HB_Err_Out_Of_Memory )
+      return error;
+
+    for ( i = 0; i < st_count; i++ )
+    {
+      length = _HB_OPEN_Coverage_Limit( &st[i].st.gsub.single.Coverage );
+      if ( length > limit )
+	limit = length;
+    }
+  }
+
+  /* none of the lookups covers anything */
+  if ( !limit )
+  {
+    first->ComposedCount  = count;
+    first->ComposedLength = 0;
+    first->ComposedMap    = NULL;
+
+    return HB_Err_Ok;
+  }
+
+  hb_buffer_clear( buffer );
+
+  for ( n = 0; n < limit; n++ )
+    if ( ( error = hb_buffer_add_glyph( buffer, n, 0, n ) ) != HB_Err_Ok )
+      return error;
+
+  if ( ALLOC_ARRAY( map, limit, HB_UInt ) )
+    return error;
+
+  for ( n = 0; n < count; n++ )
+  {
+    _hb_buffer_clear_output( buffer );
+    buffer->in_pos = 0;
+
+    while ( buffer->in_pos < buffer->in_length )
+    {
+      pos   = buffer->in_pos;
+      error = GSUB_Do_Glyph_Lookup( gsub, first[n].LookupIndex, buffer,
+				    0xFFFF, 0 );
+      if ( error == HB_Err_Not_Covered )
+      {
+	if ( COPY_Glyph( buffer ) )
+	  goto Fail;
+      }
+      else if ( error )
+	goto Fail;
+      else
+	map[pos] = HB_PLAN_COMPOSED_APPLIED;
+    }
+
+    _hb_buffer_swap( buffer );
+  }
+
+  length = 0;
+
+  for ( n = 0; n < limit; n++ )
+    if ( map[n] )
+    {
+      map[n] |= IN_GLYPH( n );
+      length  = n + 1;
+    }
+
+  if ( !length )
+    FREE( map );
+  else if ( REALLOC_ARRAY( map, length, HB_UInt ) )
+    goto Fail;
+
+  first->ComposedCount  = count;
+  first->ComposedLength = length;
+  first->ComposedMap    = map;
+
+  return HB_Err_Ok;
+
+Fail:
+  FREE( map );
+  return error;
+}
+
+
+HB_Error  HB_GSUB_Compose_Plan( HB_GSUBHeader*  gsub,
+				HB_LookupPlan*  plan )
+{
+  HB_Error        error = HB_Err_Ok;
+  HB_UInt         i, count;
+  HB_Buffer       buffer = NULL;
+  HB_GDEFHeader*  gdef;
+  HB_Byte*        state;
+
+
+  if ( !gsub || !plan )
+    return ERR(HB_Err_Invalid_Argument);
+
+  _HB_OPEN_Plan_Free_Composed( plan );
+
+  if ( plan->LookupCount )
+  {
+    if ( ALLOC_ARRAY( state, gsub->LookupList.LookupCount, HB_Byte ) )
+      return error;
+
+    /* reverse chaining lookups are applied in place anyway */
+
+    for ( i = 0; i < plan->LookupCount; i++ )
+      plan->Lookup[i].InPlace =
+	gsub->LookupList.Lookup[plan->Lookup[i].LookupIndex].LookupType !=
+	  HB_GSUB_LOOKUP_REVERSE_CHAIN &&
+	Lookup_Keeps_Length( gsub, plan->Lookup[i].LookupIndex, state );
+
+    FREE( state );
+  }
+
+  /* the properties of a glyph must only depend on its glyph ID, not on
+     the classes added while shaping or on the cached properties of a
+     buffer item                                                        */
+
+  gdef = gsub->gdef;
+  if ( gdef && !gdef->GlyphProperties &&
+       ( gdef->GlyphClassDef.loaded || gdef->MarkAttachClassDef.loaded ) )
+    return HB_Err_Ok;
+
+  for ( i = 0; i < plan->LookupCount; i += count )
+  {
+    for ( count = 0; i + count < plan->LookupCount; count++ )
+      if ( !Is_Composable( gsub, &plan->Lookup[i + count],
+			   plan->Lookup[i].Properties ) )
+	break;
+
+    if ( count < HB_COMPOSE_MIN_LOOKUPS )
+    {
+      count = 1;
+      continue;
+    }
+
+    if ( !buffer && ( error = hb_buffer_new( &buffer ) ) != HB_Err_Ok )
+      break;
+
+    /* a run that fails to compose is applied lookup by lookup */
+
+    error = Compose_Lookups( gsub, &plan->Lookup[i], count, buffer );
+    if ( error == HB_Err_Out_Of_Memory )
+      break;
+    error = HB_Err_Ok;
+  }
+
+  if ( buffer )
+    hb_buffer_free( buffer );
+
+  return error;
+}
+
+
+
 HB_Error  HB_GSUB_Register_Alternate_Function( HB_GSUBHeader*  gsub,
 					       HB_AltFunction  altfunc,
 					       void*            data )
@@ -4309,7 +4068,9 @@ HB_Error  HB_GSUB_Apply_String( HB_GSUBHeader*   gsub,
       if (lookup_index >= lookup_count)
        continue;
 
-	error = GSUB_Do_String_Lookup( gsub, lookup_index, buffer );
+	error = GSUB_Do_String_Lookup( gsub, lookup_index,
+				       gsub->LookupList.Properties[lookup_index],
+				       FALSE, buffer );
       if ( error )
       {
 	if ( error != HB_Err_Not_Covered )
@@ -4325,5 +4086,110 @@ HB_Error  HB_GSUB_Apply_String( HB_GSUBHeader*   gsub,
   return error;
 }
 
+/* Apply a run of single substitutions merged by HB_GSUB_Compose_Plan();
+   like them, it replaces the glyphs in place.                          */
+
+static HB_Error  GSUB_Apply_Composed( const HB_PlanLookup*  pl,
+				      HB_Buffer             buffer )
+{
+  HB_Error      retError = HB_Err_Not_Covered;
+  HB_UInt       n, value;
+  HB_GlyphItem  item;
+
+
+  for ( n = 0, item = buffer->in_string; n < buffer->in_length; n++, item++ )
+    if ( item->gindex < pl->ComposedLength &&
+	 ~item->properties & pl->Properties )
+    {
+      value = pl->ComposedMap[item->gindex];
+
+      if ( value & HB_PLAN_COMPOSED_APPLIED )
+      {
+	item->gindex = value & 0xFFFF;
+#ifdef HB_PARALLEL_GINDEX
+	buffer->in_gindex[n] = (HB_UShort)value;
+#endif
+	DIGEST_Add_Glyph( &buffer->digest, item->gindex );
+	retError = HB_Err_Ok;
+      }
+    }
+
+  return retError;
+}
+
+
+/* Same as HB_GSUB_Apply_String(), but applies the lookups of `plan'
+ * instead of the feature selection stored in `gsub'.
+ */
+HB_Error  HB_GSUB_Apply_Plan( HB_GSUBHeader*        gsub,
+			      const HB_LookupPlan*  plan,
+			      HB_Buffer             buffer )
+{
+  if ( !buffer )
+    return ERR(HB_Err_Invalid_Argument);
+
+  return HB_GSUB_Apply_Strings( gsub, plan, &buffer, 1, NULL );
+}
+
+
+/* The buffers are processed lookup by lookup, so that the subtables of
+ * a lookup are read for all of them while they are still in the cache.
+ */
+HB_Error  HB_GSUB_Apply_Strings( HB_GSUBHeader*        gsub,
+				 const HB_LookupPlan*  plan,
+				 HB_Buffer*            buffers,
+				 HB_UInt               count,
+				 HB_Error*             results )
+{
+  HB_Error              error, retError = HB_Err_Not_Covered;
+  HB_UInt               i, n, step;
+  const HB_PlanLookup*  pl;
+
+  if ( !gsub ||
+       !plan ||
+       ( count && !buffers ) )
+    return ERR(HB_Err_Invalid_Argument);
+
+  for ( n = 0; n < count; n++ )
+  {
+    if ( !buffers[n] )
+      return ERR(HB_Err_Invalid_Argument);
+    if ( results )
+      results[n] = HB_Err_Not_Covered;
+  }
+
+  for ( i = 0; i < plan->LookupCount; i += step )
+  {
+    pl   = &plan->Lookup[i];
+    step = pl->ComposedCount ? pl->ComposedCount : 1;
+
+    for ( n = 0; n < count; n++ )
+    {
+      if ( buffers[n]->in_length == 0 )
+	continue;
+
+      if ( pl->ComposedCount )
+	error = GSUB_Apply_Composed( pl, buffers[n] );
+      else
+	error = GSUB_Do_String_Lookup( gsub, pl->LookupIndex,
+				       pl->Properties, pl->InPlace,
+				       buffers[n] );
+      if ( error )
+      {
+	if ( error != HB_Err_Not_Covered )
+	  return error;
+      }
+      else
+      {
+	retError = error;
+	if ( results )
+	  results[n] = error;
+      }
+    }
+  }
+
+  return retError;
+}
+
 
 /* END */
@@ -75,12 +75,17 @@ struct  HB_GSUBHeader_
 
   HB_AltFunction  altfunc;
   void*            data;
+
+  HB_Arena        arena;          /* holds the header and the lists */
 };
 
 typedef struct HB_GSUBHeader_   HB_GSUBHeader;
 typedef HB_GSUBHeader*  HB_GSUB;
 
 
+/* On success the table takes over the data of `stream' (its destroy
+   function is cleared), as lookup subtables are loaded from it on first
+   use; it is released by HB_Done_GSUB_Table().                        */
 HB_Error  HB_Load_GSUB_Table( HB_Stream       stream,
 			      HB_GSUBHeader** gsub,
 			      HB_GDEFHeader*  gdef,
@@ -126,6 +131,20 @@ HB_Error  HB_GSUB_Add_Feature( HB_GSUBHeader*  gsub,
 
 HB_Error  HB_GSUB_Clear_Features( HB_GSUBHeader*  gsub );
 
+HB_Error  HB_GSUB_Plan_Add_Feature( HB_GSUBHeader*  gsub,
+				    HB_LookupPlan*  plan,
+				    HB_UShort       feature_index,
+				    HB_UInt         property );
+
+/* Mark the lookups of `plan' that only replace glyphs one by one, so
+   that they are applied in place, and merge runs of single
+   substitutions into glyph mappings, applied in one pass over the
+   buffer; call it once all features are added.  Returns HB_Err_Ok also
+   if nothing could be merged.                                          */
+
+HB_Error  HB_GSUB_Compose_Plan( HB_GSUBHeader*  gsub,
+				HB_LookupPlan*  plan );
+
 
 HB_Error  HB_GSUB_Register_Alternate_Function( HB_GSUBHeader*  gsub,
 					       HB_AltFunction  altfunc,
@@ -135,6 +154,23 @@ HB_Error  HB_GSUB_Register_Alternate_Function( HB_GSUBHeader*  gsub,
 HB_Error  HB_GSUB_Apply_String( HB_GSUBHeader*   gsub,
 				HB_Buffer        buffer );
 
+HB_Error  HB_GSUB_Apply_Plan( HB_GSUBHeader*        gsub,
+			      const HB_LookupPlan*  plan,
+			      HB_Buffer             buffer );
+
+/* Same as calling HB_GSUB_Apply_Plan() for each of the `count' buffers,
+   but applies every lookup to all of the buffers before the next one.
+   If `results' isn't NULL, it gets what HB_GSUB_Apply_Plan() would have
+   returned for each buffer.  Returns the first error that happened,
+   otherwise HB_Err_Not_Covered if nothing was applied to any buffer, or
+   HB_Err_Ok.                                                           */
+
+HB_Error  HB_GSUB_Apply_Strings( HB_GSUBHeader*        gsub,
+				 const HB_LookupPlan*  plan,
+				 HB_Buffer*            buffers,
+				 HB_UInt               count,
+				 HB_Error*             results );
+
 
 HB_END_HEADER
 
@@ -237,6 +237,7 @@ HB_Bool HB_HangulShape(HB_ShaperItem *item)
         openType = HB_SelectScript(item, hangul_features);
 #endif
         syllable = *item;
+        syllable.run = 0;
 
         while (sstart < end) {
             int send = hangul_nextSyllableBoundary(item->string, sstart, end);
@@ -249,6 +250,9 @@ HB_Bool HB_HangulShape(HB_ShaperItem *item)
             syllable.advances = item->advances + first_glyph;
             syllable.num_glyphs = item->num_glyphs - first_glyph;
             if (!hangul_shape_syllable(&syllable, openType)) {
+                /* shaping into a glyph run, make room and shape the syllable again */
+                if (HB_GrowGlyphRun(item, first_glyph, first_glyph + syllable.num_glyphs))
+                    continue;
                 item->num_glyphs += syllable.num_glyphs;
                 return FALSE;
             }
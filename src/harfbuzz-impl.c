@@ -76,6 +76,118 @@ _hb_free( HB_Pointer  block )
 }
 
 
+#define ARENA_ROUND(size) \
+  ( ( (size) + sizeof(HB_ArenaAlign) - 1 ) / sizeof(HB_ArenaAlign) * sizeof(HB_ArenaAlign) )
+
+#define ARENA_CHUNK_HEADER  ARENA_ROUND( sizeof(HB_ArenaChunk) )
+
+
+/* The arena itself lives in its first chunk. */
+
+HB_INTERNAL HB_Arena
+_hb_arena_new( size_t     chunk_size,
+	       HB_Error  *perror )
+{
+  HB_ArenaRec     arena;
+  HB_Arena        self;
+  HB_Error        error;
+
+  arena.chunks     = NULL;
+  arena.chunk_size = chunk_size;
+
+  self = _hb_arena_alloc( &arena, sizeof(HB_ArenaRec), &error );
+  if ( !error )
+    *self = arena;
+
+  *perror = error;
+  return self;
+}
+
+
+HB_INTERNAL HB_Pointer
+_hb_arena_alloc( HB_Arena   arena,
+		 size_t     size,
+		 HB_Error  *perror )
+{
+  HB_Error        error = 0;
+  HB_ArenaChunk*  chunk = arena->chunks;
+  HB_Pointer      block = NULL;
+
+  size = ARENA_ROUND( size );
+
+  if ( size > 0 )
+  {
+    if ( !chunk || chunk->size - chunk->used < size )
+    {
+      size_t  chunk_size = arena->chunk_size;
+
+      if ( chunk )
+	chunk_size = chunk->size * 2;
+      while ( chunk_size < size )
+	chunk_size *= 2;
+
+      chunk = calloc( 1, ARENA_CHUNK_HEADER + chunk_size );
+      if ( !chunk )
+      {
+	*perror = ERR(HB_Err_Out_Of_Memory);
+	return NULL;
+      }
+
+      chunk->next   = arena->chunks;
+      chunk->size   = chunk_size;
+      chunk->used   = 0;
+      arena->chunks = chunk;
+    }
+
+    block = (char*)chunk + ARENA_CHUNK_HEADER + chunk->used;
+    chunk->used += size;
+  }
+
+  *perror = error;
+  return block;
+}
+
+
+HB_INTERNAL void
+_hb_arena_free( HB_Arena arena )
+{
+  HB_ArenaChunk*  chunk;
+  HB_ArenaChunk*  next;
+
+  if ( !arena )
+    return;
+
+  /* the chunk holding the arena goes last */
+  for ( chunk = arena->chunks; chunk; chunk = next )
+  {
+    next = chunk->next;
+    free( chunk );
+  }
+}
+
+
+HB_INTERNAL void
+_hb_digest_add_range( HB_GlyphDigest*  digest,
+		      HB_UInt          start,
+		      HB_UInt          end )
+{
+  HB_UInt  n, first, last;
+
+  for ( n = 0; n < HB_DIGEST_SHIFTS; n++ )
+  {
+    first = start >> DIGEST_Shift( n );
+    last  = end >> DIGEST_Shift( n );
+
+    /* a range over 32 or more buckets hits every bit */
+    if ( last - first >= 31 )
+      digest->mask[n] = 0xFFFFFFFFU;
+    else
+      for ( ; first <= last; first++ )
+	digest->mask[n] |= (HB_UInt)1 << ( first & 31 );
+  }
+}
+
+
 /* helper func to set a breakpoint on */
 HB_INTERNAL HB_Error
 _hb_err (HB_Error code)
@@ -68,6 +68,39 @@ HB_BEGIN_HEADER
 #define ARRAY_LEN(Array) ((int)(sizeof (Array) / sizeof (Array)[0]))
 
 
+/* Data that is created on demand in a table shared between threads (the
+ * plans of a face, lazily loaded lookups) is built completely first and
+ * then published with a compare-and-swap, without any lock.  Readers
+ * fetch the pointer with HB_AtomicLoadPtr, so that they see the data it
+ * points to as it was when published.  */
+#if defined(__GNUC__)
+#define HB_MemoryBarrier() __sync_synchronize()
+#define HB_AtomicTestAndSetPtr(ptr, expected, value) \
+    __sync_bool_compare_and_swap((ptr), (expected), (value))
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)
+#define HB_AtomicLoadPtr(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#else
+#define HB_AtomicLoadPtr(ptr) __sync_val_compare_and_swap((ptr), 0, 0)
+#endif
+#define HB_AtomicIncrement(ptr) __sync_add_and_fetch((ptr), 1)
+#elif defined(_MSC_VER)
+#include <windows.h>
+#define HB_MemoryBarrier() MemoryBarrier()
+#define HB_AtomicTestAndSetPtr(ptr, expected, value) \
+    (InterlockedCompareExchangePointer((PVOID volatile *)(ptr), (value), (expected)) == (expected))
+#define HB_AtomicLoadPtr(ptr) \
+    InterlockedCompareExchangePointer((PVOID volatile *)(ptr), NULL, NULL)
+#define HB_AtomicIncrement(ptr) InterlockedIncrement((LONG volatile *)(ptr))
+#else
+/* no atomics known for this compiler, tables must not be shared between threads */
+#define HB_MemoryBarrier()
+#define HB_AtomicTestAndSetPtr(ptr, expected, value) \
+    (*(ptr) == (expected) ? (*(ptr) = (value), 1) : 0)
+#define HB_AtomicLoadPtr(ptr) (*(ptr))
+#define HB_AtomicIncrement(ptr) (++*(ptr))
+#endif
+
+
 
 #define HB_IsHighSurrogate(ucs) \
     (((ucs) & 0xfc00) == 0xd800)
@@ -103,6 +136,16 @@ HB_BEGIN_HEADER
 #define  REALLOC_ARRAY(_ptr,_newcnt,_type) \
            REALLOC(_ptr,(_newcnt)*sizeof(_type))
 
+/* The structures of a loaded table are allocated from the arena of the
+   stream they are loaded from; they are never freed one by one but all
+   at once with the arena.  The memory is cleared like with ALLOC.       */
+
+#define  ARENA_ALLOC(_ptr,_size)   \
+           ( (_ptr) = _hb_arena_alloc( stream->arena, _size, &error ), error != 0 )
+
+#define  ARENA_ALLOC_ARRAY(_ptr,_count,_type)   \
+           ARENA_ALLOC(_ptr,(_count)*sizeof(_type))
+
 #define  MEM_Copy(dest,source,count)   memcpy( (char*)(dest), (const char*)(source), (size_t)(count) )
 
 #define ERR(err)   _hb_err (err)
@@ -121,6 +164,80 @@ HB_INTERNAL void
 _hb_free( HB_Pointer block );
 
 
+/* An arena hands out memory from a list of chunks; each chunk is at
+   least twice as large as the previous one.                          */
+
+typedef union
+{
+  long        l;
+  double      d;
+  HB_Pointer  p;
+} HB_ArenaAlign;
+
+typedef struct HB_ArenaChunk_  HB_ArenaChunk;
+
+struct HB_ArenaChunk_
+{
+  HB_ArenaChunk*  next;
+  size_t          size;
+  size_t          used;
+};
+
+struct HB_ArenaRec_
+{
+  HB_ArenaChunk*  chunks;
+  size_t          chunk_size;
+};
+
+HB_INTERNAL HB_Arena
+_hb_arena_new( size_t     chunk_size,
+	       HB_Error  *perror_ );
+
+HB_INTERNAL HB_Pointer
+_hb_arena_alloc( HB_Arena   arena,
+		 size_t     size,
+		 HB_Error  *perror_ );
+
+HB_INTERNAL void
+_hb_arena_free( HB_Arena arena );
+
+
+/* Glyph digests (see HB_GlyphDigest); the shift widths are 0, 4 and 9.
+   A glyph can only be in the set if all its bits are set, and two sets
+   can only share a glyph if all their masks intersect.                */
+
+#define  DIGEST_Shift(_n)       ( (_n) == 0 ? 0 : (_n) == 1 ? 4 : 9 )
+#define  DIGEST_Bit(_glyph,_n)  \
+           ( (HB_UInt)1 << ( ( (_glyph) >> DIGEST_Shift(_n) ) & 31 ) )
+
+#define  DIGEST_Clear(_digest)  \
+           ( (_digest)->mask[0] = (_digest)->mask[1] = (_digest)->mask[2] = 0 )
+#define  DIGEST_Fill(_digest)   \
+           ( (_digest)->mask[0] = (_digest)->mask[1] = (_digest)->mask[2] = \
+	       0xFFFFFFFFU )
+#define  DIGEST_Add_Glyph(_digest,_glyph)              \
+           ( (_digest)->mask[0] |= DIGEST_Bit( _glyph, 0 ), \
+	     (_digest)->mask[1] |= DIGEST_Bit( _glyph, 1 ), \
+	     (_digest)->mask[2] |= DIGEST_Bit( _glyph, 2 ) )
+#define  DIGEST_May_Have(_digest,_glyph)                  \
+           ( ( (_digest)->mask[0] & DIGEST_Bit( _glyph, 0 ) ) && \
+	     ( (_digest)->mask[1] & DIGEST_Bit( _glyph, 1 ) ) && \
+	     ( (_digest)->mask[2] & DIGEST_Bit( _glyph, 2 ) ) )
+#define  DIGEST_Merge(_a,_b)                             \
+           ( (_a)->mask[0] |= (_b)->mask[0],             \
+	     (_a)->mask[1] |= (_b)->mask[1],             \
+	     (_a)->mask[2] |= (_b)->mask[2] )
+#define  DIGEST_Intersects(_a,_b)                        \
+           ( ( (_a)->mask[0] & (_b)->mask[0] ) &&        \
+	     ( (_a)->mask[1] & (_b)->mask[1] ) &&        \
+	     ( (_a)->mask[2] & (_b)->mask[2] ) )
+
+HB_INTERNAL void
+_hb_digest_add_range( HB_GlyphDigest*  digest,
+		      HB_UInt          start,
+		      HB_UInt          end );
+
+
 /* helper func to set a breakpoint on */
 HB_INTERNAL HB_Error
 _hb_err (HB_Error code);
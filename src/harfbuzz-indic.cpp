@@ -1620,8 +1620,8 @@ static bool indic_shape_syllable(HB_Bool openType, HB_ShaperItem *item, bool inv
         item->log_clusters = clusters;
         HB_OpenTypeShape(item, properties);
 
-        int newLen = item->face->buffer->in_length;
-        HB_GlyphItem otl_glyphs = item->face->buffer->in_string;
+        int newLen = item->context->buffer->in_length;
+        HB_GlyphItem otl_glyphs = item->context->buffer->in_string;
 
         // move the left matra back to its correct position in malayalam and tamil
         if ((script == HB_Script_Malayalam || script == HB_Script_Tamil) && (form(reordered[0]) == Matra)) {
@@ -1638,6 +1638,12 @@ static bool indic_shape_syllable(HB_Bool openType, HB_ShaperItem *item, bool inv
                 for (i = 0; i < basePos; ++i)
                     otl_glyphs[i] = otl_glyphs[i+1];
                 otl_glyphs[basePos] = m;
+#ifdef HB_PARALLEL_GINDEX
+                HB_UShort *otl_gindex = item->context->buffer->in_gindex;
+                for (i = 0; i < basePos; ++i)
+                    otl_gindex[i] = otl_gindex[i+1];
+                otl_gindex[basePos] = m.gindex;
+#endif
             }
         }
 
@@ -1785,6 +1791,7 @@ HB_Bool HB_IndicShape(HB_ShaperItem *item)
     unsigned short *logClusters = item->log_clusters;
 
     HB_ShaperItem syllable = *item;
+    syllable.run = 0;
     int first_glyph = 0;
 
     int sstart = item->item.pos;
@@ -1804,6 +1811,9 @@ HB_Bool HB_IndicShape(HB_ShaperItem *item)
         syllable.num_glyphs = item->num_glyphs - first_glyph;
         if (!indic_shape_syllable(openType, &syllable, invalid)) {
             IDEBUG("syllable shaping failed, syllable requests %d glyphs", syllable.num_glyphs);
+            // shaping into a glyph run, make room and shape the syllable again
+            if (HB_GrowGlyphRun(item, first_glyph, first_glyph + syllable.num_glyphs))
+                continue;
             item->num_glyphs += syllable.num_glyphs;
             return false;
         }
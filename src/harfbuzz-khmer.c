@@ -602,6 +602,7 @@ HB_Bool HB_KhmerShape(HB_ShaperItem *item)
     int end = sstart + item->item.length;
 
     assert(item->item.script == HB_Script_Khmer);
+    syllable.run = 0;
 
 #ifndef NO_OPENTYPE
     openType = HB_SelectScript(item, khmer_features);
@@ -622,6 +623,9 @@ HB_Bool HB_KhmerShape(HB_ShaperItem *item)
         syllable.num_glyphs = item->num_glyphs - first_glyph;
         if (!khmer_shape_syllable(openType, &syllable)) {
             KHDEBUG("syllable shaping failed, syllable requests %d glyphs", syllable.num_glyphs);
+            /* shaping into a glyph run, make room and shape the syllable again */
+            if (HB_GrowGlyphRun(item, first_glyph, first_glyph + syllable.num_glyphs))
+                continue;
             item->num_glyphs += syllable.num_glyphs;
             return FALSE;
         }
@@ -474,6 +474,7 @@ HB_Bool HB_MyanmarShape(HB_ShaperItem *item)
     int i = 0;
 
     assert(item->item.script == HB_Script_Myanmar);
+    syllable.run = 0;
 #ifndef NO_OPENTYPE
     openType = HB_SelectScript(item, myanmar_features);
 #endif
@@ -493,6 +494,9 @@ HB_Bool HB_MyanmarShape(HB_ShaperItem *item)
         syllable.num_glyphs = item->num_glyphs - first_glyph;
         if (!myanmar_shape_syllable(openType, &syllable, invalid)) {
             MMDEBUG("syllable shaping failed, syllable requests %d glyphs", syllable.num_glyphs);
+            /* shaping into a glyph run, make room and shape the syllable again */
+            if (HB_GrowGlyphRun(item, first_glyph, first_glyph + syllable.num_glyphs))
+                continue;
             item->num_glyphs += syllable.num_glyphs;
             return FALSE;
         }
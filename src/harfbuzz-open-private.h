@@ -34,8 +34,14 @@
 HB_BEGIN_HEADER
 
 
+/* `Digest' holds the glyphs a subtable can be applied at, that is the
+   first glyph of its input sequence; a lookup is only applied to a
+   string if one of its subtable digests intersects the buffer digest. */
+
 struct  HB_SubTable_
 {
+  HB_GlyphDigest  Digest;
+
   union
   {
     HB_GSUB_SubTable  gsub;
@@ -44,6 +50,29 @@ struct  HB_SubTable_
 };
 
 
+/* initial chunk sizes of the arena of a table resp. of the arena of
+   the subtables of a lookup                                          */
+
+#define HB_TABLE_ARENA_CHUNK   4096
+#define HB_LOOKUP_ARENA_CHUNK   512
+
+/* a format 2 class definition gets a direct-index array if its glyphs
+   span at most HB_CLASSDEF_FLAT_BASE glyphs plus
+   HB_CLASSDEF_FLAT_PER_RANGE glyphs per class range record          */
+
+#define HB_CLASSDEF_FLAT_BASE       1024
+#define HB_CLASSDEF_FLAT_PER_RANGE    16
+
+
+/* reading the arrays of coverage and class definition tables, which
+   are used in place (see harfbuzz-open.h)                           */
+
+#define  ARRAY_UShort(_array,_i)  PEEK_UShort( (_array) + 2 * (_i) )
+#define  RANGE_Start(_rr,_i)      PEEK_UShort( (_rr) + 6 * (_i) )
+#define  RANGE_End(_rr,_i)        PEEK_UShort( (_rr) + 6 * (_i) + 2 )
+#define  RANGE_Value(_rr,_i)      PEEK_UShort( (_rr) + 6 * (_i) + 4 )
+
+
 HB_INTERNAL HB_Error
 _HB_OPEN_Load_ScriptList( HB_ScriptList* sl,
 			   HB_Stream     input );
@@ -54,6 +83,12 @@ HB_INTERNAL HB_Error
 _HB_OPEN_Load_LookupList( HB_LookupList*  ll,
 			   HB_Stream        input,
 			   HB_Type         type );
+HB_INTERNAL HB_Error
+_HB_OPEN_Get_Lookup_SubTables( HB_LookupList*  ll,
+			       HB_UShort       lookup_index,
+			       HB_Type         type,
+			       HB_SubTable**   subtables,
+			       HB_UShort*      count );
 
 HB_INTERNAL HB_Error
 _HB_OPEN_Load_Coverage( HB_Coverage* c,
@@ -72,14 +107,91 @@ HB_INTERNAL HB_Error
 _HB_OPEN_Load_Device( HB_Device* d,
 		       HB_Stream    input );
 
-HB_INTERNAL void  _HB_OPEN_Free_ScriptList( HB_ScriptList*  sl );
-HB_INTERNAL void  _HB_OPEN_Free_FeatureList( HB_FeatureList*  fl );
-HB_INTERNAL void  _HB_OPEN_Free_LookupList( HB_LookupList*  ll,
-		       HB_Type         type );
+HB_INTERNAL void  _HB_OPEN_Free_LookupList( HB_LookupList*  ll );
+
+HB_INTERNAL HB_Error
+_HB_OPEN_Lookup_May_Apply( HB_LookupList*  ll,
+			   HB_UShort       lookup_index,
+			   HB_Type         type,
+			   HB_Buffer       buffer );
+
+HB_INTERNAL void
+_HB_OPEN_Lookup_Digest( HB_LookupList*   ll,
+			HB_UShort        lookup_index,
+			HB_Type          type,
+			HB_GlyphDigest*  digest );
+
+HB_INTERNAL HB_UInt
+_HB_OPEN_Next_In_Digest( HB_Buffer              buffer,
+			 const HB_GlyphDigest*  digest );
+
+HB_INTERNAL HB_Error
+_HB_OPEN_Plan_Add_Feature( HB_LookupPlan*   plan,
+			   HB_FeatureList*  fl,
+			   HB_LookupList*   ll,
+			   HB_UShort        feature_index,
+			   HB_UInt          property );
+
+HB_INTERNAL void
+_HB_OPEN_Plan_Free_Composed( HB_LookupPlan*  plan );
 
-HB_INTERNAL void  _HB_OPEN_Free_Coverage( HB_Coverage*  c );
-HB_INTERNAL void  _HB_OPEN_Free_ClassDefinition( HB_ClassDefinition*  cd );
-HB_INTERNAL void  _HB_OPEN_Free_Device( HB_Device*  d );
+
+/* The sequences of a chaining context rule; `Input' starts with the
+   second input glyph resp. class.                                    */
+
+struct  HB_ChainRuleKey_
+{
+  HB_UShort         BacktrackCount;
+  const HB_UShort*  Backtrack;
+  HB_UShort         InputCount;
+  const HB_UShort*  Input;
+  HB_UShort         LookaheadCount;
+  const HB_UShort*  Lookahead;
+
+  HB_UInt           Kind;             /* internal to the trie builder */
+};
+
+typedef struct HB_ChainRuleKey_  HB_ChainRuleKey;
+
+#define CHAIN_RULE_Key( key, rule )					\
+	  ( (key)->BacktrackCount = (rule)->BacktrackGlyphCount,	\
+	    (key)->Backtrack      = (rule)->Backtrack,			\
+	    (key)->InputCount     = (rule)->InputGlyphCount,		\
+	    (key)->Input          = (rule)->Input,			\
+	    (key)->LookaheadCount = (rule)->LookaheadGlyphCount,	\
+	    (key)->Lookahead      = (rule)->Lookahead )
+
+
+/* Where and how a chaining context trie is matched.  The class
+   definitions are NULL for rules of glyphs (format 1).            */
+
+struct  HB_ChainContext_
+{
+  HB_GDEFHeader*       gdef;
+  HB_Buffer            buffer;
+  HB_UShort            flags;
+  HB_UShort            context_length;
+  HB_Bool              backtrack_output;  /* the backtrack glyphs are in
+					     the output (GSUB)           */
+
+  HB_ClassDefinition*  BacktrackClassDef;
+  HB_ClassDefinition*  InputClassDef;
+  HB_ClassDefinition*  LookaheadClassDef;
+};
+
+typedef struct HB_ChainContext_  HB_ChainContext;
+
+HB_INTERNAL HB_Error
+_HB_OPEN_Make_Chain_Trie( HB_ChainTrie*     trie,
+			  HB_ChainRuleKey*  keys,
+			  HB_UShort         count,
+			  HB_Bool           classes,
+			  HB_Stream         stream );
+
+HB_INTERNAL HB_Error
+_HB_OPEN_Match_Chain_Trie( const HB_ChainTrie*     trie,
+			   const HB_ChainContext*  cc,
+			   HB_UShort*              rule_index );
 
 
 
@@ -87,6 +199,8 @@ HB_INTERNAL HB_Error
 _HB_OPEN_Coverage_Index( HB_Coverage* c,
 			  HB_UShort      glyphID,
 			  HB_UShort*     index );
+HB_INTERNAL HB_UInt
+_HB_OPEN_Coverage_Limit( HB_Coverage* c );
 HB_INTERNAL HB_Error
 _HB_OPEN_Get_Class( HB_ClassDefinition* cd,
 		     HB_UShort             glyphID,
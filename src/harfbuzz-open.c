@@ -25,6 +25,7 @@
 
 #include "harfbuzz-impl.h"
 #include "harfbuzz-open-private.h"
+#include "harfbuzz-gdef-private.h"
 
 
 /***************************
@@ -53,14 +54,11 @@ static HB_Error  Load_LangSys( HB_LangSys*  ls,
 
   ls->FeatureIndex = NULL;
 
-  if ( ALLOC_ARRAY( ls->FeatureIndex, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( ls->FeatureIndex, count, HB_UShort ) )
     return error;
 
   if ( ACCESS_Frame( count * 2L ) )
-  {
-    FREE( ls->FeatureIndex );
     return error;
-  }
 
   fi = ls->FeatureIndex;
 
@@ -73,19 +71,13 @@ static HB_Error  Load_LangSys( HB_LangSys*  ls,
 }
 
 
-static void  Free_LangSys( HB_LangSys*  ls )
-{
-  FREE( ls->FeatureIndex );
-}
-
-
 /* Script */
 
 static HB_Error  Load_Script( HB_ScriptTable*  s,
 			      HB_Stream    stream )
 {
   HB_Error   error;
-  HB_UShort  n, m, count;
+  HB_UShort  n, count;
   HB_UInt   cur_offset, new_offset, base_offset;
 
   HB_LangSysRecord*  lsr;
@@ -120,7 +112,7 @@ static HB_Error  Load_Script( HB_ScriptTable*  s,
   }
 
   if ( ACCESS_Frame( 2L ) )
-    goto Fail2;
+    return error;
 
   count = s->LangSysCount = GET_UShort();
 
@@ -128,24 +120,21 @@ static HB_Error  Load_Script( HB_ScriptTable*  s,
      fonts won't work */
 
   if ( s->LangSysCount == 0 && s->DefaultLangSys.FeatureCount == 0 )
-  {
-    error = HB_Err_Not_Covered;
-    goto Fail2;
-  }
+    return HB_Err_Not_Covered;
 
   FORGET_Frame();
 
   s->LangSysRecord = NULL;
 
-  if ( ALLOC_ARRAY( s->LangSysRecord, count, HB_LangSysRecord ) )
-    goto Fail2;
+  if ( ARENA_ALLOC_ARRAY( s->LangSysRecord, count, HB_LangSysRecord ) )
+    return error;
 
   lsr = s->LangSysRecord;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 6L ) )
-      goto Fail1;
+      return error;
 
     lsr[n].LangSysTag = GET_ULong();
     new_offset = GET_UShort() + base_offset;
@@ -155,43 +144,11 @@ static HB_Error  Load_Script( HB_ScriptTable*  s,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_LangSys( &lsr[n].LangSys, stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_LangSys( &lsr[m].LangSys );
-
-  FREE( s->LangSysRecord );
-
-Fail2:
-  Free_LangSys( &s->DefaultLangSys );
-  return error;
-}
-
-
-static void  Free_Script( HB_ScriptTable*  s )
-{
-  HB_UShort           n, count;
-
-  HB_LangSysRecord*  lsr;
-
-
-  Free_LangSys( &s->DefaultLangSys );
-
-  if ( s->LangSysRecord )
-  {
-    count = s->LangSysCount;
-    lsr   = s->LangSysRecord;
-
-    for ( n = 0; n < count; n++ )
-      Free_LangSys( &lsr[n].LangSys );
-
-    FREE( lsr );
-  }
 }
 
 
@@ -220,7 +177,7 @@ _HB_OPEN_Load_ScriptList( HB_ScriptList* sl,
 
   sl->ScriptRecord = NULL;
 
-  if ( ALLOC_ARRAY( sl->ScriptRecord, script_count, HB_ScriptRecord ) )
+  if ( ARENA_ALLOC_ARRAY( sl->ScriptRecord, script_count, HB_ScriptRecord ) )
     return error;
 
   sr = sl->ScriptRecord;
@@ -229,7 +186,7 @@ _HB_OPEN_Load_ScriptList( HB_ScriptList* sl,
   for ( n = 0; n < script_count; n++ )
   {
     if ( ACCESS_Frame( 6L ) )
-      goto Fail;
+      return error;
 
     sr[sl->ScriptCount].ScriptTag = GET_ULong();
     new_offset = GET_UShort() + base_offset;
@@ -239,13 +196,13 @@ _HB_OPEN_Load_ScriptList( HB_ScriptList* sl,
     cur_offset = FILE_Pos();
 
     if ( FILE_Seek( new_offset ) )
-      goto Fail;
+      return error;
 
     error = Load_Script( &sr[sl->ScriptCount].Script, stream );
     if ( error == HB_Err_Ok )
       sl->ScriptCount += 1;
     else if ( error != HB_Err_Not_Covered )
-      goto Fail;
+      return error;
 
     (void)FILE_Seek( cur_offset );
   }
@@ -255,41 +212,10 @@ _HB_OPEN_Load_ScriptList( HB_ScriptList* sl,
    */
 #if 0
   if ( sl->ScriptCount == 0 )
-  {
-    error = ERR(HB_Err_Invalid_SubTable);
-    goto Fail;
-  }
+    return ERR(HB_Err_Invalid_SubTable);
 #endif
   
   return HB_Err_Ok;
-
-Fail:
-  for ( n = 0; n < sl->ScriptCount; n++ )
-    Free_Script( &sr[n].Script );
-
-  FREE( sl->ScriptRecord );
-  return error;
-}
-
-
-HB_INTERNAL void
-_HB_OPEN_Free_ScriptList( HB_ScriptList* sl )
-{
-  HB_UShort          n, count;
-
-  HB_ScriptRecord*  sr;
-
-
-  if ( sl->ScriptRecord )
-  {
-    count = sl->ScriptCount;
-    sr    = sl->ScriptRecord;
-
-    for ( n = 0; n < count; n++ )
-      Free_Script( &sr[n].Script );
-
-    FREE( sr );
-  }
 }
 
 
@@ -321,16 +247,13 @@ static HB_Error  Load_Feature( HB_Feature*  f,
 
   f->LookupListIndex = NULL;
 
-  if ( ALLOC_ARRAY( f->LookupListIndex, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( f->LookupListIndex, count, HB_UShort ) )
     return error;
 
   lli = f->LookupListIndex;
 
   if ( ACCESS_Frame( count * 2L ) )
-  {
-    FREE( f->LookupListIndex );
     return error;
-  }
 
   for ( n = 0; n < count; n++ )
     lli[n] = GET_UShort();
@@ -341,12 +264,6 @@ static HB_Error  Load_Feature( HB_Feature*  f,
 }
 
 
-static void  Free_Feature( HB_Feature*  f )
-{
-  FREE( f->LookupListIndex );
-}
-
-
 /* FeatureList */
 
 HB_INTERNAL HB_Error
@@ -355,7 +272,7 @@ _HB_OPEN_Load_FeatureList( HB_FeatureList* fl,
 {
   HB_Error   error;
 
-  HB_UShort           n, m, count;
+  HB_UShort           n, count;
   HB_UInt            cur_offset, new_offset, base_offset;
 
   HB_FeatureRecord*  fr;
@@ -372,10 +289,10 @@ _HB_OPEN_Load_FeatureList( HB_FeatureList* fl,
 
   fl->FeatureRecord = NULL;
 
-  if ( ALLOC_ARRAY( fl->FeatureRecord, count, HB_FeatureRecord ) )
+  if ( ARENA_ALLOC_ARRAY( fl->FeatureRecord, count, HB_FeatureRecord ) )
+    return error;
+  if ( ARENA_ALLOC_ARRAY( fl->ApplyOrder, count, HB_UShort ) )
     return error;
-  if ( ALLOC_ARRAY( fl->ApplyOrder, count, HB_UShort ) )
-    goto Fail2;
   
   fl->ApplyCount = 0;
 
@@ -384,7 +301,7 @@ _HB_OPEN_Load_FeatureList( HB_FeatureList* fl,
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 6L ) )
-      goto Fail1;
+      return error;
 
     fr[n].FeatureTag = GET_ULong();
     new_offset = GET_UShort() + base_offset;
@@ -394,45 +311,11 @@ _HB_OPEN_Load_FeatureList( HB_FeatureList* fl,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_Feature( &fr[n].Feature, stream ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  for ( m = 0; m < n; m++ )
-    Free_Feature( &fr[m].Feature );
-
-  FREE( fl->ApplyOrder );
-
-Fail2:
-  FREE( fl->FeatureRecord );
-
-  return error;
-}
-
-
-HB_INTERNAL void
-_HB_OPEN_Free_FeatureList( HB_FeatureList*  fl )
-{
-  HB_UShort           n, count;
-
-  HB_FeatureRecord*  fr;
-
-
-  if ( fl->FeatureRecord )
-  {
-    count = fl->FeatureCount;
-    fr    = fl->FeatureRecord;
-
-    for ( n = 0; n < count; n++ )
-      Free_Feature( &fr[n].Feature );
-
-    FREE( fr );
-  }
-  
-  FREE( fl->ApplyOrder );
 }
 
 
@@ -452,38 +335,43 @@ static HB_Error  Load_SubTable( HB_SubTable*  st,
 				HB_Type       table_type,
 				HB_UShort     lookup_type )
 {
+  HB_Error      error;
+  HB_Coverage*  c;
+
   if ( table_type == HB_Type_GSUB )
-    return _HB_GSUB_Load_SubTable ( &st->st.gsub, stream, lookup_type );
+    error = _HB_GSUB_Load_SubTable ( &st->st.gsub, stream, lookup_type );
   else
-    return _HB_GPOS_Load_SubTable ( &st->st.gpos, stream, lookup_type );
-}
+    error = _HB_GPOS_Load_SubTable ( &st->st.gpos, stream, lookup_type );
 
+  if ( error )
+    return error;
 
-static void  Free_SubTable( HB_SubTable*  st,
-			    HB_Type       table_type,
-			    HB_UShort      lookup_type )
-{
   if ( table_type == HB_Type_GSUB )
-    _HB_GSUB_Free_SubTable ( &st->st.gsub, lookup_type );
+    c = _HB_GSUB_First_Coverage( &st->st.gsub, lookup_type );
   else
-    _HB_GPOS_Free_SubTable ( &st->st.gpos, lookup_type );
+    c = _HB_GPOS_First_Coverage( &st->st.gpos, lookup_type );
+
+  if ( c )
+    st->Digest = c->Digest;
+  else
+    DIGEST_Fill( &st->Digest );
+
+  return HB_Err_Ok;
 }
 
 
 /* Lookup */
 
+/* Only the Lookup table header is read here; the subtables are loaded
+   on demand by _HB_OPEN_Get_Lookup_SubTables().                        */
+
 static HB_Error  Load_Lookup( HB_Lookup*   l,
 			      HB_Stream     stream,
 			      HB_Type      type )
 {
   HB_Error   error;
 
-  HB_UShort      n, m, count;
-  HB_UInt       cur_offset, new_offset, base_offset;
-
-  HB_SubTable*  st;
-
-  HB_Bool        is_extension = FALSE;
+  HB_UInt       new_offset, base_offset;
 
 
   base_offset = FILE_Pos();
@@ -493,20 +381,102 @@ static HB_Error  Load_Lookup( HB_Lookup*   l,
 
   l->LookupType            = GET_UShort();
   l->LookupFlag            = GET_UShort();
-  count = l->SubTableCount = GET_UShort();
+  l->SubTableCount         = GET_UShort();
 
   FORGET_Frame();
 
-  l->SubTable = NULL;
+  l->SubTable      = NULL;
+  l->SubTableArena = NULL;
+  l->Offset        = base_offset;
 
-  if ( ALLOC_ARRAY( l->SubTable, count, HB_SubTable ) )
-    return error;
+  if ( ( ( type == HB_Type_GSUB && l->LookupType == HB_GSUB_LOOKUP_EXTENSION ) ||
+	 ( type == HB_Type_GPOS && l->LookupType == HB_GPOS_LOOKUP_EXTENSION ) ) &&
+       l->SubTableCount > 0 )
+  {
+    /* all extension subtables of a lookup share the same type */
+
+    if ( ACCESS_Frame( 2L ) )
+      return error;
+
+    new_offset = GET_UShort() + base_offset;
+
+    FORGET_Frame();
+
+    if ( FILE_Seek( new_offset ) || ACCESS_Frame( 4L ) )
+      return error;
+
+    if (GET_UShort() != 1) /* format should be 1 */
+      error = ERR(HB_Err_Invalid_SubTable_Format);
+    else
+      l->LookupType = GET_UShort();
+
+    FORGET_Frame();
+  }
+
+  return error;
+}
+
+
+/* What the subtables of a lookup are set to when they can't be loaded,
+   so that the lookup is not parsed again each time it is applied.
+   Running out of memory is not recorded: the next call tries again.   */
 
-  st = l->SubTable;
+static HB_SubTable  failed_subtables[1];
 
-  if ( ( type == HB_Type_GSUB && l->LookupType == HB_GSUB_LOOKUP_EXTENSION ) ||
-       ( type == HB_Type_GPOS && l->LookupType == HB_GPOS_LOOKUP_EXTENSION ) )
+
+static HB_Error  Load_Lookup_SubTables( HB_LookupList*  ll,
+					HB_UShort       lookup_index,
+					HB_Type         type )
+{
+  HB_Error   error;
+
+  HB_UShort      n, count;
+  HB_UInt       cur_offset, new_offset, base_offset;
+
+  HB_Lookup*    l = &ll->Lookup[lookup_index];
+  HB_SubTable*  st;
+  HB_Arena      arena;
+
+  HB_Bool        is_extension = FALSE;
+
+  /* Several threads may load the same lookup at once, so each one reads
+     through its own copy of the stream, into its own arena.            */
+  HB_StreamRec  stream_rec;
+  HB_Stream     stream = &stream_rec;
+
+
+  stream_rec         = ll->Stream;
+  stream_rec.pos     = 0;
+  stream_rec.cursor  = NULL;
+  stream_rec.destroy = NULL;
+
+  base_offset = l->Offset;
+  arena       = NULL;
+
+  if ( FILE_Seek( base_offset ) || ACCESS_Frame( 6L ) )
+    goto Fail;
+
+  if ( GET_UShort() == ( type == HB_Type_GSUB ? HB_GSUB_LOOKUP_EXTENSION
+					       : HB_GPOS_LOOKUP_EXTENSION ) )
     is_extension = TRUE;
+  (void)GET_UShort();
+  count = GET_UShort();
+
+  FORGET_Frame();
+
+  if ( count != l->SubTableCount )
+  {
+    error = ERR(HB_Err_Invalid_SubTable);
+    goto Fail;
+  }
+
+  arena = _hb_arena_new( HB_LOOKUP_ARENA_CHUNK, &error );
+  if ( error )
+    goto Fail;
+  stream_rec.arena = arena;
+
+  if ( ARENA_ALLOC_ARRAY( st, count, HB_SubTable ) )
+    goto Fail;
 
   for ( n = 0; n < count; n++ )
   {
@@ -524,10 +494,13 @@ static HB_Error  Load_Lookup( HB_Lookup*   l,
       if ( FILE_Seek( new_offset ) || ACCESS_Frame( 8L ) )
 	goto Fail;
 
-      if (GET_UShort() != 1) /* format should be 1 */
+      if (GET_UShort() != 1 || /* format should be 1 */
+	  GET_UShort() != l->LookupType)
+      {
+	FORGET_Frame();
+	error = ERR(HB_Err_Invalid_SubTable_Format);
 	goto Fail;
-
-      l->LookupType = GET_UShort();
+      }
       new_offset += GET_ULong();
 
       FORGET_Frame();
@@ -540,35 +513,143 @@ static HB_Error  Load_Lookup( HB_Lookup*   l,
     (void)FILE_Seek( cur_offset );
   }
 
+  /* if another thread was faster, use its subtables */
+  HB_MemoryBarrier();
+  if ( HB_AtomicTestAndSetPtr( &l->SubTable, NULL, st ) )
+    l->SubTableArena = arena;
+  else
+    _hb_arena_free( arena );
+
   return HB_Err_Ok;
 
 Fail:
-  for ( m = 0; m < n; m++ )
-    Free_SubTable( &st[m], type, l->LookupType );
-
-  FREE( l->SubTable );
+  _hb_arena_free( arena );
+  if ( error != HB_Err_Out_Of_Memory )
+    (void)HB_AtomicTestAndSetPtr( &l->SubTable, NULL, failed_subtables );
   return error;
 }
 
 
-static void  Free_Lookup( HB_Lookup*   l,
-			  HB_Type      type)
-{
-  HB_UShort      n, count;
+/* Get the subtables of lookup `lookup_index', loading them if this is
+   the first time; `*count' is set to their number.  A lookup whose
+   subtables can't be loaded has none, and HB_Err_Invalid_SubTable is
+   returned for it.  If memory runs out while loading them, there are
+   none this time and HB_Err_Out_Of_Memory is returned.                */
 
+HB_INTERNAL HB_Error
+_HB_OPEN_Get_Lookup_SubTables( HB_LookupList*  ll,
+			       HB_UShort       lookup_index,
+			       HB_Type         type,
+			       HB_SubTable**   subtables,
+			       HB_UShort*      count )
+{
+  HB_Error      error;
+  HB_Lookup*    l = &ll->Lookup[lookup_index];
   HB_SubTable*  st;
 
 
-  if ( l->SubTable )
-  {
-    count = l->SubTableCount;
-    st    = l->SubTable;
+  *subtables = NULL;
+  *count     = 0;
 
-    for ( n = 0; n < count; n++ )
-      Free_SubTable( &st[n], type, l->LookupType );
+  if ( l->SubTableCount == 0 )
+    return HB_Err_Ok;
 
-    FREE( st );
+  st = HB_AtomicLoadPtr( &l->SubTable );
+  if ( !st )
+  {
+    error = Load_Lookup_SubTables( ll, lookup_index, type );
+    if ( error == HB_Err_Out_Of_Memory )
+      return error;
+    st = HB_AtomicLoadPtr( &l->SubTable );
   }
+
+  if ( st == failed_subtables )
+    return HB_Err_Invalid_SubTable;
+
+  *subtables = st;
+  *count     = l->SubTableCount;
+  return HB_Err_Ok;
+}
+
+
+/* Check whether lookup `l' can apply to any glyph of `buffer', loading
+   its subtables if necessary; returns HB_Err_Not_Covered if it can't.
+   A lookup whose subtables can't be loaded applies nowhere, unless
+   memory ran out loading them.                                        */
+
+HB_INTERNAL HB_Error
+_HB_OPEN_Lookup_May_Apply( HB_LookupList*  ll,
+			   HB_UShort       lookup_index,
+			   HB_Type         type,
+			   HB_Buffer       buffer )
+{
+  HB_Error      error;
+  HB_UShort     n, count;
+  HB_SubTable*  st;
+
+
+  error = _HB_OPEN_Get_Lookup_SubTables( ll, lookup_index, type, &st, &count );
+  if ( error == HB_Err_Out_Of_Memory )
+    return error;
+
+  for ( n = 0; n < count; n++ )
+    if ( DIGEST_Intersects( &st[n].Digest, &buffer->digest ) )
+      return HB_Err_Ok;
+
+  return HB_Err_Not_Covered;
+}
+
+
+/* Get the glyphs lookup `l' can be applied at, the union of the digests
+   of its subtables.                                                    */
+
+HB_INTERNAL void
+_HB_OPEN_Lookup_Digest( HB_LookupList*   ll,
+			HB_UShort        lookup_index,
+			HB_Type          type,
+			HB_GlyphDigest*  digest )
+{
+  HB_UShort     n, count;
+  HB_SubTable*  st;
+
+
+  DIGEST_Clear( digest );
+
+  (void)_HB_OPEN_Get_Lookup_SubTables( ll, lookup_index, type, &st, &count );
+
+  for ( n = 0; n < count; n++ )
+    DIGEST_Merge( digest, &st[n].Digest );
+}
+
+
+/* Find the first glyph of the input string at or after `in_pos' which
+   may be in `digest'; returns `in_length' if there is none.  This is
+   how the string lookups pass over the glyphs a lookup can't be applied
+   at, reading nothing but the glyph IDs.                               */
+
+HB_INTERNAL HB_UInt
+_HB_OPEN_Next_In_Digest( HB_Buffer              buffer,
+			 const HB_GlyphDigest*  digest )
+{
+  HB_UInt       pos = buffer->in_pos;
+#ifdef HB_PARALLEL_GINDEX
+  /* the digests don't look past the low 16 bits of a glyph ID */
+  const HB_UShort*  gindex = buffer->in_gindex;
+
+
+  for ( ; pos < buffer->in_length; pos++ )
+    if ( DIGEST_May_Have( digest, gindex[pos] ) )
+      break;
+#else
+  HB_GlyphItem  item = buffer->in_string + pos;
+
+
+  for ( ; pos < buffer->in_length; pos++, item++ )
+    if ( DIGEST_May_Have( digest, item->gindex ) )
+      break;
+#endif
+
+  return pos;
 }
 
 
@@ -581,7 +662,7 @@ _HB_OPEN_Load_LookupList( HB_LookupList* ll,
 {
   HB_Error   error;
 
-  HB_UShort    n, m, count;
+  HB_UShort    n, count;
   HB_UInt     cur_offset, new_offset, base_offset;
 
   HB_Lookup*  l;
@@ -597,18 +678,19 @@ _HB_OPEN_Load_LookupList( HB_LookupList* ll,
   FORGET_Frame();
 
   ll->Lookup = NULL;
+  ll->Stream.destroy = NULL;
 
-  if ( ALLOC_ARRAY( ll->Lookup, count, HB_Lookup ) )
+  if ( ARENA_ALLOC_ARRAY( ll->Lookup, count, HB_Lookup ) )
+    return error;
+  if ( ARENA_ALLOC_ARRAY( ll->Properties, count, HB_UInt ) )
     return error;
-  if ( ALLOC_ARRAY( ll->Properties, count, HB_UInt ) )
-    goto Fail2;
 
   l = ll->Lookup;
 
   for ( n = 0; n < count; n++ )
   {
     if ( ACCESS_Frame( 2L ) )
-      goto Fail1;
+      return error;
 
     new_offset = GET_UShort() + base_offset;
 
@@ -617,98 +699,221 @@ _HB_OPEN_Load_LookupList( HB_LookupList* ll,
     cur_offset = FILE_Pos();
     if ( FILE_Seek( new_offset ) ||
 	 ( error = Load_Lookup( &l[n], stream, type ) ) != HB_Err_Ok )
-      goto Fail1;
+      return error;
     (void)FILE_Seek( cur_offset );
   }
 
   return HB_Err_Ok;
-
-Fail1:
-  FREE( ll->Properties );
-
-  for ( m = 0; m < n; m++ )
-    Free_Lookup( &l[m], type );
-
-Fail2:
-  FREE( ll->Lookup );
-  return error;
 }
 
 
 HB_INTERNAL void
-_HB_OPEN_Free_LookupList( HB_LookupList* ll,
-		       HB_Type         type )
+_HB_OPEN_Free_LookupList( HB_LookupList* ll )
 {
-  HB_UShort    n, count;
-
-  HB_Lookup*  l;
-
+  HB_UShort    n;
 
-  FREE( ll->Properties );
 
-  if ( ll->Lookup )
-  {
-    count = ll->LookupCount;
-    l     = ll->Lookup;
+  /* everything else is in the arena of the table */
 
-    for ( n = 0; n < count; n++ )
-      Free_Lookup( &l[n], type );
+  for ( n = 0; n < ll->LookupCount; n++ )
+    _hb_arena_free( ll->Lookup[n].SubTableArena );
 
-    FREE( l );
-  }
+  if ( ll->Stream.destroy )
+    ll->Stream.destroy( ll->Stream.user_data );
 }
 
 
 
-/*****************************
- * Coverage related functions
- *****************************/
-
+/******************************
+ * Lookup Plan related functions
+ ******************************/
 
-/* CoverageFormat1 */
 
-static HB_Error  Load_Coverage1( HB_CoverageFormat1*  cf1,
-				 HB_Stream             stream )
+HB_INTERNAL HB_Error
+_HB_OPEN_Plan_Add_Feature( HB_LookupPlan*   plan,
+			   HB_FeatureList*  fl,
+			   HB_LookupList*   ll,
+			   HB_UShort        feature_index,
+			   HB_UInt          property )
 {
-  HB_Error   error;
+  HB_Error     error;
+  HB_UShort    i;
+  HB_UInt      n, new_allocated;
 
-  HB_UShort  n, count;
+  HB_Feature   feature;
 
-  HB_UShort* ga;
 
+  if ( !plan || feature_index >= fl->FeatureCount )
+    return ERR(HB_Err_Invalid_Argument);
 
-  if ( ACCESS_Frame( 2L ) )
-    return error;
+  /* the properties of lookups may change */
+  _HB_OPEN_Plan_Free_Composed( plan );
 
-  count = cf1->GlyphCount = GET_UShort();
+  feature = fl->FeatureRecord[feature_index].Feature;
 
-  FORGET_Frame();
+  new_allocated = plan->LookupCount + feature.LookupListCount;
+  if ( new_allocated > plan->Allocated )
+  {
+    if ( REALLOC_ARRAY( plan->Lookup, new_allocated, HB_PlanLookup ) )
+      return error;
+    plan->Allocated = new_allocated;
+  }
 
-  cf1->GlyphArray = NULL;
+  for ( i = 0; i < feature.LookupListCount; i++ )
+  {
+    HB_UShort  lookup_index = feature.LookupListIndex[i];
+    HB_UInt    properties = property;
 
-  if ( ALLOC_ARRAY( cf1->GlyphArray, count, HB_UShort ) )
-    return error;
+    /* Skip nonexistant lookups */
+    if ( lookup_index >= ll->LookupCount )
+      continue;
 
-  ga = cf1->GlyphArray;
+    /* all entries of a lookup share the union of the properties */
+    for ( n = 0; n < plan->LookupCount; n++ )
+      if ( plan->Lookup[n].LookupIndex == lookup_index )
+      {
+	plan->Lookup[n].Properties |= property;
+	properties = plan->Lookup[n].Properties;
+      }
 
-  if ( ACCESS_Frame( count * 2L ) )
-  {
-    FREE( cf1->GlyphArray );
-    return error;
+    plan->Lookup[plan->LookupCount].LookupIndex    = lookup_index;
+    plan->Lookup[plan->LookupCount].Properties     = properties;
+    plan->Lookup[plan->LookupCount].InPlace        = FALSE;
+    plan->Lookup[plan->LookupCount].ComposedCount  = 0;
+    plan->Lookup[plan->LookupCount].ComposedLength = 0;
+    plan->Lookup[plan->LookupCount].ComposedMap    = NULL;
+    plan->LookupCount++;
   }
 
-  for ( n = 0; n < count; n++ )
-    ga[n] = GET_UShort();
-
-  FORGET_Frame();
-
   return HB_Err_Ok;
 }
 
 
-static void  Free_Coverage1( HB_CoverageFormat1*  cf1)
+HB_INTERNAL void
+_HB_OPEN_Plan_Free_Composed( HB_LookupPlan*  plan )
+{
+  HB_UInt  n;
+
+
+  for ( n = 0; n < plan->LookupCount; n++ )
+  {
+    FREE( plan->Lookup[n].ComposedMap );
+    plan->Lookup[n].ComposedCount  = 0;
+    plan->Lookup[n].ComposedLength = 0;
+    plan->Lookup[n].InPlace        = FALSE;
+  }
+}
+
+
+void
+HB_Clear_LookupPlan( HB_LookupPlan*  plan )
+{
+  _HB_OPEN_Plan_Free_Composed( plan );
+  plan->LookupCount = 0;
+}
+
+
+void
+HB_Done_LookupPlan( HB_LookupPlan*  plan )
+{
+  _HB_OPEN_Plan_Free_Composed( plan );
+  FREE( plan->Lookup );
+  plan->LookupCount = 0;
+  plan->Allocated = 0;
+}
+
+
+
+/*****************************
+ * Coverage related functions
+ *****************************/
+
+
+/* Coverage digest */
+
+static void  Make_Coverage_Digest( HB_Coverage*  c )
+{
+  HB_UShort       n, glyph;
+  const HB_Byte*  rr;
+
+
+  DIGEST_Clear( &c->Digest );
+
+  if ( c->CoverageFormat == 1 )
+  {
+    for ( n = 0; n < c->cf.cf1.GlyphCount; n++ )
+    {
+      glyph = ARRAY_UShort( c->cf.cf1.GlyphArray, n );
+      DIGEST_Add_Glyph( &c->Digest, glyph );
+    }
+  }
+  else
+  {
+    rr = c->cf.cf2.RangeRecord;
+
+    for ( n = 0; n < c->cf.cf2.RangeCount; n++ )
+      _hb_digest_add_range( &c->Digest,
+			    RANGE_Start( rr, n ), RANGE_End( rr, n ) );
+  }
+}
+
+
+/* One more than the largest glyph ID covered, or 0 if none is. */
+
+HB_INTERNAL HB_UInt
+_HB_OPEN_Coverage_Limit( HB_Coverage* c )
 {
-  FREE( cf1->GlyphArray );
+  HB_UShort       n;
+  HB_UInt         limit = 0;
+  const HB_Byte*  rr;
+
+
+  if ( c->CoverageFormat == 1 )
+  {
+    for ( n = 0; n < c->cf.cf1.GlyphCount; n++ )
+      if ( ARRAY_UShort( c->cf.cf1.GlyphArray, n ) >= limit )
+	limit = ARRAY_UShort( c->cf.cf1.GlyphArray, n ) + 1;
+  }
+  else
+  {
+    rr = c->cf.cf2.RangeRecord;
+
+    for ( n = 0; n < c->cf.cf2.RangeCount; n++ )
+      if ( RANGE_End( rr, n ) >= limit )
+	limit = RANGE_End( rr, n ) + 1;
+  }
+
+  return limit;
+}
+
+
+/* CoverageFormat1 */
+
+static HB_Error  Load_Coverage1( HB_CoverageFormat1*  cf1,
+				 HB_Stream             stream )
+{
+  HB_Error   error;
+
+  HB_UShort  count;
+
+
+  if ( ACCESS_Frame( 2L ) )
+    return error;
+
+  count = cf1->GlyphCount = GET_UShort();
+
+  FORGET_Frame();
+
+  /* the glyph array is used in place */
+
+  if ( ACCESS_Frame( count * 2L ) )
+    return error;
+
+  cf1->GlyphArray = FRAME_Data();
+
+  FORGET_Frame();
+
+  return HB_Err_Ok;
 }
 
 
@@ -719,9 +924,8 @@ static HB_Error  Load_Coverage2( HB_CoverageFormat2*  cf2,
 {
   HB_Error   error;
 
-  HB_UShort         n, count;
-
-  HB_RangeRecord*  rr;
+  HB_UShort  n, count;
+  HB_UShort  start, end, start_index;
 
 
   if ( ACCESS_Frame( 2L ) )
@@ -731,45 +935,28 @@ static HB_Error  Load_Coverage2( HB_CoverageFormat2*  cf2,
 
   FORGET_Frame();
 
-  cf2->RangeRecord = NULL;
+  /* the range records are used in place, after checking them once */
 
-  if ( ALLOC_ARRAY( cf2->RangeRecord, count, HB_RangeRecord ) )
+  if ( ACCESS_Frame( count * 6L ) )
     return error;
 
-  rr = cf2->RangeRecord;
-
-  if ( ACCESS_Frame( count * 6L ) )
-    goto Fail;
+  cf2->RangeRecord = FRAME_Data();
 
   for ( n = 0; n < count; n++ )
   {
-    rr[n].Start              = GET_UShort();
-    rr[n].End                = GET_UShort();
-    rr[n].StartCoverageIndex = GET_UShort();
+    start       = GET_UShort();
+    end         = GET_UShort();
+    start_index = GET_UShort();
 
     /* sanity check; we are limited to 16bit integers */
-    if ( rr[n].Start > rr[n].End ||
-	 ( rr[n].End - rr[n].Start + (long)rr[n].StartCoverageIndex ) >=
-	   0x10000L )
-    {
-      error = ERR(HB_Err_Invalid_SubTable);
-      goto Fail;
-    }
+    if ( start > end ||
+	 ( end - start + (long)start_index ) >= 0x10000L )
+      return ERR(HB_Err_Invalid_SubTable);
   }
 
   FORGET_Frame();
 
   return HB_Err_Ok;
-
-Fail:
-  FREE( cf2->RangeRecord );
-  return error;
-}
-
-
-static void  Free_Coverage2( HB_CoverageFormat2*  cf2 )
-{
-  FREE( cf2->RangeRecord );
 }
 
 
@@ -788,24 +975,17 @@ _HB_OPEN_Load_Coverage( HB_Coverage* c,
 
   switch ( c->CoverageFormat )
   {
-  case 1:  return Load_Coverage1( &c->cf.cf1, stream );
-  case 2:  return Load_Coverage2( &c->cf.cf2, stream );
+  case 1:  error = Load_Coverage1( &c->cf.cf1, stream ); break;
+  case 2:  error = Load_Coverage2( &c->cf.cf2, stream ); break;
   default: return ERR(HB_Err_Invalid_SubTable_Format);
   }
 
-  return HB_Err_Ok;               /* never reached */
-}
+  if ( error )
+    return error;
 
+  Make_Coverage_Digest( c );
 
-HB_INTERNAL void
-_HB_OPEN_Free_Coverage( HB_Coverage* c )
-{
-  switch ( c->CoverageFormat )
-  {
-  case 1:  Free_Coverage1( &c->cf.cf1 ); break;
-  case 2:  Free_Coverage2( &c->cf.cf2 ); break;
-  default:					 break;
-  }
+  return HB_Err_Ok;
 }
 
 
@@ -815,7 +995,7 @@ static HB_Error  Coverage_Index1( HB_CoverageFormat1*  cf1,
 {
   HB_UShort min, max, new_min, new_max, middle;
 
-  HB_UShort*  array = cf1->GlyphArray;
+  const HB_Byte*  array = cf1->GlyphArray;
 
 
   /* binary search */
@@ -836,12 +1016,12 @@ static HB_Error  Coverage_Index1( HB_CoverageFormat1*  cf1,
 
     middle = max - ( ( max - min ) >> 1 );
 
-    if ( glyphID == array[middle] )
+    if ( glyphID == ARRAY_UShort( array, middle ) )
     {
       *index = middle;
       return HB_Err_Ok;
     }
-    else if ( glyphID < array[middle] )
+    else if ( glyphID < ARRAY_UShort( array, middle ) )
     {
       if ( middle == min )
 	break;
@@ -865,7 +1045,7 @@ static HB_Error  Coverage_Index2( HB_CoverageFormat2*  cf2,
 {
   HB_UShort         min, max, new_min, new_max, middle;
 
-  HB_RangeRecord*  rr = cf2->RangeRecord;
+  const HB_Byte*    rr = cf2->RangeRecord;
 
 
   /* binary search */
@@ -886,12 +1066,13 @@ static HB_Error  Coverage_Index2( HB_CoverageFormat2*  cf2,
 
     middle = max - ( ( max - min ) >> 1 );
 
-    if ( glyphID >= rr[middle].Start && glyphID <= rr[middle].End )
+    if ( glyphID >= RANGE_Start( rr, middle ) &&
+	 glyphID <= RANGE_End( rr, middle ) )
     {
-      *index = rr[middle].StartCoverageIndex + glyphID - rr[middle].Start;
+      *index = RANGE_Value( rr, middle ) + glyphID - RANGE_Start( rr, middle );
       return HB_Err_Ok;
     }
-    else if ( glyphID < rr[middle].Start )
+    else if ( glyphID < RANGE_Start( rr, middle ) )
     {
       if ( middle == min )
 	break;
@@ -914,6 +1095,11 @@ _HB_OPEN_Coverage_Index( HB_Coverage* c,
 			  HB_UShort      glyphID,
 			  HB_UShort*     index )
 {
+  /* most glyphs we are asked for aren't covered */
+
+  if ( !DIGEST_May_Have( &c->Digest, glyphID ) )
+    return HB_Err_Not_Covered;
+
   switch ( c->CoverageFormat )
   {
   case 1:  return Coverage_Index1( &c->cf.cf1, glyphID, index );
@@ -941,8 +1127,6 @@ static HB_Error  Load_ClassDef1( HB_ClassDefinition*  cd,
 
   HB_UShort             n, count;
 
-  HB_UShort*            cva;
-
   HB_ClassDefFormat1*  cdf1;
 
 
@@ -961,44 +1145,103 @@ static HB_Error  Load_ClassDef1( HB_ClassDefinition*  cd,
   if ( cdf1->StartGlyph + (long)count >= 0x10000L )
     return ERR(HB_Err_Invalid_SubTable);
 
-  cdf1->ClassValueArray = NULL;
+  /* the class values are used in place, after checking them once */
 
-  if ( ALLOC_ARRAY( cdf1->ClassValueArray, count, HB_UShort ) )
+  if ( ACCESS_Frame( count * 2L ) )
     return error;
 
-  cva = cdf1->ClassValueArray;
-
-  if ( ACCESS_Frame( count * 2L ) )
-    goto Fail;
+  cdf1->ClassValueArray = FRAME_Data();
 
   for ( n = 0; n < count; n++ )
   {
-    cva[n] = GET_UShort();
-    if ( cva[n] >= limit )
-    {
-      error = ERR(HB_Err_Invalid_SubTable);
-      goto Fail;
-    }
+    if ( GET_UShort() >= limit )
+      return ERR(HB_Err_Invalid_SubTable);
   }
 
   FORGET_Frame();
 
   return HB_Err_Ok;
+}
 
-Fail:
-  FREE( cva );
 
-  return error;
+/* ClassDefFormat2 */
+
+static HB_Bool  Check_ClassRange( const HB_Byte*  crr,
+				  HB_UShort       limit )
+{
+  return RANGE_Start( crr, 0 ) <= RANGE_End( crr, 0 ) &&
+	 RANGE_Value( crr, 0 ) < limit;
 }
 
 
-static void  Free_ClassDef1( HB_ClassDefFormat1*  cdf1 )
+static HB_Error  Make_ClassDef2_Flat( HB_ClassDefFormat2*  cdf2,
+				      HB_UShort             limit,
+				      HB_Stream             stream )
 {
-  FREE( cdf1->ClassValueArray );
-}
+  HB_Error        error;
 
+  HB_UShort       n, count, glyph, end;
+  HB_UInt         span;
+
+  const HB_Byte*  crr = cdf2->ClassRangeRecord;
+  HB_Byte*        flat;
+
+
+  cdf2->FlatStart   = 0;
+  cdf2->FlatCount   = 0;
+  cdf2->FlatClasses = NULL;
+
+  count = cdf2->ClassRangeCount;
+
+  /* class values are stored plus one in a byte */
+
+  if ( count == 0 || limit > 255 )
+    return HB_Err_Ok;
+
+  /* the records are sorted, but corrupt fonts needn't care */
+
+  cdf2->FlatStart = RANGE_Start( crr, 0 );
+  end             = RANGE_End( crr, 0 );
+
+  for ( n = 1; n < count; n++ )
+  {
+    if ( RANGE_Start( crr, n ) < cdf2->FlatStart )
+      cdf2->FlatStart = RANGE_Start( crr, n );
+    if ( RANGE_End( crr, n ) > end )
+      end = RANGE_End( crr, n );
+  }
+
+  span = end - cdf2->FlatStart + 1L;
+
+  if ( span > 0xFFFFL ||
+       span > HB_CLASSDEF_FLAT_BASE + HB_CLASSDEF_FLAT_PER_RANGE * (HB_UInt)count )
+    return HB_Err_Ok;
+
+  if ( ARENA_ALLOC( flat, span ) )
+    return error;
+
+  /* the first range covering a glyph wins */
+
+  for ( n = 0; n < count; n++ )
+  {
+    glyph = RANGE_Start( crr, n );
+    end   = RANGE_End( crr, n );
+
+    for ( ;; glyph++ )
+    {
+      if ( !flat[glyph - cdf2->FlatStart] )
+	flat[glyph - cdf2->FlatStart] = (HB_Byte)( RANGE_Value( crr, n ) + 1 );
+      if ( glyph == end )
+	break;
+    }
+  }
+
+  cdf2->FlatCount   = (HB_UShort)span;
+  cdf2->FlatClasses = flat;
+
+  return HB_Err_Ok;
+}
 
-/* ClassDefFormat2 */
 
 static HB_Error  Load_ClassDef2( HB_ClassDefinition*  cd,
 				 HB_UShort             limit,
@@ -1006,9 +1249,10 @@ static HB_Error  Load_ClassDef2( HB_ClassDefinition*  cd,
 {
   HB_Error   error;
 
-  HB_UShort              n, count;
+  HB_UShort              n, m, count, good;
 
-  HB_ClassRangeRecord*  crr;
+  const HB_Byte*         crr;
+  HB_Byte*               copy;
 
   HB_ClassDefFormat2*   cdf2;
 
@@ -1019,56 +1263,50 @@ static HB_Error  Load_ClassDef2( HB_ClassDefinition*  cd,
     return error;
 
   count = GET_UShort();
-  cdf2->ClassRangeCount = 0; /* zero for now.  we fill with the number of good entries later */
 
   FORGET_Frame();
 
-  cdf2->ClassRangeRecord = NULL;
+  /* the range records are used in place, after checking them once */
 
-  if ( ALLOC_ARRAY( cdf2->ClassRangeRecord, count, HB_ClassRangeRecord ) )
+  if ( ACCESS_Frame( count * 6L ) )
     return error;
 
-  crr = cdf2->ClassRangeRecord;
-
-  if ( ACCESS_Frame( count * 6L ) )
-    goto Fail;
+  crr  = FRAME_Data();
+  good = 0;
 
   for ( n = 0; n < count; n++ )
-  {
-    crr[n].Start = GET_UShort();
-    crr[n].End   = GET_UShort();
-    crr[n].Class = GET_UShort();
-
-    /* sanity check */
-
-    if ( crr[n].Start > crr[n].End ||
-	 crr[n].Class >= limit )
-    {
-      /* XXX
-       * Corrupt entry.  Skip it.
-       * This is hit by Nafees Nastaliq font for example
-       */
-       n--;
-       count--;
-    }
-  }
+    if ( Check_ClassRange( crr + 6 * n, limit ) )
+      good++;
 
   FORGET_Frame();
 
-  cdf2->ClassRangeCount = count;
-
-  return HB_Err_Ok;
+  if ( good < count )
+  {
+    /* XXX
+     * Corrupt entries.  Skip them, which needs a copy of the good ones.
+     * This is hit by Nafees Nastaliq font for example
+     */
+    if ( ARENA_ALLOC( copy, good * 6L ) )
+      return error;
 
-Fail:
-  FREE( crr );
+    for ( n = 0, m = 0; n < count; n++ )
+      if ( Check_ClassRange( crr + 6 * n, limit ) )
+      {
+	copy[m++] = crr[6 * n];
+	copy[m++] = crr[6 * n + 1];
+	copy[m++] = crr[6 * n + 2];
+	copy[m++] = crr[6 * n + 3];
+	copy[m++] = crr[6 * n + 4];
+	copy[m++] = crr[6 * n + 5];
+      }
 
-  return error;
-}
+    crr = copy;
+  }
 
+  cdf2->ClassRangeRecord = crr;
+  cdf2->ClassRangeCount  = good;
 
-static void  Free_ClassDef2( HB_ClassDefFormat2*  cdf2 )
-{
-  FREE( cdf2->ClassRangeRecord );
+  return Make_ClassDef2_Flat( cdf2, limit, stream );
 }
 
 
@@ -1107,12 +1345,11 @@ _HB_OPEN_Load_ClassDefinition( HB_ClassDefinition* cd,
 static HB_Error
 _HB_OPEN_Load_EmptyClassDefinition( HB_ClassDefinition*  cd )
 {
-  HB_Error   error;
-
   cd->ClassFormat = 1; /* Meaningless */
 
-  if ( ALLOC_ARRAY( cd->cd.cd1.ClassValueArray, 1, HB_UShort ) )
-    return error;
+  cd->cd.cd1.StartGlyph      = 0;
+  cd->cd.cd1.GlyphCount      = 0;
+  cd->cd.cd1.ClassValueArray = NULL;
 
   return HB_Err_Ok;
 }
@@ -1143,27 +1380,13 @@ _HB_OPEN_Load_EmptyOrClassDefinition( HB_ClassDefinition* cd,
   return error;
 }
 
-HB_INTERNAL void
-_HB_OPEN_Free_ClassDefinition( HB_ClassDefinition*  cd )
-{
-  if ( !cd->loaded )
-    return;
-
-  switch ( cd->ClassFormat )
-  {
-  case 1:  Free_ClassDef1( &cd->cd.cd1 ); break;
-  case 2:  Free_ClassDef2( &cd->cd.cd2 ); break;
-  default:				  break;
-  }
-}
-
 
 static HB_Error  Get_Class1( HB_ClassDefFormat1*  cdf1,
 			     HB_UShort             glyphID,
 			     HB_UShort*            klass,
 			     HB_UShort*            index )
 {
-  HB_UShort*  cva = cdf1->ClassValueArray;
+  const HB_Byte*  cva = cdf1->ClassValueArray;
 
 
   if ( index )
@@ -1172,7 +1395,7 @@ static HB_Error  Get_Class1( HB_ClassDefFormat1*  cdf1,
   if ( glyphID >= cdf1->StartGlyph &&
        glyphID < cdf1->StartGlyph + cdf1->GlyphCount )
   {
-    *klass = cva[glyphID - cdf1->StartGlyph];
+    *klass = ARRAY_UShort( cva, glyphID - cdf1->StartGlyph );
     return HB_Err_Ok;
   }
   else
@@ -1194,9 +1417,30 @@ static HB_Error  Get_Class2( HB_ClassDefFormat2*  cdf2,
   HB_Error               error = HB_Err_Ok;
   HB_UShort              min, max, new_min, new_max, middle;
 
-  HB_ClassRangeRecord*  crr = cdf2->ClassRangeRecord;
+  const HB_Byte*         crr = cdf2->ClassRangeRecord;
 
 
+  if ( cdf2->FlatCount )
+  {
+    HB_Byte  flat = 0;
+
+    if ( index )
+      *index = 0;
+
+    if ( glyphID >= cdf2->FlatStart &&
+	 glyphID - cdf2->FlatStart < cdf2->FlatCount )
+      flat = cdf2->FlatClasses[glyphID - cdf2->FlatStart];
+
+    if ( flat )
+    {
+      *klass = flat - 1;
+      return HB_Err_Ok;
+    }
+
+    *klass = 0;
+    return HB_Err_Not_Covered;
+  }
+
   /* binary search */
 
   if ( cdf2->ClassRangeCount == 0 )
@@ -1221,13 +1465,14 @@ static HB_Error  Get_Class2( HB_ClassDefFormat2*  cdf2,
 
     middle = max - ( ( max - min ) >> 1 );
 
-    if ( glyphID >= crr[middle].Start && glyphID <= crr[middle].End )
+    if ( glyphID >= RANGE_Start( crr, middle ) &&
+	 glyphID <= RANGE_End( crr, middle ) )
     {
-      *klass = crr[middle].Class;
+      *klass = RANGE_Value( crr, middle );
       error  = HB_Err_Ok;
       break;
     }
-    else if ( glyphID < crr[middle].Start )
+    else if ( glyphID < RANGE_Start( crr, middle ) )
     {
       if ( middle == min )
       {
@@ -1273,6 +1518,556 @@ _HB_OPEN_Get_Class( HB_ClassDefinition* cd,
 }
 
 
+/***************************************
+ * Chaining context related functions
+ ***************************************/
+
+
+/* The path of a rule in its trie: the input glyphs resp. classes past
+   the first one, then the lookahead.  In rules of classes the
+   lookahead classes get bit 16 set, as they come from another class
+   definition than the input classes.                                 */
+
+static HB_UInt  Chain_Path_Length( const HB_ChainRuleKey*  key )
+{
+  return ( key->InputCount ? key->InputCount - 1 : 0 ) + key->LookaheadCount;
+}
+
+
+static HB_UInt  Chain_Path_Element( const HB_ChainRuleKey*  key,
+				    HB_UInt                 depth )
+{
+  HB_UInt  inputs = key->InputCount ? key->InputCount - 1 : 0;
+
+
+  if ( depth < inputs )
+    return key->Input[depth];
+
+  return key->Kind | key->Lookahead[depth - inputs];
+}
+
+
+static int  Compare_Chain_Rules( const void*  a,
+				 const void*  b )
+{
+  const HB_ChainRuleKey*  ka = *(const HB_ChainRuleKey* const*)a;
+  const HB_ChainRuleKey*  kb = *(const HB_ChainRuleKey* const*)b;
+  HB_UInt                 na = Chain_Path_Length( ka );
+  HB_UInt                 nb = Chain_Path_Length( kb );
+  HB_UInt                 n, ea, eb;
+
+
+  for ( n = 0; n < na && n < nb; n++ )
+  {
+    ea = Chain_Path_Element( ka, n );
+    eb = Chain_Path_Element( kb, n );
+
+    if ( ea != eb )
+      return ea < eb ? -1 : 1;
+  }
+
+  if ( na != nb )
+    return na < nb ? -1 : 1;
+
+  /* rules with the same path keep the order of the font */
+
+  return ka < kb ? -1 : ka > kb;
+}
+
+
+/* Like the ligature tries of GSUB, the trie is built breadth first
+   from the sorted rules: the rules below a node form a contiguous run,
+   with the ones ending at the node first.                             */
+
+HB_INTERNAL HB_Error
+_HB_OPEN_Make_Chain_Trie( HB_ChainTrie*     trie,
+			  HB_ChainRuleKey*  keys,
+			  HB_UShort         count,
+			  HB_Bool           classes,
+			  HB_Stream         stream )
+{
+  HB_Error  error;
+
+  HB_UShort           first, n;
+  HB_UInt             depth, len, prev_len, value;
+  HB_UInt             node_count, next, node, k, r;
+  HB_ChainRuleKey**   order = NULL;
+  HB_UInt*            run = NULL;
+  HB_ChainTrieNode*   nodes;
+  HB_ChainTrieRule*   rules;
+
+
+  trie->Node         = NULL;
+  trie->Rule         = NULL;
+  trie->MaxDepth     = 0;
+  trie->MaxBacktrack = 0;
+
+  if ( !count )
+    return HB_Err_Ok;
+
+  if ( ALLOC_ARRAY( order, count, HB_ChainRuleKey* ) )
+    return error;
+
+  for ( n = 0; n < count; n++ )
+  {
+    keys[n].Kind = classes ? 0x10000 : 0;
+    order[n]     = &keys[n];
+  }
+
+  qsort( order, count, sizeof( HB_ChainRuleKey* ), Compare_Chain_Rules );
+
+  /* every rule adds the nodes past its common prefix with the
+     previous one                                               */
+
+  node_count = 1;
+  prev_len   = 0;
+
+  for ( n = 0; n < count; n++ )
+  {
+    len = Chain_Path_Length( order[n] );
+
+    for ( depth = 0; n && depth < len && depth < prev_len; depth++ )
+      if ( Chain_Path_Element( order[n], depth ) !=
+	   Chain_Path_Element( order[n - 1], depth ) )
+	break;
+
+    node_count += len - depth;
+    prev_len    = len;
+
+    if ( len > trie->MaxDepth )
+      trie->MaxDepth = len;
+    if ( order[n]->BacktrackCount > trie->MaxBacktrack )
+      trie->MaxBacktrack = order[n]->BacktrackCount;
+  }
+
+  /* the run of node `k' is run[3k] to run[3k + 1], at depth run[3k + 2] */
+
+  if ( ALLOC_ARRAY( run, node_count * 3, HB_UInt ) ||
+       ARENA_ALLOC_ARRAY( nodes, node_count, HB_ChainTrieNode ) ||
+       ARENA_ALLOC_ARRAY( rules, count, HB_ChainTrieRule ) )
+    goto Fail;
+
+  run[0] = 0;
+  run[1] = count;
+  run[2] = 0;
+  next   = 1;
+  r      = 0;
+
+  for ( node = 0; node < next; node++ )
+  {
+    k     = run[3 * node];
+    depth = run[3 * node + 2];
+
+    first = 0xFFFF;
+    for ( ; k < run[3 * node + 1]; k++ )
+      if ( order[k] - keys < first )
+	first = (HB_UShort)( order[k] - keys );
+    nodes[node].First = first + 1;
+
+    nodes[node].FirstRule = r;
+
+    k = run[3 * node];
+    while ( k < run[3 * node + 1] && Chain_Path_Length( order[k] ) == depth )
+    {
+      rules[r].Index          = (HB_UShort)( order[k] - keys );
+      rules[r].InputCount     = order[k]->InputCount;
+      rules[r].BacktrackCount = order[k]->BacktrackCount;
+      rules[r].Backtrack      = order[k]->Backtrack;
+      r++;
+      k++;
+    }
+
+    nodes[node].RuleCount  = (HB_UShort)( r - nodes[node].FirstRule );
+    nodes[node].FirstChild = next;
+
+    while ( k < run[3 * node + 1] )
+    {
+      value = Chain_Path_Element( order[k], depth );
+
+      nodes[next].Value     = (HB_UShort)value;
+      nodes[next].Lookahead = (HB_UShort)( value >> 16 );
+      run[3 * next]         = k;
+      run[3 * next + 2]     = depth + 1;
+
+      while ( k < run[3 * node + 1] &&
+	      Chain_Path_Element( order[k], depth ) == value )
+	k++;
+
+      run[3 * next + 1] = k;
+      next++;
+    }
+
+    nodes[node].ChildCount = (HB_UShort)( next - nodes[node].FirstChild );
+  }
+
+  trie->Node = nodes;
+  trie->Rule = rules;
+
+Fail:
+  FREE( run );
+  FREE( order );
+  return error;
+}
+
+
+/* The glyphs around the current position are only looked at when the
+   trie asks for them, and then only once.  Positions and values not
+   known yet are HB_CHAIN_UNKNOWN; HB_CHAIN_NONE marks the end of the
+   string.  Small tries keep their scratch space on the stack.         */
+
+#define HB_CHAIN_UNKNOWN  0xFFFFFFFFUL
+#define HB_CHAIN_NONE     0xFFFFFFFEUL
+
+#define HB_CHAIN_LOCAL_SIZE  256
+
+
+static HB_Error  Chain_Value( HB_ClassDefinition*  cd,
+			      HB_UShort            glyph,
+			      HB_UInt*             value )
+{
+  HB_UShort  klass;
+  HB_Error   error;
+
+
+  if ( !cd )
+  {
+    *value = glyph;
+    return HB_Err_Ok;
+  }
+
+  error = _HB_OPEN_Get_Class( cd, glyph, &klass, NULL );
+  if ( error && error != HB_Err_Not_Covered )
+    return error;
+
+  *value = klass;
+  return HB_Err_Ok;
+}
+
+
+/* the first glyph after `pos' not ignored by the lookup flags */
+
+static HB_Error  Chain_Skip_Forward( const HB_ChainContext*  cc,
+				     HB_UInt                 pos,
+				     HB_UInt*                next )
+{
+  HB_Buffer  buffer = cc->buffer;
+  HB_Error   error;
+
+
+  pos++;
+
+  if ( SKIP_Forward( cc->gdef, cc->flags, pos ) )
+  {
+    if ( error != HB_Err_Not_Covered )
+      return error;
+    pos = HB_CHAIN_NONE;
+  }
+
+  *next = pos;
+  return HB_Err_Ok;
+}
+
+
+/* the last glyph before `pos' not ignored by the lookup flags, taken
+   from the output string if the backtrack has been processed already */
+
+static HB_Error  Chain_Skip_Backward( const HB_ChainContext*  cc,
+				      HB_UInt                 pos,
+				      HB_UInt*                prev )
+{
+  HB_Buffer     buffer = cc->buffer;
+  HB_UShort     property;
+  HB_Error      error;
+
+
+  if ( !pos )
+  {
+    *prev = HB_CHAIN_NONE;
+    return HB_Err_Ok;
+  }
+
+  pos--;
+
+  if ( !cc->backtrack_output )
+  {
+    if ( SKIP_Backward( cc->gdef, cc->flags, pos ) )
+    {
+      if ( error != HB_Err_Not_Covered )
+	return error;
+      pos = HB_CHAIN_NONE;
+    }
+
+    *prev = pos;
+    return HB_Err_Ok;
+  }
+
+  /* the output string grows while the lookup runs, so it has no skip
+     list                                                             */
+
+  for ( ;; pos-- )
+  {
+    if ( !CHECK_Property( cc->gdef, OUT_ITEM( pos ), cc->flags, &property ) )
+      break;
+
+    if ( error != HB_Err_Not_Covered )
+      return error;
+
+    if ( !pos )
+    {
+      pos = HB_CHAIN_NONE;
+      break;
+    }
+  }
+
+  *prev = pos;
+  return HB_Err_Ok;
+}
+
+
+static HB_Error  Chain_Match_Backtrack( const HB_ChainContext*   cc,
+					const HB_ChainTrieRule*  rule,
+					HB_UInt*                 bpos,
+					HB_UInt*                 bval,
+					HB_Bool*                 match )
+{
+  HB_Buffer  buffer = cc->buffer;
+  HB_UInt    i, start;
+  HB_UShort  glyph;
+  HB_Error   error;
+
+
+  *match = FALSE;
+
+  start = cc->backtrack_output ? buffer->out_pos : buffer->in_pos;
+
+  for ( i = 0; i < rule->BacktrackCount; i++ )
+  {
+    if ( bpos[i] == HB_CHAIN_UNKNOWN )
+    {
+      error = Chain_Skip_Backward( cc, i ? bpos[i - 1] : start, &bpos[i] );
+      if ( error )
+	return error;
+    }
+
+    if ( bpos[i] == HB_CHAIN_NONE )
+      return HB_Err_Ok;
+
+    if ( bval[i] == HB_CHAIN_UNKNOWN )
+    {
+      glyph = cc->backtrack_output ? OUT_GLYPH( bpos[i] ) : IN_GLYPH( bpos[i] );
+
+      error = Chain_Value( cc->BacktrackClassDef, glyph, &bval[i] );
+      if ( error )
+	return error;
+    }
+
+    if ( bval[i] != rule->Backtrack[i] )
+      return HB_Err_Ok;
+  }
+
+  *match = TRUE;
+  return HB_Err_Ok;
+}
+
+
+static HB_UInt  Chain_Find_Child( const HB_ChainTrie*      trie,
+				  const HB_ChainTrieNode*  node,
+				  HB_UInt                  key )
+{
+  HB_UInt                  lo, hi, mid, k;
+  const HB_ChainTrieNode*  child;
+
+
+  lo = node->FirstChild;
+  hi = lo + node->ChildCount;
+
+  while ( lo < hi )
+  {
+    mid   = ( lo + hi ) >> 1;
+    child = &trie->Node[mid];
+    k     = ( (HB_UInt)child->Lookahead << 16 ) | child->Value;
+
+    if ( k == key )
+      return mid;
+    else if ( k < key )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return 0;                       /* the root is nobody's child */
+}
+
+
+/* Search the trie depth first for the first rule (in the order of the
+   font) matching at the current position.  A node is only entered if
+   a rule below it could still beat the best match found so far; of
+   two children, the one leading to the earlier rule is tried first.  */
+
+HB_INTERNAL HB_Error
+_HB_OPEN_Match_Chain_Trie( const HB_ChainTrie*     trie,
+			   const HB_ChainContext*  cc,
+			   HB_UShort*              rule_index )
+{
+  HB_Error  error = HB_Err_Ok;
+
+  HB_Buffer                buffer = cc->buffer;
+  HB_UInt                  local[HB_CHAIN_LOCAL_SIZE];
+  HB_UInt*                 work = local;
+  HB_UInt                  size, depth, best, top, r, n, a, b, c;
+  HB_UInt*                 fpos;
+  HB_UInt*                 fval;
+  HB_UInt*                 bpos;
+  HB_UInt*                 bval;
+  HB_UInt*                 stack;
+  HB_Bool                  match;
+  const HB_ChainTrieNode*  node;
+  const HB_ChainTrieRule*  rule;
+
+
+  if ( !trie->Node )
+    return HB_Err_Not_Covered;
+
+  /* the stack holds at most one pending sibling per level, plus the
+     two children of the node entered last                           */
+
+  size = 3 * trie->MaxDepth + 2 * trie->MaxBacktrack +
+	 2 * ( trie->MaxDepth + 2 );
+
+  if ( size > HB_CHAIN_LOCAL_SIZE && ALLOC_ARRAY( work, size, HB_UInt ) )
+    return error;
+
+  fpos  = work;
+  fval  = fpos + trie->MaxDepth;
+  bpos  = fval + 2 * trie->MaxDepth;
+  bval  = bpos + trie->MaxBacktrack;
+  stack = bval + trie->MaxBacktrack;
+
+  for ( n = 0; n < 3 * trie->MaxDepth + 2 * trie->MaxBacktrack; n++ )
+    work[n] = HB_CHAIN_UNKNOWN;
+
+  best     = 0x10000;
+  stack[0] = 0;
+  stack[1] = 0;
+  top      = 1;
+
+  while ( top )
+  {
+    top--;
+    node  = &trie->Node[stack[2 * top]];
+    depth = stack[2 * top + 1];
+
+    if ( node->First - 1U >= best )
+      continue;
+
+    /* the rules ending here, in the order of the font */
+
+    for ( r = 0; r < node->RuleCount; r++ )
+    {
+      rule = &trie->Rule[node->FirstRule + r];
+
+      if ( rule->Index >= best )
+	break;
+
+      if ( cc->context_length != 0xFFFF &&
+	   cc->context_length < rule->InputCount )
+	continue;
+
+      error = Chain_Match_Backtrack( cc, rule, bpos, bval, &match );
+      if ( error )
+	goto End;
+
+      if ( match )
+      {
+	best = rule->Index;
+	break;
+      }
+    }
+
+    if ( !node->ChildCount )
+      continue;
+
+    if ( fpos[depth] == HB_CHAIN_UNKNOWN )
+    {
+      error = Chain_Skip_Forward( cc, depth ? fpos[depth - 1] : buffer->in_pos,
+				  &fpos[depth] );
+      if ( error )
+	goto End;
+    }
+
+    if ( fpos[depth] == HB_CHAIN_NONE )
+      continue;
+
+    /* `a' continues the input, `b' starts resp. continues the
+       lookahead; rules of glyphs don't tell them apart          */
+
+    a = b = 0;
+
+    if ( !cc->InputClassDef )
+      a = Chain_Find_Child( trie, node, IN_GLYPH( fpos[depth] ) );
+    else
+    {
+      if ( !trie->Node[node->FirstChild].Lookahead )
+      {
+	if ( fval[2 * depth] == HB_CHAIN_UNKNOWN )
+	{
+	  error = Chain_Value( cc->InputClassDef, IN_GLYPH( fpos[depth] ),
+			       &fval[2 * depth] );
+	  if ( error )
+	    goto End;
+	}
+
+	a = Chain_Find_Child( trie, node, fval[2 * depth] );
+      }
+
+      if ( trie->Node[node->FirstChild + node->ChildCount - 1].Lookahead )
+      {
+	if ( fval[2 * depth + 1] == HB_CHAIN_UNKNOWN )
+	{
+	  error = Chain_Value( cc->LookaheadClassDef, IN_GLYPH( fpos[depth] ),
+			       &fval[2 * depth + 1] );
+	  if ( error )
+	    goto End;
+	}
+
+	b = Chain_Find_Child( trie, node, 0x10000 | fval[2 * depth + 1] );
+      }
+    }
+
+    if ( a && b && trie->Node[a].First < trie->Node[b].First )
+    {
+      c = a;
+      a = b;
+      b = c;
+    }
+
+    if ( a && trie->Node[a].First - 1U < best )
+    {
+      stack[2 * top]     = a;
+      stack[2 * top + 1] = depth + 1;
+      top++;
+    }
+    if ( b && trie->Node[b].First - 1U < best )
+    {
+      stack[2 * top]     = b;
+      stack[2 * top + 1] = depth + 1;
+      top++;
+    }
+  }
+
+  if ( best < 0x10000 )
+    *rule_index = (HB_UShort)best;
+  else
+    error = HB_Err_Not_Covered;
+
+End:
+  if ( work != local )
+    FREE( work );
+
+  return error;
+}
+
+
 
 /***************************
  * Device related functions
@@ -1315,14 +2110,11 @@ _HB_OPEN_Load_Device( HB_Device* d,
   count = ( ( d->EndSize - d->StartSize + 1 ) >>
 	      ( 4 - d->DeltaFormat ) ) + 1;
 
-  if ( ALLOC_ARRAY( d->DeltaValue, count, HB_UShort ) )
+  if ( ARENA_ALLOC_ARRAY( d->DeltaValue, count, HB_UShort ) )
     return error;
 
   if ( ACCESS_Frame( count * 2L ) )
-  {
-    FREE( d->DeltaValue );
     return error;
-  }
 
   dv = d->DeltaValue;
 
@@ -1335,13 +2127,6 @@ _HB_OPEN_Load_Device( HB_Device* d,
 }
 
 
-HB_INTERNAL void
-_HB_OPEN_Free_Device( HB_Device* d )
-{
-  FREE( d->DeltaValue );
-}
-
-
 /* Since we have the delta values stored in compressed form, we must
    uncompress it now.  To simplify the interface, the function always
    returns a meaningful value in `value'; the error is just for
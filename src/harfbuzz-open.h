@@ -27,6 +27,7 @@
 #define HARFBUZZ_OPEN_H
 
 #include "harfbuzz-global.h"
+#include "harfbuzz-stream.h"
 
 HB_BEGIN_HEADER
 
@@ -125,12 +126,21 @@ typedef struct HB_FeatureList_  HB_FeatureList;
 typedef struct HB_SubTable_  HB_SubTable;
 
 
+/* The subtables of a lookup are only loaded when the lookup is applied
+   for the first time; until then, `SubTable' is NULL.  They are read
+   through _HB_OPEN_Get_Lookup_SubTables(), which also knows about the
+   lookups whose subtables failed to load.  For extension lookups,
+   `LookupType' is the type of the extension subtables.                 */
+
 struct  HB_Lookup_
 {
   HB_UShort      LookupType;          /* Lookup type         */
   HB_UShort      LookupFlag;          /* Lookup qualifiers   */
   HB_UShort      SubTableCount;       /* number of SubTables */
   HB_SubTable*  SubTable;            /* array of SubTables  */
+  HB_UInt        Offset;              /* position of the Lookup
+					 table in the stream  */
+  HB_Arena       SubTableArena;       /* holds the SubTables */
 };
 
 typedef struct HB_Lookup_  HB_Lookup;
@@ -147,11 +157,59 @@ struct  HB_LookupList_
   HB_UShort    LookupCount;           /* number of Lookups       */
   HB_Lookup*  Lookup;                /* array of Lookup records */
   HB_UInt*     Properties;            /* array of flags          */
+  HB_StreamRec Stream;                /* the table data, to load
+					 subtables from          */
 };
 
 typedef struct HB_LookupList_  HB_LookupList;
 
 
+/* A lookup plan is the ordered list of lookups a feature selection
+   applies, each with the property mask it is applied with.  Unlike the
+   selection made with HB_GSUB_Add_Feature() resp. HB_GPOS_Add_Feature(),
+   it is kept outside of the table, so that a loaded table is never
+   modified while shaping and can be shared between threads.  A lookup
+   used by several features gets the union of their properties, as it
+   does with the `Properties' array above.  Initialize a plan by zeroing
+   it.
+
+   HB_GSUB_Compose_Plan() marks the lookups that can't change the length
+   of the string and can merge consecutive single substitutions with the
+   same properties into one glyph mapping, stored with the first of
+   them; adding a feature drops both again.                             */
+
+#define HB_PLAN_COMPOSED_APPLIED  0x10000   /* see `ComposedMap' below */
+
+struct  HB_PlanLookup_
+{
+  HB_UShort  LookupIndex;             /* index into the LookupList    */
+  HB_UInt    Properties;              /* flags, see `Properties' above */
+  HB_Bool    InPlace;                 /* the lookup only replaces glyphs
+					 one by one, so it is applied to
+					 the input string directly    */
+
+  HB_UInt    ComposedCount;           /* number of lookups applied
+					 through `ComposedMap', or 0  */
+  HB_UInt    ComposedLength;          /* number of entries in the map */
+  HB_UInt*   ComposedMap;             /* resulting glyph of every
+					 glyph ID, or'ed with
+					 HB_PLAN_COMPOSED_APPLIED if
+					 any of the lookups applies   */
+};
+
+typedef struct HB_PlanLookup_  HB_PlanLookup;
+
+
+struct  HB_LookupPlan_
+{
+  HB_UInt         LookupCount;        /* number of entries in Lookup  */
+  HB_UInt         Allocated;          /* allocated size of Lookup     */
+  HB_PlanLookup*  Lookup;             /* lookups in application order */
+};
+
+typedef struct HB_LookupPlan_  HB_LookupPlan;
+
+
 /* Possible LookupFlag bit masks.  `HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS' comes from the
    OpenType 1.2 specification; HB_LOOKUP_FLAG_RIGHT_TO_LEFT has been (re)introduced in
    OpenType 1.3 -- if set, the last glyph in a cursive attachment
@@ -165,38 +223,37 @@ typedef struct HB_LookupList_  HB_LookupList;
 #define HB_LOOKUP_FLAG_IGNORE_SPECIAL_MARKS  0xFF00
 
 
+/* The arrays of coverage and class definition tables are not copied;
+   they point into the (validated) table data and hold big-endian
+   values.  A range record consists of three UShorts: the first and
+   the last glyph ID of the range, followed by the coverage index of
+   the first glyph resp. the class of all glyphs in the range.      */
+
 struct  HB_CoverageFormat1_
 {
-  HB_UShort   GlyphCount;             /* number of glyphs in GlyphArray */
-  HB_UShort*  GlyphArray;             /* array of glyph IDs             */
+  HB_UShort       GlyphCount;         /* number of glyphs in GlyphArray */
+  const HB_Byte*  GlyphArray;         /* array of glyph IDs             */
 };
 
 typedef struct HB_CoverageFormat1_  HB_CoverageFormat1;
 
 
-struct HB_RangeRecord_
-{
-  HB_UShort  Start;                   /* first glyph ID in the range */
-  HB_UShort  End;                     /* last glyph ID in the range  */
-  HB_UShort  StartCoverageIndex;      /* coverage index of first
-					 glyph ID in the range       */
-};
-
-typedef struct HB_RangeRecord_  HB_RangeRecord;
-
-
 struct  HB_CoverageFormat2_
 {
-  HB_UShort         RangeCount;       /* number of RangeRecords */
-  HB_RangeRecord*  RangeRecord;      /* array of RangeRecords  */
+  HB_UShort       RangeCount;         /* number of RangeRecords */
+  const HB_Byte*  RangeRecord;        /* array of RangeRecords  */
 };
 
 typedef struct HB_CoverageFormat2_  HB_CoverageFormat2;
 
 
+/* `Digest' rejects most glyphs that aren't covered without searching
+   the table.                                                          */
+
 struct  HB_Coverage_
 {
-  HB_UShort  CoverageFormat;          /* 1 or 2 */
+  HB_UShort       CoverageFormat;     /* 1 or 2                  */
+  HB_GlyphDigest  Digest;             /* of the covered glyphs   */
 
   union
   {
@@ -210,31 +267,31 @@ typedef struct HB_Coverage_  HB_Coverage;
 
 struct  HB_ClassDefFormat1_
 {
-  HB_UShort   StartGlyph;             /* first glyph ID of the
+  HB_UShort       StartGlyph;         /* first glyph ID of the
 					 ClassValueArray             */
-  HB_UShort   GlyphCount;             /* size of the ClassValueArray */
-  HB_UShort*  ClassValueArray;        /* array of class values       */
+  HB_UShort       GlyphCount;         /* size of the ClassValueArray */
+  const HB_Byte*  ClassValueArray;    /* array of class values       */
 };
 
 typedef struct HB_ClassDefFormat1_  HB_ClassDefFormat1;
 
 
-struct  HB_ClassRangeRecord_
-{
-  HB_UShort  Start;                   /* first glyph ID in the range    */
-  HB_UShort  End;                     /* last glyph ID in the range     */
-  HB_UShort  Class;                   /* applied to all glyphs in range */
-};
-
-typedef struct HB_ClassRangeRecord_  HB_ClassRangeRecord;
-
+/* If the glyphs of the ClassRangeRecords span a small enough range
+   and all class values fit into a byte, the loader also builds a
+   direct-index array: `FlatClasses[glyph - FlatStart]' is the class of
+   `glyph' plus one, or zero if the glyph isn't in any range.  It is
+   used instead of searching the ranges if `FlatCount' isn't zero.     */
 
 struct  HB_ClassDefFormat2_
 {
-  HB_UShort              ClassRangeCount;
+  HB_UShort       ClassRangeCount;
 				      /* number of ClassRangeRecords */
-  HB_ClassRangeRecord*  ClassRangeRecord;
+  const HB_Byte*  ClassRangeRecord;
 				      /* array of ClassRangeRecords  */
+
+  HB_UShort       FlatStart;          /* first glyph ID of FlatClasses */
+  HB_UShort       FlatCount;          /* size of FlatClasses           */
+  const HB_Byte*  FlatClasses;        /* direct-index class array      */
 };
 
 typedef struct HB_ClassDefFormat2_  HB_ClassDefFormat2;
@@ -268,6 +325,53 @@ struct HB_Device_
 typedef struct HB_Device_  HB_Device;
 
 
+/* The rules of a chaining context rule set (formats 1 and 2) are
+   compiled into a trie over the glyphs resp. classes following the
+   first input glyph: the rest of the input, then the lookahead.  Only
+   the backtrack of the rules ending at a node is left to check, so a
+   single scan of the input tries all rules of the set.                */
+
+struct  HB_ChainTrieRule_
+{
+  HB_UShort         Index;            /* index of the rule in its set */
+  HB_UShort         InputCount;       /* InputGlyphCount of the rule  */
+  HB_UShort         BacktrackCount;   /* BacktrackGlyphCount          */
+  const HB_UShort*  Backtrack;        /* backtrack glyphs resp. classes */
+};
+
+typedef struct HB_ChainTrieRule_  HB_ChainTrieRule;
+
+
+struct  HB_ChainTrieNode_
+{
+  HB_UShort  Value;                   /* glyph or class leading here  */
+  HB_UShort  Lookahead;               /* TRUE if `Value' is a lookahead
+					 class                          */
+  HB_UShort  First;                   /* 1 + index of the first rule
+					 ending in the subtree          */
+  HB_UShort  RuleCount;               /* number of rules ending here  */
+  HB_UInt    FirstRule;               /* index of the first of them   */
+  HB_UInt    FirstChild;              /* index of the first child; the
+					 children are consecutive and
+					 sorted by Lookahead and Value */
+  HB_UShort  ChildCount;              /* number of child nodes        */
+};
+
+typedef struct HB_ChainTrieNode_  HB_ChainTrieNode;
+
+
+struct  HB_ChainTrie_
+{
+  HB_ChainTrieNode*  Node;            /* node 0 is the first glyph;
+					 NULL for an empty rule set    */
+  HB_ChainTrieRule*  Rule;            /* rules, grouped by node       */
+  HB_UInt            MaxDepth;        /* length of the longest path   */
+  HB_UInt            MaxBacktrack;    /* longest backtrack            */
+};
+
+typedef struct HB_ChainTrie_  HB_ChainTrie;
+
+
 enum  HB_Type_
 {
   HB_Type_GSUB,
@@ -277,6 +381,11 @@ enum  HB_Type_
 typedef enum HB_Type_  HB_Type;
 
 
+void  HB_Clear_LookupPlan( HB_LookupPlan*  plan );
+
+void  HB_Done_LookupPlan( HB_LookupPlan*  plan );
+
+
 HB_END_HEADER
 
 #endif /* HARFBUZZ_OPEN_H */
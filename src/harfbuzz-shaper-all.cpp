@@ -23,6 +23,8 @@
  */
 
 #include "harfbuzz-shaper.cpp"
+#include "harfbuzz-shaper-pool.cpp"
+#include "harfbuzz-shaper-cache.cpp"
 #include "harfbuzz-indic.cpp"
 extern "C" {
 #include "harfbuzz-tibetan.c"
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies)
+ *
+ * This is part of HarfBuzz, an OpenType Layout engine library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "harfbuzz-shaper.h"
+#include "harfbuzz-shaper-private.h"
+
+#include <string.h>
+
+#if defined(HB_NO_THREADS)
+#elif defined(_WIN32)
+#define HB_USE_WIN32_THREADS
+#include <windows.h>
+#else
+#define HB_USE_PTHREADS
+#include <pthread.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------
+//
+// Word cache
+//
+// The entries are kept in a hash table of chains and on a list running from the most to the least
+// recently used entry. The text of a word and the arrays it was shaped to follow its entry in the
+// same block of memory:
+//
+//     HB_ShapeCacheEntry | offsets | advances | glyphs | attributes | text | log_clusters
+//
+// -----------------------------------------------------------------------------------------------------
+
+struct HB_ShapeCacheEntry {
+    HB_ShapeCacheEntry *chain;
+    HB_ShapeCacheEntry *prev; // more recently used
+    HB_ShapeCacheEntry *next; // less recently used
+    hb_uint32 hash;
+    hb_uint32 size;
+
+    HB_Face face;
+    HB_Font font;
+    HB_UShort x_ppem, y_ppem;
+    HB_16Dot16 x_scale, y_scale;
+    int script;
+    HB_UInt language;
+    int flags;
+    int rightToLeft;
+    hb_uint32 length;
+
+    hb_uint32 num_glyphs;
+    HB_Bool kerning_applied;
+};
+
+struct HB_ShapeCacheRec_ {
+    HB_ShapeCacheEntry **buckets;
+    hb_uint32 numBuckets; // a power of two
+    hb_uint32 count;
+    hb_uint32 size;
+    hb_uint32 maxSize;
+    HB_ShapeCacheEntry *first;
+    HB_ShapeCacheEntry *last;
+#if defined(HB_USE_PTHREADS)
+    pthread_mutex_t lock;
+#elif defined(HB_USE_WIN32_THREADS)
+    CRITICAL_SECTION lock;
+#endif
+};
+
+static inline void lockCache(HB_ShapeCache cache)
+{
+#if defined(HB_USE_PTHREADS)
+    pthread_mutex_lock(&cache->lock);
+#elif defined(HB_USE_WIN32_THREADS)
+    EnterCriticalSection(&cache->lock);
+#else
+    (void)cache;
+#endif
+}
+
+static inline void unlockCache(HB_ShapeCache cache)
+{
+#if defined(HB_USE_PTHREADS)
+    pthread_mutex_unlock(&cache->lock);
+#elif defined(HB_USE_WIN32_THREADS)
+    LeaveCriticalSection(&cache->lock);
+#else
+    (void)cache;
+#endif
+}
+
+#define HB_SHAPE_CACHE_INITIAL_BUCKETS 64
+
+static inline HB_FixedPoint *entryOffsets(HB_ShapeCacheEntry *entry)
+{
+    return (HB_FixedPoint *)(entry + 1);
+}
+
+static inline HB_Fixed *entryAdvances(HB_ShapeCacheEntry *entry)
+{
+    return (HB_Fixed *)(entryOffsets(entry) + entry->num_glyphs);
+}
+
+static inline HB_Glyph *entryGlyphs(HB_ShapeCacheEntry *entry)
+{
+    return (HB_Glyph *)(entryAdvances(entry) + entry->num_glyphs);
+}
+
+static inline HB_GlyphAttributes *entryAttributes(HB_ShapeCacheEntry *entry)
+{
+    return (HB_GlyphAttributes *)(entryGlyphs(entry) + entry->num_glyphs);
+}
+
+static inline HB_UChar16 *entryText(HB_ShapeCacheEntry *entry)
+{
+    return (HB_UChar16 *)(entryAttributes(entry) + entry->num_glyphs);
+}
+
+static inline unsigned short *entryLogClusters(HB_ShapeCacheEntry *entry)
+{
+    return (unsigned short *)(entryText(entry) + entry->length);
+}
+
+static hb_uint32 hashWord(const HB_ShaperItem *word)
+{
+    const HB_UChar16 *text = word->string + word->item.pos;
+    hb_uint32 h = 2166136261u;
+
+    h = (h ^ (hb_uint32)word->item.script) * 16777619u;
+    h = (h ^ (hb_uint32)word->context->language) * 16777619u;
+    h = (h ^ (hb_uint32)word->shaperFlags) * 16777619u;
+    h = (h ^ (hb_uint32)word->font->x_ppem) * 16777619u;
+    h = (h ^ (hb_uint32)word->font->x_scale) * 16777619u;
+    for (hb_uint32 i = 0; i < word->item.length; ++i)
+        h = (h ^ text[i]) * 16777619u;
+    return h;
+}
+
+static bool entryMatches(HB_ShapeCacheEntry *entry, const HB_ShaperItem *word, hb_uint32 hash)
+{
+    return entry->hash == hash
+        && entry->face == word->face
+        && entry->font == word->font
+        && entry->x_ppem == word->font->x_ppem
+        && entry->y_ppem == word->font->y_ppem
+        && entry->x_scale == word->font->x_scale
+        && entry->y_scale == word->font->y_scale
+        && entry->script == (int)word->item.script
+        && entry->language == word->context->language
+        && entry->flags == word->shaperFlags
+        && entry->rightToLeft == (int)(word->item.bidiLevel % 2)
+        && entry->length == word->item.length
+        && !memcmp(entryText(entry), word->string + word->item.pos, word->item.length * sizeof(HB_UChar16));
+}
+
+static HB_ShapeCacheEntry *findEntry(HB_ShapeCache cache, const HB_ShaperItem *word, hb_uint32 hash)
+{
+    HB_ShapeCacheEntry *entry = cache->buckets[hash & (cache->numBuckets - 1)];
+    while (entry && !entryMatches(entry, word, hash))
+        entry = entry->chain;
+    return entry;
+}
+
+static void unlinkEntry(HB_ShapeCache cache, HB_ShapeCacheEntry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache->first = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache->last = entry->prev;
+}
+
+static void linkEntry(HB_ShapeCache cache, HB_ShapeCacheEntry *entry)
+{
+    entry->prev = 0;
+    entry->next = cache->first;
+    if (cache->first)
+        cache->first->prev = entry;
+    else
+        cache->last = entry;
+    cache->first = entry;
+}
+
+static void removeEntry(HB_ShapeCache cache, HB_ShapeCacheEntry *entry)
+{
+    HB_ShapeCacheEntry **link = cache->buckets + (entry->hash & (cache->numBuckets - 1));
+    while (*link != entry)
+        link = &(*link)->chain;
+    *link = entry->chain;
+
+    unlinkEntry(cache, entry);
+    cache->size -= entry->size;
+    --cache->count;
+    free(entry);
+}
+
+static void growBuckets(HB_ShapeCache cache)
+{
+    hb_uint32 numBuckets = cache->numBuckets * 2;
+    HB_ShapeCacheEntry **buckets = (HB_ShapeCacheEntry **)calloc(numBuckets, sizeof(HB_ShapeCacheEntry *));
+    if (!buckets)
+        return; // longer chains, but still correct
+
+    for (HB_ShapeCacheEntry *entry = cache->first; entry; entry = entry->next) {
+        HB_ShapeCacheEntry **bucket = buckets + (entry->hash & (numBuckets - 1));
+        entry->chain = *bucket;
+        *bucket = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->numBuckets = numBuckets;
+}
+
+HB_ShapeCache HB_NewShapeCache(hb_uint32 maxBytes)
+{
+    HB_ShapeCache cache = (HB_ShapeCache)malloc(sizeof(HB_ShapeCacheRec_));
+    if (!cache)
+        return 0;
+    cache->buckets = (HB_ShapeCacheEntry **)calloc(HB_SHAPE_CACHE_INITIAL_BUCKETS, sizeof(HB_ShapeCacheEntry *));
+    if (!cache->buckets) {
+        free(cache);
+        return 0;
+    }
+    cache->numBuckets = HB_SHAPE_CACHE_INITIAL_BUCKETS;
+    cache->count = 0;
+    cache->size = 0;
+    cache->maxSize = maxBytes;
+    cache->first = cache->last = 0;
+#if defined(HB_USE_PTHREADS)
+    pthread_mutex_init(&cache->lock, 0);
+#elif defined(HB_USE_WIN32_THREADS)
+    InitializeCriticalSection(&cache->lock);
+#endif
+    return cache;
+}
+
+void HB_FreeShapeCache(HB_ShapeCache cache)
+{
+    if (!cache)
+        return;
+    while (cache->first) {
+        HB_ShapeCacheEntry *entry = cache->first;
+        cache->first = entry->next;
+        free(entry);
+    }
+#if defined(HB_USE_PTHREADS)
+    pthread_mutex_destroy(&cache->lock);
+#elif defined(HB_USE_WIN32_THREADS)
+    DeleteCriticalSection(&cache->lock);
+#endif
+    free(cache->buckets);
+    free(cache);
+}
+
+HB_Bool HB_ShapeCacheLookup(HB_ShapeCache cache, HB_ShaperItem *word)
+{
+    hb_uint32 hash = hashWord(word);
+    HB_Bool found = false;
+
+    lockCache(cache);
+    HB_ShapeCacheEntry *entry = findEntry(cache, word, hash);
+    if (entry && entry->num_glyphs <= word->num_glyphs) {
+        hb_uint32 n = entry->num_glyphs;
+        memcpy(word->glyphs, entryGlyphs(entry), n * sizeof(HB_Glyph));
+        memcpy(word->attributes, entryAttributes(entry), n * sizeof(HB_GlyphAttributes));
+        memcpy(word->advances, entryAdvances(entry), n * sizeof(HB_Fixed));
+        memcpy(word->offsets, entryOffsets(entry), n * sizeof(HB_FixedPoint));
+        memcpy(word->log_clusters, entryLogClusters(entry), entry->length * sizeof(unsigned short));
+        word->num_glyphs = n;
+        word->kerning_applied = entry->kerning_applied;
+        found = true;
+
+        unlinkEntry(cache, entry);
+        linkEntry(cache, entry);
+    }
+    unlockCache(cache);
+    return found;
+}
+
+void HB_ShapeCacheInsert(HB_ShapeCache cache, const HB_ShaperItem *word)
+{
+    hb_uint32 n = word->num_glyphs;
+    hb_uint32 size = sizeof(HB_ShapeCacheEntry)
+                     + n * (sizeof(HB_FixedPoint) + sizeof(HB_Fixed) + sizeof(HB_Glyph) + sizeof(HB_GlyphAttributes))
+                     + word->item.length * (sizeof(HB_UChar16) + sizeof(unsigned short));
+    if (size > cache->maxSize)
+        return;
+
+    // fill in the entry before taking the lock
+    HB_ShapeCacheEntry *entry = (HB_ShapeCacheEntry *)malloc(size);
+    if (!entry)
+        return;
+    entry->hash = hashWord(word);
+    entry->size = size;
+    entry->face = word->face;
+    entry->font = word->font;
+    entry->x_ppem = word->font->x_ppem;
+    entry->y_ppem = word->font->y_ppem;
+    entry->x_scale = word->font->x_scale;
+    entry->y_scale = word->font->y_scale;
+    entry->script = word->item.script;
+    entry->language = word->context->language;
+    entry->flags = word->shaperFlags;
+    entry->rightToLeft = word->item.bidiLevel % 2;
+    entry->length = word->item.length;
+    entry->num_glyphs = n;
+    entry->kerning_applied = word->kerning_applied;
+    memcpy(entryOffsets(entry), word->offsets, n * sizeof(HB_FixedPoint));
+    memcpy(entryAdvances(entry), word->advances, n * sizeof(HB_Fixed));
+    memcpy(entryGlyphs(entry), word->glyphs, n * sizeof(HB_Glyph));
+    memcpy(entryAttributes(entry), word->attributes, n * sizeof(HB_GlyphAttributes));
+    memcpy(entryText(entry), word->string + word->item.pos, entry->length * sizeof(HB_UChar16));
+    memcpy(entryLogClusters(entry), word->log_clusters, entry->length * sizeof(unsigned short));
+
+    lockCache(cache);
+    if (findEntry(cache, word, entry->hash)) {
+        // another thread shaped the same word in the meantime
+        free(entry);
+    } else {
+        while (cache->last && cache->size + size > cache->maxSize)
+            removeEntry(cache, cache->last);
+        if (cache->count >= cache->numBuckets)
+            growBuckets(cache);
+
+        HB_ShapeCacheEntry **bucket = cache->buckets + (entry->hash & (cache->numBuckets - 1));
+        entry->chain = *bucket;
+        *bucket = entry;
+        linkEntry(cache, entry);
+        cache->size += size;
+        ++cache->count;
+    }
+    unlockCache(cache);
+}
+
+void HB_ShapeCacheRemoveFace(HB_ShapeCache cache, HB_Face face)
+{
+    lockCache(cache);
+    HB_ShapeCacheEntry *entry = cache->first;
+    while (entry) {
+        HB_ShapeCacheEntry *next = entry->next;
+        if (entry->face == face)
+            removeEntry(cache, entry);
+        entry = next;
+    }
+    unlockCache(cache);
+}
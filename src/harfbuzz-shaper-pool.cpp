@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies)
+ *
+ * This is part of HarfBuzz, an OpenType Layout engine library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "harfbuzz-shaper.h"
+#include "harfbuzz-shaper-private.h"
+
+#if !defined(_WIN32) && !defined(HB_NO_THREADS)
+#define HB_USE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------
+//
+// Batch shaping
+//
+// Every worker owns a range of the items array and a shaping context. It takes items from the front
+// of its own range, and once that is empty steals the back half of the range of another worker. The
+// thread calling HB_ShapeItems() works as the first worker.
+//
+// -----------------------------------------------------------------------------------------------------
+
+struct HB_ShaperWorker {
+    HB_ShaperPool pool;
+    HB_ShapeContext context;
+    hb_uint32 begin;
+    hb_uint32 end;
+    HB_Bool failed;
+#ifdef HB_USE_PTHREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+#endif
+};
+
+struct HB_ShaperPoolRec_ {
+    int numWorkers;
+    HB_ShaperWorker *workers;
+    HB_ShaperItem *items;
+#ifdef HB_USE_PTHREADS
+    pthread_mutex_t callLock; // one HB_ShapeItems() call at a time
+    pthread_mutex_t jobLock;
+    pthread_cond_t jobStarted;
+    pthread_cond_t jobDone;
+    unsigned int generation;
+    int busyWorkers;
+    HB_Bool quit;
+#endif
+};
+
+static HB_Bool takeItem(HB_ShaperWorker *worker, hb_uint32 *index)
+{
+    HB_Bool found = false;
+#ifdef HB_USE_PTHREADS
+    pthread_mutex_lock(&worker->lock);
+#endif
+    if (worker->begin < worker->end) {
+        *index = worker->begin++;
+        found = true;
+    }
+#ifdef HB_USE_PTHREADS
+    pthread_mutex_unlock(&worker->lock);
+#endif
+    return found;
+}
+
+#ifdef HB_USE_PTHREADS
+static HB_Bool stealItems(HB_ShaperWorker *thief)
+{
+    HB_ShaperPool pool = thief->pool;
+    int self = thief - pool->workers;
+
+    for (int i = 1; i < pool->numWorkers; ++i) {
+        HB_ShaperWorker *victim = pool->workers + (self + i) % pool->numWorkers;
+        hb_uint32 begin = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end) {
+            begin = victim->begin + (victim->end - victim->begin) / 2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            // our own range is empty, so nobody steals from us in between
+            pthread_mutex_lock(&thief->lock);
+            thief->begin = begin;
+            thief->end = end;
+            pthread_mutex_unlock(&thief->lock);
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+static void runWorker(HB_ShaperWorker *worker)
+{
+    HB_ShaperItem *items = worker->pool->items;
+    hb_uint32 index;
+
+    for (;;) {
+        if (!takeItem(worker, &index)) {
+#ifdef HB_USE_PTHREADS
+            if (stealItems(worker))
+                continue;
+#endif
+            break;
+        }
+        if (!HB_ShapeItemInContext(items + index, worker->context))
+            worker->failed = true;
+    }
+}
+
+#ifdef HB_USE_PTHREADS
+static void *workerThread(void *data)
+{
+    HB_ShaperWorker *worker = (HB_ShaperWorker *)data;
+    HB_ShaperPool pool = worker->pool;
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&pool->jobLock);
+    for (;;) {
+        while (!pool->quit && pool->generation == generation)
+            pthread_cond_wait(&pool->jobStarted, &pool->jobLock);
+        if (pool->quit)
+            break;
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->jobLock);
+
+        runWorker(worker);
+
+        pthread_mutex_lock(&pool->jobLock);
+        if (--pool->busyWorkers == 0)
+            pthread_cond_signal(&pool->jobDone);
+    }
+    pthread_mutex_unlock(&pool->jobLock);
+    return 0;
+}
+#endif
+
+HB_ShaperPool HB_NewShaperPool(int numThreads)
+{
+#ifdef HB_USE_PTHREADS
+    if (numThreads <= 0)
+        numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (numThreads <= 0)
+        numThreads = 1;
+#ifndef HB_USE_PTHREADS
+    numThreads = 1;
+#endif
+
+    HB_ShaperPool pool = (HB_ShaperPool)malloc(sizeof(HB_ShaperPoolRec_));
+    if (!pool)
+        return 0;
+    pool->items = 0;
+    pool->workers = (HB_ShaperWorker *)calloc(numThreads, sizeof(HB_ShaperWorker));
+    if (!pool->workers) {
+        free(pool);
+        return 0;
+    }
+
+#ifdef HB_USE_PTHREADS
+    pthread_mutex_init(&pool->callLock, 0);
+    pthread_mutex_init(&pool->jobLock, 0);
+    pthread_cond_init(&pool->jobStarted, 0);
+    pthread_cond_init(&pool->jobDone, 0);
+    pool->generation = 0;
+    pool->busyWorkers = 0;
+    pool->quit = false;
+#endif
+
+    pool->numWorkers = 0;
+    for (int i = 0; i < numThreads; ++i) {
+        HB_ShaperWorker *worker = pool->workers + i;
+        worker->pool = pool;
+        worker->context = HB_NewShapeContext();
+        if (!worker->context)
+            break;
+#ifdef HB_USE_PTHREADS
+        pthread_mutex_init(&worker->lock, 0);
+        // worker 0 is the calling thread
+        if (i > 0 && pthread_create(&worker->thread, 0, workerThread, worker)) {
+            pthread_mutex_destroy(&worker->lock);
+            HB_FreeShapeContext(worker->context);
+            break;
+        }
+#endif
+        ++pool->numWorkers;
+    }
+
+    if (!pool->numWorkers) {
+        HB_FreeShaperPool(pool);
+        return 0;
+    }
+    return pool;
+}
+
+void HB_FreeShaperPool(HB_ShaperPool pool)
+{
+    if (!pool)
+        return;
+#ifdef HB_USE_PTHREADS
+    pthread_mutex_lock(&pool->jobLock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->jobStarted);
+    pthread_mutex_unlock(&pool->jobLock);
+#endif
+    for (int i = 0; i < pool->numWorkers; ++i) {
+        HB_ShaperWorker *worker = pool->workers + i;
+#ifdef HB_USE_PTHREADS
+        if (i > 0)
+            pthread_join(worker->thread, 0);
+        pthread_mutex_destroy(&worker->lock);
+#endif
+        HB_FreeShapeContext(worker->context);
+    }
+#ifdef HB_USE_PTHREADS
+    pthread_cond_destroy(&pool->jobDone);
+    pthread_cond_destroy(&pool->jobStarted);
+    pthread_mutex_destroy(&pool->jobLock);
+    pthread_mutex_destroy(&pool->callLock);
+#endif
+    free(pool->workers);
+    free(pool);
+}
+
+HB_Bool HB_ShapeItems(HB_ShaperItem *items, hb_uint32 count, HB_ShaperPool pool)
+{
+    HB_Bool result = true;
+
+    if (!pool) {
+        for (hb_uint32 i = 0; i < count; ++i) {
+            if (!HB_ShapeItem(items + i))
+                result = false;
+        }
+        return result;
+    }
+
+#ifdef HB_USE_PTHREADS
+    pthread_mutex_lock(&pool->callLock);
+#endif
+
+    pool->items = items;
+    for (int i = 0; i < pool->numWorkers; ++i) {
+        HB_ShaperWorker *worker = pool->workers + i;
+        worker->begin = (hb_uint32)((unsigned long long)count * i / pool->numWorkers);
+        worker->end = (hb_uint32)((unsigned long long)count * (i + 1) / pool->numWorkers);
+        worker->failed = false;
+    }
+
+#ifdef HB_USE_PTHREADS
+    if (pool->numWorkers > 1 && count > 1) {
+        pthread_mutex_lock(&pool->jobLock);
+        pool->busyWorkers = pool->numWorkers - 1;
+        ++pool->generation;
+        pthread_cond_broadcast(&pool->jobStarted);
+        pthread_mutex_unlock(&pool->jobLock);
+
+        runWorker(pool->workers);
+
+        pthread_mutex_lock(&pool->jobLock);
+        while (pool->busyWorkers)
+            pthread_cond_wait(&pool->jobDone, &pool->jobLock);
+        pthread_mutex_unlock(&pool->jobLock);
+    } else
+#endif
+    {
+        pool->workers[0].begin = 0;
+        pool->workers[0].end = count;
+        for (int i = 1; i < pool->numWorkers; ++i)
+            pool->workers[i].begin = pool->workers[i].end = 0;
+        runWorker(pool->workers);
+    }
+
+    for (int i = 0; i < pool->numWorkers; ++i) {
+        if (pool->workers[i].failed)
+            result = false;
+    }
+    pool->items = 0;
+
+#ifdef HB_USE_PTHREADS
+    pthread_mutex_unlock(&pool->callLock);
+#endif
+    return result;
+}
@@ -125,6 +125,20 @@ typedef struct {
 
 #define PositioningProperties 0x80000000
 
+struct HB_ShapePlanRec_ {
+    struct HB_ShapePlanRec_ *next;
+
+    /* key */
+    HB_Script script;
+    HB_UInt language; /* OpenType language tag, 0 for the default language system */
+    int flags; /* HB_ShaperFlags */
+    const HB_OpenTypeFeature *features; /* compared by contents, see sameFeatures() */
+
+    HB_Bool has_opentype_kerning;
+    HB_LookupPlan gsub_plan;
+    HB_LookupPlan gpos_plan;
+};
+
 HB_Bool HB_SelectScript(HB_ShaperItem *item, const HB_OpenTypeFeature *features);
 
 HB_Bool HB_OpenTypeShape(HB_ShaperItem *item, const hb_uint32 *properties);
@@ -140,11 +154,22 @@ void HB_HeuristicSetGlyphAttributes(HB_ShaperItem *item);
 
 HB_Bool HB_ConvertStringToGlyphIndices(HB_ShaperItem *shaper_item);
 
+/* Makes room for needed glyphs when the item is shaped into a glyph run, keeping the first
+ * keep glyphs and clearing the attributes and offsets after them. Returns false if the item
+ * has no run, the shaper then has to ask the caller for more glyphs. Items made up by a
+ * shaper to shape a part of its item (syllables, words) have no run.
+ */
+HB_Bool HB_GrowGlyphRun(HB_ShaperItem *item, hb_uint32 keep, hb_uint32 needed);
+
+HB_Bool HB_ShapeCacheLookup(HB_ShapeCache cache, HB_ShaperItem *word);
+void HB_ShapeCacheInsert(HB_ShapeCache cache, const HB_ShaperItem *word);
+void HB_ShapeCacheRemoveFace(HB_ShapeCache cache, HB_Face face);
+
 #define HB_GetGlyphAdvances(shaper_item) \
     shaper_item->font->klass->getGlyphAdvances(shaper_item->font, \
                                                shaper_item->glyphs, shaper_item->num_glyphs, \
                                                shaper_item->advances, \
-                                               shaper_item->face->current_flags);
+                                               shaper_item->context->current_flags);
 
 #define HB_DECLARE_STACKARRAY(Type, Name) \
     Type stack##Name[512]; \
@@ -922,32 +922,75 @@ static HB_Bool checkScript(HB_Face face, int script)
     return true;
 }
 
-static HB_Stream getTableStream(void *font, HB_GetFontTableFunc tableFunc, HB_Tag tag)
+// The stream reads the blob data in place; it takes over the blob and destroys it when closed,
+// also if opening the stream fails.
+static HB_Stream openBlobStream(const HB_BlobRec *blob)
+{
+    HB_Stream stream = (HB_Stream)malloc(sizeof(HB_StreamRec));
+    if (!stream) {
+        if (blob->destroy)
+            blob->destroy(blob->user_data);
+        return 0;
+    }
+
+    // the stream never writes to its data
+    stream->base = (HB_Byte *)blob->data;
+    stream->size = blob->length;
+    stream->pos = 0;
+    stream->cursor = 0;
+    stream->destroy = blob->destroy;
+    stream->user_data = blob->user_data;
+    stream->arena = 0;
+    return stream;
+}
+
+static HB_Stream getTableStream(void *font, HB_GetFontTableFunc tableFunc, HB_GetFontTableBlobFunc blobFunc, HB_Tag tag)
 {
     HB_Error error;
-    HB_UInt length = 0;
-    HB_Stream stream = 0;
+    HB_BlobRec blob;
 
     if (!font)
         return 0;
 
+    if (blobFunc) {
+        // the font hands out its table data, no need to copy it
+        blob.destroy = 0;
+        blob.user_data = 0;
+        if (blobFunc(font, tag, &blob))
+            return 0;
+        return openBlobStream(&blob);
+    }
+
+    HB_UInt length = 0;
     error = tableFunc(font, tag, 0, &length);
     if (error)
         return 0;
-    stream = (HB_Stream)malloc(sizeof(HB_StreamRec));
-    stream->base = (HB_Byte*)malloc(length);
-    error = tableFunc(font, tag, stream->base, &length);
+    HB_Byte *data = (HB_Byte *)malloc(length);
+    if (!data)
+        return 0;
+    error = tableFunc(font, tag, data, &length);
     if (error) {
-        _hb_close_stream(stream);
+        free(data);
         return 0;
     }
-    stream->size = length;
-    stream->pos = 0;
-    stream->cursor = NULL;
-    return stream;
+    blob.data = data;
+    blob.length = length;
+    blob.destroy = free;
+    blob.user_data = data;
+    return openBlobStream(&blob);
 }
 
-HB_Face HB_NewFace(void *font, HB_GetFontTableFunc tableFunc)
+static void freeShapePlan(HB_ShapePlan plan)
+{
+    HB_Done_LookupPlan(&plan->gsub_plan);
+    HB_Done_LookupPlan(&plan->gpos_plan);
+    free(plan);
+}
+
+// the contexts remember the face of their plan by address and serial, see HB_SelectScript
+static hb_uint32 faceSerials = 0;
+
+static HB_Face newFace(void *font, HB_GetFontTableFunc tableFunc, HB_GetFontTableBlobFunc blobFunc)
 {
     HB_Face face = (HB_Face )malloc(sizeof(HB_FaceRec));
 
@@ -955,25 +998,19 @@ HB_Face HB_NewFace(void *font, HB_GetFontTableFunc tableFunc)
     face->gdef = 0;
     face->gpos = 0;
     face->gsub = 0;
-    face->current_script = HB_ScriptCount;
-    face->current_flags = HB_ShaperFlag_Default;
-    face->has_opentype_kerning = false;
-    face->tmpAttributes = 0;
-    face->tmpLogClusters = 0;
-    face->glyphs_substituted = false;
 
     HB_Error error;
     HB_Stream stream;
     HB_Stream gdefStream;
 
-    gdefStream = getTableStream(font, tableFunc, TTAG_GDEF);
+    gdefStream = getTableStream(font, tableFunc, blobFunc, TTAG_GDEF);
     if (!gdefStream || (error = HB_Load_GDEF_Table(gdefStream, &face->gdef))) {
         //DEBUG("error loading gdef table: %d", error);
         face->gdef = 0;
     }
 
     //DEBUG() << "trying to load gsub table";
-    stream = getTableStream(font, tableFunc, TTAG_GSUB);
+    stream = getTableStream(font, tableFunc, blobFunc, TTAG_GSUB);
     if (!stream || (error = HB_Load_GSUB_Table(stream, &face->gsub, face->gdef, gdefStream))) {
         face->gsub = 0;
         if (error != HB_Err_Not_Covered) {
@@ -984,7 +1021,7 @@ HB_Face HB_NewFace(void *font, HB_GetFontTableFunc tableFunc)
     }
     _hb_close_stream(stream);
 
-    stream = getTableStream(font, tableFunc, TTAG_GPOS);
+    stream = getTableStream(font, tableFunc, blobFunc, TTAG_GPOS);
     if (!stream || (error = HB_Load_GPOS_Table(stream, &face->gpos, face->gdef, gdefStream))) {
         face->gpos = 0;
         DEBUG("error loading gpos table: %d", error);
@@ -996,11 +1033,24 @@ HB_Face HB_NewFace(void *font, HB_GetFontTableFunc tableFunc)
     for (unsigned int i = 0; i < HB_ScriptCount; ++i)
         face->supported_scripts[i] = checkScript(face, i);
 
-    hb_buffer_new(&face->buffer);
+    face->plans = 0;
+    face->context = HB_NewShapeContext();
+    face->cache = 0;
+    face->serial = HB_AtomicIncrement(&faceSerials);
 
     return face;
 }
 
+HB_Face HB_NewFace(void *font, HB_GetFontTableFunc tableFunc)
+{
+    return newFace(font, tableFunc, 0);
+}
+
+HB_Face HB_NewFaceFromBlobs(void *font, HB_GetFontTableBlobFunc blobFunc)
+{
+    return newFace(font, 0, blobFunc);
+}
+
 void HB_FreeFace(HB_Face face)
 {
     if (!face)
@@ -1011,28 +1061,77 @@ void HB_FreeFace(HB_Face face)
         HB_Done_GSUB_Table(face->gsub);
     if (face->gdef)
         HB_Done_GDEF_Table(face->gdef);
-    if (face->buffer)
-        hb_buffer_free(face->buffer);
-    if (face->tmpAttributes)
-        free(face->tmpAttributes);
-    if (face->tmpLogClusters)
-        free(face->tmpLogClusters);
+    HB_FreeShapeContext(face->context);
+    if (face->cache)
+        HB_ShapeCacheRemoveFace(face->cache, face);
+    while (face->plans) {
+        HB_ShapePlan plan = face->plans;
+        face->plans = plan->next;
+        freeShapePlan(plan);
+    }
     free(face);
 }
 
-HB_Bool HB_SelectScript(HB_ShaperItem *shaper_item, const HB_OpenTypeFeature *features)
+HB_ShapeContext HB_NewShapeContext(void)
 {
-    HB_Script script = shaper_item->item.script;
+    HB_ShapeContext context = (HB_ShapeContext)malloc(sizeof(HB_ShapeContextRec));
+    if (!context)
+        return 0;
 
-    if (!shaper_item->face->supported_scripts[script])
-        return false;
+    context->face = 0;
+    context->face_serial = 0;
+    context->language = 0;
+    context->error = HB_Err_Ok;
+    context->current_script = HB_ScriptCount;
+    context->current_language = 0;
+    context->current_flags = HB_ShaperFlag_Default;
+    context->plan = 0;
+    context->glyphs_substituted = false;
+    context->tmpAttributes = 0;
+    context->tmpLogClusters = 0;
+    context->tmpAllocated = 0;
+    context->length = 0;
+    context->orig_nglyphs = 0;
+
+    if (hb_buffer_new(&context->buffer)) {
+        free(context);
+        return 0;
+    }
 
-    HB_Face face = shaper_item->face;
-    if (face->current_script == script && face->current_flags == shaper_item->shaperFlags)
-        return true;
+    return context;
+}
 
-    face->current_script = script;
-    face->current_flags = shaper_item->shaperFlags;
+void HB_FreeShapeContext(HB_ShapeContext context)
+{
+    if (!context)
+        return;
+    if (context->buffer)
+        hb_buffer_free(context->buffer);
+    if (context->tmpAttributes)
+        free(context->tmpAttributes);
+    if (context->tmpLogClusters)
+        free(context->tmpLogClusters);
+    free(context);
+}
+
+static HB_ShapePlan buildShapePlan(HB_Face face, HB_Script script, HB_UInt language, int flags, const HB_OpenTypeFeature *features)
+{
+    HB_ShapePlan plan = (HB_ShapePlan)malloc(sizeof(HB_ShapePlanRec_));
+    if (!plan)
+        return 0;
+
+    plan->next = 0;
+    plan->script = script;
+    plan->language = language;
+    plan->flags = flags;
+    plan->features = features;
+    plan->has_opentype_kerning = false;
+    plan->gsub_plan.LookupCount = 0;
+    plan->gsub_plan.Allocated = 0;
+    plan->gsub_plan.Lookup = 0;
+    plan->gpos_plan.LookupCount = 0;
+    plan->gpos_plan.Allocated = 0;
+    plan->gpos_plan.Lookup = 0;
 
     assert(script < HB_ScriptCount);
     // find script in our list of supported scripts.
@@ -1050,31 +1149,38 @@ HB_Bool HB_SelectScript(HB_ShaperItem *shaper_item, const HB_OpenTypeFeature *fe
             }
         }
 #endif
-        HB_GSUB_Clear_Features(face->gsub);
         HB_UShort script_index;
         HB_Error error = HB_GSUB_Select_Script(face->gsub, tag, &script_index);
         if (!error) {
             DEBUG("script %s has script index %d", tag_to_string(script), script_index);
+            HB_UShort language_index = HB_DEFAULT_LANGUAGE;
+            HB_UShort req_feature_index;
+            if (language && HB_GSUB_Select_Language(face->gsub, language, script_index, &language_index, &req_feature_index))
+                language_index = HB_DEFAULT_LANGUAGE;
             while (features->tag) {
                 HB_UShort feature_index;
-                error = HB_GSUB_Select_Feature(face->gsub, features->tag, script_index, 0xffff, &feature_index);
+                error = HB_GSUB_Select_Feature(face->gsub, features->tag, script_index, language_index, &feature_index);
                 if (!error) {
                     DEBUG("  adding feature %s", tag_to_string(features->tag));
-                    HB_GSUB_Add_Feature(face->gsub, feature_index, features->property);
+                    error = HB_GSUB_Plan_Add_Feature(face->gsub, &plan->gsub_plan, feature_index, features->property);
+                    if (error == HB_Err_Out_Of_Memory)
+                        goto fail;
                 }
                 ++features;
             }
+            if (HB_GSUB_Compose_Plan(face->gsub, &plan->gsub_plan) == HB_Err_Out_Of_Memory)
+                goto fail;
         }
     }
 
-    // reset
-    face->has_opentype_kerning = false;
-
     if (face->gpos) {
-        HB_GPOS_Clear_Features(face->gpos);
         HB_UShort script_index;
         HB_Error error = HB_GPOS_Select_Script(face->gpos, tag, &script_index);
         if (!error) {
+            HB_UShort language_index = HB_DEFAULT_LANGUAGE;
+            HB_UShort req_feature_index;
+            if (language && HB_GPOS_Select_Language(face->gpos, language, script_index, &language_index, &req_feature_index))
+                language_index = HB_DEFAULT_LANGUAGE;
 #ifdef OT_DEBUG
             {
                 HB_FeatureList featurelist = face->gpos->FeatureList;
@@ -1083,27 +1189,31 @@ HB_Bool HB_SelectScript(HB_ShaperItem *shaper_item, const HB_OpenTypeFeature *fe
                 for(int i = 0; i < numfeatures; i++) {
                     HB_FeatureRecord *r = featurelist.FeatureRecord + i;
                     HB_UShort feature_index;
-                    HB_GPOS_Select_Feature(face->gpos, r->FeatureTag, script_index, 0xffff, &feature_index);
+                    HB_GPOS_Select_Feature(face->gpos, r->FeatureTag, script_index, language_index, &feature_index);
                     DEBUG("   feature '%s'", tag_to_string(r->FeatureTag));
                 }
             }
 #endif
             HB_UInt *feature_tag_list_buffer;
-            error = HB_GPOS_Query_Features(face->gpos, script_index, 0xffff, &feature_tag_list_buffer);
+            error = HB_GPOS_Query_Features(face->gpos, script_index, language_index, &feature_tag_list_buffer);
             if (!error) {
                 HB_UInt *feature_tag_list = feature_tag_list_buffer;
                 while (*feature_tag_list) {
                     HB_UShort feature_index;
                     if (*feature_tag_list == HB_MAKE_TAG('k', 'e', 'r', 'n')) {
-                        if (face->current_flags & HB_ShaperFlag_NoKerning) {
+                        if (flags & HB_ShaperFlag_NoKerning) {
                             ++feature_tag_list;
                             continue;
                         }
-                        face->has_opentype_kerning = true;
+                        plan->has_opentype_kerning = true;
                     }
-                    error = HB_GPOS_Select_Feature(face->gpos, *feature_tag_list, script_index, 0xffff, &feature_index);
+                    error = HB_GPOS_Select_Feature(face->gpos, *feature_tag_list, script_index, language_index, &feature_index);
                     if (!error)
-                        HB_GPOS_Add_Feature(face->gpos, feature_index, PositioningProperties);
+                        error = HB_GPOS_Plan_Add_Feature(face->gpos, &plan->gpos_plan, feature_index, PositioningProperties);
+                    if (error == HB_Err_Out_Of_Memory) {
+                        FREE(feature_tag_list_buffer);
+                        goto fail;
+                    }
                     ++feature_tag_list;
                 }
                 FREE(feature_tag_list_buffer);
@@ -1111,6 +1221,96 @@ HB_Bool HB_SelectScript(HB_ShaperItem *shaper_item, const HB_OpenTypeFeature *fe
         }
     }
 
+    return plan;
+
+fail:
+    freeShapePlan(plan);
+    return 0;
+}
+
+// the feature lists of the shapers are static tables, but two shapers may use equal ones
+static bool sameFeatures(const HB_OpenTypeFeature *a, const HB_OpenTypeFeature *b)
+{
+    if (a == b)
+        return true;
+    for (; a->tag == b->tag && a->property == b->property; ++a, ++b) {
+        if (!a->tag)
+            return true;
+    }
+    return false;
+}
+
+static HB_ShapePlan findShapePlan(HB_ShapePlan plan, HB_ShapePlan end, HB_Script script, HB_UInt language, int flags, const HB_OpenTypeFeature *features)
+{
+    for (; plan != end; plan = plan->next) {
+        if (plan->script == script && plan->language == language
+            && plan->flags == flags && sameFeatures(plan->features, features))
+            return plan;
+    }
+    return 0;
+}
+
+/* Returns the plan for the given key, building and adding it to the face's
+ * plan cache if it doesn't exist yet. Safe to call from several threads with
+ * the same face.
+ */
+static HB_ShapePlan shapePlan(HB_Face face, HB_Script script, HB_UInt language, int flags, const HB_OpenTypeFeature *features)
+{
+    HB_ShapePlan head = (HB_ShapePlan)HB_AtomicLoadPtr(&face->plans);
+    HB_ShapePlan plan = findShapePlan(head, 0, script, language, flags, features);
+    if (plan)
+        return plan;
+
+    plan = buildShapePlan(face, script, language, flags, features);
+    if (!plan)
+        return 0;
+
+    for (;;) {
+        plan->next = head;
+        HB_MemoryBarrier();
+        if (HB_AtomicTestAndSetPtr(&face->plans, head, plan))
+            return plan;
+
+        // another thread added plans in the meantime, it might have built the same one
+        HB_ShapePlan oldHead = head;
+        head = (HB_ShapePlan)HB_AtomicLoadPtr(&face->plans);
+        HB_ShapePlan other = findShapePlan(head, oldHead, script, language, flags, features);
+        if (other) {
+            freeShapePlan(plan);
+            return other;
+        }
+    }
+}
+
+HB_Bool HB_SelectScript(HB_ShaperItem *shaper_item, const HB_OpenTypeFeature *features)
+{
+    HB_Script script = shaper_item->item.script;
+
+    if (!shaper_item->face->supported_scripts[script])
+        return false;
+
+    HB_Face face = shaper_item->face;
+    HB_ShapeContext context = shaper_item->context;
+    if (context->plan && context->face == face && context->face_serial == face->serial
+        && context->current_script == script
+        && context->current_language == context->language
+        && context->current_flags == shaper_item->shaperFlags && sameFeatures(context->plan->features, features))
+        return true;
+
+    HB_ShapePlan plan = shapePlan(face, script, context->language, shaper_item->shaperFlags, features);
+    if (!plan) {
+        // only fails when memory runs out
+        context->error = HB_Err_Out_Of_Memory;
+        return false;
+    }
+
+    context->face = face;
+    context->face_serial = face->serial;
+    context->current_script = script;
+    context->current_language = context->language;
+    context->current_flags = shaper_item->shaperFlags;
+    context->plan = plan;
+
     return true;
 }
 
@@ -1118,17 +1318,39 @@ HB_Bool HB_OpenTypeShape(HB_ShaperItem *item, const hb_uint32 *properties)
 {
 
     HB_Face face = item->face;
+    HB_ShapeContext context = item->context;
+
+    context->length = item->num_glyphs;
+
+    hb_buffer_clear(context->buffer);
+
+    // the context keeps its buffer and scratch arrays, so once it has shaped an item of
+    // this length, shaping allocates nothing
+    if (context->length > context->tmpAllocated) {
+        int allocated = context->tmpAllocated + (context->tmpAllocated >> 1) + 8;
+        if (allocated < context->length)
+            allocated = context->length;
+        HB_GlyphAttributes *attributes = (HB_GlyphAttributes *) realloc(context->tmpAttributes, allocated*sizeof(HB_GlyphAttributes));
+        if (attributes)
+            context->tmpAttributes = attributes;
+        unsigned int *logClusters = (unsigned int *) realloc(context->tmpLogClusters, allocated*sizeof(unsigned int));
+        if (logClusters)
+            context->tmpLogClusters = logClusters;
+        if (!attributes || !logClusters) {
+            context->error = HB_Err_Out_Of_Memory;
+            return false;
+        }
+        context->tmpAllocated = allocated;
+    }
+    if (hb_buffer_reserve(context->buffer, context->length)) {
+        context->error = HB_Err_Out_Of_Memory;
+        return false;
+    }
 
-    face->length = item->num_glyphs;
-
-    hb_buffer_clear(face->buffer);
-
-    face->tmpAttributes = (HB_GlyphAttributes *) realloc(face->tmpAttributes, face->length*sizeof(HB_GlyphAttributes));
-    face->tmpLogClusters = (unsigned int *) realloc(face->tmpLogClusters, face->length*sizeof(unsigned int));
-    for (int i = 0; i < face->length; ++i) {
-        hb_buffer_add_glyph(face->buffer, item->glyphs[i], properties ? properties[i] : 0, i);
-        face->tmpAttributes[i] = item->attributes[i];
-        face->tmpLogClusters[i] = item->log_clusters[i];
+    for (int i = 0; i < context->length; ++i) {
+        hb_buffer_add_glyph(context->buffer, item->glyphs[i], properties ? properties[i] : 0, i);
+        context->tmpAttributes[i] = item->attributes[i];
+        context->tmpLogClusters[i] = item->log_clusters[i];
     }
 
 #ifdef OT_DEBUG
@@ -1142,12 +1364,14 @@ HB_Bool HB_OpenTypeShape(HB_ShaperItem *item, const hb_uint32 *properties)
 //     dump_string(hb_buffer);
 #endif
 
-    face->glyphs_substituted = false;
+    context->glyphs_substituted = false;
     if (face->gsub) {
-        unsigned int error = HB_GSUB_Apply_String(face->gsub, face->buffer);
+        unsigned int error = HB_GSUB_Apply_Plan(face->gsub, &context->plan->gsub_plan, context->buffer);
+        if (error == HB_Err_Out_Of_Memory)
+            context->error = HB_Err_Out_Of_Memory;
         if (error && error != HB_Err_Not_Covered)
             return false;
-        face->glyphs_substituted = (error != HB_Err_Not_Covered);
+        context->glyphs_substituted = (error != HB_Err_Not_Covered);
     }
 
 #ifdef OT_DEBUG
@@ -1167,46 +1391,57 @@ HB_Bool HB_OpenTypeShape(HB_ShaperItem *item, const hb_uint32 *properties)
 HB_Bool HB_OpenTypePosition(HB_ShaperItem *item, int availableGlyphs, HB_Bool doLogClusters)
 {
     HB_Face face = item->face;
+    HB_ShapeContext context = item->context;
+
+    // HB_OpenTypeShape ran out of memory, the buffer doesn't hold the item
+    if (context->error)
+        return false;
 
     bool glyphs_positioned = false;
     if (face->gpos) {
-        if (face->buffer->positions)
-            memset(face->buffer->positions, 0, face->buffer->in_length*sizeof(HB_PositionRec));
+        if (context->buffer->positions)
+            memset(context->buffer->positions, 0, context->buffer->in_length*sizeof(HB_PositionRec));
         // #### check that passing "false,false" is correct
-        glyphs_positioned = HB_GPOS_Apply_String(item->font, face->gpos, face->current_flags, face->buffer, false, false) != HB_Err_Not_Covered;
+        HB_Error error = HB_GPOS_Apply_Plan(item->font, face->gpos, &context->plan->gpos_plan, context->current_flags, context->buffer, false, false);
+        if (error == HB_Err_Out_Of_Memory) {
+            context->error = error;
+            return false;
+        }
+        glyphs_positioned = error != HB_Err_Not_Covered;
     }
 
-    if (!face->glyphs_substituted && !glyphs_positioned) {
+    if (!context->glyphs_substituted && !glyphs_positioned) {
         HB_GetGlyphAdvances(item);
         return true; // nothing to do for us
     }
 
     // make sure we have enough space to write everything back
-    if (availableGlyphs < (int)face->buffer->in_length) {
-        item->num_glyphs = face->buffer->in_length;
+    if (availableGlyphs < (int)context->buffer->in_length
+        && !HB_GrowGlyphRun(item, 0, context->buffer->in_length)) {
+        item->num_glyphs = context->buffer->in_length;
         return false;
     }
 
     HB_Glyph *glyphs = item->glyphs;
     HB_GlyphAttributes *attributes = item->attributes;
 
-    for (unsigned int i = 0; i < face->buffer->in_length; ++i) {
-        glyphs[i] = face->buffer->in_string[i].gindex;
-        attributes[i] = face->tmpAttributes[face->buffer->in_string[i].cluster];
-        if (i && face->buffer->in_string[i].cluster == face->buffer->in_string[i-1].cluster)
+    for (unsigned int i = 0; i < context->buffer->in_length; ++i) {
+        glyphs[i] = context->buffer->in_string[i].gindex;
+        attributes[i] = context->tmpAttributes[context->buffer->in_string[i].cluster];
+        if (i && context->buffer->in_string[i].cluster == context->buffer->in_string[i-1].cluster)
             attributes[i].clusterStart = false;
     }
-    item->num_glyphs = face->buffer->in_length;
+    item->num_glyphs = context->buffer->in_length;
 
-    if (doLogClusters && face->glyphs_substituted) {
+    if (doLogClusters && context->glyphs_substituted) {
         // we can't do this for indic, as we pass the stuf in syllables and it's easier to do it in the shaper.
         unsigned short *logClusters = item->log_clusters;
         int clusterStart = 0;
         int oldCi = 0;
         // #### the reconstruction of the logclusters currently does not work if the original string
         // contains surrogate pairs
-        for (unsigned int i = 0; i < face->buffer->in_length; ++i) {
-            int ci = face->buffer->in_string[i].cluster;
+        for (unsigned int i = 0; i < context->buffer->in_length; ++i) {
+            int ci = context->buffer->in_string[i].cluster;
             //         DEBUG("   ci[%d] = %d mark=%d, cmb=%d, cs=%d",
             //                i, ci, glyphAttributes[i].mark, glyphAttributes[i].combiningClass, glyphAttributes[i].clusterStart);
             if (!attributes[i].mark && attributes[i].clusterStart && ci != oldCi) {
@@ -1216,7 +1451,7 @@ HB_Bool HB_OpenTypePosition(HB_ShaperItem *item, int availableGlyphs, HB_Bool do
                 oldCi = ci;
             }
         }
-        for (int j = oldCi; j < face->length; j++)
+        for (int j = oldCi; j < context->length; j++)
             logClusters[j] = clusterStart;
     }
 
@@ -1226,11 +1461,11 @@ HB_Bool HB_OpenTypePosition(HB_ShaperItem *item, int availableGlyphs, HB_Bool do
     // positioning code:
     if (glyphs_positioned) {
         HB_GetGlyphAdvances(item);
-        HB_Position positions = face->buffer->positions;
+        HB_Position positions = context->buffer->positions;
         HB_Fixed *advances = item->advances;
 
 //         DEBUG("positioned glyphs:");
-        for (unsigned int i = 0; i < face->buffer->in_length; i++) {
+        for (unsigned int i = 0; i < context->buffer->in_length; i++) {
 //             DEBUG("    %d:\t orig advance: (%d/%d)\tadv=(%d/%d)\tpos=(%d/%d)\tback=%d\tnew_advance=%d", i,
 //                    glyphs[i].advance.x.toInt(), glyphs[i].advance.y.toInt(),
 //                    (int)(positions[i].x_advance >> 6), (int)(positions[i].y_advance >> 6),
@@ -1239,7 +1474,7 @@ HB_Bool HB_OpenTypePosition(HB_ShaperItem *item, int availableGlyphs, HB_Bool do
 
             HB_Fixed adjustment = (item->item.bidiLevel % 2) ? -positions[i].x_advance : positions[i].x_advance;
 
-            if (!(face->current_flags & HB_ShaperFlag_UseDesignMetrics))
+            if (!(context->current_flags & HB_ShaperFlag_UseDesignMetrics))
                 adjustment = HB_FIXED_ROUND(adjustment);
 
             if (positions[i].new_advance) {
@@ -1274,7 +1509,7 @@ HB_Bool HB_OpenTypePosition(HB_ShaperItem *item, int availableGlyphs, HB_Bool do
 //             DEBUG("   ->\tadv=%d\tpos=(%d/%d)",
 //                    glyphs[i].advance.x.toInt(), glyphs[i].offset.x.toInt(), glyphs[i].offset.y.toInt());
         }
-        item->kerning_applied = face->has_opentype_kerning;
+        item->kerning_applied = context->plan->has_opentype_kerning;
     } else {
         HB_HeuristicPosition(item);
     }
@@ -1297,7 +1532,124 @@ HB_Bool HB_OpenTypePosition(HB_ShaperItem *item, int availableGlyphs, HB_Bool do
     return true;
 }
 
-HB_Bool HB_ShapeItem(HB_ShaperItem *shaper_item)
+// scripts that separate words by spaces, so that an item can be shaped word by word
+static const HB_Bool spaceSeparatedScripts[HB_ScriptCount] = {
+    true,  // Common
+    true,  // Greek
+    true,  // Cyrillic
+    true,  // Armenian
+    true,  // Hebrew
+    true,  // Arabic
+    true,  // Syriac
+    true,  // Thaana
+    true,  // Devanagari
+    true,  // Bengali
+    true,  // Gurmukhi
+    true,  // Gujarati
+    true,  // Oriya
+    true,  // Tamil
+    true,  // Telugu
+    true,  // Kannada
+    true,  // Malayalam
+    true,  // Sinhala
+    false, // Thai
+    false, // Lao
+    false, // Tibetan
+    false, // Myanmar
+    true,  // Georgian
+    true,  // Hangul
+    false, // Ogham
+    true,  // Runic
+    false  // Khmer
+};
+
+// longer words are not worth keeping in the cache
+#define HB_MAX_CACHED_WORD 64
+
+// a space followed by a mark carries the mark, so it doesn't separate words
+static bool isMarkedSpace(const HB_UChar16 *string, hb_uint32 pos, hb_uint32 end)
+{
+    if (string[pos] != ' ' || pos + 1 >= end)
+        return false;
+    HB_UChar32 ch = string[pos + 1];
+    if (HB_IsHighSurrogate(ch) && pos + 2 < end && HB_IsLowSurrogate(string[pos + 2]))
+        ch = HB_SurrogateToUcs4(ch, string[pos + 2]);
+    HB_CharCategory category = HB_GetUnicodeCharCategory(ch);
+    return category >= HB_Mark_NonSpacing && category <= HB_Mark_Enclosing;
+}
+
+// Shapes the item word by word, a word being the text up to and including a run of spaces, and
+// takes the words that are bounded by spaces or the ends of the string from the cache. A space
+// with a mark on it doesn't separate words, as it makes a cluster with the mark. The shapers look
+// at the characters around an item, so a word that has other neighbours isn't the same word
+// every time; the spaces a word ends with hide the text after them. Lookups of the font that reach
+// across a space, like kerning pairs with a space or contextual lookups matching one, see only one
+// side of it, and the marks of a word the font doesn't position get the fallback positioning even
+// if the font positions other words of the item. Falls back to shaping the whole item if the words
+// don't fit into the arrays.
+static HB_Bool shapeWords(HB_ShaperItem *shaper_item)
+{
+    const HB_ShapeFunction shape = HB_ScriptEngines[shaper_item->item.script].shape;
+    HB_ShapeCache cache = shaper_item->face->cache;
+    const HB_UChar16 *string = shaper_item->string;
+    const hb_uint32 start = shaper_item->item.pos;
+    const hb_uint32 end = start + shaper_item->item.length;
+    hb_uint32 numGlyphs = 0;
+    HB_Bool kerningApplied = false;
+
+    hb_uint32 from = start;
+    while (from < end) {
+        hb_uint32 wordEnd = from;
+        while (wordEnd < end && (string[wordEnd] != ' ' || isMarkedSpace(string, wordEnd, end)))
+            ++wordEnd;
+        hb_uint32 to = wordEnd;
+        while (to < end && string[to] == ' ' && !isMarkedSpace(string, to, end))
+            ++to;
+
+        HB_ShaperItem word = *shaper_item;
+        word.run = 0;
+        word.item.pos = from;
+        word.item.length = to - from;
+        word.num_glyphs = shaper_item->num_glyphs - numGlyphs;
+        word.glyphs = shaper_item->glyphs + numGlyphs;
+        word.attributes = shaper_item->attributes + numGlyphs;
+        word.advances = shaper_item->advances + numGlyphs;
+        word.offsets = shaper_item->offsets + numGlyphs;
+        word.log_clusters = shaper_item->log_clusters + (from - start);
+        word.kerning_applied = false;
+
+        const bool cacheable = word.item.length <= HB_MAX_CACHED_WORD
+                               && (from == 0 || string[from - 1] == ' ')
+                               && (wordEnd == shaper_item->stringLength || string[wordEnd] == ' ');
+
+        if (!cacheable || !HB_ShapeCacheLookup(cache, &word)) {
+            if (word.num_glyphs < word.item.length || !shape(&word)) {
+                // shaping into a glyph run, the word gets another try once there is room
+                hb_uint32 needed = word.num_glyphs > word.item.length ? word.num_glyphs : word.item.length;
+                if (HB_GrowGlyphRun(shaper_item, numGlyphs, numGlyphs + needed))
+                    continue;
+                if (shaper_item->context->error)
+                    return false;
+                return shape(shaper_item);
+            }
+            if (cacheable)
+                HB_ShapeCacheInsert(cache, &word);
+        }
+
+        for (hb_uint32 i = 0; i < word.item.length; ++i)
+            word.log_clusters[i] += numGlyphs;
+        numGlyphs += word.num_glyphs;
+        kerningApplied |= word.kerning_applied;
+        from = to;
+    }
+
+    shaper_item->num_glyphs = numGlyphs;
+    if (kerningApplied)
+        shaper_item->kerning_applied = true;
+    return true;
+}
+
+static HB_Bool shapeItem(HB_ShaperItem *shaper_item, HB_ShapeContext context, HB_GlyphRun run)
 {
     HB_Bool result = false;
     if (shaper_item->num_glyphs < shaper_item->item.length) {
@@ -1305,8 +1657,161 @@ HB_Bool HB_ShapeItem(HB_ShaperItem *shaper_item)
         return false;
     }
     assert(shaper_item->item.script < HB_ScriptCount);
-    result = HB_ScriptEngines[shaper_item->item.script].shape(shaper_item);
+    // the context of the face couldn't be allocated
+    if (!context) {
+        shaper_item->num_glyphs = 0;
+        return false;
+    }
+    shaper_item->context = context;
+    shaper_item->run = run;
+    context->error = HB_Err_Ok;
+    if (shaper_item->face->cache && !shaper_item->glyphIndicesPresent
+        && spaceSeparatedScripts[shaper_item->item.script])
+        result = shapeWords(shaper_item);
+    else
+        result = HB_ScriptEngines[shaper_item->item.script].shape(shaper_item);
     shaper_item->glyphIndicesPresent = false;
+    // whatever the shaper asked for or made of the item without the lookups, more glyphs won't help
+    if (context->error) {
+        shaper_item->num_glyphs = 0;
+        result = false;
+    }
+    return result;
+}
+
+HB_Bool HB_ShapeItem(HB_ShaperItem *shaper_item)
+{
+    return shapeItem(shaper_item, shaper_item->face->context, 0);
+}
+
+HB_Bool HB_ShapeItemInContext(HB_ShaperItem *shaper_item, HB_ShapeContext context)
+{
+    return shapeItem(shaper_item, context, 0);
+}
+
+// -----------------------------------------------------------------------------------------------------
+//
+// Glyph runs
+//
+// The item shaped into a run is handed the first `available' glyphs of the arrays. A shaper that
+// needs more grows the run with HB_GrowGlyphRun and carries on where it was (the syllable and word
+// loops shape the part that didn't fit again), so an item is shaped once. Shapers that can't do
+// that ask for more glyphs as usual, and HB_ShapeItemToRun shapes the item again.
+//
+// -----------------------------------------------------------------------------------------------------
+
+HB_GlyphRun HB_NewGlyphRun(void)
+{
+    HB_GlyphRun run = (HB_GlyphRun)malloc(sizeof(HB_GlyphRunRec));
+    if (!run)
+        return 0;
+    memset(run, 0, sizeof(HB_GlyphRunRec));
+    return run;
+}
+
+void HB_FreeGlyphRun(HB_GlyphRun run)
+{
+    if (!run)
+        return;
+    free(run->glyphs);
+    free(run->attributes);
+    free(run->advances);
+    free(run->offsets);
+    free(run->log_clusters);
+    free(run);
+}
+
+static bool reserveGlyphs(HB_GlyphRun run, hb_uint32 size)
+{
+    if (size <= run->allocated)
+        return true;
+
+    HB_Glyph *glyphs = (HB_Glyph *)realloc(run->glyphs, size * sizeof(HB_Glyph));
+    if (glyphs)
+        run->glyphs = glyphs;
+    HB_GlyphAttributes *attributes = (HB_GlyphAttributes *)realloc(run->attributes, size * sizeof(HB_GlyphAttributes));
+    if (attributes)
+        run->attributes = attributes;
+    HB_Fixed *advances = (HB_Fixed *)realloc(run->advances, size * sizeof(HB_Fixed));
+    if (advances)
+        run->advances = advances;
+    HB_FixedPoint *offsets = (HB_FixedPoint *)realloc(run->offsets, size * sizeof(HB_FixedPoint));
+    if (offsets)
+        run->offsets = offsets;
+    if (!glyphs || !attributes || !advances || !offsets)
+        return false;
+
+    run->allocated = size;
+    return true;
+}
+
+// hands the first size glyphs of the run to the item, the ones from keep on cleared
+static void offerGlyphs(HB_ShaperItem *item, HB_GlyphRun run, hb_uint32 keep, hb_uint32 size)
+{
+    memset(run->attributes + keep, 0, (size - keep) * sizeof(HB_GlyphAttributes));
+    memset(run->offsets + keep, 0, (size - keep) * sizeof(HB_FixedPoint));
+    run->available = size;
+
+    item->glyphs = run->glyphs;
+    item->attributes = run->attributes;
+    item->advances = run->advances;
+    item->offsets = run->offsets;
+    item->num_glyphs = size;
+}
+
+HB_Bool HB_GrowGlyphRun(HB_ShaperItem *item, hb_uint32 keep, hb_uint32 needed)
+{
+    HB_GlyphRun run = item->run;
+    if (!run || item->context->error || needed <= run->available)
+        return false;
+
+    hb_uint32 size = run->available + (run->available >> 1) + 8;
+    if (size < needed)
+        size = needed;
+    if (!reserveGlyphs(run, size)) {
+        item->context->error = HB_Err_Out_Of_Memory;
+        return false;
+    }
+    offerGlyphs(item, run, keep, size);
+    return true;
+}
+
+HB_Bool HB_ShapeItemToRun(HB_ShaperItem *item, HB_GlyphRun run, HB_ShapeContext context)
+{
+    if (!context)
+        context = item->face->context;
+    // the context of the face couldn't be allocated
+    if (!context) {
+        run->num_glyphs = 0;
+        return false;
+    }
+
+    if (run->allocatedClusters < item->item.length) {
+        unsigned short *logClusters = (unsigned short *)realloc(run->log_clusters, item->item.length * sizeof(unsigned short));
+        if (!logClusters) {
+            context->error = HB_Err_Out_Of_Memory;
+            return false;
+        }
+        run->log_clusters = logClusters;
+        run->allocatedClusters = item->item.length;
+    }
+    item->log_clusters = run->log_clusters;
+
+    // a little more than the characters, the syllable shapers ask for a few glyphs extra
+    hb_uint32 size = item->item.length + 8;
+    if (!reserveGlyphs(run, size)) {
+        context->error = HB_Err_Out_Of_Memory;
+        return false;
+    }
+    offerGlyphs(item, run, 0, size);
+    item->glyphIndicesPresent = false;
+
+    HB_Bool result = shapeItem(item, context, run);
+    while (!result && HB_GrowGlyphRun(item, 0, item->num_glyphs))
+        result = shapeItem(item, context, run);
+
+    item->run = 0;
+    run->num_glyphs = result ? item->num_glyphs : 0;
     return result;
 }
 
@@ -189,29 +189,73 @@ typedef struct {
     unsigned combiningClass  :8;
 } HB_GlyphAttributes;
 
-typedef struct HB_FaceRec_ {
-    HB_Bool isSymbolFont;
+/* The lookups to apply for one script, language, set of shaper flags and set of features.
+ * Plans are built once per face on first use and never modified afterwards.
+ */
+typedef struct HB_ShapePlanRec_ *HB_ShapePlan;
 
-    HB_GDEF gdef;
-    HB_GSUB gsub;
-    HB_GPOS gpos;
-    HB_Bool supported_scripts[HB_ScriptCount];
+/* The per-call state of the OpenType shaper. A face is never modified by shaping,
+ * so several threads can use the same face at once as long as each one shapes with
+ * its own context (see HB_ShapeItemInContext).
+ *
+ * language is the OpenType language system tag (for example HB_MAKE_TAG('T','R','K',' '))
+ * the items shaped with the context use. It is 0, the default language system of the
+ * script, for a new context and the contexts of HB_ShapeItem and HB_ShapeItems.
+ *
+ * error is HB_Err_Out_Of_Memory if the last item shaped with the context failed because
+ * memory ran out, and HB_Err_Ok otherwise.
+ */
+typedef struct HB_ShapeContextRec_ {
+    HB_UInt language; /* in */
+    HB_Error error; /* out */
     HB_Buffer buffer;
+    HB_Face face; /* face the plan below was selected from */
+    hb_uint32 face_serial; /* its serial, as the face may have been freed since */
     HB_Script current_script;
+    HB_UInt current_language;
     int current_flags; /* HB_ShaperFlags */
-    HB_Bool has_opentype_kerning;
+    HB_ShapePlan plan;
     HB_Bool glyphs_substituted;
     HB_GlyphAttributes *tmpAttributes;
     unsigned int *tmpLogClusters;
+    int tmpAllocated; /* size of the two arrays above, kept between calls */
     int length;
     int orig_nglyphs;
+} HB_ShapeContextRec;
+
+typedef HB_ShapeContextRec *HB_ShapeContext;
+
+/* A size bounded cache of shaped words, see HB_NewShapeCache. */
+typedef struct HB_ShapeCacheRec_ *HB_ShapeCache;
+
+typedef struct HB_FaceRec_ {
+    HB_Bool isSymbolFont;
+
+    HB_GDEF gdef;
+    HB_GSUB gsub;
+    HB_GPOS gpos;
+    HB_Bool supported_scripts[HB_ScriptCount];
+    HB_ShapePlan plans; /* cache of the plans built so far, shared by all contexts */
+    HB_ShapeContext context; /* used by HB_ShapeItem, not thread safe */
+    HB_ShapeCache cache; /* optional, not owned by the face */
+    hb_uint32 serial; /* differs from that of any other face, even one freed at the same address */
 } HB_FaceRec;
 
 typedef HB_Error (*HB_GetFontTableFunc)(void *font, HB_Tag tag, HB_Byte *buffer, HB_UInt *length);
 
 HB_Face HB_NewFace(void *font, HB_GetFontTableFunc tableFunc);
+
+/* Fills in blob with the data of the table tag, without copying it. The data has to stay
+ * valid until the library calls blob->destroy. Returns an error if the font has no such table.
+ */
+typedef HB_Error (*HB_GetFontTableBlobFunc)(void *font, HB_Tag tag, HB_BlobRec *blob);
+
+HB_Face HB_NewFaceFromBlobs(void *font, HB_GetFontTableBlobFunc blobFunc);
 void HB_FreeFace(HB_Face face);
 
+HB_ShapeContext HB_NewShapeContext(void);
+void HB_FreeShapeContext(HB_ShapeContext context);
+
 typedef struct {
     HB_Fixed x, y;
     HB_Fixed width, height;
@@ -242,6 +286,25 @@ typedef struct HB_Font_ {
     void *userData;
 } HB_FontRec;
 
+/* The glyphs of an item shaped with HB_ShapeItemToRun, in arrays owned by the run. The
+ * arrays grow while the item is shaped and are kept for the next item.
+ */
+typedef struct {
+    hb_uint32 num_glyphs;
+    HB_Glyph *glyphs;
+    HB_GlyphAttributes *attributes;
+    HB_Fixed *advances;
+    HB_FixedPoint *offsets;
+    unsigned short *log_clusters; /* one per character of the item */
+
+    /* internal */
+    hb_uint32 allocated; /* glyphs */
+    hb_uint32 available; /* glyphs handed to the item being shaped, with cleared attributes and offsets */
+    hb_uint32 allocatedClusters;
+} HB_GlyphRunRec;
+
+typedef HB_GlyphRunRec *HB_GlyphRun;
+
 typedef struct HB_ShaperItem_ HB_ShaperItem;
 
 struct HB_ShaperItem_ {
@@ -264,9 +327,54 @@ struct HB_ShaperItem_ {
 
     /* internal */
     HB_Bool kerning_applied; /* out: kerning applied by shaper */
+    HB_ShapeContext context;
+    HB_GlyphRun run; /* owner of the arrays above when shaping with HB_ShapeItemToRun */
 };
 
+/* Returns false if the glyph arrays of the item are too small, with num_glyphs set to the
+ * number of glyphs needed, so that the item can be shaped again with larger arrays. If
+ * memory runs out, it returns false with num_glyphs set to 0 and the error of the context
+ * set (see HB_ShapeContextRec); shaping the item again won't help then.
+ */
 HB_Bool HB_ShapeItem(HB_ShaperItem *item);
+HB_Bool HB_ShapeItemInContext(HB_ShaperItem *item, HB_ShapeContext context);
+
+HB_GlyphRun HB_NewGlyphRun(void);
+void HB_FreeGlyphRun(HB_GlyphRun run);
+
+/* Shapes the item in a single pass into run, instead of asking the caller for more glyphs
+ * like HB_ShapeItem does. The output arrays of the item are ignored and pointed to those of
+ * the run, and the glyphs always come from the string (glyphIndicesPresent is ignored). A
+ * context of 0 means the context of the face. Returns false only if shaping failed or memory
+ * ran out.
+ */
+HB_Bool HB_ShapeItemToRun(HB_ShaperItem *item, HB_GlyphRun run, HB_ShapeContext context);
+
+typedef struct HB_ShaperPoolRec_ *HB_ShaperPool;
+
+HB_ShaperPool HB_NewShaperPool(int numThreads); /* numThreads <= 0 means one per CPU */
+void HB_FreeShaperPool(HB_ShaperPool pool);
+
+/* Shapes count independent items on the threads of pool, with one shaping context per thread.
+ * A pool of 0 shapes the items one after the other in the calling thread. Returns false if
+ * any of the items failed; then the items that need more glyphs have num_glyphs set as with
+ * HB_ShapeItem, and those that ran out of memory have it at 0.
+ */
+HB_Bool HB_ShapeItems(HB_ShaperItem *items, hb_uint32 count, HB_ShaperPool pool);
+
+/* Set as the cache of one or more faces, a shape cache keeps the glyphs of the words shaped
+ * with them, and HB_ShapeItem splices repeated words together from it instead of shaping them
+ * again. Only items of scripts that separate words by spaces are cut into words. The cache can
+ * be used from several threads at once, unless the library is built with HB_NO_THREADS; once it
+ * holds more than maxBytes the least recently used words are dropped. It has to outlive the
+ * faces that use it.
+ *
+ * As the words are shaped one by one, lookups of a font that reach across a space don't apply:
+ * kerning pairs with a space and contextual lookups matching one give other glyphs or positions
+ * than without a cache. Only set a cache on faces whose fonts don't rely on them.
+ */
+HB_ShapeCache HB_NewShapeCache(hb_uint32 maxBytes);
+void HB_FreeShapeCache(HB_ShapeCache cache);
 
 HB_END_HEADER
 
@@ -76,6 +76,10 @@ _hb_stream_frame_exit( HB_Stream stream );
 #define  GET_ULong()     ((HB_UInt)GET_Long())
 #define  GET_Tag4()      GET_ULong()
 
+/* the data of the current frame, valid as long as the stream data */
+#define  FRAME_Data()    ((const HB_Byte*)stream->cursor)
+#define  PEEK_UShort(p)  ((HB_UShort)( ((p)[0] << 8) | (p)[1] ))
+
 HB_END_HEADER
 
 #endif /* HARFBUZZ_STREAM_PRIVATE_H */
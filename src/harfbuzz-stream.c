@@ -53,7 +53,8 @@ _hb_close_stream( HB_Stream stream )
 {
   if (!stream)
       return;
-  free(stream->base);
+  if (stream->destroy)
+      stream->destroy(stream->user_data);
   free(stream);
 }
 
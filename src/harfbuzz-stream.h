@@ -30,6 +30,19 @@
 
 HB_BEGIN_HEADER
 
+/* A blob is a read-only piece of memory holding the data of a font table,
+   e.g. part of a font file that is mapped into memory.  If `destroy' is not
+   NULL, it is called with `user_data' once the data isn't needed anymore. */
+
+typedef struct HB_BlobRec_
+{
+    const HB_Byte* data;
+    HB_UInt        length;
+
+    void         (*destroy)( void* user_data );
+    void*          user_data;
+} HB_BlobRec;
+
 typedef struct HB_StreamRec_
 {
     HB_Byte*       base;
@@ -37,6 +50,11 @@ typedef struct HB_StreamRec_
     HB_UInt        pos;
     
     HB_Byte*       cursor;
+
+    void         (*destroy)( void* user_data );  /* releases `base' */
+    void*          user_data;
+
+    HB_Arena       arena;  /* where the tables read from it are allocated */
 } HB_StreamRec;
 
 
@@ -215,6 +215,7 @@ HB_Bool HB_TibetanShape(HB_ShaperItem *item)
     int end = sstart + item->item.length;
 
     assert(item->item.script == HB_Script_Tibetan);
+    syllable.run = 0;
 
 #ifndef QT_NO_OPENTYPE
     openType = HB_SelectScript(item, tibetan_features);
@@ -234,6 +235,9 @@ HB_Bool HB_TibetanShape(HB_ShaperItem *item)
         syllable.advances = item->advances + first_glyph;
         syllable.num_glyphs = item->num_glyphs - first_glyph;
         if (!tibetan_shape_syllable(openType, &syllable, invalid)) {
+            /* shaping into a glyph run, make room and shape the syllable again */
+            if (HB_GrowGlyphRun(item, first_glyph, first_glyph + syllable.num_glyphs))
+                continue;
             item->num_glyphs += syllable.num_glyphs;
             return FALSE;
         }
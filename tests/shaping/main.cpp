@@ -29,11 +29,45 @@
 #include FT_TRUETYPE_TABLES_H
 
 #include <harfbuzz-shaper.h>
+#include <harfbuzz-shaper-private.h>
 #include <harfbuzz-global.h>
 #include <harfbuzz-gpos.h>
+#include <harfbuzz-gpos-private.h>
 
 static FT_Library freetype;
 
+// the sanitizers replace malloc themselves
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define FAIL_ALLOCATIONS
+
+// While a test sets allocationsToFail, it counts down the allocations and the one at 0 fails.
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+
+static long allocationsToFail = -1;
+
+static bool failAllocation()
+{
+    return allocationsToFail >= 0 && allocationsToFail-- == 0;
+}
+
+extern "C" void *malloc(size_t size)
+{
+    return failAllocation() ? 0 : __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    return failAllocation() ? 0 : __libc_realloc(ptr, size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    return failAllocation() ? 0 : __libc_calloc(count, size);
+}
+#endif
+
 static FT_Face loadFace(const char *name)
 {
     FT_Face face;
@@ -152,6 +186,249 @@ const HB_FontClass hb_fontClass = {
     hb_getPointInOutline, hb_getGlyphMetrics, hb_getFontMetric
 };
 
+// Adds every feature of the default language of `script' to `plan', with `property'.
+static bool addGsubFeatures(HB_GSUBHeader *gsub, HB_UInt script, HB_UInt property, HB_LookupPlan *plan)
+{
+    HB_UShort script_index;
+    HB_UInt *feature_tags;
+    if (HB_GSUB_Select_Script(gsub, script, &script_index)
+        || HB_GSUB_Query_Features(gsub, script_index, HB_DEFAULT_LANGUAGE, &feature_tags))
+        return false;
+
+    bool ok = true;
+    for (HB_UInt *tag = feature_tags; *tag && ok; ++tag) {
+        HB_UShort feature_index;
+        if (!HB_GSUB_Select_Feature(gsub, *tag, script_index, HB_DEFAULT_LANGUAGE, &feature_index))
+            ok = HB_GSUB_Plan_Add_Feature(gsub, plan, feature_index, property) == HB_Err_Ok;
+    }
+    free(feature_tags);
+    return ok;
+}
+
+static bool addGposFeatures(HB_GPOSHeader *gpos, HB_UInt script, HB_UInt property, HB_LookupPlan *plan)
+{
+    HB_UShort script_index;
+    HB_UInt *feature_tags;
+    if (HB_GPOS_Select_Script(gpos, script, &script_index)
+        || HB_GPOS_Query_Features(gpos, script_index, HB_DEFAULT_LANGUAGE, &feature_tags))
+        return false;
+
+    bool ok = true;
+    for (HB_UInt *tag = feature_tags; *tag && ok; ++tag) {
+        HB_UShort feature_index;
+        if (!HB_GPOS_Select_Feature(gpos, *tag, script_index, HB_DEFAULT_LANGUAGE, &feature_index))
+            ok = HB_GPOS_Plan_Add_Feature(gpos, plan, feature_index, property) == HB_Err_Ok;
+    }
+    free(feature_tags);
+    return ok;
+}
+
+// A font of `face' at its current size, and plans that addFeatures fills and that are freed
+// with it.
+struct TestFont {
+    HB_FontRec font;
+    HB_LookupPlan gsubPlan;
+    HB_LookupPlan gposPlan;
+
+    TestFont(FT_Face face)
+    {
+        font.klass = &hb_fontClass;
+        font.userData = face;
+        font.x_ppem  = face->size->metrics.x_ppem;
+        font.y_ppem  = face->size->metrics.y_ppem;
+        font.x_scale = face->size->metrics.x_scale;
+        font.y_scale = face->size->metrics.y_scale;
+        memset(&gsubPlan, 0, sizeof(gsubPlan));
+        memset(&gposPlan, 0, sizeof(gposPlan));
+    }
+
+    ~TestFont()
+    {
+        HB_Done_LookupPlan(&gsubPlan);
+        HB_Done_LookupPlan(&gposPlan);
+    }
+
+    // every feature of `script' in the GSUB and GPOS tables that `hbFace' has
+    bool addFeatures(HB_Face hbFace, HB_UInt script, HB_UInt property)
+    {
+        return (!hbFace->gsub || addGsubFeatures(hbFace->gsub, script, property, &gsubPlan))
+            && (!hbFace->gpos || addGposFeatures(hbFace->gpos, script, property, &gposPlan));
+    }
+};
+
+// A piece of a made up OpenType table, which refers to other pieces by their offset from its
+// own start.
+struct TablePiece {
+    struct Link {
+        int at;
+        TablePiece *piece;
+    };
+    QByteArray bytes;
+    QList<Link> links;
+
+    TablePiece &u16(int value)
+    {
+        bytes.append(char(value >> 8));
+        bytes.append(char(value));
+        return *this;
+    }
+
+    TablePiece &tag(HB_UInt value)
+    {
+        return u16(value >> 16).u16(value & 0xffff);
+    }
+
+    // filled in by MadeUpTable::write, 0 for no piece
+    TablePiece &offset(TablePiece *piece)
+    {
+        if (piece) {
+            Link link = { bytes.size(), piece };
+            links.append(link);
+        }
+        return u16(0);
+    }
+};
+
+// The pieces of a table, each of them referred to by one other only, which it is laid out after.
+struct MadeUpTable {
+    QList<TablePiece *> pieces;
+
+    ~MadeUpTable()
+    {
+        qDeleteAll(pieces);
+    }
+
+    TablePiece *piece()
+    {
+        pieces.append(new TablePiece);
+        return pieces.last();
+    }
+
+    QByteArray write(TablePiece *first) const
+    {
+        QList<TablePiece *> order;
+        QList<int> positions;
+        order.append(first);
+        positions.append(0);
+        for (int i = 0; i < order.size(); ++i) {
+            for (int j = 0; j < order.at(i)->links.size(); ++j) {
+                positions.append(positions.last() + order.at(order.size() - 1)->bytes.size());
+                order.append(order.at(i)->links.at(j).piece);
+            }
+        }
+
+        QByteArray table;
+        for (int i = 0; i < order.size(); ++i) {
+            TablePiece *piece = order.at(i);
+            QByteArray bytes = piece->bytes;
+            for (int j = 0; j < piece->links.size(); ++j) {
+                int offset = positions.at(order.indexOf(piece->links.at(j).piece)) - positions.at(i);
+                bytes.data()[piece->links.at(j).at] = char(offset >> 8);
+                bytes.data()[piece->links.at(j).at + 1] = char(offset);
+            }
+            for (int j = 0; j < bytes.size(); ++j)
+                table.append(bytes.constData()[j]);
+        }
+        return table;
+    }
+
+    // the glyphs from `first' to `last'
+    TablePiece *coverage(int first, int last)
+    {
+        TablePiece *piece = this->piece();
+        piece->u16(2).u16(1).u16(first).u16(last).u16(0);
+        return piece;
+    }
+
+    // the classes of `count' glyphs from `first' on
+    TablePiece *classDef(int first, int count, const int *classes)
+    {
+        TablePiece *piece = this->piece();
+        piece->u16(1).u16(first).u16(count);
+        for (int i = 0; i < count; ++i)
+            piece->u16(classes[i]);
+        return piece;
+    }
+
+    // pixel adjustments from -8 to 7 for `count' sizes from `first' on
+    TablePiece *device(int first, int count, const int *deltas)
+    {
+        TablePiece *piece = this->piece();
+        piece->u16(first).u16(first + count - 1).u16(2);
+        for (int i = 0; i < (count / 4 + 1) * 4; i += 4) {
+            int word = 0;
+            for (int j = i; j < i + 4; ++j)
+                word = word << 4 | (j < count ? deltas[j] & 0xf : 0);
+            piece->u16(word);
+        }
+        return piece;
+    }
+
+    TablePiece *lookup(int type, int flags, TablePiece **subtables, int count)
+    {
+        TablePiece *piece = this->piece();
+        piece->u16(type).u16(flags).u16(count);
+        for (int i = 0; i < count; ++i)
+            piece->offset(subtables[i]);
+        return piece;
+    }
+
+    // A GSUB or GPOS table of `lookups', the first `applied' of which (all by default) the
+    // default language of 'latn' applies in this order; the others are for context lookups.
+    QByteArray layoutTable(TablePiece **lookups, int count, int applied = -1)
+    {
+        if (applied < 0)
+            applied = count;
+
+        TablePiece *header = piece();
+        TablePiece *scriptList = piece();
+        TablePiece *script = piece();
+        TablePiece *language = piece();
+        TablePiece *featureList = piece();
+        TablePiece *feature = piece();
+        TablePiece *lookupList = piece();
+
+        header->u16(1).u16(0).offset(scriptList).offset(featureList).offset(lookupList);
+        scriptList->u16(1).tag(HB_MAKE_TAG('l', 'a', 't', 'n')).offset(script);
+        script->offset(language).u16(0);
+        language->u16(0).u16(0xffff).u16(1).u16(0);
+        featureList->u16(1).tag(HB_MAKE_TAG('t', 'e', 's', 't')).offset(feature);
+        feature->u16(0).u16(applied);
+        for (int i = 0; i < applied; ++i)
+            feature->u16(i);
+        lookupList->u16(count);
+        for (int i = 0; i < count; ++i)
+            lookupList->offset(lookups[i]);
+        return write(header);
+    }
+};
+
+// The tables of a made up face, which has no others.
+struct MadeUpFace {
+    QByteArray gdef;
+    QByteArray gsub;
+    QByteArray gpos;
+};
+
+static HB_Error madeUpFaceTable(void *font, HB_Tag tableTag, HB_Byte *buffer, HB_UInt *length)
+{
+    const MadeUpFace *face = (const MadeUpFace *)font;
+    const QByteArray *table = 0;
+    if (tableTag == TTAG_GDEF)
+        table = &face->gdef;
+    else if (tableTag == TTAG_GSUB)
+        table = &face->gsub;
+    else if (tableTag == TTAG_GPOS)
+        table = &face->gpos;
+    if (!table || table->isEmpty())
+        return HB_Err_Not_Covered;
+
+    if (buffer)
+        memcpy(buffer, table->constData(), qMin(*length, HB_UInt(table->size())));
+    *length = table->size();
+    return HB_Err_Ok;
+}
+
 
 //TESTED_CLASS=
 //TESTED_FILES= gui/text/qscriptengine.cpp
@@ -182,6 +459,21 @@ private slots:
 
     void khmer();
     void linearB();
+
+    void composedPlan();
+    void applyStrings();
+    void bufferReserve();
+    void shapeCache();
+    void glyphRunSyllables();
+    void glyphRunWords();
+    void glyphRunOpenType();
+    void outOfMemory();
+    void kernMatrix();
+    void markDistance();
+    void chainTrie();
+    void ligatureTrie();
+    void inPlace();
+    void parallelGlyphIds();
 };
 
 tst_QScriptEngine::tst_QScriptEngine()
@@ -1030,6 +1322,1337 @@ void tst_QScriptEngine::linearB()
     }
 }
 
+// The glyphs of the zero terminated string `text'.
+static HB_Buffer textBuffer(FT_Face face, const unsigned short *text)
+{
+    HB_Buffer buffer;
+    if (hb_buffer_new(&buffer))
+        return 0;
+    for (HB_UInt i = 0; text[i]; ++i)
+        hb_buffer_add_glyph(buffer, FT_Get_Char_Index(face, text[i]), 0, i);
+    return buffer;
+}
+
+// Every glyph of the face once, with some of them excluded from the lookups by their properties.
+static HB_Buffer allGlyphsBuffer(FT_Face face, HB_UInt property)
+{
+    HB_Buffer buffer;
+    if (hb_buffer_new(&buffer))
+        return 0;
+    for (HB_UInt glyph = 0; glyph < (HB_UInt)face->num_glyphs; ++glyph)
+        hb_buffer_add_glyph(buffer, glyph, glyph % 3 ? 0 : property, glyph);
+    return buffer;
+}
+
+// HB_GSUB_Compose_Plan merges runs of single substitutions into one glyph mapping;
+// the composed plan must substitute exactly as the lookups do one by one.
+void tst_QScriptEngine::composedPlan()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    QVERIFY(hbFace->gsub);
+
+    TestFont plain(face);
+    TestFont composed(face);
+    const HB_UInt arab = HB_MAKE_TAG('a', 'r', 'a', 'b');
+    QVERIFY(plain.addFeatures(hbFace, arab, 0x1));
+    QVERIFY(composed.addFeatures(hbFace, arab, 0x1));
+    QCOMPARE(HB_GSUB_Compose_Plan(hbFace->gsub, &composed.gsubPlan), HB_Err_Ok);
+
+    HB_UInt merged = 0;
+    for (HB_UInt i = 0; i < composed.gsubPlan.LookupCount; ++i)
+        if (composed.gsubPlan.Lookup[i].ComposedCount > 1)
+            merged += composed.gsubPlan.Lookup[i].ComposedCount;
+    QVERIFY(merged > 1);
+
+    HB_Buffer expected = allGlyphsBuffer(face, 0x1);
+    HB_Buffer result = allGlyphsBuffer(face, 0x1);
+    QVERIFY(expected && result);
+    HB_GSUB_Apply_Plan(hbFace->gsub, &plain.gsubPlan, expected);
+    HB_GSUB_Apply_Plan(hbFace->gsub, &composed.gsubPlan, result);
+
+    QCOMPARE(result->in_length, expected->in_length);
+    for (HB_UInt i = 0; i < expected->in_length; ++i) {
+        QCOMPARE(result->in_string[i].gindex, expected->in_string[i].gindex);
+        QCOMPARE(result->in_string[i].cluster, expected->in_string[i].cluster);
+    }
+
+    hb_buffer_free(expected);
+    hb_buffer_free(result);
+    HB_FreeFace(hbFace);
+    FT_Done_Face(face);
+}
+
+// HB_GSUB_Apply_Strings and HB_GPOS_Apply_Strings apply each lookup to all of the buffers
+// before the next one; every buffer must end up as if the plan had been applied to it alone.
+void tst_QScriptEngine::applyStrings()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    QVERIFY(hbFace->gsub && hbFace->gpos);
+
+    FT_Set_Pixel_Sizes(face, 0, 32);
+    TestFont font(face);
+    QVERIFY(font.addFeatures(hbFace, HB_MAKE_TAG('l', 'a', 't', 'n'), 0x1));
+    QCOMPARE(HB_GSUB_Compose_Plan(hbFace->gsub, &font.gsubPlan), HB_Err_Ok);
+
+    // of different lengths, with and without ligatures, kerning pairs and marks
+    static const unsigned short texts[][24] = {
+        { 'A', 'V', 'A', 'T', 'A', 'R', 0 },
+        { 0 },
+        { 'o', 'f', 'f', 'i', 'c', 'e', ' ', 'a', 'f', 'f', 'l', 'u', 'e', 'n', 't', 0 },
+        { 'x', 0 },
+        { 'T', 'o', ' ', 'W', 'a', 0x301, 0x327, ' ', 'Y', 'o', 0x308, ' ', 'f', 'j', 'o', 'r', 'd',
+          ' ', 'f', 'f', 'i', 0x323, 0x302, 0 },
+        { 'e', 0x301, 'e', 0x300, 'e', 0x302, 0x301, 0 }
+    };
+    const HB_UInt count = sizeof(texts) / sizeof(texts[0]);
+
+    HB_Buffer expected[count];
+    HB_Buffer result[count];
+    HB_Error expectedErrors[count];
+    HB_Error resultErrors[count];
+
+    for (HB_UInt i = 0; i < count; ++i) {
+        expected[i] = textBuffer(face, texts[i]);
+        result[i] = textBuffer(face, texts[i]);
+        QVERIFY(expected[i] && result[i]);
+    }
+
+    for (HB_UInt i = 0; i < count; ++i)
+        expectedErrors[i] = HB_GSUB_Apply_Plan(hbFace->gsub, &font.gsubPlan, expected[i]);
+    HB_GSUB_Apply_Strings(hbFace->gsub, &font.gsubPlan, result, count, resultErrors);
+
+    for (HB_UInt i = 0; i < count; ++i) {
+        QCOMPARE(resultErrors[i], expectedErrors[i]);
+        QCOMPARE(result[i]->in_length, expected[i]->in_length);
+        for (HB_UInt j = 0; j < expected[i]->in_length; ++j) {
+            QCOMPARE(result[i]->in_string[j].gindex, expected[i]->in_string[j].gindex);
+            QCOMPARE(result[i]->in_string[j].cluster, expected[i]->in_string[j].cluster);
+        }
+    }
+
+    for (HB_UInt i = 0; i < count; ++i)
+        expectedErrors[i] = HB_GPOS_Apply_Plan(&font.font, hbFace->gpos, &font.gposPlan, 0, expected[i], true, false);
+    HB_GPOS_Apply_Strings(&font.font, hbFace->gpos, &font.gposPlan, 0, result, count, resultErrors, true, false);
+
+    for (HB_UInt i = 0; i < count; ++i) {
+        QCOMPARE(resultErrors[i], expectedErrors[i]);
+        if (expectedErrors[i] == HB_Err_Not_Covered)
+            continue;
+        for (HB_UInt j = 0; j < expected[i]->in_length; ++j) {
+            const HB_PositionRec &e = expected[i]->positions[j];
+            const HB_PositionRec &r = result[i]->positions[j];
+            QCOMPARE(r.x_pos, e.x_pos);
+            QCOMPARE(r.y_pos, e.y_pos);
+            QCOMPARE(r.x_advance, e.x_advance);
+            QCOMPARE(r.y_advance, e.y_advance);
+            QCOMPARE(r.back, e.back);
+            QCOMPARE(r.new_advance, e.new_advance);
+            QCOMPARE(r.cursive_chain, e.cursive_chain);
+        }
+    }
+
+    for (HB_UInt i = 0; i < count; ++i) {
+        hb_buffer_free(expected[i]);
+        hb_buffer_free(result[i]);
+    }
+    HB_FreeFace(hbFace);
+    FT_Done_Face(face);
+}
+
+// A buffer with room reserved for a string keeps its arrays while holding and shaping it,
+// and when cleared for the next one.
+void tst_QScriptEngine::bufferReserve()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    QVERIFY(hbFace->gsub && hbFace->gpos);
+
+    TestFont font(face);
+    QVERIFY(font.addFeatures(hbFace, HB_MAKE_TAG('l', 'a', 't', 'n'), 0x1));
+
+    static const unsigned short text[] = {
+        'A', 'V', 'A', ' ', 'o', 'f', 'f', 'i', 'c', 'e', ' ', 'e', 0x301, ' ', 'W', 'a', 0x327,
+        ' ', 'f', 'f', 'l', ' ', 'T', 'o', 0x308, 0
+    };
+    const HB_UInt length = sizeof(text) / sizeof(text[0]) - 1;
+
+    HB_Buffer buffer;
+    QCOMPARE(hb_buffer_new(&buffer), HB_Err_Ok);
+    QCOMPARE(hb_buffer_reserve(buffer, 0), HB_Err_Ok);
+    QCOMPARE(hb_buffer_reserve(buffer, length), HB_Err_Ok);
+
+    const HB_UInt allocated = buffer->allocated;
+    HB_GlyphItem strings[3] = { buffer->in_string, buffer->out_string, buffer->alt_string };
+    const HB_Position positions = buffer->positions;
+    const HB_UInt *skipLists = buffer->skip_lists;
+    QVERIFY(allocated >= length);
+    QVERIFY(strings[0] && strings[2] && positions && skipLists);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        hb_buffer_clear(buffer);
+        // less than before, nothing is given back
+        QCOMPARE(hb_buffer_reserve(buffer, length / 2), HB_Err_Ok);
+        for (HB_UInt i = 0; i < length; ++i)
+            QCOMPARE(hb_buffer_add_glyph(buffer, FT_Get_Char_Index(face, text[i]), 0, i), HB_Err_Ok);
+
+        QVERIFY(HB_GSUB_Apply_Plan(hbFace->gsub, &font.gsubPlan, buffer) != HB_Err_Out_Of_Memory);
+        QVERIFY(HB_GPOS_Apply_Plan(&font.font, hbFace->gpos, &font.gposPlan, 0, buffer, true, false) != HB_Err_Out_Of_Memory);
+
+        // the strings are swapped while shaping, but none of them is reallocated
+        QCOMPARE(buffer->allocated, allocated);
+        QVERIFY(buffer->in_string == strings[0] || buffer->in_string == strings[1] || buffer->in_string == strings[2]);
+        QVERIFY(buffer->alt_string == strings[0] || buffer->alt_string == strings[1] || buffer->alt_string == strings[2]);
+        QVERIFY(buffer->positions == positions);
+        QVERIFY(buffer->skip_lists == skipLists);
+    }
+
+    hb_buffer_free(buffer);
+    HB_FreeFace(hbFace);
+    FT_Done_Face(face);
+}
+
+// A word of the text of `letter' repeated, with room for the glyphs of any word as long.
+struct CacheWord {
+    enum { Length = 64 };
+    HB_UChar16 text[Length];
+    HB_ShaperItem item;
+    HB_Glyph glyphs[Length];
+    HB_GlyphAttributes attributes[Length];
+    HB_Fixed advances[Length];
+    HB_FixedPoint offsets[Length];
+    unsigned short logClusters[Length];
+
+    CacheWord(HB_UChar16 letter, HB_Font font, HB_Face face, HB_ShapeContext context)
+    {
+        memset(this, 0, sizeof(*this));
+        for (int i = 0; i < Length; ++i)
+            text[i] = letter;
+        item.string = text;
+        item.stringLength = Length;
+        item.item.pos = 0;
+        item.item.length = Length;
+        item.item.script = HB_Script_Common;
+        item.font = font;
+        item.face = face;
+        item.context = context;
+        item.num_glyphs = Length;
+        item.glyphs = glyphs;
+        item.attributes = attributes;
+        item.advances = advances;
+        item.offsets = offsets;
+        item.log_clusters = logClusters;
+    }
+
+    // made up glyphs, different for every letter
+    void shape()
+    {
+        for (int i = 0; i < Length; ++i) {
+            glyphs[i] = text[i] * 100 + i;
+            advances[i] = text[i] + i;
+            offsets[i].x = i;
+            offsets[i].y = -i;
+            logClusters[i] = i;
+        }
+    }
+
+    bool sameGlyphsAs(const CacheWord &other) const
+    {
+        if (item.num_glyphs != other.item.num_glyphs)
+            return false;
+        for (hb_uint32 i = 0; i < item.num_glyphs; ++i)
+            if (glyphs[i] != other.glyphs[i] || advances[i] != other.advances[i]
+                || offsets[i].x != other.offsets[i].x || offsets[i].y != other.offsets[i].y
+                || logClusters[i] != other.logClusters[i])
+                return false;
+        return true;
+    }
+};
+
+// The word cache gives back what was put into it for the same word, face and font size only,
+// drops the least recently used words when full and forgets the words of a face being freed.
+void tst_QScriptEngine::shapeCache()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    HB_Face otherFace = HB_NewFace(face, hb_getSFntTable);
+    HB_ShapeContext context = HB_NewShapeContext();
+    QVERIFY(hbFace && otherFace && context);
+
+    FT_Set_Pixel_Sizes(face, 0, 16);
+    TestFont font(face);
+    FT_Set_Pixel_Sizes(face, 0, 32);
+    TestFont largerFont(face);
+
+    // hits and misses
+    HB_ShapeCache cache = HB_NewShapeCache(1 << 20);
+    QVERIFY(cache);
+    CacheWord a('a', &font.font, hbFace, context);
+    a.shape();
+    HB_ShapeCacheInsert(cache, &a.item);
+
+    CacheWord hit('a', &font.font, hbFace, context);
+    QVERIFY(HB_ShapeCacheLookup(cache, &hit.item));
+    QVERIFY(hit.sameGlyphsAs(a));
+    CacheWord otherWord('b', &font.font, hbFace, context);
+    QVERIFY(!HB_ShapeCacheLookup(cache, &otherWord.item));
+    CacheWord otherSize('a', &largerFont.font, hbFace, context);
+    QVERIFY(!HB_ShapeCacheLookup(cache, &otherSize.item));
+    CacheWord otherFaceWord('a', &font.font, otherFace, context);
+    QVERIFY(!HB_ShapeCacheLookup(cache, &otherFaceWord.item));
+    CacheWord tooFewGlyphs('a', &font.font, hbFace, context);
+    tooFewGlyphs.item.num_glyphs = CacheWord::Length - 1;
+    QVERIFY(!HB_ShapeCacheLookup(cache, &tooFewGlyphs.item));
+    HB_FreeShapeCache(cache);
+
+    // room for two of the words, with entry headers of less than 256 bytes
+    const hb_uint32 wordSize = CacheWord::Length
+        * (sizeof(HB_Glyph) + sizeof(HB_GlyphAttributes) + sizeof(HB_Fixed) + sizeof(HB_FixedPoint)
+           + sizeof(HB_UChar16) + sizeof(unsigned short));
+    const hb_uint32 maxBytes = 2 * (wordSize + 256);
+
+    // eviction of the least recently used word
+    cache = HB_NewShapeCache(maxBytes);
+    QVERIFY(cache);
+    CacheWord b('b', &font.font, hbFace, context);
+    CacheWord c('c', &font.font, hbFace, context);
+    b.shape();
+    c.shape();
+    HB_ShapeCacheInsert(cache, &a.item);
+    HB_ShapeCacheInsert(cache, &b.item);
+    CacheWord lookup('a', &font.font, hbFace, context);
+    QVERIFY(HB_ShapeCacheLookup(cache, &lookup.item));
+    HB_ShapeCacheInsert(cache, &c.item);
+
+    CacheWord afterA('a', &font.font, hbFace, context);
+    CacheWord afterB('b', &font.font, hbFace, context);
+    CacheWord afterC('c', &font.font, hbFace, context);
+    QVERIFY(HB_ShapeCacheLookup(cache, &afterA.item));
+    QVERIFY(!HB_ShapeCacheLookup(cache, &afterB.item));
+    QVERIFY(HB_ShapeCacheLookup(cache, &afterC.item));
+    QVERIFY(afterA.sameGlyphsAs(a));
+    QVERIFY(afterC.sameGlyphsAs(c));
+    HB_FreeShapeCache(cache);
+
+    // freeing a face drops its words: had the word of the freed face stayed, making room for
+    // the third word would drop the least recently used one, the first
+    cache = HB_NewShapeCache(maxBytes);
+    QVERIFY(cache);
+    hbFace->cache = otherFace->cache = cache;
+    CacheWord kept('a', &font.font, hbFace, context);
+    CacheWord dropped('b', &font.font, otherFace, context);
+    CacheWord added('c', &font.font, hbFace, context);
+    kept.shape();
+    dropped.shape();
+    added.shape();
+    HB_ShapeCacheInsert(cache, &kept.item);
+    HB_ShapeCacheInsert(cache, &dropped.item);
+    HB_FreeFace(otherFace);
+    HB_ShapeCacheInsert(cache, &added.item);
+
+    CacheWord afterKept('a', &font.font, hbFace, context);
+    CacheWord afterAdded('c', &font.font, hbFace, context);
+    QVERIFY(HB_ShapeCacheLookup(cache, &afterKept.item));
+    QVERIFY(HB_ShapeCacheLookup(cache, &afterAdded.item));
+
+    HB_FreeShapeContext(context);
+    HB_FreeFace(hbFace);
+    HB_FreeShapeCache(cache);
+    FT_Done_Face(face);
+}
+
+// Shapes `item' with HB_ShapeItem into arrays of its own and with HB_ShapeItemToRun into `run',
+// and tells whether both give the same glyphs.
+static bool sameInRun(const HB_ShaperItem &item, HB_GlyphRun run)
+{
+    HB_ShaperItem shaper_item = item;
+    shaper_item.num_glyphs = shaper_item.item.length;
+    shaper_item.glyphIndicesPresent = false;
+    shaper_item.initialGlyphCount = 0;
+
+    QVarLengthArray<HB_Glyph> hb_glyphs(shaper_item.num_glyphs);
+    QVarLengthArray<HB_GlyphAttributes> hb_attributes(shaper_item.num_glyphs);
+    QVarLengthArray<HB_Fixed> hb_advances(shaper_item.num_glyphs);
+    QVarLengthArray<HB_FixedPoint> hb_offsets(shaper_item.num_glyphs);
+    QVarLengthArray<unsigned short> hb_logClusters(shaper_item.item.length);
+
+    while (1) {
+        hb_glyphs.resize(shaper_item.num_glyphs);
+        hb_attributes.resize(shaper_item.num_glyphs);
+        hb_advances.resize(shaper_item.num_glyphs);
+        hb_offsets.resize(shaper_item.num_glyphs);
+
+        memset(hb_glyphs.data(), 0, hb_glyphs.size() * sizeof(HB_Glyph));
+        memset(hb_attributes.data(), 0, hb_attributes.size() * sizeof(HB_GlyphAttributes));
+        memset(hb_advances.data(), 0, hb_advances.size() * sizeof(HB_Fixed));
+        memset(hb_offsets.data(), 0, hb_offsets.size() * sizeof(HB_FixedPoint));
+
+        shaper_item.glyphs = hb_glyphs.data();
+        shaper_item.attributes = hb_attributes.data();
+        shaper_item.advances = hb_advances.data();
+        shaper_item.offsets = hb_offsets.data();
+        shaper_item.log_clusters = hb_logClusters.data();
+
+        if (HB_ShapeItem(&shaper_item))
+            break;
+        if (!shaper_item.num_glyphs)
+            return false;
+    }
+
+    HB_ShaperItem run_item = item;
+    if (!HB_ShapeItemToRun(&run_item, run, 0))
+        return false;
+
+    if (run->num_glyphs != shaper_item.num_glyphs)
+        return false;
+    for (hb_uint32 i = 0; i < run->num_glyphs; ++i) {
+        if (run->glyphs[i] != shaper_item.glyphs[i]
+            || run->advances[i] != shaper_item.advances[i]
+            || run->offsets[i].x != shaper_item.offsets[i].x
+            || run->offsets[i].y != shaper_item.offsets[i].y
+            || run->attributes[i].clusterStart != shaper_item.attributes[i].clusterStart
+            || run->attributes[i].mark != shaper_item.attributes[i].mark)
+            return false;
+    }
+    for (hb_uint32 i = 0; i < item.item.length; ++i)
+        if (run->log_clusters[i] != shaper_item.log_clusters[i])
+            return false;
+    return true;
+}
+
+static HB_ShaperItem runItem(const unsigned short *text, HB_Script script, HB_Font font, HB_Face face)
+{
+    HB_ShaperItem shaper_item;
+    memset(&shaper_item, 0, sizeof(shaper_item));
+    shaper_item.string = text;
+    while (text[shaper_item.stringLength])
+        ++shaper_item.stringLength;
+    shaper_item.item.script = script;
+    shaper_item.item.pos = 0;
+    shaper_item.item.length = shaper_item.stringLength;
+    shaper_item.item.bidiLevel = 0;
+    shaper_item.shaperFlags = 0;
+    shaper_item.font = font;
+    shaper_item.face = face;
+    return shaper_item;
+}
+
+// A run is handed a few glyphs more than the item has characters. Lone vowel signs get a
+// dotted circle each, so the syllable loop has to grow the run as it goes.
+void tst_QScriptEngine::glyphRunSyllables()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    TestFont font(face);
+
+    unsigned short text[41];
+    for (int i = 0; i < 40; ++i)
+        text[i] = i % 5 == 4 ? 0x0915 : 0x093f;
+    text[40] = 0;
+
+    HB_GlyphRun run = HB_NewGlyphRun();
+    QVERIFY(run);
+    HB_ShaperItem item = runItem(text, HB_Script_Devanagari, &font.font, hbFace);
+    QVERIFY(sameInRun(item, run));
+    QVERIFY(run->num_glyphs > item.item.length + 8);
+
+    HB_FreeGlyphRun(run);
+    HB_FreeFace(hbFace);
+    FT_Done_Face(face);
+}
+
+// Shapes `item' with the cache of its face and without one, and tells whether both give the
+// same glyphs.
+static bool sameWithoutCache(const HB_ShaperItem &item)
+{
+    HB_GlyphRun cached = HB_NewGlyphRun();
+    HB_GlyphRun uncached = HB_NewGlyphRun();
+    HB_ShapeCache cache = item.face->cache;
+    HB_ShaperItem cachedItem = item;
+    HB_ShaperItem uncachedItem = item;
+
+    bool same = cached && uncached && HB_ShapeItemToRun(&cachedItem, cached, 0);
+    item.face->cache = 0;
+    same = same && HB_ShapeItemToRun(&uncachedItem, uncached, 0);
+    item.face->cache = cache;
+
+    same = same && cached->num_glyphs == uncached->num_glyphs;
+    for (hb_uint32 i = 0; same && i < cached->num_glyphs; ++i) {
+        const HB_GlyphAttributes &a = cached->attributes[i];
+        const HB_GlyphAttributes &b = uncached->attributes[i];
+        same = cached->glyphs[i] == uncached->glyphs[i]
+            && cached->advances[i] == uncached->advances[i]
+            && cached->offsets[i].x == uncached->offsets[i].x
+            && cached->offsets[i].y == uncached->offsets[i].y
+            && a.justification == b.justification
+            && a.clusterStart == b.clusterStart
+            && a.mark == b.mark
+            && (!a.mark || a.combiningClass == b.combiningClass); // not set for other glyphs
+    }
+    for (hb_uint32 i = 0; same && i < item.item.length; ++i)
+        same = cached->log_clusters[i] == uncached->log_clusters[i];
+
+    HB_FreeGlyphRun(cached);
+    HB_FreeGlyphRun(uncached);
+    return same;
+}
+
+// The same with a word cache: the words that don't fit are shaped or taken from the cache
+// again once the run has grown. A mark after a space belongs to that space, which isn't cut
+// off from it.
+void tst_QScriptEngine::glyphRunWords()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    HB_ShapeCache cache = HB_NewShapeCache(1 << 20);
+    QVERIFY(hbFace && cache);
+    hbFace->cache = cache;
+
+    FT_Set_Pixel_Sizes(face, 0, 32);
+    TestFont font(face);
+
+    unsigned short text[51];
+    for (int i = 0; i < 50; ++i)
+        text[i] = i % 5 == 4 ? ' ' : 0x093f;
+    text[50] = 0;
+
+    // the words are shaped the first time and come from the cache the second
+    HB_ShaperItem item = runItem(text, HB_Script_Devanagari, &font.font, hbFace);
+    for (int pass = 0; pass < 2; ++pass) {
+        HB_GlyphRun run = HB_NewGlyphRun();
+        QVERIFY(run);
+        QVERIFY(sameInRun(item, run));
+        QVERIFY(run->num_glyphs > item.item.length + 8);
+        HB_FreeGlyphRun(run);
+    }
+
+    static const unsigned short latin[] = {
+        'a', ' ', 0x0301, 'b', ' ', ' ', 0x0308, ' ', 'c', 0x0327, ' ', 0x0300, 0x0301, ' ', 'd', 0
+    };
+    static const unsigned short hebrew[] = {
+        0x05e9, 0x05dc, ' ', 0x05b8, 0x05d5, ' ', ' ', 0x05bc, 0x05dd, ' ', 0x05d0, 0
+    };
+    static const unsigned short arabic[] = {
+        0x0644, 0x0627, ' ', 0x064e, 0x0633, 0x0644, ' ', ' ', 0x0650, 0x0645, ' ', 0x0628, 0x0652, 0
+    };
+    for (int pass = 0; pass < 2; ++pass) {
+        QVERIFY(sameWithoutCache(runItem(latin, HB_Script_Common, &font.font, hbFace)));
+        QVERIFY(sameWithoutCache(runItem(hebrew, HB_Script_Hebrew, &font.font, hbFace)));
+        QVERIFY(sameWithoutCache(runItem(arabic, HB_Script_Arabic, &font.font, hbFace)));
+    }
+
+    HB_FreeFace(hbFace);
+    HB_FreeShapeCache(cache);
+    FT_Done_Face(face);
+}
+
+// Items shaped with OpenType lookups one after the other into the same run, which has to grow
+// for the longer ones, and Indic syllables whose lookups give more glyphs than they have
+// characters.
+void tst_QScriptEngine::glyphRunOpenType()
+{
+    {
+        FT_Face face = loadFace("DejaVuSans.ttf");
+        if (!face)
+            QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+        HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+        QVERIFY(hbFace->gsub && hbFace->gpos);
+
+        FT_Set_Pixel_Sizes(face, 0, 32);
+        TestFont font(face);
+
+        // with ligatures, kerning pairs and marks
+        static const unsigned short texts[][40] = {
+            { 'A', 'V', 0 },
+            { 'o', 'f', 'f', 'i', 'c', 'e', ' ', 'a', 'f', 'f', 'l', 'u', 'e', 'n', 't', ' ', 'A', 'V', 'A', 'T',
+              'A', 'R', 0 },
+            { 'x', 0 },
+            { 'T', 'o', ' ', 'W', 'a', 0x301, 0x327, ' ', 'Y', 'o', 0x308, ' ', 'f', 'j', 'o', 'r', 'd', ' ',
+              'f', 'f', 'i', 0x323, 0x302, ' ', 'e', 0x301, 'e', 0x300, 'e', 0x302, 0x301, ' ', 'L', 'T', 'A', 'V', 0 }
+        };
+
+        HB_GlyphRun run = HB_NewGlyphRun();
+        QVERIFY(run);
+        for (unsigned i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+            HB_ShaperItem item = runItem(texts[i], HB_Script_Common, &font.font, hbFace);
+            QVERIFY(sameInRun(item, run));
+        }
+
+        HB_FreeGlyphRun(run);
+        HB_FreeFace(hbFace);
+        FT_Done_Face(face);
+    }
+    {
+        FT_Face face = loadFace("raghu.ttf");
+        if (face) {
+            HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+            TestFont font(face);
+
+            // lone vowel signs and conjuncts with reph
+            unsigned short text[61];
+            for (int i = 0; i < 60; i += 6) {
+                text[i] = 0x093f;
+                text[i + 1] = 0x0930;
+                text[i + 2] = 0x094d;
+                text[i + 3] = 0x0915;
+                text[i + 4] = 0x0940;
+                text[i + 5] = 0x0947;
+            }
+            text[60] = 0;
+
+            HB_GlyphRun run = HB_NewGlyphRun();
+            QVERIFY(run);
+            HB_ShaperItem item = runItem(text, HB_Script_Devanagari, &font.font, hbFace);
+            QVERIFY(sameInRun(item, run));
+
+            HB_FreeGlyphRun(run);
+            HB_FreeFace(hbFace);
+            FT_Done_Face(face);
+        } else {
+            QSKIP("couldn't find raghu.ttf", SkipAll);
+        }
+    }
+}
+
+// An item with room for all of its glyphs, which come out of HB_ShapeItem without further
+// allocations.
+struct ShapedText {
+    enum { Available = 64 };
+    HB_ShaperItem item;
+    HB_Glyph glyphs[Available];
+    HB_GlyphAttributes attributes[Available];
+    HB_Fixed advances[Available];
+    HB_FixedPoint offsets[Available];
+    unsigned short logClusters[Available];
+
+    ShapedText(const unsigned short *text, HB_Script script, HB_Font font, HB_Face face)
+    {
+        item = runItem(text, script, font, face);
+    }
+
+    bool shape()
+    {
+        memset(attributes, 0, sizeof(attributes));
+        memset(offsets, 0, sizeof(offsets));
+        item.num_glyphs = Available;
+        item.glyphs = glyphs;
+        item.attributes = attributes;
+        item.advances = advances;
+        item.offsets = offsets;
+        item.log_clusters = logClusters;
+        return HB_ShapeItem(&item);
+    }
+
+    bool sameGlyphsAs(const ShapedText &other) const
+    {
+        return item.num_glyphs == other.item.num_glyphs
+            && !memcmp(glyphs, other.glyphs, item.num_glyphs * sizeof(HB_Glyph));
+    }
+};
+
+// Running out of memory while the lookups are loaded for the first time must fail the item,
+// and must not keep the face from shaping it right once there is memory again.
+void tst_QScriptEngine::outOfMemory()
+{
+#ifndef FAIL_ALLOCATIONS
+    QSKIP("can't make allocations fail here", SkipAll);
+#else
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    TestFont font(face);
+
+    static const unsigned short text[] = {
+        0x0644, 0x0627, 0x0020, 0x0633, 0x0644, 0x0627, 0x0645, 0x0020, 0x0628, 0x0650, 0x0633, 0x0652,
+        0x0645, 0x0650, 0
+    };
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    ShapedText expected(text, HB_Script_Arabic, &font.font, hbFace);
+    QVERIFY(expected.shape());
+    HB_FreeFace(hbFace);
+
+    // fail each allocation of the first shaping in turn, until it needs no more
+    bool failed = true;
+    for (long n = 0; failed; ++n) {
+        hbFace = HB_NewFace(face, hb_getSFntTable);
+        QVERIFY(hbFace && hbFace->context);
+
+        ShapedText shaped(text, HB_Script_Arabic, &font.font, hbFace);
+        allocationsToFail = n;
+        bool ok = shaped.shape();
+        failed = allocationsToFail < 0;
+        allocationsToFail = -1;
+
+        if (ok) {
+            QVERIFY(shaped.sameGlyphsAs(expected));
+        } else {
+            QVERIFY(failed);
+            QCOMPARE(hbFace->context->error, HB_Err_Out_Of_Memory);
+            QCOMPARE(shaped.item.num_glyphs, hb_uint32(0));
+        }
+
+        // with memory again
+        QVERIFY(shaped.shape());
+        QVERIFY(shaped.sameGlyphsAs(expected));
+
+        HB_FreeFace(hbFace);
+    }
+
+    FT_Done_Face(face);
+#endif
+}
+
+// The made up kerning pairs: glyphs 10 to 12 in classes 1, 0 and 1 followed by glyphs 20 to 22
+// in classes 1, 2 and 0, with device adjustments for 11 to 15 pixels per em.
+enum { KernFirstSize = 11, KernSizes = 5 };
+
+static void kernValues(int class1, int class2, int *xPlacement1, int *xAdvance1, int *xPlacement2,
+                       int *xAdvanceDeltas1, int *xPlacementDeltas2)
+{
+    *xPlacement1 = 3 + 5 * class1 + class2;
+    *xAdvance1 = -40 - 7 * class1 - 11 * class2;
+    *xPlacement2 = 17 - class1 - 2 * class2;
+    for (int i = 0; i < KernSizes; ++i) {
+        xAdvanceDeltas1[i] = (class1 + class2 + i) % 8 - 3;
+        xPlacementDeltas2[i] = 2 - (3 * class1 + class2 + i) % 6;
+    }
+}
+
+static QByteArray kernTable()
+{
+    static const int classes1[] = { 1, 0, 1 };
+    static const int classes2[] = { 1, 2 };
+
+    MadeUpTable table;
+    TablePiece *pairs = table.piece();
+    pairs->u16(2).offset(table.coverage(10, 12))
+        .u16(HB_GPOS_FORMAT_HAVE_X_PLACEMENT | HB_GPOS_FORMAT_HAVE_X_ADVANCE | HB_GPOS_FORMAT_HAVE_X_ADVANCE_DEVICE)
+        .u16(HB_GPOS_FORMAT_HAVE_X_PLACEMENT | HB_GPOS_FORMAT_HAVE_X_PLACEMENT_DEVICE)
+        .offset(table.classDef(10, 3, classes1)).offset(table.classDef(20, 2, classes2))
+        .u16(2).u16(3);
+    for (int class1 = 0; class1 < 2; ++class1) {
+        for (int class2 = 0; class2 < 3; ++class2) {
+            int xPlacement1, xAdvance1, xPlacement2, xAdvanceDeltas1[KernSizes], xPlacementDeltas2[KernSizes];
+            kernValues(class1, class2, &xPlacement1, &xAdvance1, &xPlacement2, xAdvanceDeltas1, xPlacementDeltas2);
+            pairs->u16(xPlacement1).u16(xAdvance1).offset(table.device(KernFirstSize, KernSizes, xAdvanceDeltas1))
+                .u16(xPlacement2).offset(table.device(KernFirstSize, KernSizes, xPlacementDeltas2));
+        }
+    }
+
+    TablePiece *lookup = table.lookup(2, 0, &pairs, 1);
+    return table.layoutTable(&lookup, 1);
+}
+
+// Positions every pair of the made up kerning table with `face' at `ppem' pixels per em and
+// tells whether it got what the values and device tables of the pair give at that size.
+static bool sameAsKernValues(HB_Face hbFace, FT_Face face, int ppem)
+{
+    static const int classes1[] = { 1, 0, 1 };
+    static const int classes2[] = { 1, 2, 0 };
+
+    FT_Set_Pixel_Sizes(face, 0, ppem);
+    TestFont font(face);
+    if (!font.addFeatures(hbFace, HB_MAKE_TAG('l', 'a', 't', 'n'), 0x1))
+        return false;
+
+    for (int first = 0; first < 3; ++first) {
+        for (int second = 0; second < 3; ++second) {
+            HB_Buffer buffer;
+            if (hb_buffer_new(&buffer))
+                return false;
+            hb_buffer_add_glyph(buffer, 10 + first, 0, 0);
+            hb_buffer_add_glyph(buffer, 20 + second, 0, 1);
+            HB_Error error = HB_GPOS_Apply_Plan(&font.font, hbFace->gpos, &font.gposPlan, 0, buffer, false, false);
+
+            int xPlacement1, xAdvance1, xPlacement2, xAdvanceDeltas1[KernSizes], xPlacementDeltas2[KernSizes];
+            kernValues(classes1[first], classes2[second], &xPlacement1, &xAdvance1, &xPlacement2,
+                       xAdvanceDeltas1, xPlacementDeltas2);
+            int size = ppem - KernFirstSize;
+            bool inDevice = size >= 0 && size < KernSizes;
+            HB_Fixed scale = font.font.x_scale;
+
+            bool same = error == HB_Err_Ok
+                && buffer->positions[0].x_pos == scale * xPlacement1 / 0x10000
+                && buffer->positions[0].x_advance
+                   == scale * xAdvance1 / 0x10000 + (inDevice ? xAdvanceDeltas1[size] * 64 : 0)
+                && buffer->positions[1].x_pos
+                   == scale * xPlacement2 / 0x10000 + (inDevice ? xPlacementDeltas2[size] * 64 : 0);
+            hb_buffer_free(buffer);
+            if (!same)
+                return false;
+        }
+    }
+    return true;
+}
+
+static int kernMatrixCount(HB_Face hbFace)
+{
+    int count = 0;
+    for (HB_KernMatrix *m = hbFace->gpos->kern_matrices; m; m = m->chain)
+        ++count;
+    return count;
+}
+
+// Kerning pairs of a class based subtable are resolved into a matrix for each font size, with
+// the adjustments of the device tables for that size. A face that has matrices for as many
+// sizes as it keeps positions the pairs one by one, and must give the same.
+void tst_QScriptEngine::kernMatrix()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    MadeUpFace tables;
+    tables.gpos = kernTable();
+    HB_Face matrixFace = HB_NewFace(&tables, madeUpFaceTable);
+    HB_Face pairFace = HB_NewFace(&tables, madeUpFaceTable);
+    QVERIFY(matrixFace->gpos && pairFace->gpos);
+
+    for (int ppem = 20; kernMatrixCount(pairFace) < HB_KERN_MATRIX_MAX_SCALES; ppem += 4)
+        QVERIFY(sameAsKernValues(pairFace, face, ppem));
+
+    static const int sizes[] = { 12, 14, 12 };
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(sameAsKernValues(matrixFace, face, sizes[i]));
+        QVERIFY(sameAsKernValues(pairFace, face, sizes[i]));
+    }
+    QCOMPARE(kernMatrixCount(matrixFace), 2);
+    QCOMPARE(kernMatrixCount(pairFace), int(HB_KERN_MATRIX_MAX_SCALES));
+
+    HB_FreeFace(matrixFace);
+    HB_FreeFace(pairFace);
+    FT_Done_Face(face);
+}
+
+// A made up GDEF table with the glyph classes of `count' glyphs from `first' on.
+static QByteArray glyphClassTable(int first, int count, const int *classes)
+{
+    MadeUpTable table;
+    TablePiece *header = table.piece();
+    header->u16(1).u16(0).offset(table.classDef(first, count, classes)).u16(0).u16(0).u16(0);
+    return table.write(header);
+}
+
+// A mark is attached to the base glyph before it, which its position refers to by the number of
+// glyphs in between; a mark further away than a position can count isn't attached.
+void tst_QScriptEngine::markDistance()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    // glyph 1 is a base glyph and glyph 2 a mark (classes 1 and 3), anchored 500 units apart
+    static const int classes[] = { 1, 3 };
+    MadeUpTable table;
+    TablePiece *markArray = table.piece();
+    TablePiece *baseArray = table.piece();
+    markArray->u16(1).u16(0).offset(&table.piece()->u16(1).u16(0).u16(0));
+    baseArray->u16(1).offset(&table.piece()->u16(1).u16(500).u16(0));
+    TablePiece *markBase = table.piece();
+    markBase->u16(1).offset(table.coverage(2, 2)).offset(table.coverage(1, 1)).u16(1)
+        .offset(markArray).offset(baseArray);
+    TablePiece *lookup = table.lookup(4, 0, &markBase, 1);
+
+    MadeUpFace tables;
+    tables.gdef = glyphClassTable(1, 2, classes);
+    tables.gpos = table.layoutTable(&lookup, 1);
+    HB_Face hbFace = HB_NewFace(&tables, madeUpFaceTable);
+    QVERIFY(hbFace->gdef && hbFace->gpos);
+    FT_Set_Pixel_Sizes(face, 0, 32);
+    TestFont font(face);
+    QVERIFY(font.addFeatures(hbFace, HB_MAKE_TAG('l', 'a', 't', 'n'), 0x1));
+
+    const HB_UInt marks = HB_POSITION_MAX_BACK + 2;
+    HB_Buffer buffer;
+    QCOMPARE(hb_buffer_new(&buffer), HB_Err_Ok);
+    QCOMPARE(hb_buffer_add_glyph(buffer, 1, 0, 0), HB_Err_Ok);
+    for (HB_UInt i = 1; i <= marks; ++i)
+        QCOMPARE(hb_buffer_add_glyph(buffer, 2, 0, i), HB_Err_Ok);
+    QCOMPARE(HB_GPOS_Apply_Plan(&font.font, hbFace->gpos, &font.gposPlan, 0, buffer, false, false), HB_Err_Ok);
+
+    const HB_Fixed x = HB_Fixed(font.font.x_scale) * 500 / 0x10000;
+    QVERIFY(x != 0);
+    for (HB_UInt i = 1; i <= marks; ++i) {
+        const HB_PositionRec &position = buffer->positions[i];
+        if (i <= HB_POSITION_MAX_BACK) {
+            QCOMPARE(HB_UInt(position.back), i);
+            QCOMPARE(position.x_pos, x);
+        } else {
+            QCOMPARE(HB_UInt(position.back), HB_UInt(0));
+            QCOMPARE(position.x_pos, HB_Fixed(0));
+        }
+    }
+
+    hb_buffer_free(buffer);
+    HB_FreeFace(hbFace);
+    FT_Done_Face(face);
+}
+
+
+// A rule of glyphs of a made up chaining context subtable, which applies lookup `lookup' to its
+// first input glyph. The backtrack goes backwards from the glyph before the input, `input'
+// starts with the second input glyph.
+static TablePiece *chainRule(MadeUpTable &table, const QList<int> &backtrack, const QList<int> &input,
+                             const QList<int> &lookahead, int lookup)
+{
+    TablePiece *rule = table.piece();
+    rule->u16(backtrack.size());
+    for (int i = 0; i < backtrack.size(); ++i)
+        rule->u16(backtrack.at(i));
+    rule->u16(input.size() + 1);
+    for (int i = 0; i < input.size(); ++i)
+        rule->u16(input.at(i));
+    rule->u16(lookahead.size());
+    for (int i = 0; i < lookahead.size(); ++i)
+        rule->u16(lookahead.at(i));
+    rule->u16(1).u16(0).u16(lookup);
+    return rule;
+}
+
+// a chaining context subtable of rules of glyphs (format 1) for `glyph' only
+static TablePiece *chainSubtable(MadeUpTable &table, int glyph, const QList<TablePiece *> &rules)
+{
+    TablePiece *ruleSet = table.piece();
+    ruleSet->u16(rules.size());
+    for (int i = 0; i < rules.size(); ++i)
+        ruleSet->offset(rules.at(i));
+    TablePiece *subtable = table.piece();
+    subtable->u16(1).offset(table.coverage(glyph, glyph)).u16(1).offset(ruleSet);
+    return subtable;
+}
+
+static QList<int> repeated(int glyph, int count)
+{
+    QList<int> glyphs;
+    for (int i = 0; i < count; ++i)
+        glyphs.append(glyph);
+    return glyphs;
+}
+
+// A made up GSUB or GPOS table whose only feature applies a chaining context lookup that ignores
+// marks. Its rules apply lookup k of 1 to 7, which adds 200 + k to a glyph resp. moves it 100 * k
+// units to the right.
+static QByteArray chainTable(bool gpos)
+{
+    const QList<int> none;
+    MadeUpTable table;
+
+    // glyph 10 with 5 before it and 11 after it, with 11 and 12 after it as input and then as
+    // lookahead (the same glyphs for the trie), or alone
+    QList<TablePiece *> rules10;
+    rules10.append(chainRule(table, QList<int>() << 5, none, QList<int>() << 11, 1));
+    rules10.append(chainRule(table, none, QList<int>() << 11 << 12, none, 2));
+    rules10.append(chainRule(table, none, none, QList<int>() << 11 << 12, 3));
+    rules10.append(chainRule(table, none, none, none, 4));
+
+    // glyph 40 with one of 300 glyphs after it, or between 130 glyphs 50 and 60 glyphs 51, which
+    // is more than the matching keeps on the stack
+    QList<TablePiece *> rules40;
+    for (int i = 0; i < 300; ++i)
+        rules40.append(chainRule(table, none, none, QList<int>() << 100 + i, i == 299 ? 5 : 6));
+    rules40.append(chainRule(table, repeated(50, 130), none, repeated(51, 60), 7));
+
+    TablePiece *subtables[] = { chainSubtable(table, 10, rules10), chainSubtable(table, 40, rules40) };
+    TablePiece *lookups[8];
+    lookups[0] = table.lookup(gpos ? 8 : 6, HB_LOOKUP_FLAG_IGNORE_MARKS, subtables, 2);
+    for (int k = 1; k < 8; ++k) {
+        TablePiece *single = table.piece();
+        single->u16(1).offset(table.coverage(10, 40));
+        if (gpos)
+            single->u16(HB_GPOS_FORMAT_HAVE_X_PLACEMENT).u16(100 * k);
+        else
+            single->u16(200 + k);
+        lookups[k] = table.lookup(1, 0, &single, 1);
+    }
+    return table.layoutTable(lookups, 8, 1);
+}
+
+// Applies the table of chainTable that `hbFace' has to `glyphs' and returns the lookup applied
+// to the glyph at `pos', 0 for none and -1 if that fails.
+static int chainLookupAt(HB_Face hbFace, TestFont &font, const QList<int> &glyphs, int pos)
+{
+    HB_Buffer buffer;
+    if (hb_buffer_new(&buffer))
+        return -1;
+    HB_Error error = HB_Err_Ok;
+    for (int i = 0; i < glyphs.size() && !error; ++i)
+        error = hb_buffer_add_glyph(buffer, glyphs.at(i), 0, i);
+    if (!error && hbFace->gsub)
+        error = HB_GSUB_Apply_Plan(hbFace->gsub, &font.gsubPlan, buffer);
+    else if (!error)
+        error = HB_GPOS_Apply_Plan(&font.font, hbFace->gpos, &font.gposPlan, 0, buffer, false, false);
+
+    int lookup = -1;
+    if (error == HB_Err_Not_Covered) {
+        lookup = 0;
+    } else if (!error && hbFace->gsub) {
+        int glyph = buffer->in_string[pos].gindex;
+        if (buffer->in_length == HB_UInt(glyphs.size()))
+            lookup = glyph == glyphs.at(pos) ? 0 : glyph - glyphs.at(pos) - 200;
+    } else if (!error) {
+        for (int k = 0; k < 8; ++k)
+            if (buffer->positions[pos].x_pos == HB_Fixed(font.font.x_scale) * 100 * k / 0x10000)
+                lookup = k;
+    }
+    hb_buffer_free(buffer);
+    return lookup;
+}
+
+// The rules of a chaining context subtable are matched through a trie, which must still apply
+// the first matching rule in the order of the font, skip the marks in the backtrack (taken from
+// the output string in GSUB) and the rest of the context, and match long rules.
+void tst_QScriptEngine::chainTrie()
+{
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    // glyph 7 is a mark
+    static const int classes[] = { 3 };
+    MadeUpFace gsubTables;
+    MadeUpFace gposTables;
+    gsubTables.gdef = gposTables.gdef = glyphClassTable(7, 1, classes);
+    gsubTables.gsub = chainTable(false);
+    gposTables.gpos = chainTable(true);
+
+    FT_Set_Pixel_Sizes(face, 0, 32);
+    for (int i = 0; i < 2; ++i) {
+        HB_Face hbFace = HB_NewFace(i ? &gposTables : &gsubTables, madeUpFaceTable);
+        QVERIFY(hbFace->gdef && (i ? hbFace->gpos != 0 : hbFace->gsub != 0));
+        TestFont font(face);
+        QVERIFY(font.addFeatures(hbFace, HB_MAKE_TAG('l', 'a', 't', 'n'), 0x1));
+
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 5 << 10 << 11 << 12, 1), 1);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 6 << 10 << 11 << 12, 1), 2);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 6 << 10 << 11 << 13, 1), 4);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 5 << 10 << 13, 1), 4);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 10 << 11, 0), 4);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 5 << 7 << 7 << 10 << 7 << 11, 3), 1);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 6 << 7 << 10 << 7 << 11 << 7 << 12, 2), 2);
+
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 40 << 399, 0), 5);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 40 << 150, 0), 6);
+        QCOMPARE(chainLookupAt(hbFace, font, QList<int>() << 40 << 400, 0), 0);
+        QCOMPARE(chainLookupAt(hbFace, font, repeated(50, 130) << 40 << repeated(51, 60), 130), 7);
+        QCOMPARE(chainLookupAt(hbFace, font, repeated(50, 129) << 40 << repeated(51, 60), 129), 0);
+        QCOMPARE(chainLookupAt(hbFace, font, repeated(50, 130) << 40 << repeated(51, 59), 130), 0);
+        QCOMPARE(chainLookupAt(hbFace, font, repeated(50, 65) << 7 << repeated(50, 65) << 40 << 7
+                               << repeated(51, 60), 131), 7);
+
+        HB_FreeFace(hbFace);
+    }
+    FT_Done_Face(face);
+}
+
+
+// a ligature of `glyph' and the glyphs of `components' after it
+static TablePiece *ligature(MadeUpTable &table, int glyph, const QList<int> &components)
+{
+    TablePiece *ligature = table.piece();
+    ligature->u16(glyph).u16(components.size() + 1);
+    for (int i = 0; i < components.size(); ++i)
+        ligature->u16(components.at(i));
+    return ligature;
+}
+
+// a ligature substitution subtable for the ligatures starting with `glyph' only
+static TablePiece *ligatureSubtable(MadeUpTable &table, int glyph, const QList<TablePiece *> &ligatures)
+{
+    TablePiece *ligatureSet = table.piece();
+    ligatureSet->u16(ligatures.size());
+    for (int i = 0; i < ligatures.size(); ++i)
+        ligatureSet->offset(ligatures.at(i));
+    TablePiece *subtable = table.piece();
+    subtable->u16(1).offset(table.coverage(glyph, glyph)).u16(1).offset(ligatureSet);
+    return subtable;
+}
+
+// A made up GSUB table of ligatures that ignore marks, which its feature applies directly or, if
+// `nested', through a chaining context lookup with an input of 20 21 22 or of 20 21.
+static QByteArray ligatureTable(bool nested)
+{
+    const QList<int> none;
+    MadeUpTable table;
+
+    // 100 of 10 11 before 101 of 10 11 12, 102 of 20 21 22 before 103 of 20 21, 104 of 30 31
+    // and 105 of 30 alone, with a ComponentCount of 0
+    QList<TablePiece *> ligatures[4];
+    ligatures[0].append(ligature(table, 100, QList<int>() << 11));
+    ligatures[0].append(ligature(table, 101, QList<int>() << 11 << 12));
+    ligatures[1].append(ligature(table, 102, QList<int>() << 21 << 22));
+    ligatures[1].append(ligature(table, 103, QList<int>() << 21));
+    ligatures[2].append(ligature(table, 104, QList<int>() << 31));
+    ligatures[2].append(&table.piece()->u16(105).u16(0));
+    ligatures[3].append(ligature(table, 106, QList<int>() << 41 << 42));
+
+    TablePiece *subtables[4];
+    for (int i = 0; i < 4; ++i)
+        subtables[i] = ligatureSubtable(table, 10 * (i + 1), ligatures[i]);
+    TablePiece *lookups[2];
+    lookups[1] = table.lookup(4, HB_LOOKUP_FLAG_IGNORE_MARKS, subtables, 4);
+
+    QList<TablePiece *> rules;
+    rules.append(chainRule(table, none, QList<int>() << 21 << 22, none, 1));
+    rules.append(chainRule(table, none, QList<int>() << 21, none, 1));
+    TablePiece *context = chainSubtable(table, 20, rules);
+    lookups[0] = nested ? table.lookup(6, 0, &context, 1) : lookups[1];
+    return table.layoutTable(lookups, nested ? 2 : 1, 1);
+}
+
+// `glyphs' after the table of ligatureTable that `hbFace' has is applied to them, 0 if that fails
+static HB_Buffer ligatureBuffer(HB_Face hbFace, const QList<int> &glyphs)
+{
+    HB_Buffer buffer;
+    if (hb_buffer_new(&buffer))
+        return 0;
+    HB_Error error = HB_Err_Ok;
+    for (int i = 0; i < glyphs.size() && !error; ++i)
+        error = hb_buffer_add_glyph(buffer, glyphs.at(i), 0, i);
+
+    HB_LookupPlan plan;
+    memset(&plan, 0, sizeof(plan));
+    if (!error && !addGsubFeatures(hbFace->gsub, HB_MAKE_TAG('l', 'a', 't', 'n'), 0x1, &plan))
+        error = HB_Err_Invalid_Argument;
+    if (!error)
+        error = HB_GSUB_Apply_Plan(hbFace->gsub, &plan, buffer);
+    HB_Done_LookupPlan(&plan);
+
+    if (error && error != HB_Err_Not_Covered) {
+        hb_buffer_free(buffer);
+        return 0;
+    }
+    return buffer;
+}
+
+static QList<int> ligatureGlyphs(HB_Face hbFace, const QList<int> &glyphs)
+{
+    QList<int> result;
+    HB_Buffer buffer = ligatureBuffer(hbFace, glyphs);
+    if (!buffer)
+        return result;
+    for (HB_UInt i = 0; i < buffer->in_length; ++i)
+        result.append(buffer->in_string[i].gindex);
+    hb_buffer_free(buffer);
+    return result;
+}
+
+// The ligatures of a set are matched through a trie, which must still apply the first matching
+// ligature in the order of the font, only try the ligatures before the first one longer than
+// the context of a nested lookup, and give the marks skipped within a ligature the component
+// they follow.
+void tst_QScriptEngine::ligatureTrie()
+{
+    // glyph 7 is a mark
+    static const int classes[] = { 3 };
+    MadeUpFace directTables;
+    MadeUpFace nestedTables;
+    directTables.gdef = nestedTables.gdef = glyphClassTable(7, 1, classes);
+    directTables.gsub = ligatureTable(false);
+    nestedTables.gsub = ligatureTable(true);
+    HB_Face direct = HB_NewFace(&directTables, madeUpFaceTable);
+    HB_Face nested = HB_NewFace(&nestedTables, madeUpFaceTable);
+    QVERIFY(direct->gdef && direct->gsub && nested->gdef && nested->gsub);
+
+    QCOMPARE(ligatureGlyphs(direct, QList<int>() << 10 << 11 << 12), QList<int>() << 100 << 12);
+    QCOMPARE(ligatureGlyphs(direct, QList<int>() << 10 << 12), QList<int>() << 10 << 12);
+    QCOMPARE(ligatureGlyphs(direct, QList<int>() << 20 << 21 << 22), QList<int>() << 102);
+    QCOMPARE(ligatureGlyphs(direct, QList<int>() << 20 << 21 << 23), QList<int>() << 103 << 23);
+    QCOMPARE(ligatureGlyphs(direct, QList<int>() << 30 << 31), QList<int>() << 104);
+    QCOMPARE(ligatureGlyphs(direct, QList<int>() << 30 << 32), QList<int>() << 105 << 32);
+    QCOMPARE(ligatureGlyphs(direct, QList<int>() << 30), QList<int>() << 105);
+
+    // 103 fits into the context 20 21 but comes after 102, which doesn't
+    QCOMPARE(ligatureGlyphs(nested, QList<int>() << 20 << 21 << 22), QList<int>() << 102);
+    QCOMPARE(ligatureGlyphs(nested, QList<int>() << 20 << 21 << 23), QList<int>() << 20 << 21 << 23);
+
+    HB_Buffer buffer = ligatureBuffer(direct, QList<int>() << 40 << 7 << 41 << 7 << 7 << 42 << 7);
+    QVERIFY(buffer);
+    static const int glyphs[] = { 106, 7, 7, 7, 7 };
+    static const int components[] = { 0xFFFF, 0, 1, 1 };
+    QCOMPARE(buffer->in_length, HB_UInt(5));
+    for (int i = 0; i < 5; ++i)
+        QCOMPARE(int(buffer->in_string[i].gindex), glyphs[i]);
+    QVERIFY(buffer->in_string[0].ligID != 0);
+    for (int i = 1; i < 4; ++i) {
+        QCOMPARE(int(buffer->in_string[i].component), components[i]);
+        QCOMPARE(buffer->in_string[i].ligID, buffer->in_string[0].ligID);
+    }
+    QVERIFY(buffer->in_string[4].ligID != buffer->in_string[0].ligID);
+    hb_buffer_free(buffer);
+
+    HB_FreeFace(direct);
+    HB_FreeFace(nested);
+}
+
+
+// A made up GSUB table whose feature applies three chaining context lookups: one that ignores
+// marks and adds 200 to a glyph 10 after a glyph 210, one that makes a ligature 100 of 20 21,
+// and one whose subtable can't be loaded.
+static QByteArray inPlaceTable()
+{
+    const QList<int> none;
+    MadeUpTable table;
+
+    QList<TablePiece *> substituted;
+    substituted.append(chainRule(table, QList<int>() << 210, none, none, 3));
+    QList<TablePiece *> ligated;
+    ligated.append(chainRule(table, none, QList<int>() << 21, none, 4));
+    QList<TablePiece *> ligatures;
+    ligatures.append(ligature(table, 100, QList<int>() << 21));
+
+    TablePiece *subtables[] = {
+        chainSubtable(table, 10, substituted), chainSubtable(table, 20, ligated),
+        &table.piece()->u16(9), table.piece(), ligatureSubtable(table, 20, ligatures)
+    };
+    subtables[3]->u16(1).offset(table.coverage(10, 40)).u16(200);
+
+    TablePiece *lookups[] = {
+        table.lookup(6, HB_LOOKUP_FLAG_IGNORE_MARKS, &subtables[0], 1), table.lookup(6, 0, &subtables[1], 1),
+        table.lookup(6, 0, &subtables[2], 1), table.lookup(1, 0, &subtables[3], 1),
+        table.lookup(4, 0, &subtables[4], 1)
+    };
+    return table.layoutTable(lookups, 5, 3);
+}
+
+// the glyphs that `plan' for `hbFace' makes of `glyphs', none if applying it fails
+static QList<int> planGlyphs(HB_Face hbFace, HB_LookupPlan *plan, const QList<int> &glyphs)
+{
+    QList<int> result;
+    HB_Buffer buffer;
+    if (hb_buffer_new(&buffer))
+        return result;
+    HB_Error error = HB_Err_Ok;
+    for (int i = 0; i < glyphs.size() && !error; ++i)
+        error = hb_buffer_add_glyph(buffer, glyphs.at(i), 0, i);
+    if (!error)
+        error = HB_GSUB_Apply_Plan(hbFace->gsub, plan, buffer);
+    if (!error || error == HB_Err_Not_Covered) {
+        for (HB_UInt i = 0; i < buffer->in_length; ++i)
+            result.append(buffer->in_string[i].gindex);
+    }
+    hb_buffer_free(buffer);
+    return result;
+}
+
+// A composed plan applies the lookups that only replace glyphs one by one in place. A context
+// lookup doing so must see the glyphs it has replaced before in its backtrack; one that nests a
+// ligature lookup, or whose subtables can't be loaded, mustn't be applied in place.
+void tst_QScriptEngine::inPlace()
+{
+    // glyph 7 is a mark
+    static const int classes[] = { 3 };
+    MadeUpFace tables;
+    tables.gdef = glyphClassTable(7, 1, classes);
+    tables.gsub = inPlaceTable();
+    HB_Face hbFace = HB_NewFace(&tables, madeUpFaceTable);
+    QVERIFY(hbFace->gdef && hbFace->gsub);
+
+    HB_LookupPlan plain;
+    HB_LookupPlan composed;
+    memset(&plain, 0, sizeof(plain));
+    memset(&composed, 0, sizeof(composed));
+    const HB_UInt latn = HB_MAKE_TAG('l', 'a', 't', 'n');
+    QVERIFY(addGsubFeatures(hbFace->gsub, latn, 0x1, &plain));
+    QVERIFY(addGsubFeatures(hbFace->gsub, latn, 0x1, &composed));
+    QCOMPARE(HB_GSUB_Compose_Plan(hbFace->gsub, &composed), HB_Err_Ok);
+
+    QCOMPARE(composed.LookupCount, HB_UInt(3));
+    for (HB_UInt i = 0; i < 3; ++i) {
+        QCOMPARE(HB_UInt(composed.Lookup[i].LookupIndex), i);
+        QCOMPARE(bool(composed.Lookup[i].InPlace), i == 0);
+    }
+
+    const QList<int> glyphs = QList<int>() << 210 << 10 << 7 << 10 << 10 << 20 << 21 << 10;
+    const QList<int> expected = QList<int>() << 210 << 210 << 7 << 210 << 210 << 100 << 10;
+    QCOMPARE(planGlyphs(hbFace, &plain, glyphs), expected);
+    QCOMPARE(planGlyphs(hbFace, &composed, glyphs), expected);
+
+    HB_Done_LookupPlan(&plain);
+    HB_Done_LookupPlan(&composed);
+    HB_FreeFace(hbFace);
+}
+
+
+#ifdef HB_PARALLEL_GINDEX
+// whether the parallel glyph IDs of `buffer' are those of its input string
+static bool sameParallelGlyphIds(HB_Buffer buffer)
+{
+    for (HB_UInt i = 0; i < buffer->in_length; ++i)
+        if (buffer->in_gindex[i] != HB_UShort(buffer->in_string[i].gindex))
+            return false;
+    return true;
+}
+#endif
+
+// With HB_PARALLEL_GINDEX, the buffer keeps the glyph IDs of its strings in arrays of their own,
+// which must follow the strings through substitutions that change the length, substitutions in
+// place and composed plans.
+void tst_QScriptEngine::parallelGlyphIds()
+{
+#ifndef HB_PARALLEL_GINDEX
+    QSKIP("the buffer has no parallel glyph IDs", SkipAll);
+#else
+    FT_Face face = loadFace("DejaVuSans.ttf");
+    if (!face)
+        QSKIP("couldn't find DejaVuSans.ttf", SkipAll);
+
+    HB_Face hbFace = HB_NewFace(face, hb_getSFntTable);
+    QVERIFY(hbFace->gsub && hbFace->gpos);
+
+    FT_Set_Pixel_Sizes(face, 0, 32);
+    TestFont plain(face);
+    TestFont composed(face);
+    const HB_UInt latn = HB_MAKE_TAG('l', 'a', 't', 'n');
+    const HB_UInt arab = HB_MAKE_TAG('a', 'r', 'a', 'b');
+    QVERIFY(plain.addFeatures(hbFace, latn, 0x1) && plain.addFeatures(hbFace, arab, 0x1));
+    QVERIFY(composed.addFeatures(hbFace, latn, 0x1) && composed.addFeatures(hbFace, arab, 0x1));
+    QCOMPARE(HB_GSUB_Compose_Plan(hbFace->gsub, &composed.gsubPlan), HB_Err_Ok);
+
+    static const unsigned short texts[][24] = {
+        { 'o', 'f', 'f', 'i', 'c', 'e', ' ', 'a', 'f', 'f', 'l', 'u', 'e', 'n', 't', 0 },
+        { 'T', 'o', ' ', 'W', 'a', 0x301, 0x327, ' ', 'f', 'f', 'i', 0x323, 0x302, 0 },
+        { 0x644, 0x627, ' ', 0x633, 0x644, 0x627, 0x645, ' ', 0x644, 0x650, 0x627, 0 }
+    };
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            TestFont &font = j ? composed : plain;
+            HB_Buffer buffer = textBuffer(face, texts[i]);
+            QVERIFY(buffer && sameParallelGlyphIds(buffer));
+            HB_GSUB_Apply_Plan(hbFace->gsub, &font.gsubPlan, buffer);
+            QVERIFY(sameParallelGlyphIds(buffer));
+            HB_GPOS_Apply_Plan(&font.font, hbFace->gpos, &font.gposPlan, 0, buffer, false, false);
+            QVERIFY(sameParallelGlyphIds(buffer));
+            hb_buffer_free(buffer);
+        }
+    }
+
+    HB_FreeFace(hbFace);
+    FT_Done_Face(face);
+#endif
+}
+
 
 QTEST_MAIN(tst_QScriptEngine)
 #include "main.moc"